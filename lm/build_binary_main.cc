@@ -18,12 +18,16 @@
 #include <unistd.h>
 #endif
 
+#ifdef WITH_THREADS
+#include <boost/thread/thread.hpp>
+#endif
+
 namespace lm {
 namespace ngram {
 namespace {
 
-void Usage(const char *name, const char *default_mem) {
-  std::cerr << "Usage: " << name << " [-u log10_unknown_probability] [-s] [-i] [-w mmap|after] [-p probing_multiplier] [-T trie_temporary] [-S trie_building_mem] [-q bits] [-b bits] [-a bits] [type] input.arpa [output.mmap]\n\n"
+void Usage(const char *name, const char *default_mem, std::size_t default_threads) {
+  std::cerr << "Usage: " << name << " [-u log10_unknown_probability] [-s] [-i] [-w mmap|after] [-j threads] [-p probing_multiplier] [-T trie_temporary] [-S trie_building_mem] [-q bits] [-b bits] [-a bits] [type] input.arpa [output.mmap]\n\n"
 "-u sets the log10 probability for <unk> if the ARPA file does not have one.\n"
 "   Default is -100.  The ARPA file will always take precedence.\n"
 "-s allows models to be built even if they do not have <s> and </s>.\n"
@@ -34,7 +38,9 @@ void Usage(const char *name, const char *default_mem) {
 "-r \"order1.arpa order2 order3 order4\" adds lower-order rest costs from these\n"
 "   model files.  order1.arpa must be an ARPA file.  All others may be ARPA or\n"
 "   the same data structure as being built.  All files must have the same\n"
-"   vocabulary.  For probing, the unigrams must be in the same order.\n\n"
+"   vocabulary.  For probing, the unigrams must be in the same order.\n"
+"-j sets the number of threads that parse the ARPA file and, for trie, sort.\n"
+"   Default is " << default_threads << ".  The binary file does not depend on it.\n\n"
 "type is either probing or trie.  Default is probing.\n\n"
 "probing uses a probing hash table.  It is the fastest but uses the most memory.\n"
 "-p sets the space multiplier and must be >1.0.  The default is 1.5.\n\n"
@@ -103,16 +109,21 @@ int main(int argc, char *argv[]) {
   using namespace lm::ngram;
 
   const char *default_mem = util::GuessPhysicalMemory() ? "80%" : "1G";
+  std::size_t default_threads = 1;
+#ifdef WITH_THREADS
+  default_threads = std::max<std::size_t>(1, boost::thread::hardware_concurrency());
+#endif
 
   if (argc == 2 && !strcmp(argv[1], "--help"))
-    Usage(argv[0], default_mem);
+    Usage(argv[0], default_mem, default_threads);
 
   try {
     bool quantize = false, set_backoff_bits = false, bhiksha = false, set_write_method = false, rest = false;
     lm::ngram::Config config;
     config.building_memory = util::ParseSize(default_mem);
+    config.building_threads = default_threads;
     int opt;
-    while ((opt = getopt(argc, argv, "q:b:a:u:p:t:T:m:S:w:sir:h")) != -1) {
+    while ((opt = getopt(argc, argv, "q:b:a:u:p:t:T:m:S:w:j:sir:h")) != -1) {
       switch(opt) {
         case 'q':
           config.prob_bits = ParseBitCount(optarg);
@@ -151,9 +162,12 @@ int main(int argc, char *argv[]) {
           } else if (!strcmp(optarg, "after")) {
             config.write_method = Config::WRITE_AFTER;
           } else {
-            Usage(argv[0], default_mem);
+            Usage(argv[0], default_mem, default_threads);
           }
           break;
+        case 'j':
+          config.building_threads = std::max<unsigned long>(1, ParseUInt(optarg));
+          break;
         case 's':
           config.sentence_marker_missing = lm::SILENT;
           break;
@@ -167,7 +181,7 @@ int main(int argc, char *argv[]) {
           break;
         case 'h': // help
         default:
-          Usage(argv[0], default_mem);
+          Usage(argv[0], default_mem, default_threads);
       }
     }
     if (!quantize && set_backoff_bits) {
@@ -190,7 +204,7 @@ int main(int argc, char *argv[]) {
       from_file = argv[optind + 1];
       config.write_mmap = argv[optind + 2];
     } else {
-      Usage(argv[0], default_mem);
+      Usage(argv[0], default_mem, default_threads);
       return 1;
     }
     if (!strcmp(model_type, "probing")) {
@@ -221,7 +235,7 @@ int main(int argc, char *argv[]) {
         }
       }
     } else {
-      Usage(argv[0], default_mem);
+      Usage(argv[0], default_mem, default_threads);
     }
   }
   catch (const std::exception &e) {
@@ -72,7 +72,8 @@ int main(int argc, char *argv[]) {
     po::options_description options("Language model building options");
     lm::builder::PipelineConfig pipeline;
 
-    std::string text, intermediate, arpa;
+    std::string text, intermediate, arpa, binary, binary_type;
+    unsigned int prob_bits, backoff_bits, pointer_bits;
     std::vector<std::string> pruning;
     std::vector<std::string> discount_fallback;
     std::vector<std::string> discount_fallback_default;
@@ -100,6 +101,11 @@ int main(int argc, char *argv[]) {
       ("verbose_header", po::bool_switch(&verbose_header), "Add a verbose header to the ARPA file that includes information such as token count, smoothing type, etc.")
       ("text", po::value<std::string>(&text), "Read text from a file instead of stdin")
       ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("binary", po::value<std::string>(&binary), "Write a KenLM binary file directly instead of ARPA, without the text and the separate build_binary step.  Turns off ARPA output (which can be reactivated by --arpa file).")
+      ("binary_type", po::value<std::string>(&binary_type)->default_value("probing"), "Data structure of the --binary file: probing or trie")
+      ("binary_prob_bits", po::value<unsigned int>(&prob_bits), "Quantize probabilities of the trie to this many bits, like build_binary -q")
+      ("binary_backoff_bits", po::value<unsigned int>(&backoff_bits), "Quantize backoffs of the trie to this many bits (default: same as --binary_prob_bits), like build_binary -b")
+      ("binary_pointer_bits", po::value<unsigned int>(&pointer_bits), "Compress trie pointers by chopping this many high bits, like build_binary -a")
       ("intermediate", po::value<std::string>(&intermediate), "Write ngrams to intermediate files.  Turns off ARPA output (which can be reactivated by --arpa file).  Forces --renumber on.")
       ("renumber", po::bool_switch(&pipeline.renumber_vocabulary), "Rrenumber the vocabulary identifiers so that they are monotone with the hash of each string.  This is consistent with the ordering used by the trie data structure.")
       ("collapse_values", po::bool_switch(&pipeline.output_q), "Collapse probability and backoff into a single value, q that yields the same sentence-level probabilities.  See http://kheafield.com/professional/edinburgh/rest_paper.pdf for more details, including a proof.")
@@ -197,15 +203,49 @@ int main(int argc, char *argv[]) {
       out.reset(util::CreateOrThrow(arpa.c_str()));
     }
 
+    // Options for building the binary file, as build_binary would.
+    lm::ngram::ModelType model_type = lm::ngram::PROBING;
+    lm::ngram::Config binary_config;
+    if (vm.count("binary")) {
+      UTIL_THROW_IF(pipeline.output_q, util::Exception, "--binary needs probabilities and backoffs, not --collapse_values");
+      binary_config.write_mmap = binary.c_str();
+      binary_config.temporary_directory_prefix = pipeline.sort.temp_prefix;
+      binary_config.building_memory = pipeline.sort.total_memory;
+      bool quantize = vm.count("binary_prob_bits");
+      UTIL_THROW_IF(!quantize && vm.count("binary_backoff_bits"), util::Exception, "You specified backoff quantization (--binary_backoff_bits) but not probability quantization (--binary_prob_bits)");
+      if (quantize) {
+        UTIL_THROW_IF(prob_bits > 25 || (vm.count("binary_backoff_bits") && backoff_bits > 25), util::Exception, "Bit counts are limited to 25");
+        binary_config.prob_bits = prob_bits;
+        binary_config.backoff_bits = vm.count("binary_backoff_bits") ? backoff_bits : prob_bits;
+      }
+      bool bhiksha = vm.count("binary_pointer_bits");
+      if (bhiksha) {
+        UTIL_THROW_IF(pointer_bits > 25, util::Exception, "Bit counts are limited to 25");
+        binary_config.pointer_bhiksha_bits = pointer_bits;
+      }
+      if (binary_type == "probing") {
+        UTIL_THROW_IF(quantize || bhiksha, util::Exception, "Quantization and pointer compression are only implemented in the trie data structure");
+        binary_config.write_method = lm::ngram::Config::WRITE_AFTER;
+      } else if (binary_type == "trie") {
+        model_type = quantize ? (bhiksha ? lm::ngram::QUANT_ARRAY_TRIE : lm::ngram::QUANT_TRIE) : (bhiksha ? lm::ngram::ARRAY_TRIE : lm::ngram::TRIE);
+        binary_config.write_method = lm::ngram::Config::WRITE_MMAP;
+      } else {
+        UTIL_THROW(util::Exception, "Unknown --binary_type " << binary_type << ", expected probing or trie");
+      }
+    }
+
     try {
       bool writing_intermediate = vm.count("intermediate");
       if (writing_intermediate) {
         pipeline.renumber_vocabulary = true;
       }
       lm::builder::Output output(writing_intermediate ? intermediate : pipeline.sort.temp_prefix, writing_intermediate, pipeline.output_q);
-      if (!writing_intermediate || vm.count("arpa")) {
+      if ((!writing_intermediate && !vm.count("binary")) || vm.count("arpa")) {
         output.Add(new lm::builder::PrintHook(out.release(), verbose_header));
       }
+      if (vm.count("binary")) {
+        output.Add(new lm::builder::BinaryHook(model_type, binary_config));
+      }
       lm::builder::Pipeline(pipeline, in.release(), output);
     } catch (const util::MallocException &e) {
       std::cerr << e.what() << std::endl;
@@ -2,8 +2,13 @@
 
 #include "lm/common/model_buffer.hh"
 #include "lm/common/print.hh"
+#include "lm/model.hh"
+#include "lm/ngram_source.hh"
 #include "util/fake_ofstream.hh"
 #include "util/stream/multi_stream.hh"
+#include "util/stream/stream.hh"
+
+#include <boost/scoped_ptr.hpp>
 
 #include <iostream>
 
@@ -25,7 +30,7 @@ void Output::SinkProbs(util::stream::Chains &chains) {
   chains >> util::stream::kRecycle;
   chains.Wait(false);
   if (Have(PROB_SEQUENTIAL_HOOK)) {
-    std::cerr << "=== 5/5 Writing ARPA model ===" << std::endl;
+    std::cerr << "=== 5/5 Writing the model ===" << std::endl;
     buffer_.Source(chains);
     Apply(PROB_SEQUENTIAL_HOOK, chains);
     chains >> util::stream::kRecycle;
@@ -49,4 +54,107 @@ void PrintHook::Sink(const HeaderInfo &info, int vocab_file, util::stream::Chain
   chains >> PrintARPA(vocab_file, file_.get(), info.counts_pruned);
 }
 
+namespace {
+
+// Hands the n-grams of the sequential chains to the KenLM model builders.
+class ChainSource : public NGramSource {
+  public:
+    ChainSource(const util::stream::ChainPositions &positions, int vocab_file, const std::vector<uint64_t> &counts, const char *name)
+      : positions_(positions), vocab_(vocab_file), counts_(counts), name_(name), order_(0) {}
+
+    void ReadCounts(std::vector<uint64_t> &counts) {
+      counts = counts_;
+    }
+
+    void BeginOrder(unsigned int order) {
+      CheckFinished();
+      UTIL_THROW_IF(order == 0 || order > positions_.size(), FormatLoadException, "Asked for " << order << "-grams from a model of order " << positions_.size());
+      order_ = order;
+      words_.resize(order);
+      stream_.reset(new util::stream::Stream(positions_[order - 1]));
+    }
+
+    const WordIndex *Next(ProbBackoff &weights) {
+      UTIL_THROW_IF(!stream_ || !*stream_, FormatLoadException, "Fewer " << order_ << "-grams than counted");
+      // Copy out because the block goes back to the chain once the stream moves past it.
+      const WordIndex *words = static_cast<const WordIndex*>(stream_->Get());
+      std::copy(words, words + order_, words_.begin());
+      const float *values = reinterpret_cast<const float*>(words + order_);
+      weights.prob = values[0];
+      // The highest order only has a probability.
+      weights.backoff = (order_ == positions_.size()) ? 0.0 : values[1];
+      ++*stream_;
+      return &words_[0];
+    }
+
+    StringPiece Word(WordIndex source_id) const {
+      UTIL_THROW_IF(source_id >= vocab_.Size(), FormatLoadException, "Word id " << source_id << " is not in the vocabulary of " << vocab_.Size() << " words");
+      return vocab_.LookupPiece(source_id);
+    }
+
+    void End() {
+      CheckFinished();
+    }
+
+    const char *Name() const { return name_; }
+
+  private:
+    void CheckFinished() {
+      if (stream_) {
+        UTIL_THROW_IF(*stream_, FormatLoadException, "More " << order_ << "-grams than counted");
+        stream_.reset();
+      }
+    }
+
+    const util::stream::ChainPositions &positions_;
+    VocabReconstitute vocab_;
+    const std::vector<uint64_t> &counts_;
+    const char *name_;
+
+    unsigned int order_;
+    boost::scoped_ptr<util::stream::Stream> stream_;
+    std::vector<WordIndex> words_;
+};
+
+class WriteBinary {
+  public:
+    WriteBinary(ngram::ModelType model_type, const ngram::Config &config, int vocab_file, const std::vector<uint64_t> &counts)
+      : model_type_(model_type), config_(config), vocab_file_(vocab_file), counts_(counts) {}
+
+    void Run(const util::stream::ChainPositions &positions) {
+      ChainSource source(positions, vocab_file_, counts_, config_.write_mmap);
+      switch (model_type_) {
+        case ngram::PROBING:
+          ngram::ProbingModel(source, config_);
+          break;
+        case ngram::TRIE:
+          ngram::TrieModel(source, config_);
+          break;
+        case ngram::QUANT_TRIE:
+          ngram::QuantTrieModel(source, config_);
+          break;
+        case ngram::ARRAY_TRIE:
+          ngram::ArrayTrieModel(source, config_);
+          break;
+        case ngram::QUANT_ARRAY_TRIE:
+          ngram::QuantArrayTrieModel(source, config_);
+          break;
+        default:
+          UTIL_THROW(FormatLoadException, "Writing " << ngram::kModelNames[model_type_] << " directly is not supported");
+      }
+    }
+
+  private:
+    ngram::ModelType model_type_;
+    ngram::Config config_;
+    int vocab_file_;
+    std::vector<uint64_t> counts_;
+};
+
+} // namespace
+
+void BinaryHook::Sink(const HeaderInfo &info, int vocab_file, util::stream::Chains &chains) {
+  chains >> WriteBinary(model_type_, config_, vocab_file, info.counts_pruned);
+}
+
 }} // namespaces
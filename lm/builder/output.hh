@@ -3,6 +3,8 @@
 
 #include "lm/builder/header_info.hh"
 #include "lm/common/model_buffer.hh"
+#include "lm/config.hh"
+#include "lm/model_type.hh"
 #include "util/file.hh"
 
 #include <boost/ptr_container/ptr_vector.hpp>
@@ -80,6 +82,23 @@ class PrintHook : public OutputHook {
     bool verbose_header_;
 };
 
+/* Builds a KenLM binary file straight from the estimated n-grams, as
+ * build_binary would from the ARPA file but without writing or parsing text.
+ * The model type may be PROBING or one of the tries.  config.write_mmap names
+ * the file.
+ */
+class BinaryHook : public OutputHook {
+  public:
+    BinaryHook(ngram::ModelType model_type, const ngram::Config &config)
+      : OutputHook(PROB_SEQUENTIAL_HOOK), model_type_(model_type), config_(config) {}
+
+    void Sink(const HeaderInfo &info, int vocab_file, util::stream::Chains &chains);
+
+  private:
+    ngram::ModelType model_type_;
+    ngram::Config config_;
+};
+
 }} // namespaces
 
 #endif // LM_BUILDER_OUTPUT_H
@@ -65,6 +65,10 @@ struct Config {
   // models.
   std::size_t building_memory;
 
+  // (default 1) Threads that parse ARPA text and, for the trie, sort n-grams
+  // while building.  Only used if compiled with WITH_THREADS.
+  std::size_t building_threads;
+
   // Template for temporary directory appropriate for passing to mkdtemp.
   // The characters XXXXXX are appended before passing to mkdtemp.  Only
   // applies to trie.  If empty, defaults to write_mmap.  If that's NULL,
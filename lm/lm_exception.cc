@@ -14,6 +14,9 @@ LoadException::~LoadException() throw() {}
 FormatLoadException::FormatLoadException() throw() {}
 FormatLoadException::~FormatLoadException() throw() {}
 
+ParallelFormatLoadException::ParallelFormatLoadException(uint64_t offset) throw() : offset_(offset) {}
+ParallelFormatLoadException::~ParallelFormatLoadException() throw() {}
+
 VocabLoadException::VocabLoadException() throw() {}
 VocabLoadException::~VocabLoadException() throw() {}
 
@@ -9,6 +9,8 @@
 #include <exception>
 #include <string>
 
+#include <stdint.h>
+
 namespace lm {
 
 typedef enum {THROW_UP, COMPLAIN, SILENT} WarningAction;
@@ -33,6 +35,19 @@ class FormatLoadException : public LoadException {
     ~FormatLoadException() throw();
 };
 
+// A format error in n-grams parsed on other threads, while the file was read
+// on ahead.  Offset() is the byte of the file where parsing stopped.
+class ParallelFormatLoadException : public FormatLoadException {
+  public:
+    explicit ParallelFormatLoadException(uint64_t offset) throw();
+    ~ParallelFormatLoadException() throw();
+
+    uint64_t Offset() const { return offset_; }
+
+  private:
+    uint64_t offset_;
+};
+
 class VocabLoadException : public LoadException {
   public:
     virtual ~VocabLoadException() throw();
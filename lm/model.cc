@@ -2,6 +2,7 @@
 
 #include "lm/blank.hh"
 #include "lm/lm_exception.hh"
+#include "lm/ngram_source.hh"
 #include "lm/search_hashed.hh"
 #include "lm/search_trie.hh"
 #include "lm/read_arpa.hh"
@@ -54,6 +55,14 @@ void CheckCounts(const std::vector<uint64_t> &counts) {
   }
 }
 
+void AppendPosition(util::Exception &e, const util::FilePiece &f) {
+  e << " Byte: " << f.Offset();
+}
+
+void AppendPosition(util::Exception &e, const NGramSource &f) {
+  e << " Entry: " << f.Offset() << " of " << f.Name();
+}
+
 } // namespace
 
 template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::GenericModel(const char *file, const Config &init_config) : backing_(init_config) {
@@ -75,7 +84,15 @@ template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::Ge
     ComplainAboutARPA(init_config, kModelType);
     InitializeFromARPA(fd.release(), file, init_config);
   }
+  InitializeStates();
+}
 
+template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::GenericModel(NGramSource &source, const Config &config) : backing_(config) {
+  InitializeFromSource(source, source.Name(), config);
+  InitializeStates();
+}
+
+template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::InitializeStates() {
   // g++ prints warnings unless these are fully initialized.
   State begin_sentence = State();
   begin_sentence.length = 1;
@@ -92,6 +109,10 @@ template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::Ge
 template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::InitializeFromARPA(int fd, const char *file, const Config &config) {
   // Backing file is the ARPA.
   util::FilePiece f(fd, file, config.ProgressMessages());
+  InitializeFromSource(f, file, config);
+}
+
+template <class Search, class VocabularyT> template <class Source> void GenericModel<Search, VocabularyT>::InitializeFromSource(Source &f, const char *file, const Config &config) {
   try {
     std::vector<uint64_t> counts;
     // File counts do not include pruned trigrams that extend to quadgrams etc.   These will be fixed by search_.
@@ -125,8 +146,12 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
       search_.UnknownUnigram().prob = config.unknown_missing_logprob;
     }
     backing_.FinishFile(config, kModelType, kVersion, counts);
+  } catch (ParallelFormatLoadException &e) {
+    // f has been read past the error.
+    e << " Byte: " << e.Offset();
+    throw;
   } catch (util::Exception &e) {
-    e << " Byte: " << f.Offset();
+    AppendPosition(e, f);
     throw;
   }
 }
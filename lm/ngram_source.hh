@@ -0,0 +1,75 @@
+#ifndef LM_NGRAM_SOURCE_H
+#define LM_NGRAM_SOURCE_H
+
+#include "lm/word_index.hh"
+#include "lm/weights.hh"
+#include "util/string_piece.hh"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm {
+
+// Entry of NGramSource::ModelIds for source ids that were not unigrams.
+const WordIndex kNoModelId = static_cast<WordIndex>(-1);
+
+/* Supplies n-grams to the model builders in the order of an ARPA file (all
+ * unigrams, then all bigrams, etc) without going through text.  This lets a
+ * program that estimates a model, like lmplz, build a binary file directly.
+ * The overloads of ReadARPACounts, Read1Grams, ReadNGram, etc in read_arpa.hh
+ * take an NGramSource where they would take a FilePiece.
+ *
+ * Words are identified by the source's own ids, which need not match the ids
+ * of the model being built.  Every id used by an n-gram must also appear as a
+ * unigram.
+ */
+class NGramSource {
+  public:
+    NGramSource() : read_(0) {}
+
+    virtual ~NGramSource() {}
+
+    // Number of n-grams of each order, lowest order first.
+    virtual void ReadCounts(std::vector<uint64_t> &counts) = 0;
+
+    // Called before reading the n-grams of each order, starting with 1.
+    virtual void BeginOrder(unsigned int order) = 0;
+
+    /* Read the next n-gram of the current order.  Returns its words, oldest
+     * first, as source ids.  These stay valid until the next call.  The
+     * backoff is ignored for n-grams of the highest order.
+     */
+    virtual const WordIndex *Next(ProbBackoff &weights) = 0;
+
+    // String for a source id.
+    virtual StringPiece Word(WordIndex source_id) const = 0;
+
+    // Called after the last n-gram has been read.
+    virtual void End() {}
+
+    // Used in messages and as the default prefix of temporary files.
+    virtual const char *Name() const = 0;
+
+    const WordIndex *ReadNext(ProbBackoff &weights) {
+      ++read_;
+      return Next(weights);
+    }
+
+    // Number of n-grams read so far, reported in errors like FilePiece::Offset.
+    uint64_t Offset() const { return read_; }
+
+    // Model id of each source id, filled in while the unigrams are read.
+    std::vector<WordIndex> &ModelIds() { return model_ids_; }
+    const std::vector<WordIndex> &ModelIds() const { return model_ids_; }
+
+  private:
+    uint64_t read_;
+
+    std::vector<WordIndex> model_ids_;
+};
+
+} // namespace lm
+
+#endif // LM_NGRAM_SOURCE_H
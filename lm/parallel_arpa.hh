@@ -0,0 +1,192 @@
+#ifndef LM_PARALLEL_ARPA_H
+#define LM_PARALLEL_ARPA_H
+
+/* Parse the n-grams of an ARPA file on several threads.  Converting a large
+ * ARPA file is bound by parsing numbers and looking up words, which are
+ * independent for each line.
+ */
+
+#include "lm/read_arpa.hh"
+#include "lm/word_index.hh"
+#include "util/file_piece.hh"
+#include "util/string_piece.hh"
+
+#ifdef WITH_THREADS
+#include "util/thread_pool.hh"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#endif
+
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <stdint.h>
+
+namespace lm {
+
+/* Read count n-grams of order n as if by calling ReadNGram count times.
+ * Entry i is written at out + i * entry_size: the vocab ids in reverse order
+ * followed by the Weights.
+ *
+ * With more than one thread, the calling thread only cuts the text into
+ * chunks at line boundaries.  Workers parse the chunks and write each n-gram
+ * at its position, so the result is the same as reading serially.
+ */
+template <class Weights, class Voc> void ReadNGramBlock(util::FilePiece &f, unsigned char n, std::size_t count, const Voc &vocab, void *out, std::size_t entry_size, PositiveProbWarn &warn, std::size_t threads);
+
+namespace detail {
+
+template <class Weights, class Source, class Voc, class Warn> void ReadNGramEntries(Source &f, unsigned char n, std::size_t count, const Voc &vocab, uint8_t *out, std::size_t entry_size, Warn &warn) {
+  for (uint8_t *entry = out; entry != out + count * entry_size; entry += entry_size) {
+    std::reverse_iterator<WordIndex*> it(reinterpret_cast<WordIndex*>(entry) + n);
+    ReadNGram(f, n, vocab, it, *reinterpret_cast<Weights*>(entry + sizeof(WordIndex) * n), warn);
+  }
+}
+
+#ifdef WITH_THREADS
+
+struct ARPAChunk {
+  // Whole lines of the ARPA file, blank ones included, so that offsets in
+  // the text plus offset are offsets in the file.
+  std::string text;
+  uint64_t offset;
+  // The n-grams in text are entries [first, first + count).
+  std::size_t first, count;
+};
+
+// The caller's PositiveProbWarn, shared by all workers so that it complains
+// once however many chunks have positive probabilities.
+class LockedWarn {
+  public:
+    LockedWarn(PositiveProbWarn &warn, boost::mutex &mutex) : warn_(warn), mutex_(mutex) {}
+
+    void Warn(float prob) {
+      boost::mutex::scoped_lock lock(mutex_);
+      warn_.Warn(prob);
+    }
+
+  private:
+    PositiveProbWarn &warn_;
+    boost::mutex &mutex_;
+};
+
+template <class Voc, class Weights> class ChunkParser {
+  public:
+    struct Shared {
+      unsigned char n;
+      const Voc *vocab;
+      uint8_t *out;
+      std::size_t entry_size;
+      PositiveProbWarn *warn;
+
+      boost::mutex mutex;
+      bool failed;
+      // The message of the first exception, as the serial reader gives it,
+      // and the byte of the file where it was thrown.
+      std::string error;
+      uint64_t error_offset;
+    };
+
+    typedef ARPAChunk *Request;
+
+    explicit ChunkParser(Shared *shared) : shared_(*shared) {}
+
+    void operator()(ARPAChunk *chunk) {
+      boost::scoped_ptr<ARPAChunk> deleter(chunk);
+      std::istringstream stream(chunk->text);
+      boost::scoped_ptr<util::FilePiece> f;
+      try {
+        f.reset(new util::FilePiece(stream, NULL, chunk->text.size() + 1, chunk->offset));
+        LockedWarn warn(*shared_.warn, shared_.mutex);
+        ReadNGramEntries<Weights>(*f, shared_.n, chunk->count, *shared_.vocab, shared_.out + chunk->first * shared_.entry_size, shared_.entry_size, warn);
+      } catch (const std::exception &e) {
+        const uint64_t offset = f ? f->Offset() : chunk->offset;
+        boost::mutex::scoped_lock lock(shared_.mutex);
+        // Chunks finish out of order: keep the error first in the file.
+        if (!shared_.failed || offset < shared_.error_offset) {
+          shared_.failed = true;
+          shared_.error = e.what();
+          shared_.error_offset = offset;
+        }
+      }
+    }
+
+  private:
+    Shared &shared_;
+};
+
+inline bool IsBlankLine(const StringPiece &line) {
+  for (const char *i = line.data(); i != line.data() + line.size(); ++i) {
+    if (!isspace(*i)) return false;
+  }
+  return true;
+}
+
+#endif // WITH_THREADS
+
+} // namespace detail
+
+template <class Weights, class Voc> void ReadNGramBlock(util::FilePiece &f, unsigned char n, std::size_t count, const Voc &vocab, void *out, std::size_t entry_size, PositiveProbWarn &warn, std::size_t threads) {
+#ifdef WITH_THREADS
+  if (threads > 1 && count > 1) {
+    // Big enough to amortize a FilePiece and a queue operation.
+    const std::size_t kChunkBytes = 1 << 20;
+    typedef detail::ChunkParser<Voc, Weights> Parser;
+    typename Parser::Shared shared;
+    shared.n = n;
+    shared.vocab = &vocab;
+    shared.out = static_cast<uint8_t*>(out);
+    shared.entry_size = entry_size;
+    shared.warn = &warn;
+    shared.failed = false;
+    {
+      util::ThreadPool<Parser> pool(threads * 2, threads, &shared, NULL);
+      for (std::size_t done = 0; done < count; ) {
+        detail::ARPAChunk *chunk = new detail::ARPAChunk();
+        chunk->offset = f.Offset();
+        chunk->first = done;
+        chunk->count = 0;
+        try {
+          while (done < count && chunk->text.size() < kChunkBytes) {
+            // Keep carriage returns: ReadNGram rejects them too.
+            StringPiece line(f.ReadLine('\n', false));
+            chunk->text.append(line.data(), line.size());
+            chunk->text += '\n';
+            // ReadNGram skips blank lines before an n-gram.
+            if (detail::IsBlankLine(line)) continue;
+            ++chunk->count;
+            ++done;
+          }
+        } catch (...) {
+          delete chunk;
+          throw;
+        }
+        // The worker deletes it.
+        pool.Produce(chunk);
+      }
+    }
+    if (shared.failed) {
+      // Without a location of its own: the message already has the one
+      // where the worker threw and the byte of the n-gram in the file.
+      ParallelFormatLoadException e(shared.error_offset);
+      e << shared.error;
+      throw e;
+    }
+    return;
+  }
+#endif
+  detail::ReadNGramEntries<Weights>(f, n, count, vocab, static_cast<uint8_t*>(out), entry_size, warn);
+}
+
+// N-grams from a source are not text, so there is nothing to parse in parallel.
+template <class Weights, class Voc> void ReadNGramBlock(NGramSource &f, unsigned char n, std::size_t count, const Voc &vocab, void *out, std::size_t entry_size, PositiveProbWarn &warn, std::size_t /*threads*/) {
+  detail::ReadNGramEntries<Weights>(f, n, count, vocab, static_cast<uint8_t*>(out), entry_size, warn);
+}
+
+} // namespace lm
+
+#endif // LM_PARALLEL_ARPA_H
@@ -0,0 +1,123 @@
+#ifndef LM_QUERY_CACHE_H
+#define LM_QUERY_CACHE_H
+
+#include "lm/max_order.hh"
+#include "lm/return.hh"
+#include "lm/state.hh"
+#include "lm/word_index.hh"
+
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm {
+namespace ngram {
+
+/* Policies for QueryCache.  A policy has two static functions:
+ *
+ * bool Cacheable(const State &in_state, WordIndex new_word)
+ *   Whether to look the query up in the cache and store it there on a miss.
+ * bool Replace(const FullScoreReturn &resident, const FullScoreReturn &incoming)
+ *   Whether a query that missed evicts the entry occupying its slot.
+ */
+
+// Cache every query and let the latest one win its slot.
+struct CacheAllPolicy {
+  static bool Cacheable(const State &, WordIndex) { return true; }
+  static bool Replace(const FullScoreReturn &, const FullScoreReturn &) { return true; }
+};
+
+/* Without context, FullScore is a single array access into the unigrams, so
+ * caching it only pushes out entries that were expensive to look up.
+ */
+struct SkipUnigramPolicy {
+  static bool Cacheable(const State &in_state, WordIndex) { return in_state.length != 0; }
+  static bool Replace(const FullScoreReturn &, const FullScoreReturn &) { return true; }
+};
+
+/* Fixed-size direct-mapped cache of FullScore.  Each (state, word) pair maps
+ * to one slot by its hash, so a hit costs a hash and a comparison with one
+ * entry instead of the lookups of every order in the model.
+ *
+ * Entries are compared in full, so results are exactly those of the model.
+ * Not thread safe: give each thread its own cache.  The model must outlive
+ * the cache.
+ */
+template <class Model, class Policy = SkipUnigramPolicy> class QueryCache {
+  public:
+    // entries is rounded up to a power of two.
+    QueryCache(const Model &model, std::size_t entries)
+      : model_(model), hits_(0), misses_(0) {
+      std::size_t size = 1;
+      while (size < entries) size <<= 1;
+      entries_.resize(size);
+      mask_ = size - 1;
+      Clear();
+    }
+
+    FullScoreReturn FullScore(const State &in_state, const WordIndex new_word, State &out_state) {
+      if (!Policy::Cacheable(in_state, new_word))
+        return model_.FullScore(in_state, new_word, out_state);
+      Entry &entry = entries_[hash_value(in_state, new_word) & mask_];
+      if (entry.word == new_word && entry.in == in_state) {
+        ++hits_;
+        out_state = entry.out;
+        return entry.ret;
+      }
+      ++misses_;
+      FullScoreReturn ret(model_.FullScore(in_state, new_word, out_state));
+      if (entry.in.length == kEmpty || Policy::Replace(entry.ret, ret)) {
+        entry.in = in_state;
+        entry.word = new_word;
+        entry.ret = ret;
+        entry.out = out_state;
+      }
+      return ret;
+    }
+
+    float Score(const State &in_state, const WordIndex new_word, State &out_state) {
+      return FullScore(in_state, new_word, out_state).prob;
+    }
+
+    void Clear() {
+      for (typename std::vector<Entry>::iterator i = entries_.begin(); i != entries_.end(); ++i) {
+        i->in.length = kEmpty;
+      }
+    }
+
+    // Queries answered from the cache and queries passed to the model since
+    // construction or ResetCounters.  Queries the policy does not cache are
+    // not counted.
+    uint64_t Hits() const { return hits_; }
+    uint64_t Misses() const { return misses_; }
+
+    void ResetCounters() { hits_ = misses_ = 0; }
+
+    std::size_t Size() const { return entries_.size(); }
+
+    const Model &GetModel() const { return model_; }
+
+  private:
+    // No state is this long, so an entry with it never matches.
+    static const unsigned char kEmpty = KENLM_MAX_ORDER;
+
+    struct Entry {
+      State in;
+      WordIndex word;
+      FullScoreReturn ret;
+      State out;
+    };
+
+    const Model &model_;
+
+    std::vector<Entry> entries_;
+    std::size_t mask_;
+
+    uint64_t hits_, misses_;
+};
+
+} // namespace ngram
+} // namespace lm
+
+#endif // LM_QUERY_CACHE_H
@@ -0,0 +1,100 @@
+#include "lm/query_cache.hh"
+
+#include "lm/model.hh"
+#include "util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE QueryCacheTest
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+namespace lm {
+namespace ngram {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+Config SilentConfig() {
+  Config config;
+  config.arpa_complain = Config::NONE;
+  config.messages = NULL;
+  return config;
+}
+
+struct ModelFixture {
+  ModelFixture() : m(TestLocation(), SilentConfig()) {
+    const char *kText = "looking on a little more loin . also would consider higher to look "
+      "in the screening . i would consider looking on a little more loin </s> foo bar baz "
+      "looking on a little more loin . unknownword looking on a little more loin";
+    for (util::TokenIter<util::SingleCharacter, true> i(kText, ' '); i; ++i) {
+      words.push_back(m.GetVocabulary().Index(*i));
+    }
+  }
+
+  ProbingModel m;
+  std::vector<WordIndex> words;
+};
+
+template <class Cache> void CheckSame(const ProbingModel &m, const std::vector<WordIndex> &words, Cache &cache) {
+  State model_state(m.BeginSentenceState()), cache_state(m.BeginSentenceState()), model_out, cache_out;
+  for (std::vector<WordIndex>::const_iterator i = words.begin(); i != words.end(); ++i) {
+    FullScoreReturn expect(m.FullScore(model_state, *i, model_out));
+    FullScoreReturn got(cache.FullScore(cache_state, *i, cache_out));
+    BOOST_CHECK_EQUAL(expect.prob, got.prob);
+    BOOST_CHECK_EQUAL(expect.ngram_length, got.ngram_length);
+    BOOST_CHECK_EQUAL(expect.independent_left, got.independent_left);
+    BOOST_CHECK_EQUAL(expect.rest, got.rest);
+    BOOST_CHECK(model_out == cache_out);
+    for (unsigned char j = 0; j < model_out.length; ++j) {
+      BOOST_CHECK_EQUAL(model_out.backoff[j], cache_out.backoff[j]);
+    }
+    model_state = model_out;
+    cache_state = cache_out;
+  }
+}
+
+BOOST_FIXTURE_TEST_SUITE(suite, ModelFixture)
+
+BOOST_AUTO_TEST_CASE(SameAsModel) {
+  QueryCache<ProbingModel> cache(m, 1024);
+  CheckSame(m, words, cache);
+  BOOST_CHECK(cache.Misses() > 0);
+  uint64_t hits = cache.Hits();
+  // The same text again, now mostly from the cache.
+  CheckSame(m, words, cache);
+  BOOST_CHECK(cache.Hits() > hits);
+}
+
+BOOST_AUTO_TEST_CASE(Collisions) {
+  // One slot: every query collides, which must still give the model's answers.
+  QueryCache<ProbingModel, CacheAllPolicy> cache(m, 1);
+  BOOST_CHECK_EQUAL(1, cache.Size());
+  CheckSame(m, words, cache);
+  BOOST_CHECK_EQUAL(words.size(), cache.Hits() + cache.Misses());
+}
+
+BOOST_AUTO_TEST_CASE(ClearAndCount) {
+  QueryCache<ProbingModel, CacheAllPolicy> cache(m, 100);
+  BOOST_CHECK_EQUAL(128, cache.Size());
+  CheckSame(m, words, cache);
+  cache.ResetCounters();
+  cache.Clear();
+  BOOST_CHECK_EQUAL(0, cache.Hits());
+  State out;
+  cache.FullScore(m.BeginSentenceState(), words[0], out);
+  BOOST_CHECK_EQUAL(0, cache.Hits());
+  BOOST_CHECK_EQUAL(1, cache.Misses());
+  cache.FullScore(m.BeginSentenceState(), words[0], out);
+  BOOST_CHECK_EQUAL(1, cache.Hits());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace
+} // namespace ngram
+} // namespace lm
@@ -85,6 +85,18 @@ void ReadNGramHeader(util::FilePiece &in, unsigned int length) {
   if (line != expected.str()) UTIL_THROW(FormatLoadException, "Was expecting n-gram header " << expected.str() << " but got " << line << " instead");
 }
 
+namespace {
+void CheckBackoff(float backoff) {
+#if defined(WIN32) && !defined(__MINGW32__)
+  int float_class = _fpclass(backoff);
+  UTIL_THROW_IF(float_class == _FPCLASS_SNAN || float_class == _FPCLASS_QNAN || float_class == _FPCLASS_NINF || float_class == _FPCLASS_PINF, FormatLoadException, "Bad backoff " << backoff);
+#else
+  int float_class = std::fpclassify(backoff);
+  UTIL_THROW_IF(float_class == FP_NAN || float_class == FP_INFINITE, FormatLoadException, "Bad backoff " << backoff);
+#endif
+}
+} // namespace
+
 void ReadBackoff(util::FilePiece &in, Prob &/*weights*/) {
   switch (in.get()) {
     case '\t':
@@ -111,15 +123,7 @@ void ReadBackoff(util::FilePiece &in, float &backoff) {
     case '\t':
       backoff = in.ReadFloat();
       if (backoff == ngram::kExtensionBackoff) backoff = ngram::kNoExtensionBackoff;
-      {
-#if defined(WIN32) && !defined(__MINGW32__)
-		int float_class = _fpclass(backoff);
-        UTIL_THROW_IF(float_class == _FPCLASS_SNAN || float_class == _FPCLASS_QNAN || float_class == _FPCLASS_NINF || float_class == _FPCLASS_PINF, FormatLoadException, "Bad backoff " << backoff);
-#else
-        int float_class = std::fpclassify(backoff);
-        UTIL_THROW_IF(float_class == FP_NAN || float_class == FP_INFINITE, FormatLoadException, "Bad backoff " << backoff);
-#endif
-      }
+      CheckBackoff(backoff);
       UTIL_THROW_IF(in.get() != '\n', FormatLoadException, "Expected newline after backoff");
       break;
     case '\n':
@@ -130,6 +134,13 @@ void ReadBackoff(util::FilePiece &in, float &backoff) {
   }
 }
 
+void ReadBackoff(const ProbBackoff &from, float &backoff) {
+  // Zero is made negative for the same reason as in text.
+  backoff = from.backoff;
+  if (backoff == ngram::kExtensionBackoff) backoff = ngram::kNoExtensionBackoff;
+  CheckBackoff(backoff);
+}
+
 void ReadEnd(util::FilePiece &in) {
   StringPiece line;
   do {
@@ -2,6 +2,7 @@
 #define LM_READ_ARPA_H
 
 #include "lm/lm_exception.hh"
+#include "lm/ngram_source.hh"
 #include "lm/word_index.hh"
 #include "lm/weights.hh"
 #include "util/file_piece.hh"
@@ -26,6 +27,29 @@ inline void ReadBackoff(util::FilePiece &in, RestWeights &weights) {
 
 void ReadEnd(util::FilePiece &in);
 
+// The same for n-grams that come from an NGramSource instead of text.
+inline void ReadARPACounts(NGramSource &in, std::vector<uint64_t> &number) {
+  in.ReadCounts(number);
+}
+inline void ReadNGramHeader(NGramSource &in, unsigned int length) {
+  in.BeginOrder(length);
+}
+
+// The backoff of the highest order is ignored.
+inline void ReadBackoff(const ProbBackoff &/*from*/, Prob &/*weights*/) {}
+// Checks and normalizes zero like ReadBackoff for text.
+void ReadBackoff(const ProbBackoff &from, float &backoff);
+inline void ReadBackoff(const ProbBackoff &from, ProbBackoff &weights) {
+  ReadBackoff(from, weights.backoff);
+}
+inline void ReadBackoff(const ProbBackoff &from, RestWeights &weights) {
+  ReadBackoff(from, weights.backoff);
+}
+
+inline void ReadEnd(NGramSource &in) {
+  in.End();
+}
+
 extern const bool kARPASpaces[256];
 
 // Positive log probability warning.
@@ -67,8 +91,9 @@ template <class Voc, class Weights> void Read1Grams(util::FilePiece &f, std::siz
   vocab.FinishedLoading(unigrams);
 }
 
-// Read ngram, write vocab ids to indices_out.
-template <class Voc, class Weights, class Iterator> void ReadNGram(util::FilePiece &f, const unsigned char n, const Voc &vocab, Iterator indices_out, Weights &weights, PositiveProbWarn &warn) {
+// Read ngram, write vocab ids to indices_out.  Warn is a PositiveProbWarn or
+// anything else with the same Warn(float).
+template <class Voc, class Weights, class Iterator, class Warn> void ReadNGram(util::FilePiece &f, const unsigned char n, const Voc &vocab, Iterator indices_out, Weights &weights, Warn &warn) {
   try {
     weights.prob = f.ReadFloat();
     if (weights.prob > 0.0) {
@@ -90,6 +115,58 @@ template <class Voc, class Weights, class Iterator> void ReadNGram(util::FilePie
   }
 }
 
+template <class Voc, class Weights> void Read1Grams(NGramSource &f, std::size_t count, Voc &vocab, Weights *unigrams, PositiveProbWarn &warn) {
+  ReadNGramHeader(f, 1);
+  std::vector<WordIndex> &model_ids = f.ModelIds();
+  model_ids.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    try {
+      ProbBackoff got;
+      const WordIndex source_id = *f.ReadNext(got);
+      if (got.prob > 0.0) {
+        warn.Warn(got.prob);
+        got.prob = 0.0;
+      }
+      WordIndex word = vocab.Insert(f.Word(source_id));
+      if (source_id >= model_ids.size()) model_ids.resize(source_id + 1, kNoModelId);
+      model_ids[source_id] = 0;
+      Weights &w = unigrams[word];
+      w.prob = got.prob;
+      ReadBackoff(got, w);
+    } catch(util::Exception &e) {
+      e << " in the 1-gram at entry " << f.Offset() << " of " << f.Name();
+      throw;
+    }
+  }
+  vocab.FinishedLoading(unigrams);
+  // The sorted vocabulary renumbers words when it finishes loading.
+  for (WordIndex i = 0; i < model_ids.size(); ++i) {
+    if (model_ids[i] != kNoModelId) model_ids[i] = vocab.Index(f.Word(i));
+  }
+}
+
+template <class Voc, class Weights, class Iterator> void ReadNGram(NGramSource &f, const unsigned char n, const Voc &/*vocab*/, Iterator indices_out, Weights &weights, PositiveProbWarn &warn) {
+  try {
+    ProbBackoff got;
+    const WordIndex *words = f.ReadNext(got);
+    weights.prob = got.prob;
+    if (weights.prob > 0.0) {
+      warn.Warn(weights.prob);
+      weights.prob = 0.0;
+    }
+    const std::vector<WordIndex> &model_ids = f.ModelIds();
+    for (unsigned char i = 0; i < n; ++i, ++indices_out) {
+      UTIL_THROW_IF(words[i] >= model_ids.size() || model_ids[words[i]] == kNoModelId,
+          FormatLoadException, "Word " << f.Word(words[i]) << " was not seen in the unigrams (which are supposed to list the entire vocabulary) but appears");
+      *indices_out = model_ids[words[i]];
+    }
+    ReadBackoff(got, weights);
+  } catch(util::Exception &e) {
+    e << " in the " << static_cast<unsigned int>(n) << "-gram at entry " << f.Offset() << " of " << f.Name();
+    throw;
+  }
+}
+
 } // namespace lm
 
 #endif // LM_READ_ARPA_H
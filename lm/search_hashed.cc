@@ -4,13 +4,17 @@
 #include "lm/blank.hh"
 #include "lm/lm_exception.hh"
 #include "lm/model.hh"
+#include "lm/parallel_arpa.hh"
 #include "lm/read_arpa.hh"
 #include "lm/value.hh"
 #include "lm/vocab.hh"
 
 #include "util/bit_packing.hh"
 #include "util/file_piece.hh"
+#include "util/scoped.hh"
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 namespace lm {
@@ -156,8 +160,8 @@ template <class Build> void MarkLower(
   }
 }
 
-template <class Build, class Activate, class Store> void ReadNGrams(
-    util::FilePiece &f,
+template <class Build, class Activate, class Store, class Source> void ReadNGrams(
+    Source &f,
     const unsigned int n,
     const size_t count,
     const ProbingVocabulary &vocab,
@@ -166,35 +170,50 @@ template <class Build, class Activate, class Store> void ReadNGrams(
     std::vector<util::ProbingHashTable<typename Build::Value::ProbingEntry, util::IdentityHash> > &middle,
     Activate activate,
     Store &store,
-    PositiveProbWarn &warn) {
+    PositiveProbWarn &warn,
+    std::size_t threads) {
   typedef typename Build::Value Value;
+  typedef typename Store::Entry::Value Weights;
   assert(n >= 2);
   ReadNGramHeader(f, n);
 
+  // Parse a block of n-grams, possibly in parallel, then insert them in file
+  // order so that the hash tables come out the same.
+  const std::size_t words_size = sizeof(WordIndex) * n;
+  const std::size_t entry_size = words_size + sizeof(Weights);
+  const std::size_t block = std::min<std::size_t>(count, 1 << 20);
+  util::scoped_malloc parsed(util::MallocOrThrow(std::max<std::size_t>(block, 1) * entry_size));
+
   // Both vocab_ids and keys are non-empty because n >= 2.
   // vocab ids of words in reverse order.
   std::vector<WordIndex> vocab_ids(n);
   std::vector<uint64_t> keys(n-1);
   typename Store::Entry entry;
   std::vector<typename Value::Weights *> between;
-  for (size_t i = 0; i < count; ++i) {
-    ReadNGram(f, n, vocab, vocab_ids.rbegin(), entry.value, warn);
-    build.SetRest(&*vocab_ids.begin(), n, entry.value);
-
-    keys[0] = detail::CombineWordHash(static_cast<uint64_t>(vocab_ids.front()), vocab_ids[1]);
-    for (unsigned int h = 1; h < n - 1; ++h) {
-      keys[h] = detail::CombineWordHash(keys[h-1], vocab_ids[h+1]);
+  for (size_t done = 0; done < count; ) {
+    const std::size_t parse = std::min(block, count - done);
+    ReadNGramBlock<Weights>(f, n, parse, vocab, parsed.get(), entry_size, warn, threads);
+    done += parse;
+    for (const uint8_t *at = static_cast<const uint8_t*>(parsed.get()); at != static_cast<const uint8_t*>(parsed.get()) + parse * entry_size; at += entry_size) {
+      memcpy(&*vocab_ids.begin(), at, words_size);
+      memcpy(&entry.value, at + words_size, sizeof(Weights));
+      build.SetRest(&*vocab_ids.begin(), n, entry.value);
+
+      keys[0] = detail::CombineWordHash(static_cast<uint64_t>(vocab_ids.front()), vocab_ids[1]);
+      for (unsigned int h = 1; h < n - 1; ++h) {
+        keys[h] = detail::CombineWordHash(keys[h-1], vocab_ids[h+1]);
+      }
+      // Initially the sign bit is on, indicating it does not extend left.  Most already have this but there might +0.0.
+      util::SetSign(entry.value.prob);
+      entry.key = keys[n-2];
+
+      store.Insert(entry);
+      between.clear();
+      FindLower<Value>(keys, unigrams[vocab_ids.front()], middle, between);
+      AdjustLower<typename Store::Entry::Value, Build>(entry.value, build, between, n, vocab_ids, unigrams, middle);
+      if (Build::kMarkEvenLower) MarkLower<Build>(keys, build, unigrams[vocab_ids.front()], middle, n - between.size() - 1, *between.back());
+      activate(&*vocab_ids.begin(), n);
     }
-    // Initially the sign bit is on, indicating it does not extend left.  Most already have this but there might +0.0.
-    util::SetSign(entry.value.prob);
-    entry.key = keys[n-2];
-
-    store.Insert(entry);
-    between.clear();
-    FindLower<Value>(keys, unigrams[vocab_ids.front()], middle, between);
-    AdjustLower<typename Store::Entry::Value, Build>(entry.value, build, between, n, vocab_ids, unigrams, middle);
-    if (Build::kMarkEvenLower) MarkLower<Build>(keys, build, unigrams[vocab_ids.front()], middle, n - between.size() - 1, *between.back());
-    activate(&*vocab_ids.begin(), n);
   }
 
   store.FinishedInserting();
@@ -229,70 +248,78 @@ template <class Value> uint8_t *HashedSearch<Value>::SetupMemory(uint8_t *start,
   longest_.Relocate(start);
 }*/
 
-template <class Value> void HashedSearch<Value>::InitializeFromARPA(const char * /*file*/, util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, ProbingVocabulary &vocab, BinaryFormat &backing) {
-  void *vocab_rebase;
-  void *search_base = backing.GrowForSearch(Size(counts, config), vocab.UnkCountChangePadding(), vocab_rebase);
-  vocab.Relocate(vocab_rebase);
-  SetupMemory(reinterpret_cast<uint8_t*>(search_base), counts, config);
+template <class Value> template <class Build, class Source> void HashedSearch<Value>::ApplyBuild(Source &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, const Build &build, std::size_t threads) {
+  for (WordIndex i = 0; i < counts[0]; ++i) {
+    build.SetRest(&i, (unsigned int)1, unigram_.Raw()[i]);
+  }
 
-  PositiveProbWarn warn(config.positive_log_probability);
-  Read1Grams(f, counts[0], vocab, unigram_.Raw(), warn);
-  CheckSpecials(config, vocab);
-  DispatchBuild(f, counts, config, vocab, warn);
+  try {
+    if (counts.size() > 2) {
+      ReadNGrams<Build, ActivateUnigram<typename Value::Weights>, Middle>(
+          f, 2, counts[1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), middle_[0], warn, threads);
+    }
+    for (unsigned int n = 3; n < counts.size(); ++n) {
+      ReadNGrams<Build, ActivateLowerMiddle<Middle>, Middle>(
+          f, n, counts[n-1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_[n-3]), middle_[n-2], warn, threads);
+    }
+    if (counts.size() > 2) {
+      ReadNGrams<Build, ActivateLowerMiddle<Middle>, Longest>(
+          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_.back()), longest_, warn, threads);
+    } else {
+      ReadNGrams<Build, ActivateUnigram<typename Value::Weights>, Longest>(
+          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), longest_, warn, threads);
+    }
+  } catch (util::ProbingSizeException &e) {
+    UTIL_THROW(util::ProbingSizeException, "Avoid pruning n-grams like \"bar baz quux\" when \"foo bar baz quux\" is still in the model.  KenLM will work when this pruning happens, but the probing model assumes these events are rare enough that using blank space in the probing hash table will cover all of them.  Increase probing_multiplier (-p to build_binary) to add more blank spaces.\n");
+  }
+  ReadEnd(f);
 }
 
-template <> void HashedSearch<BackoffValue>::DispatchBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn) {
+template <> template <class Source> void HashedSearch<BackoffValue>::DispatchBuild(Source &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn) {
   NoRestBuild build;
-  ApplyBuild(f, counts, vocab, warn, build);
+  ApplyBuild(f, counts, vocab, warn, build, config.building_threads);
 }
 
-template <> void HashedSearch<RestValue>::DispatchBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn) {
+template <> template <class Source> void HashedSearch<RestValue>::DispatchBuild(Source &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn) {
   switch (config.rest_function) {
     case Config::REST_MAX:
       {
         MaxRestBuild build;
-        ApplyBuild(f, counts, vocab, warn, build);
+        ApplyBuild(f, counts, vocab, warn, build, config.building_threads);
       }
       break;
     case Config::REST_LOWER:
       {
         LowerRestBuild<ProbingModel> build(config, counts.size(), vocab);
-        ApplyBuild(f, counts, vocab, warn, build);
+        ApplyBuild(f, counts, vocab, warn, build, config.building_threads);
       }
       break;
   }
 }
 
-template <class Value> template <class Build> void HashedSearch<Value>::ApplyBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, const Build &build) {
-  for (WordIndex i = 0; i < counts[0]; ++i) {
-    build.SetRest(&i, (unsigned int)1, unigram_.Raw()[i]);
-  }
+template <class Value> template <class Source> void HashedSearch<Value>::InitializeFromARPA(const char * /*file*/, Source &f, const std::vector<uint64_t> &counts, const Config &config, ProbingVocabulary &vocab, BinaryFormat &backing) {
+  void *vocab_rebase;
+  void *search_base = backing.GrowForSearch(Size(counts, config), vocab.UnkCountChangePadding(), vocab_rebase);
+  vocab.Relocate(vocab_rebase);
+  SetupMemory(reinterpret_cast<uint8_t*>(search_base), counts, config);
 
-  try {
-    if (counts.size() > 2) {
-      ReadNGrams<Build, ActivateUnigram<typename Value::Weights>, Middle>(
-          f, 2, counts[1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), middle_[0], warn);
-    }
-    for (unsigned int n = 3; n < counts.size(); ++n) {
-      ReadNGrams<Build, ActivateLowerMiddle<Middle>, Middle>(
-          f, n, counts[n-1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_[n-3]), middle_[n-2], warn);
-    }
-    if (counts.size() > 2) {
-      ReadNGrams<Build, ActivateLowerMiddle<Middle>, Longest>(
-          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_.back()), longest_, warn);
-    } else {
-      ReadNGrams<Build, ActivateUnigram<typename Value::Weights>, Longest>(
-          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), longest_, warn);
-    }
-  } catch (util::ProbingSizeException &e) {
-    UTIL_THROW(util::ProbingSizeException, "Avoid pruning n-grams like \"bar baz quux\" when \"foo bar baz quux\" is still in the model.  KenLM will work when this pruning happens, but the probing model assumes these events are rare enough that using blank space in the probing hash table will cover all of them.  Increase probing_multiplier (-p to build_binary) to add more blank spaces.\n");
-  }
-  ReadEnd(f);
+  PositiveProbWarn warn(config.positive_log_probability);
+  Read1Grams(f, counts[0], vocab, unigram_.Raw(), warn);
+  CheckSpecials(config, vocab);
+  DispatchBuild(f, counts, config, vocab, warn);
 }
 
 template class HashedSearch<BackoffValue>;
 template class HashedSearch<RestValue>;
 
+#define LM_INSTANTIATE_ARPA(Value, Source) \
+  template void HashedSearch<Value>::InitializeFromARPA<Source>(const char *, Source &, const std::vector<uint64_t> &, const Config &, ProbingVocabulary &, BinaryFormat &);
+LM_INSTANTIATE_ARPA(BackoffValue, util::FilePiece)
+LM_INSTANTIATE_ARPA(BackoffValue, NGramSource)
+LM_INSTANTIATE_ARPA(RestValue, util::FilePiece)
+LM_INSTANTIATE_ARPA(RestValue, NGramSource)
+#undef LM_INSTANTIATE_ARPA
+
 } // namespace detail
 } // namespace ngram
 } // namespace lm
@@ -2,6 +2,7 @@
 
 #include "lm/config.hh"
 #include "lm/lm_exception.hh"
+#include "lm/parallel_arpa.hh"
 #include "lm/read_arpa.hh"
 #include "lm/vocab.hh"
 #include "lm/weights.hh"
@@ -20,6 +21,11 @@
 #include <limits>
 #include <vector>
 
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#endif
+
 namespace lm {
 namespace ngram {
 namespace trie {
@@ -70,26 +76,121 @@ class PartialViewProxy {
 
 typedef util::ProxyIterator<PartialViewProxy> PartialIter;
 
+template <class Iterator, class Compare> void SortRange(Iterator begin, Iterator end, Compare compare) {
+  // parallel_sort uses too much RAM.  TODO: figure out why windows sort doesn't like my proxies.
+#if defined(_WIN32) || defined(_WIN64)
+  std::stable_sort
+#else
+  std::sort
+#endif
+    (begin, end, compare);
+}
+
+/* Split count entries into pieces of about equal size and sort each on its
+ * own thread.  Returns the piece boundaries as entry indices.  The caller
+ * merges the pieces as it writes them out.
+ */
+template <class Iterator, class Compare> std::vector<std::size_t> SortPieces(Iterator begin, std::size_t count, Compare compare, std::size_t threads) {
+  std::vector<std::size_t> bounds;
+  for (std::size_t i = 0; i < threads; ++i) {
+    bounds.push_back(count * i / threads);
+  }
+  bounds.push_back(count);
+#ifdef WITH_THREADS
+  boost::thread_group sorters;
+  for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+    sorters.create_thread(boost::bind(&SortRange<Iterator, Compare>, begin + bounds[i], begin + bounds[i + 1], compare));
+  }
+  sorters.join_all();
+#else
+  for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+    SortRange(begin + bounds[i], begin + bounds[i + 1], compare);
+  }
+#endif
+  return bounds;
+}
+
+/* Merge sorted pieces of entries into out.  Entries are compared and written
+ * starting at offset bytes into each entry, the first order words of which
+ * are the key.  With unique, only the first of equal keys is written.
+ */
+typedef std::pair<const uint8_t*, const uint8_t*> SortedPiece; // current, end
+
+// Puts the smallest key on top of the heap.
+class PieceGreater {
+  public:
+    explicit PieceGreater(unsigned char order) : less_(order) {}
+
+    bool operator()(const SortedPiece &first, const SortedPiece &second) const {
+      return less_(second.first, first.first);
+    }
+
+  private:
+    EntryCompare less_;
+};
+
+void WriteMerged(const uint8_t *begin, std::size_t entry_size, const std::vector<std::size_t> &bounds, std::size_t offset, std::size_t size, unsigned char order, bool unique, FILE *out) {
+  typedef SortedPiece Piece;
+  PieceGreater greater(order);
+  std::vector<Piece> heap;
+  for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+    if (bounds[i] == bounds[i + 1]) continue;
+    heap.push_back(Piece(begin + bounds[i] * entry_size + offset, begin + bounds[i + 1] * entry_size + offset));
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+  const uint8_t *previous = NULL;
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    Piece &top = heap.back();
+    if (!unique || !previous || memcmp(previous, top.first, size)) {
+      util::WriteOrThrow(out, top.first, size);
+      previous = top.first;
+    }
+    top.first += entry_size;
+    if (top.first == top.second) {
+      heap.pop_back();
+    } else {
+      std::push_heap(heap.begin(), heap.end(), greater);
+    }
+  }
+}
+
 FILE *DiskFlush(const void *mem_begin, const void *mem_end, const std::string &temp_prefix) {
   util::scoped_fd file(util::MakeTemp(temp_prefix));
   util::WriteOrThrow(file.get(), mem_begin, (uint8_t*)mem_end - (uint8_t*)mem_begin);
   return util::FDOpenOrThrow(file);
 }
 
-FILE *WriteContextFile(uint8_t *begin, uint8_t *end, const std::string &temp_prefix, std::size_t entry_size, unsigned char order) {
+// Sort full records by full n-gram and write them to a temporary file.
+FILE *WriteSortedFile(uint8_t *begin, uint8_t *end, const std::string &temp_prefix, std::size_t entry_size, unsigned char order, std::size_t threads) {
+  util::SizedProxy proxy_begin(begin, entry_size), proxy_end(end, entry_size);
+  util::SizedCompare<EntryCompare> compare((EntryCompare(order)));
+  const std::size_t count = (end - begin) / entry_size;
+  if (threads <= 1 || count < threads) {
+    SortRange(NGramIter(proxy_begin), NGramIter(proxy_end), compare);
+    return DiskFlush(begin, end, temp_prefix);
+  }
+  std::vector<std::size_t> bounds(SortPieces(NGramIter(proxy_begin), count, compare, threads));
+  util::scoped_FILE out(util::FMakeTemp(temp_prefix));
+  WriteMerged(begin, entry_size, bounds, 0, entry_size, order, false, out.get());
+  return out.release();
+}
+
+FILE *WriteContextFile(uint8_t *begin, uint8_t *end, const std::string &temp_prefix, std::size_t entry_size, unsigned char order, std::size_t threads) {
   const size_t context_size = sizeof(WordIndex) * (order - 1);
   // Sort just the contexts using the same memory.
   PartialIter context_begin(PartialViewProxy(begin + sizeof(WordIndex), entry_size, context_size));
   PartialIter context_end(PartialViewProxy(end + sizeof(WordIndex), entry_size, context_size));
-
-#if defined(_WIN32) || defined(_WIN64)
-  std::stable_sort
-#else
-  std::sort
-#endif
-    (context_begin, context_end, util::SizedCompare<EntryCompare, PartialViewProxy>(EntryCompare(order - 1)));
+  util::SizedCompare<EntryCompare, PartialViewProxy> compare((EntryCompare(order - 1)));
 
   util::scoped_FILE out(util::FMakeTemp(temp_prefix));
+  const std::size_t count = (end - begin) / entry_size;
+  if (threads > 1 && count >= threads) {
+    std::vector<std::size_t> bounds(SortPieces(context_begin, count, compare, threads));
+    WriteMerged(begin, entry_size, bounds, sizeof(WordIndex), context_size, order - 1, true, out.get());
+    return out.release();
+  }
+  SortRange(context_begin, context_end, compare);
 
   // Write out to file and uniqueify at the same time.  Could have used unique_copy if there was an appropriate OutputIterator.
   if (context_begin == context_end) return out.release();
@@ -187,36 +288,6 @@ void RecordReader::Rewind() {
   }
 }
 
-SortedFiles::SortedFiles(const Config &config, util::FilePiece &f, std::vector<uint64_t> &counts, size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab) {
-  PositiveProbWarn warn(config.positive_log_probability);
-  unigram_.reset(util::MakeTemp(file_prefix));
-  {
-    // In case <unk> appears.
-    size_t size_out = (counts[0] + 1) * sizeof(ProbBackoff);
-    util::scoped_mmap unigram_mmap(util::MapZeroedWrite(unigram_.get(), size_out), size_out);
-    Read1Grams(f, counts[0], vocab, reinterpret_cast<ProbBackoff*>(unigram_mmap.get()), warn);
-    CheckSpecials(config, vocab);
-    if (!vocab.SawUnk()) ++counts[0];
-  }
-
-  // Only use as much buffer as we need.
-  size_t buffer_use = 0;
-  for (unsigned int order = 2; order < counts.size(); ++order) {
-    buffer_use = std::max<size_t>(buffer_use, static_cast<size_t>((sizeof(WordIndex) * order + 2 * sizeof(float)) * counts[order - 1]));
-  }
-  buffer_use = std::max<size_t>(buffer_use, static_cast<size_t>((sizeof(WordIndex) * counts.size() + sizeof(float)) * counts.back()));
-  buffer = std::min<size_t>(buffer, buffer_use);
-
-  util::scoped_malloc mem;
-  mem.reset(malloc(buffer));
-  if (!mem.get()) UTIL_THROW(util::ErrnoException, "malloc failed for sort buffer size " << buffer);
-
-  for (unsigned char order = 2; order <= counts.size(); ++order) {
-    ConvertToSorted(f, vocab, counts, file_prefix, order, warn, mem.get(), buffer);
-  }
-  ReadEnd(f);
-}
-
 namespace {
 class Closer {
   public:
@@ -237,7 +308,7 @@ class Closer {
 };
 } // namespace
 
-void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &file_prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size) {
+template <class Source> void SortedFiles::ConvertToSorted(Source &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &file_prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size, std::size_t threads) {
   ReadNGramHeader(f, order);
   const size_t count = counts[order - 1];
   // Size of weights.  Does it include backoff?
@@ -254,27 +325,12 @@ void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vo
     uint8_t *out = begin;
     uint8_t *out_end = out + std::min(count - done, batch_size) * entry_size;
     if (order == counts.size()) {
-      for (; out != out_end; out += entry_size) {
-        std::reverse_iterator<WordIndex*> it(reinterpret_cast<WordIndex*>(out) + order);
-        ReadNGram(f, order, vocab, it, *reinterpret_cast<Prob*>(out + words_size), warn);
-      }
+      ReadNGramBlock<Prob>(f, order, (out_end - out) / entry_size, vocab, out, entry_size, warn, threads);
     } else {
-      for (; out != out_end; out += entry_size) {
-        std::reverse_iterator<WordIndex*> it(reinterpret_cast<WordIndex*>(out) + order);
-        ReadNGram(f, order, vocab, it, *reinterpret_cast<ProbBackoff*>(out + words_size), warn);
-      }
+      ReadNGramBlock<ProbBackoff>(f, order, (out_end - out) / entry_size, vocab, out, entry_size, warn, threads);
     }
-    // Sort full records by full n-gram.
-    util::SizedProxy proxy_begin(begin, entry_size), proxy_end(out_end, entry_size);
-    // parallel_sort uses too much RAM.  TODO: figure out why windows sort doesn't like my proxies.
-#if defined(_WIN32) || defined(_WIN64)
-    std::stable_sort
-#else
-    std::sort
-#endif
-        (NGramIter(proxy_begin), NGramIter(proxy_end), util::SizedCompare<EntryCompare>(EntryCompare(order)));
-    files.push_back(DiskFlush(begin, out_end, file_prefix));
-    contexts.push_back(WriteContextFile(begin, out_end, file_prefix, entry_size, order));
+    files.push_back(WriteSortedFile(begin, out_end, file_prefix, entry_size, order, threads));
+    contexts.push_back(WriteContextFile(begin, out_end, file_prefix, entry_size, order, threads));
 
     done += (out_end - begin) / entry_size;
   }
@@ -299,6 +355,39 @@ void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vo
   }
 }
 
+template <class Source> SortedFiles::SortedFiles(const Config &config, Source &f, std::vector<uint64_t> &counts, size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab) {
+  PositiveProbWarn warn(config.positive_log_probability);
+  unigram_.reset(util::MakeTemp(file_prefix));
+  {
+    // In case <unk> appears.
+    size_t size_out = (counts[0] + 1) * sizeof(ProbBackoff);
+    util::scoped_mmap unigram_mmap(util::MapZeroedWrite(unigram_.get(), size_out), size_out);
+    Read1Grams(f, counts[0], vocab, reinterpret_cast<ProbBackoff*>(unigram_mmap.get()), warn);
+    CheckSpecials(config, vocab);
+    if (!vocab.SawUnk()) ++counts[0];
+  }
+
+  // Only use as much buffer as we need.
+  size_t buffer_use = 0;
+  for (unsigned int order = 2; order < counts.size(); ++order) {
+    buffer_use = std::max<size_t>(buffer_use, static_cast<size_t>((sizeof(WordIndex) * order + 2 * sizeof(float)) * counts[order - 1]));
+  }
+  buffer_use = std::max<size_t>(buffer_use, static_cast<size_t>((sizeof(WordIndex) * counts.size() + sizeof(float)) * counts.back()));
+  buffer = std::min<size_t>(buffer, buffer_use);
+
+  util::scoped_malloc mem;
+  mem.reset(malloc(buffer));
+  if (!mem.get()) UTIL_THROW(util::ErrnoException, "malloc failed for sort buffer size " << buffer);
+
+  for (unsigned char order = 2; order <= counts.size(); ++order) {
+    ConvertToSorted(f, vocab, counts, file_prefix, order, warn, mem.get(), buffer, config.building_threads);
+  }
+  ReadEnd(f);
+}
+
+template SortedFiles::SortedFiles(const Config &, util::FilePiece &, std::vector<uint64_t> &, std::size_t, const std::string &, SortedVocabulary &);
+template SortedFiles::SortedFiles(const Config &, NGramSource &, std::vector<uint64_t> &, std::size_t, const std::string &, SortedVocabulary &);
+
 } // namespace trie
 } // namespace ngram
 } // namespace lm
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <set>
 
 #include "Data.h"
 #include "Scorer.h"
@@ -141,21 +142,26 @@ void Data::loadNBest(const string &file, bool oneBest)
   TRACE_ERR("loading nbest from " << file << endl);
   util::FilePiece in(file.c_str());
 
-  ScoreStats scoreentry;
+  // The statistics of a batch of lines are prepared together, so that the
+  // scorer can prepare them in parallel.
+  const size_t kBatchSize = 1000;
+  vector<size_t> sentence_indices;
+  vector<string> sentences, feature_strs;
+  vector<ScoreStats> scoreentries;
+  set<int> batch_indices;
   string sentence, feature_str, alignment;
   int sentence_index;
+  bool more = true;
 
-  while (true) {
+  while (more) {
     try {
       StringPiece line = in.ReadLine();
       if (line.empty()) continue;
-      // adding statistics for error measures
-      scoreentry.clear();
 
       util::TokenIter<util::MultiCharacter> it(line, util::MultiCharacter("|||"));
 
       sentence_index = ParseInt(*it);
-      if (oneBest && m_score_data->exists(sentence_index)) continue;
+      if (oneBest && (m_score_data->exists(sentence_index) || batch_indices.count(sentence_index))) continue;
       ++it;
       sentence = it->as_string();
       ++it;
@@ -179,20 +185,32 @@ void Data::loadNBest(const string &file, bool oneBest)
         sentence += "|||";
         sentence += alignment;
       }
-      m_scorer->prepareStats(sentence_index, sentence, scoreentry);
+      sentence_indices.push_back(sentence_index);
+      sentences.push_back(sentence);
+      feature_strs.push_back(feature_str);
+      if (oneBest) batch_indices.insert(sentence_index);
+      if (sentences.size() < kBatchSize) continue;
+    } catch (util::EndOfFileException &e) {
+      more = false;
+    }
 
-      m_score_data->add(scoreentry, sentence_index);
+    // adding statistics for error measures
+    m_scorer->prepareStatsBatch(sentence_indices, sentences, scoreentries);
+    for (size_t i = 0; i < sentences.size(); ++i) {
+      m_score_data->add(scoreentries[i], sentence_indices[i]);
 
       // examine first line for name of features
       if (!existsFeatureNames()) {
-        InitFeatureMap(feature_str);
+        InitFeatureMap(feature_strs[i]);
       }
-      AddFeatures(feature_str, sentence_index);
-    } catch (util::EndOfFileException &e) {
-      PrintUserTime("Loaded N-best lists");
-      break;
+      AddFeatures(feature_strs[i], sentence_indices[i]);
     }
+    sentence_indices.clear();
+    sentences.clear();
+    feature_strs.clear();
+    batch_indices.clear();
   }
+  PrintUserTime("Loaded N-best lists");
 }
 
 void Data::save(const std::string &featfile, const std::string &scorefile, bool bin)
@@ -22,9 +22,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <iterator>
 
 #define BOOST_FILESYSTEM_VERSION 3
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include "moses/ThreadPool.h"
+#endif
+
 #include "util/exception.hh"
 #include "util/file_piece.hh"
 
@@ -39,6 +45,49 @@ namespace MosesTuning
 
 static const ValType BLEU_RATIO = 5;
 
+namespace
+{
+
+#ifdef WITH_THREADS
+/** The first error of the jobs run by RunJobs */
+struct JobStatus {
+  boost::mutex mutex;
+  string error;
+};
+
+class JobTask : public Moses::Task
+{
+public:
+  JobTask(const boost::function<void (size_t)>& job, size_t index, JobStatus& status)
+    : job_(job), index_(index), status_(status) {}
+
+  void Run() {
+    try {
+      job_(index_);
+    } catch (const std::exception& e) {
+      boost::mutex::scoped_lock lock(status_.mutex);
+      if (status_.error.empty()) status_.error = e.what();
+    }
+  }
+
+private:
+  const boost::function<void (size_t)>& job_;
+  size_t index_;
+  JobStatus& status_;
+};
+#endif
+
+void PruneGraph(const vector<boost::shared_ptr<Graph> >& graphs,
+                const vector<size_t>& edgeCounts, const SparseVector& weights,
+                Vocab& vocab, vector<boost::shared_ptr<Graph> >* prunedGraphs,
+                size_t i)
+{
+  (*prunedGraphs)[i].reset(new Graph(vocab));
+  graphs[i]->Prune((*prunedGraphs)[i].get(), weights, edgeCounts[i]);
+}
+
+}
+
 std::pair<MiraWeightVector*,size_t>
 InitialiseWeights(const string& denseInitFile, const string& sparseInitFile,
                   const string& type, bool verbose)
@@ -132,6 +181,20 @@ InitialiseWeights(const string& denseInitFile, const string& sparseInitFile,
   return pair<MiraWeightVector*,size_t>(new MiraWeightVector(initParams), initDenseSize);
 }
 
+void HopeFearDecoder::HopeFearBatch(
+  const std::vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  size_t batchSize,
+  std::vector<HopeFearData>* batch
+)
+{
+  batch->clear();
+  for (; batch->size() < batchSize && !finished(); next()) {
+    batch->push_back(HopeFearData());
+    HopeFear(backgroundBleu, wv, &(batch->back()));
+  }
+}
+
 ValType HopeFearDecoder::Evaluate(const AvgWeightVector& wv)
 {
   vector<ValType> stats(scorer_->NumberOfScores(),0);
@@ -262,8 +325,10 @@ HypergraphHopeFearDecoder::HypergraphHopeFearDecoder
   bool safe_hope,
   size_t hg_pruning,
   const MiraWeightVector& wv,
-  Scorer* scorer
+  Scorer* scorer,
+  size_t threads
 ) :
+  threads_(threads),
   num_dense_(num_dense)
 {
 
@@ -280,28 +345,47 @@ HypergraphHopeFearDecoder::HypergraphHopeFearDecoder
   fs::directory_iterator dend;
   size_t fileCount = 0;
 
-  cerr << "Reading  hypergraphs" << endl;
+  vector<fs::path> hgpaths;
   for (fs::directory_iterator di(hypergraphDir); di != dend; ++di) {
-    const fs::path& hgpath = di->path();
-    if (hgpath.filename() == kWeights) continue;
-    //  cerr << "Reading " << hgpath.filename() << endl;
-    Graph graph(vocab_);
-    size_t id = boost::lexical_cast<size_t>(hgpath.stem().string());
-    util::scoped_fd fd(util::OpenReadOrThrow(hgpath.string().c_str()));
-    //util::FilePiece file(di->path().string().c_str());
-    util::FilePiece file(fd.release());
-    ReadGraph(file,graph);
-
-    //cerr << "ref length " << references_.Length(id) << endl;
-    size_t edgeCount = hg_pruning * references_.Length(id);
-    boost::shared_ptr<Graph> prunedGraph;
-    prunedGraph.reset(new Graph(vocab_));
-    graph.Prune(prunedGraph.get(), weights, edgeCount);
-    graphs_[id] = prunedGraph;
-    // cerr << "Pruning to v=" << graphs_[id]->VertexSize() << " e=" << graphs_[id]->EdgeSize()  << endl;
-    ++fileCount;
-    if (fileCount % 10 == 0) cerr << ".";
-    if (fileCount % 400 ==  0) cerr << " [count=" << fileCount << "]\n";
+    if (di->path().filename() == kWeights) continue;
+    hgpaths.push_back(di->path());
+  }
+
+  // Parsing adds to the vocabulary and the feature names, which are shared,
+  // so the graphs are read on this thread.  They are pruned on separate
+  // threads, a few at a time to bound the memory taken by unpruned graphs.
+  const size_t chunkSize = 4 * threads_;
+  cerr << "Reading  hypergraphs" << endl;
+  for (size_t start = 0; start < hgpaths.size(); start += chunkSize) {
+    const size_t end = min(start + chunkSize, hgpaths.size());
+    vector<size_t> ids;
+    vector<size_t> edgeCounts;
+    vector<boost::shared_ptr<Graph> > chunk;
+    for (size_t i = start; i < end; ++i) {
+      const fs::path& hgpath = hgpaths[i];
+      //  cerr << "Reading " << hgpath.filename() << endl;
+      chunk.push_back(boost::shared_ptr<Graph>(new Graph(vocab_)));
+      size_t id = boost::lexical_cast<size_t>(hgpath.stem().string());
+      util::scoped_fd fd(util::OpenReadOrThrow(hgpath.string().c_str()));
+      //util::FilePiece file(di->path().string().c_str());
+      util::FilePiece file(fd.release());
+      ReadGraph(file,*chunk.back());
+
+      //cerr << "ref length " << references_.Length(id) << endl;
+      ids.push_back(id);
+      edgeCounts.push_back(hg_pruning * references_.Length(id));
+      ++fileCount;
+      if (fileCount % 10 == 0) cerr << ".";
+      if (fileCount % 400 ==  0) cerr << " [count=" << fileCount << "]\n";
+    }
+    vector<boost::shared_ptr<Graph> > prunedGraphs(chunk.size());
+    RunJobs(chunk.size(), boost::bind(&PruneGraph, boost::cref(chunk),
+                                      boost::cref(edgeCounts), boost::cref(weights),
+                                      boost::ref(vocab_), &prunedGraphs, _1));
+    for (size_t i = 0; i < chunk.size(); ++i) {
+      graphs_[ids[i]] = prunedGraphs[i];
+      // cerr << "Pruning to v=" << graphs_[ids[i]]->VertexSize() << " e=" << graphs_[ids[i]]->EdgeSize()  << endl;
+    }
   }
   cerr << endl << "Done" << endl;
 
@@ -334,10 +418,52 @@ void HypergraphHopeFearDecoder::HopeFear(
   HopeFearData* hopeFear
 )
 {
-  size_t sentenceId = *sentenceIdIter_;
   SparseVector weights;
   wv.ToSparse(&weights, num_dense_);
-  const Graph& graph = *(graphs_[sentenceId]);
+  HopeFear(*sentenceIdIter_, weights, backgroundBleu, hopeFear);
+}
+
+void HypergraphHopeFearDecoder::HopeFearBatch(
+  const vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  size_t batchSize,
+  vector<HopeFearData>* batch
+)
+{
+  SparseVector weights;
+  wv.ToSparse(&weights, num_dense_);
+  vector<size_t> sentenceIds;
+  for (; sentenceIds.size() < batchSize && !finished(); next()) {
+    sentenceIds.push_back(*sentenceIdIter_);
+  }
+  batch->clear();
+  batch->resize(sentenceIds.size());
+  RunJobs(sentenceIds.size(), boost::bind(&HypergraphHopeFearDecoder::HopeFearJob, this,
+                                          boost::cref(sentenceIds), boost::cref(weights),
+                                          boost::cref(backgroundBleu), batch, _1));
+}
+
+void HypergraphHopeFearDecoder::HopeFearJob(
+  const vector<size_t>& sentenceIds,
+  const SparseVector& weights,
+  const vector<ValType>& backgroundBleu,
+  vector<HopeFearData>* batch,
+  size_t i
+) const
+{
+  HopeFear(sentenceIds[i], weights, backgroundBleu, &(*batch)[i]);
+}
+
+void HypergraphHopeFearDecoder::HopeFear(
+  size_t sentenceId,
+  const SparseVector& weights,
+  const vector<ValType>& backgroundBleu,
+  HopeFearData* hopeFear
+) const
+{
+  GraphColl::const_iterator graphIter = graphs_.find(sentenceId);
+  UTIL_THROW_IF(graphIter == graphs_.end(), HypergraphException, "No hypergraph for sentence " << sentenceId);
+  const Graph& graph = *(graphIter->second);
 
   // ValType hope_scale = 1.0;
   HgHypothesis hopeHypo, fearHypo, modelHypo;
@@ -428,13 +554,49 @@ void HypergraphHopeFearDecoder::HopeFear(
 void HypergraphHopeFearDecoder::MaxModel(const AvgWeightVector& wv, vector<ValType>* stats)
 {
   assert(!finished());
-  HgHypothesis bestHypo;
-  size_t sentenceId = *sentenceIdIter_;
   SparseVector weights;
   wv.ToSparse(&weights, num_dense_);
+  MaxModel(*sentenceIdIter_, weights, stats);
+}
+
+ValType HypergraphHopeFearDecoder::Evaluate(const AvgWeightVector& wv)
+{
+  SparseVector weights;
+  wv.ToSparse(&weights, num_dense_);
+  vector<vector<ValType> > sentenceStats(sentenceIds_.size());
+  RunJobs(sentenceIds_.size(), boost::bind(&HypergraphHopeFearDecoder::MaxModelJob, this,
+                                           boost::cref(weights), &sentenceStats, _1));
+  // Sum in the order of the iterator, as HopeFearDecoder::Evaluate does
+  vector<ValType> stats(scorer_->NumberOfScores(),0);
+  for (size_t j = 0; j < sentenceStats.size(); ++j) {
+    for(size_t i=0; i<sentenceStats[j].size(); i++) {
+      stats[i]+=sentenceStats[j][i];
+    }
+  }
+  return scorer_->calculateScore(stats);
+}
+
+void HypergraphHopeFearDecoder::MaxModelJob(
+  const SparseVector& weights,
+  vector<vector<ValType> >* stats,
+  size_t i
+) const
+{
+  MaxModel(sentenceIds_[i], weights, &(*stats)[i]);
+}
+
+void HypergraphHopeFearDecoder::MaxModel(
+  size_t sentenceId,
+  const SparseVector& weights,
+  vector<ValType>* stats
+) const
+{
+  GraphColl::const_iterator graphIter = graphs_.find(sentenceId);
+  UTIL_THROW_IF(graphIter == graphs_.end(), HypergraphException, "No hypergraph for sentence " << sentenceId);
+  HgHypothesis bestHypo;
   vector<ValType> bg(scorer_->NumberOfScores());
   //cerr << "Calculating bleu on " << sentenceId << endl;
-  Viterbi(*(graphs_[sentenceId]), weights, 0, references_, sentenceId, bg, &bestHypo);
+  Viterbi(*(graphIter->second), weights, 0, references_, sentenceId, bg, &bestHypo);
   stats->resize(bestHypo.bleuStats.size());
   /*
   for (size_t i = 0; i < bestHypo.text.size(); ++i) {
@@ -447,6 +609,27 @@ void HypergraphHopeFearDecoder::MaxModel(const AvgWeightVector& wv, vector<ValTy
   }
 }
 
+void HypergraphHopeFearDecoder::RunJobs(size_t count, const boost::function<void (size_t)>& job) const
+{
+#ifdef WITH_THREADS
+  if (threads_ > 1 && count > 1) {
+    JobStatus status;
+    {
+      Moses::ThreadPool pool(min(threads_, count));
+      for (size_t i = 0; i < count; ++i) {
+        pool.Submit(boost::shared_ptr<Moses::Task>(new JobTask(job, i, status)));
+      }
+      pool.Stop(true);
+    }
+    UTIL_THROW_IF(!status.error.empty(), util::Exception, status.error);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; ++i) {
+    job(i);
+  }
+}
+
 
 
 };
@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <vector>
 
+#include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -84,8 +85,20 @@ public:
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats)
   = 0;
 
+  /**
+    * Calculate hope, fear and model hypotheses of up to batchSize sentences,
+    * starting with the current one, all with the same weights and background.
+    * Leaves the iterator after the last of them.
+    **/
+  virtual void HopeFearBatch(
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    size_t batchSize,
+    std::vector<HopeFearData>* batch
+  );
+
   /** Calculate bleu on training set */
-  ValType Evaluate(const AvgWeightVector& wv);
+  virtual ValType Evaluate(const AvgWeightVector& wv);
 
 protected:
   Scorer* scorer_;
@@ -137,7 +150,8 @@ public:
     bool safe_hope,
     size_t hg_pruning,
     const MiraWeightVector& wv,
-    Scorer* scorer_
+    Scorer* scorer_,
+    size_t threads = 1
   );
 
   virtual void reset();
@@ -152,7 +166,38 @@ public:
 
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats);
 
+  /** Decodes the sentences of the batch on separate threads */
+  virtual void HopeFearBatch(
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    size_t batchSize,
+    std::vector<HopeFearData>* batch
+  );
+
+  /** Decodes the sentences on separate threads */
+  virtual ValType Evaluate(const AvgWeightVector& wv);
+
 private:
+  void HopeFear(size_t sentenceId, const SparseVector& weights,
+                const std::vector<ValType>& backgroundBleu,
+                HopeFearData* hopeFear) const;
+
+  void MaxModel(size_t sentenceId, const SparseVector& weights,
+                std::vector<ValType>* stats) const;
+
+  // Jobs for RunJobs, each of which writes element i of its output
+  void HopeFearJob(const std::vector<size_t>& sentenceIds,
+                   const SparseVector& weights,
+                   const std::vector<ValType>& backgroundBleu,
+                   std::vector<HopeFearData>* batch, size_t i) const;
+  void MaxModelJob(const SparseVector& weights,
+                   std::vector<std::vector<ValType> >* stats, size_t i) const;
+
+  /** Call job(0), ..., job(count-1), on separate threads if there are any.
+   * Rethrows the first exception thrown by a job. */
+  void RunJobs(size_t count, const boost::function<void (size_t)>& job) const;
+
+  size_t threads_;
   size_t num_dense_;
   //maps sentence Id to graph ptr
   typedef std::map<size_t, boost::shared_ptr<Graph> > GraphColl;
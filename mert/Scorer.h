@@ -73,6 +73,22 @@ public:
     this->prepareStats(static_cast<std::size_t>(atoi(sindex.c_str())), text, entry);
   }
 
+  /**
+   * Process several guessed texts at once; entries[i] gets the statistics of
+   * texts[i] against reference sindices[i].  Scorers that can work on several
+   * texts in parallel override this; by default, it calls prepareStats() on
+   * each text in turn.
+   */
+  virtual void prepareStatsBatch(const std::vector<std::size_t>& sindices,
+                                 const std::vector<std::string>& texts,
+                                 std::vector<ScoreStats>& entries) {
+    entries.resize(texts.size());
+    for (std::size_t i = 0; i < texts.size(); ++i) {
+      entries[i].clear();
+      this->prepareStats(sindices[i], texts[i], entries[i]);
+    }
+  }
+
   /**
    * Score using each of the candidate index, then go through the diffs
    * applying each in turn, and calculating a new score each time.
@@ -0,0 +1,412 @@
+#include "TerCalculator.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+
+// The settings of tercpp's terCalc.
+const int kMaxShiftSize = 10;
+const int kMaxShifts = 10;
+const int kMaxShiftDistance = 25;
+const int kBeamWidth = 10;
+const int kShiftCost = 1;
+const int kInfinite = 99999;
+
+// tercpp reads an empty sentence as a single empty word.  Word ids are not
+// negative, so this stands for the empty word.
+const int kEmptyWord = numeric_limits<int>::min();
+
+inline uint64_t NgramKey(int node, int word)
+{
+  return (static_cast<uint64_t>(node) << 32) | static_cast<uint32_t>(word);
+}
+
+} // namespace
+
+namespace MosesTuning
+{
+
+TerCalculator::TerCalculator()
+  : m_blocks(0), m_shifts(kMaxShiftSize + 1) {}
+
+int TerCalculator::CountEdits(const vector<int>& hyp, const vector<int>& ref)
+{
+  Encode(hyp, ref);
+  BuildNgramIndex();
+
+  vector<int> cur(m_hyp);
+  vector<int> next;
+  int curEdits = Align(cur, &m_path);
+  int nextEdits = 0;
+  int shifts = 0;
+  while (FindBestShift(cur, curEdits, m_path, next, nextEdits)) {
+    ++shifts;
+    cur.swap(next);
+    curEdits = Align(cur, &m_path);
+  }
+  return curEdits + shifts * kShiftCost;
+}
+
+void TerCalculator::Encode(const vector<int>& hyp, const vector<int>& ref)
+{
+  m_ids.clear();
+  m_hyp.clear();
+  m_ref.clear();
+  for (size_t i = 0; i < max<size_t>(ref.size(), 1); ++i) {
+    const int word = ref.empty() ? kEmptyWord : ref[i];
+    m_ref.push_back(m_ids.insert(make_pair(word, static_cast<int>(m_ids.size()))).first->second);
+  }
+  for (size_t i = 0; i < max<size_t>(hyp.size(), 1); ++i) {
+    const int word = hyp.empty() ? kEmptyWord : hyp[i];
+    m_hyp.push_back(m_ids.insert(make_pair(word, static_cast<int>(m_ids.size()))).first->second);
+  }
+  m_idInHyp.assign(m_ids.size(), false);
+  for (size_t i = 0; i < m_hyp.size(); ++i) {
+    m_idInHyp[m_hyp[i]] = true;
+  }
+
+  m_blocks = (m_ref.size() + 63) / 64;
+  m_peq.assign(m_ids.size() * m_blocks, 0);
+  for (size_t i = 0; i < m_ref.size(); ++i) {
+    m_peq[m_ref[i] * m_blocks + i / 64] |= static_cast<uint64_t>(1) << (i % 64);
+  }
+}
+
+void TerCalculator::BuildNgramIndex()
+{
+  m_ngramStarts.clear();
+  m_ngramStarts.resize(1);
+  m_ngramChildren.clear();
+  const int refSize = m_ref.size();
+  for (int start = 0; start < refSize; ++start) {
+    int node = 0;
+    for (int end = start; end < refSize && end < start + kMaxShiftSize && m_idInHyp[m_ref[end]]; ++end) {
+      pair<boost::unordered_map<uint64_t, int>::iterator, bool> inserted =
+        m_ngramChildren.insert(make_pair(NgramKey(node, m_ref[end]), static_cast<int>(m_ngramStarts.size())));
+      if (inserted.second) {
+        m_ngramStarts.push_back(vector<int>());
+      }
+      node = inserted.first->second;
+      m_ngramStarts[node].push_back(start);
+    }
+  }
+}
+
+int TerCalculator::FindChild(int node, int word) const
+{
+  boost::unordered_map<uint64_t, int>::const_iterator it = m_ngramChildren.find(NgramKey(node, word));
+  return it == m_ngramChildren.end() ? -1 : it->second;
+}
+
+int TerCalculator::Distance(const vector<int>& words)
+{
+  m_pv.assign(m_blocks, ~static_cast<uint64_t>(0));
+  m_mv.assign(m_blocks, 0);
+  const uint64_t highBit = static_cast<uint64_t>(1) << 63;
+  const uint64_t lastBit = static_cast<uint64_t>(1) << ((m_ref.size() - 1) % 64);
+  int distance = m_ref.size();
+  for (size_t j = 0; j < words.size(); ++j) {
+    const uint64_t *peq = &m_peq[words[j] * m_blocks];
+    // difference along the top row, which is always 1
+    int carry = 1;
+    for (size_t b = 0; b < m_blocks; ++b) {
+      const uint64_t pv = m_pv[b];
+      const uint64_t mv = m_mv[b];
+      const uint64_t carryNeg = carry < 0 ? 1 : 0;
+      const uint64_t carryPos = carry > 0 ? 1 : 0;
+      uint64_t eq = peq[b];
+      const uint64_t xv = eq | mv;
+      eq |= carryNeg;
+      const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+      uint64_t ph = mv | ~(xh | pv);
+      uint64_t mh = pv & xh;
+      const uint64_t outBit = b + 1 == m_blocks ? lastBit : highBit;
+      carry = (ph & outBit) ? 1 : ((mh & outBit) ? -1 : 0);
+      ph = (ph << 1) | carryPos;
+      mh = (mh << 1) | carryNeg;
+      m_pv[b] = mh | ~(xv | ph);
+      m_mv[b] = ph & xv;
+    }
+    distance += carry;
+  }
+  return distance;
+}
+
+// terCalc::minimizeDistanceEdition without spans, step for step: the beam
+// and its ties decide the path, and the path decides the shifts.
+int TerCalculator::Align(const vector<int>& words, vector<char>* path)
+{
+  const int refSize = m_ref.size();
+  const int hypSize = words.size();
+  const int width = hypSize + 1;
+  m_cost.assign((refSize + 1) * width, -1);
+  m_trace.assign((refSize + 1) * width, '0');
+  m_cost[0] = 0;
+
+  int currentBest = kInfinite;
+  int currentFirstGood = 0;
+  int curLastGood = 0;
+  for (int j = 0; j <= hypSize; ++j) {
+    const int lastBest = currentBest;
+    currentBest = kInfinite;
+    const int firstGood = currentFirstGood;
+    currentFirstGood = -1;
+    int lastGood = curLastGood;
+    curLastGood = -1;
+    for (int i = firstGood; i <= refSize && i <= lastGood; ++i) {
+      const int score = m_cost[i * width + j];
+      if (score < 0) {
+        continue;
+      }
+      if (j < hypSize && score > lastBest + kBeamWidth) {
+        continue;
+      }
+      if (currentFirstGood == -1) {
+        currentFirstGood = i;
+      }
+      if (i < refSize && j < hypSize) {
+        const int diag = (i + 1) * width + j + 1;
+        if (m_ref[i] == words[j]) {
+          if (m_cost[diag] == -1 || score < m_cost[diag]) {
+            m_cost[diag] = score;
+            m_trace[diag] = 'A';
+          }
+          if (score < currentBest) {
+            currentBest = score;
+          }
+        } else {
+          const int cost = score + 1;
+          if (m_cost[diag] < 0 || cost < m_cost[diag]) {
+            m_cost[diag] = cost;
+            m_trace[diag] = 'S';
+            if (cost < currentBest) {
+              currentBest = cost;
+            }
+          }
+        }
+      }
+      curLastGood = i + 1;
+      if (j < hypSize) {
+        const int right = i * width + j + 1;
+        if (m_cost[right] < 0 || m_cost[right] > score + 1) {
+          m_cost[right] = score + 1;
+          m_trace[right] = 'I';
+        }
+      }
+      if (i < refSize) {
+        const int down = (i + 1) * width + j;
+        if (m_cost[down] < 0 || m_cost[down] > score + 1) {
+          m_cost[down] = score + 1;
+          m_trace[down] = 'D';
+          if (i >= lastGood) {
+            lastGood = i + 1;
+          }
+        }
+      }
+    }
+  }
+
+  if (path) {
+    path->clear();
+    int i = refSize;
+    int j = hypSize;
+    while (i > 0 || j > 0) {
+      const char step = m_trace[i * width + j];
+      path->push_back(step);
+      if (step == 'A' || step == 'S') {
+        --i;
+        --j;
+      } else if (step == 'D') {
+        --i;
+      } else if (step == 'I') {
+        --j;
+      } else {
+        throw runtime_error("TerCalculator: invalid alignment path");
+      }
+    }
+    reverse(path->begin(), path->end());
+  }
+  return m_cost[refSize * width + hypSize];
+}
+
+bool TerCalculator::FindBestShift(const vector<int>& cur, int curEdits,
+                                  const vector<char>& path,
+                                  vector<int>& bestWords, int& bestEdits)
+{
+  // terCalc::calculateTerAlignment
+  m_herr.assign(m_hyp.size() + 1, false);
+  m_rerr.assign(m_ref.size() + 1, false);
+  m_ralign.assign(m_ref.size() + 1, -1);
+  int hpos = -1;
+  int rpos = -1;
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (path[i] == 'A') {
+      m_ralign[++rpos] = ++hpos;
+    } else if (path[i] == 'S') {
+      m_herr[++hpos] = true;
+      m_rerr[++rpos] = true;
+      m_ralign[rpos] = hpos;
+    } else if (path[i] == 'I') {
+      m_herr[++hpos] = true;
+    } else {
+      m_rerr[++rpos] = true;
+      m_ralign[rpos] = hpos + 1;
+    }
+  }
+
+  FindShifts(cur);
+
+  // Longer shifts first.  Stop once no shift of the current length could
+  // beat the best shift so far.
+  bool found = false;
+  int bestShiftCost = 0;
+  bestEdits = curEdits;
+  for (int i = m_shifts.size() - 1; i >= 0; --i) {
+    const int maxFix = 2 * (i + 1);
+    for (size_t s = 0; ; ++s) {
+      const int curFix = curEdits - (bestShiftCost + bestEdits);
+      if (curFix > maxFix || (bestShiftCost != 0 && curFix == maxFix)) {
+        return found;
+      }
+      if (s == m_shifts[i].size()) {
+        break;
+      }
+      Permute(cur, m_shifts[i][s], m_shifted);
+      const int bound = (bestEdits + bestShiftCost) - (Distance(m_shifted) + kShiftCost);
+      if (bound < 0 || (bound == 0 && bestShiftCost != 0)) {
+        continue;
+      }
+      const int edits = Align(m_shifted, NULL);
+      const int gain = (bestEdits + bestShiftCost) - (edits + kShiftCost);
+      if (gain > 0 || (bestShiftCost == 0 && gain == 0)) {
+        found = true;
+        bestShiftCost = kShiftCost;
+        bestEdits = edits;
+        bestWords = m_shifted;
+      }
+    }
+  }
+  return found;
+}
+
+// terCalc::calculerPermutations, with the n-grams of cur looked up in the trie
+// as they grow.
+void TerCalculator::FindShifts(const vector<int>& cur)
+{
+  for (size_t i = 0; i < m_shifts.size(); ++i) {
+    m_shifts[i].clear();
+  }
+  int count = 0;
+  const int size = cur.size();
+  for (int start = 0; start < size; ++start) {
+    const int first = FindChild(0, cur[start]);
+    if (first < 0) {
+      continue;
+    }
+    bool ok = false;
+    for (size_t k = 0; k < m_ngramStarts[first].size() && !ok; ++k) {
+      const int ralign = m_ralign[m_ngramStarts[first][k]];
+      ok = start != ralign && ralign - start <= kMaxShiftDistance
+           && start - ralign - 1 <= kMaxShiftDistance;
+    }
+    if (!ok) {
+      continue;
+    }
+
+    int node = 0;
+    for (int end = start; ok && end < size && end < start + kMaxShiftSize; ++end) {
+      ok = false;
+      node = FindChild(node, cur[end]);
+      if (node < 0) {
+        break;
+      }
+      bool anyHerr = false;
+      for (int i = start; i <= end && !anyHerr; ++i) {
+        anyHerr = m_herr[i];
+      }
+      if (!anyHerr) {
+        ok = true;
+        continue;
+      }
+
+      const vector<int>& starts = m_ngramStarts[node];
+      for (size_t k = 0; k < starts.size(); ++k) {
+        const int moveto = starts[k];
+        const int ralign = m_ralign[moveto];
+        if (ralign == start || (ralign >= start && ralign <= end)
+            || ralign - start > kMaxShiftDistance || start - ralign > kMaxShiftDistance) {
+          continue;
+        }
+        ok = true;
+
+        // only move if there are errors at the destination
+        bool anyRerr = false;
+        for (int i = 0; i <= end - start && !anyRerr; ++i) {
+          anyRerr = m_rerr[moveto + i];
+        }
+        if (!anyRerr) {
+          continue;
+        }
+        for (int roff = -1; roff <= end - start; ++roff) {
+          Shift shift;
+          shift.start = start;
+          shift.end = end;
+          if (roff == -1 && moveto == 0) {
+            shift.newloc = -1;
+          } else if (start != m_ralign[moveto + roff]
+                     && (roff == 0 || m_ralign[moveto + roff] != ralign)) {
+            shift.newloc = m_ralign[moveto + roff];
+          } else {
+            continue;
+          }
+          m_shifts[end - start].push_back(shift);
+          if (++count == kMaxShifts) {
+            return;
+          }
+        }
+      }
+    }
+  }
+}
+
+// terCalc::permuter: move words start..end to follow position newloc, or to
+// the front if newloc is -1.
+void TerCalculator::Permute(const vector<int>& words, const Shift& shift,
+                            vector<int>& out) const
+{
+  const int size = words.size();
+  const int start = shift.start;
+  const int end = shift.end;
+  const int newloc = shift.newloc >= size ? size - 1 : shift.newloc;
+  out.clear();
+  if (newloc == -1) {
+    out.insert(out.end(), words.begin() + start, words.begin() + end + 1);
+    out.insert(out.end(), words.begin(), words.begin() + start);
+    out.insert(out.end(), words.begin() + end + 1, words.end());
+  } else if (newloc < start) {
+    out.insert(out.end(), words.begin(), words.begin() + newloc);
+    out.insert(out.end(), words.begin() + start, words.begin() + end + 1);
+    out.insert(out.end(), words.begin() + newloc, words.begin() + start);
+    out.insert(out.end(), words.begin() + end + 1, words.end());
+  } else if (newloc > end) {
+    out.insert(out.end(), words.begin(), words.begin() + start);
+    out.insert(out.end(), words.begin() + end + 1, words.begin() + newloc + 1);
+    out.insert(out.end(), words.begin() + start, words.begin() + end + 1);
+    out.insert(out.end(), words.begin() + newloc + 1, words.end());
+  } else {
+    // moving inside of itself
+    const int stop = min(size - 1, end + (newloc - start));
+    out.insert(out.end(), words.begin(), words.begin() + start);
+    out.insert(out.end(), words.begin() + end + 1, words.begin() + stop + 1);
+    out.insert(out.end(), words.begin() + start, words.begin() + end + 1);
+    out.insert(out.end(), words.begin() + stop + 1, words.end());
+  }
+}
+
+}
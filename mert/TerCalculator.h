@@ -0,0 +1,97 @@
+#ifndef MERT_TER_CALCULATOR_H_
+#define MERT_TER_CALCULATOR_H_
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include <stdint.h>
+
+namespace MosesTuning
+{
+
+/**
+ * Translation edit rate on sentences of word ids.
+ *
+ * This is the search of tercpp (TER/tercalc.cpp): greedy shifts of at most
+ * 10 words, each chosen after aligning the shifted words with a beam-pruned
+ * edit distance, and it counts the same edits.  Words are compared as small
+ * integers instead of strings, the n-grams that shifts can move are looked up
+ * in a trie of the n-grams of ref, and an exact bit-parallel edit distance
+ * (Myers 1999, in blocks of 64 words after Hyyro 2003) rules out most shifts
+ * before the beam-pruned alignment is computed: a shift whose exact distance
+ * leaves no gain cannot gain with the alignment either, which is never
+ * shorter.
+ *
+ * One calculator keeps scratch space between calls, so each thread needs
+ * its own.
+ */
+class TerCalculator
+{
+public:
+  TerCalculator();
+
+  /**
+   * Number of edits, the shifts included, that terCalc::TER(hyp, ref) finds.
+   * The words of hyp are the ones that are shifted.
+   */
+  int CountEdits(const std::vector<int>& hyp, const std::vector<int>& ref);
+
+private:
+  struct Shift {
+    int start;
+    int end;
+    int newloc;
+  };
+
+  void Encode(const std::vector<int>& hyp, const std::vector<int>& ref);
+  void BuildNgramIndex();
+  int FindChild(int node, int word) const;
+
+  int Distance(const std::vector<int>& words);
+  int Align(const std::vector<int>& words, std::vector<char>* path);
+
+  bool FindBestShift(const std::vector<int>& cur, int curEdits,
+                     const std::vector<char>& path,
+                     std::vector<int>& bestWords, int& bestEdits);
+  void FindShifts(const std::vector<int>& cur);
+  void Permute(const std::vector<int>& words, const Shift& shift,
+               std::vector<int>& out) const;
+
+  // hyp and ref with each word replaced by a small id
+  std::vector<int> m_hyp;
+  std::vector<int> m_ref;
+  boost::unordered_map<int, int> m_ids;
+  std::vector<bool> m_idInHyp;
+
+  // Trie of the n-grams of ref whose words all occur in hyp: each node has
+  // the start positions of its n-gram, in increasing order.
+  std::vector<std::vector<int> > m_ngramStarts;
+  boost::unordered_map<uint64_t, int> m_ngramChildren;
+
+  // For each id and block of ref, the bits of the positions of ref that hold
+  // the id.
+  std::vector<uint64_t> m_peq;
+  std::size_t m_blocks;
+  std::vector<uint64_t> m_pv;
+  std::vector<uint64_t> m_mv;
+
+  // Alignment of the current words with ref, as tercpp derives it
+  std::vector<bool> m_herr;
+  std::vector<bool> m_rerr;
+  std::vector<int> m_ralign;
+
+  // Candidate shifts, by length minus one
+  std::vector<std::vector<Shift> > m_shifts;
+
+  // Edit distance table and back pointers of Align()
+  std::vector<int> m_cost;
+  std::vector<char> m_trace;
+
+  std::vector<int> m_shifted;
+  std::vector<char> m_path;
+};
+
+}
+
+#endif // MERT_TER_CALCULATOR_H_
@@ -0,0 +1,76 @@
+#include "TerCalculator.h"
+
+#define BOOST_TEST_MODULE MertTerCalculator
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+#include "TER/tercalc.h"
+
+using namespace MosesTuning;
+
+namespace
+{
+
+std::vector<int> Sentence(const char *words)
+{
+  std::vector<int> sentence;
+  for (const char *c = words; *c; ++c) {
+    if (*c != ' ') sentence.push_back(*c - 'a');
+  }
+  return sentence;
+}
+
+int TercppEdits(std::vector<int> hyp, std::vector<int> ref)
+{
+  TERCPPNS_TERCpp::terCalc calc;
+  return static_cast<int>(calc.TER(hyp, ref).numEdits);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(ter_calculator_edits)
+{
+  TerCalculator calc;
+  BOOST_CHECK_EQUAL(0, calc.CountEdits(Sentence("a b c d"), Sentence("a b c d")));
+  BOOST_CHECK_EQUAL(1, calc.CountEdits(Sentence("a b c d"), Sentence("a b x d")));
+  BOOST_CHECK_EQUAL(2, calc.CountEdits(Sentence("a b c d"), Sentence("a b")));
+  // one shift instead of two deletions and two insertions
+  BOOST_CHECK_EQUAL(1, calc.CountEdits(Sentence("c d a b e f"), Sentence("a b c d e f")));
+  BOOST_CHECK_EQUAL(3, calc.CountEdits(Sentence(""), Sentence("a b c")));
+  BOOST_CHECK_EQUAL(3, calc.CountEdits(Sentence("a b c"), Sentence("")));
+  BOOST_CHECK_EQUAL(0, calc.CountEdits(Sentence(""), Sentence("")));
+}
+
+// Random sentences over a small vocabulary, so that words repeat and shifts
+// are found, some longer than one block of the bit-parallel distance.
+BOOST_AUTO_TEST_CASE(ter_calculator_matches_tercpp)
+{
+  TerCalculator calc;
+  srand(1234);
+  for (int n = 0; n < 500; ++n) {
+    const int vocab = 3 + rand() % 15;
+    std::vector<int> ref(rand() % (n % 10 == 0 ? 150 : 30));
+    for (size_t i = 0; i < ref.size(); ++i) {
+      ref[i] = rand() % vocab;
+    }
+    // a scrambled copy of ref with some words changed
+    std::vector<int> hyp(ref);
+    for (size_t i = 0; i < hyp.size(); ++i) {
+      if (rand() % 4 == 0) hyp[i] = rand() % vocab;
+    }
+    if (hyp.size() > 4) {
+      for (int k = rand() % 3; k >= 0; --k) {
+        const size_t start = rand() % (hyp.size() - 3);
+        const size_t length = 1 + rand() % 3;
+        const size_t to = rand() % (hyp.size() - length);
+        std::vector<int> moved(hyp.begin() + start, hyp.begin() + start + length);
+        hyp.erase(hyp.begin() + start, hyp.begin() + start + length);
+        hyp.insert(hyp.begin() + to, moved.begin(), moved.end());
+      }
+    }
+    if (rand() % 2) hyp.resize(hyp.size() - hyp.size() / 5);
+    BOOST_CHECK_EQUAL(TercppEdits(hyp, ref), calc.CountEdits(hyp, ref));
+  }
+}
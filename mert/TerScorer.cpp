@@ -1,23 +1,78 @@
 #include "TerScorer.h"
 
 #include <cmath>
+#include <fstream>
 #include <sstream>
 #include <stdexcept>
 
+#include <boost/shared_ptr.hpp>
+
+#ifdef WITH_THREADS
+#include "moses/ThreadPool.h"
+#endif
+
 #include "ScoreStats.h"
-#include "TER/tercalc.h"
-#include "TER/terAlignment.h"
 #include "Util.h"
 
 using namespace std;
-using namespace TERCPPNS_TERCpp;
+
+namespace
+{
+
+// terAlignment::scoreAv
+double ScoreAv(double numEdits, double averageWords)
+{
+  if ( ( averageWords <= 0.0 ) && ( numEdits > 0.0 ) ) {
+    return 1.0;
+  }
+  if ( averageWords <= 0.0 ) {
+    return 0.0;
+  }
+  return numEdits / averageWords;
+}
+
+} // namespace
 
 namespace MosesTuning
 {
 
+#ifdef WITH_THREADS
+// Scores every stride-th text of a batch, starting with the first-th.
+class TerStatsTask : public Moses::Task
+{
+public:
+  TerStatsTask(const TerScorer& scorer, const vector<size_t>& sids,
+               const vector<vector<int> >& tokens, vector<ScoreStats>& entries,
+               size_t first, size_t stride)
+    : m_scorer(scorer), m_sids(sids), m_tokens(tokens), m_entries(entries),
+      m_first(first), m_stride(stride) {}
+
+  void Run() {
+    TerCalculator calculator;
+    for (size_t i = m_first; i < m_tokens.size(); i += m_stride) {
+      m_scorer.computeStats(m_sids[i], m_tokens[i], calculator, m_entries[i]);
+    }
+  }
+
+private:
+  const TerScorer& m_scorer;
+  const vector<size_t>& m_sids;
+  const vector<vector<int> >& m_tokens;
+  vector<ScoreStats>& m_entries;
+  size_t m_first;
+  size_t m_stride;
+};
+#endif
 
 TerScorer::TerScorer(const string& config)
-  : StatisticsBasedScorer("TER",config), kLENGTH(2) {}
+  : StatisticsBasedScorer("TER",config), kLENGTH(2), m_threads(1)
+{
+  const int threads = atoi(getConfig("threads", "1").c_str());
+  if (threads < 1) {
+    throw runtime_error("TER: threads must be at least 1");
+  }
+  m_threads = threads;
+}
 
 TerScorer::~TerScorer() {}
 
@@ -52,55 +107,80 @@ void TerScorer::setReferenceFiles ( const vector<string>& referenceFiles )
   m_references=m_multi_references.at(0);
 }
 
-void TerScorer::prepareStats ( size_t sid, const string& text, ScoreStats& entry )
+void TerScorer::checkSentenceId ( size_t sid ) const
 {
-  string sentence = this->preprocessSentence(text);
-
-  terAlignment result;
-  result.numEdits = 0.0 ;
-  result.numWords = 0.0 ;
-  result.averageWords = 0.0;
-
-  for ( int incRefs = 0; incRefs < ( int ) m_multi_references.size(); incRefs++ ) {
+  for ( size_t incRefs = 0; incRefs < m_multi_references.size(); incRefs++ ) {
     if ( sid >= m_multi_references.at(incRefs).size() ) {
       stringstream msg;
       msg << "Sentence id (" << sid << ") not found in reference set";
       throw runtime_error ( msg.str() );
     }
+  }
+}
 
-    vector<int> testtokens;
-    vector<int> reftokens;
-    reftokens = m_multi_references.at ( incRefs ).at ( sid );
-    double averageLength=0.0;
-    for ( int incRefsBis = 0; incRefsBis < ( int ) m_multi_references.size(); incRefsBis++ ) {
-      if ( sid >= m_multi_references.at(incRefsBis).size() ) {
-        stringstream msg;
-        msg << "Sentence id (" << sid << ") not found in reference set";
-        throw runtime_error ( msg.str() );
-      }
-      averageLength+=(double)m_multi_references.at ( incRefsBis ).at ( sid ).size();
-    }
-    averageLength=averageLength/( double ) m_multi_references.size();
-    TokenizeAndEncode(sentence, testtokens);
-    terCalc * evaluation=new terCalc();
-    evaluation->setDebugMode ( false );
-    terAlignment tmp_result = evaluation->TER ( reftokens, testtokens );
-    tmp_result.averageWords=averageLength;
-    if ( ( result.numEdits == 0.0 ) && ( result.averageWords == 0.0 ) ) {
-      result = tmp_result;
-    } else if ( result.scoreAv() > tmp_result.scoreAv() ) {
-      result = tmp_result;
+void TerScorer::computeStats ( size_t sid, const vector<int>& testtokens, TerCalculator& calculator, ScoreStats& entry ) const
+{
+  double averageLength=0.0;
+  for ( size_t incRefs = 0; incRefs < m_multi_references.size(); incRefs++ ) {
+    averageLength+=(double)m_multi_references[incRefs][sid].size();
+  }
+  averageLength=averageLength/( double ) m_multi_references.size();
+
+  // keep the reference with the lowest edit rate
+  double numEdits = 0.0;
+  double averageWords = 0.0;
+  for ( size_t incRefs = 0; incRefs < m_multi_references.size(); incRefs++ ) {
+    // The reference is the side that is shifted, as it always has been here.
+    const double edits = calculator.CountEdits ( m_multi_references[incRefs][sid], testtokens );
+    if ( ( ( numEdits == 0.0 ) && ( averageWords == 0.0 ) ) || ScoreAv ( numEdits, averageWords ) > ScoreAv ( edits, averageLength ) ) {
+      numEdits = edits;
+      averageWords = averageLength;
     }
-    delete evaluation;
   }
   ostringstream stats;
   // multiplication by 100 in order to keep the average precision
   // in the TER calculation.
-  stats << result.numEdits*100.0 << " " << result.averageWords*100.0 << " " << result.scoreAv()*100.0 << " " ;
+  stats << numEdits*100.0 << " " << averageWords*100.0 << " " << ScoreAv ( numEdits, averageWords )*100.0 << " " ;
   string stats_str = stats.str();
   entry.set ( stats_str );
 }
 
+void TerScorer::prepareStats ( size_t sid, const string& text, ScoreStats& entry )
+{
+  string sentence = this->preprocessSentence(text);
+  checkSentenceId ( sid );
+  vector<int> testtokens;
+  TokenizeAndEncode(sentence, testtokens);
+  computeStats ( sid, testtokens, m_calculator, entry );
+}
+
+void TerScorer::prepareStatsBatch ( const vector<size_t>& sids, const vector<string>& texts, vector<ScoreStats>& entries )
+{
+  // Preprocessing and the vocabulary are not thread-safe, so the texts are
+  // encoded first and only the edits are counted in parallel.
+  vector<vector<int> > tokens ( texts.size() );
+  for ( size_t i = 0; i < texts.size(); i++ ) {
+    checkSentenceId ( sids[i] );
+    TokenizeAndEncode ( this->preprocessSentence ( texts[i] ), tokens[i] );
+  }
+  entries.resize ( texts.size() );
+
+#ifdef WITH_THREADS
+  if ( m_threads > 1 && texts.size() > 1 ) {
+    Moses::ThreadPool pool ( m_threads );
+    for ( size_t t = 0; t < m_threads; t++ ) {
+      pool.Submit ( boost::shared_ptr<Moses::Task> ( new TerStatsTask ( *this, sids, tokens, entries, t, m_threads ) ) );
+    }
+    pool.Stop ( true );
+    return;
+  }
+#endif
+
+  for ( size_t i = 0; i < texts.size(); i++ ) {
+    computeStats ( sids[i], tokens[i], m_calculator, entries[i] );
+  }
+}
+
 float TerScorer::calculateScore(const vector<ScoreStatsType>& comps) const
 {
   float denom = 1.0 * comps[1];
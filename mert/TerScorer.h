@@ -7,6 +7,7 @@
 
 #include "Types.h"
 #include "StatisticsBasedScorer.h"
+#include "TerCalculator.h"
 
 namespace MosesTuning
 {
@@ -16,6 +17,8 @@ class ScoreStats;
 
 /**
  * TER scoring
+ *
+ * Configuration: "threads:N" scores the texts of a batch on N threads.
  */
 class TerScorer: public StatisticsBasedScorer
 {
@@ -25,6 +28,9 @@ public:
 
   virtual void setReferenceFiles(const std::vector<std::string>& referenceFiles);
   virtual void prepareStats(std::size_t sid, const std::string& text, ScoreStats& entry);
+  virtual void prepareStatsBatch(const std::vector<std::size_t>& sids,
+                                 const std::vector<std::string>& texts,
+                                 std::vector<ScoreStats>& entries);
 
   virtual std::size_t NumberOfScores() const {
     // cerr << "TerScorer: " << (LENGTH + 1) << endl;
@@ -33,8 +39,20 @@ public:
 
   virtual float calculateScore(const std::vector<ScoreStatsType>& comps) const;
 
+  /**
+   * Statistics of a tokenized text against the references of sentence sid,
+   * which must exist.  Safe to call on several threads, each with its own
+   * calculator.
+   */
+  void computeStats(std::size_t sid, const std::vector<int>& testtokens,
+                    TerCalculator& calculator, ScoreStats& entry) const;
+
 private:
+  void checkSentenceId(std::size_t sid) const;
+
   const int kLENGTH;
+  std::size_t m_threads;
+  TerCalculator m_calculator;
 
   std::string m_java_env;
   std::string m_ter_com_env;
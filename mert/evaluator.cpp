@@ -51,15 +51,16 @@ vector<ScoreStats> EvaluatorUtil::loadCand(const string& candFile)
   ifstream cand(candFile.c_str());
   if (!cand.good()) throw runtime_error("Error opening candidate file");
 
-  vector<ScoreStats> entries;
-
   // Loading sentences and preparing statistics
-  ScoreStats scoreentry;
+  vector<size_t> sids;
+  vector<string> lines;
   string line;
   while (getline(cand, line)) {
-    g_scorer->prepareStats(entries.size(), line, scoreentry);
-    entries.push_back(scoreentry);
+    sids.push_back(lines.size());
+    lines.push_back(line);
   }
+  vector<ScoreStats> entries;
+  g_scorer->prepareStatsBatch(sids, lines, entries);
   return entries;
 }
 
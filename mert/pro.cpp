@@ -32,18 +32,24 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include <boost/program_options.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#ifdef WITH_THREADS
+#include "moses/ThreadPool.h"
+#endif
 
 #include "BleuScorer.h"
 #include "FeatureDataIterator.h"
 #include "ScoreDataIterator.h"
 #include "BleuScorer.h"
 #include "Util.h"
-#include "util/random.hh"
 
 using namespace std;
 using namespace MosesTuning;
@@ -53,6 +59,11 @@ namespace po = boost::program_options;
 namespace MosesTuning
 {
 
+// TODO: Add these constants to options
+const unsigned int n_candidates = 5000; // Gamma, in Hopkins & May
+const unsigned int n_samples = 50; // Xi, in Hopkins & May
+const float min_diff = 0.05;
+
 class SampledPair
 {
 private:
@@ -102,6 +113,85 @@ static void outputSample(ostream& out, const FeatureDataItem& f1, const FeatureD
   }
 }
 
+/**
+  * The hypotheses of one sentence from all the n-best lists, with their
+  * sentence BLEU, and the pairs sampled from them in megam format.
+ **/
+struct Sentence {
+  vector<FeatureDataItem> features;
+  vector<float> bleu;
+  string pairs;
+};
+
+/**
+  * Sample pairs with a generator seeded for this sentence alone, so that the
+  * pairs do not depend on which thread samples the sentence, or when.
+ **/
+static void sampleSentence(Sentence& sentence, unsigned int seed)
+{
+  //collect the candidates
+  vector<SampledPair> samples;
+  vector<float> scores;
+  size_t n_translations = sentence.features.size();
+  if (!n_translations) return;
+  boost::random::mt19937 rng(seed);
+  boost::random::uniform_int_distribution<size_t> pick(0, n_translations-1);
+  for(size_t  i=0; i<n_candidates; i++) {
+    size_t rand1 = pick(rng);
+    float bleu1 = sentence.bleu[rand1];
+
+    size_t rand2 = pick(rng);
+    float bleu2 = sentence.bleu[rand2];
+
+    if (abs(bleu1-bleu2) < min_diff)
+      continue;
+
+    // SampledPair holds (file, hypothesis); here hypotheses of all files
+    // are numbered together.
+    samples.push_back(SampledPair(make_pair(0, rand1), make_pair(0, rand2), bleu1-bleu2));
+    scores.push_back(1.0-abs(bleu1-bleu2));
+  }
+
+  float sample_threshold = -1.0;
+  if (samples.size() > n_samples) {
+    NTH_ELEMENT3(scores.begin(), scores.begin() + (n_samples-1), scores.end());
+    sample_threshold = 0.99999-scores[n_samples-1];
+  }
+
+  ostringstream out;
+  size_t collected = 0;
+  for (size_t i = 0; collected < n_samples && i < samples.size(); ++i) {
+    if (samples[i].getDiff() < sample_threshold) continue;
+    ++collected;
+    const FeatureDataItem& f1 = sentence.features[samples[i].getTranslation1().second];
+    const FeatureDataItem& f2 = sentence.features[samples[i].getTranslation2().second];
+    out << "1";
+    outputSample(out, f1, f2);
+    out << '\n';
+    out << "0";
+    outputSample(out, f2, f1);
+    out << '\n';
+  }
+  sentence.pairs = out.str();
+}
+
+#ifdef WITH_THREADS
+class SampleTask : public Moses::Task
+{
+public:
+  SampleTask(Sentence& sentence, unsigned int seed)
+    : m_sentence(sentence), m_seed(seed) {}
+
+  void Run() {
+    sampleSentence(m_sentence, m_seed);
+  }
+
+private:
+  Sentence& m_sentence;
+  unsigned int m_seed;
+};
+#endif
+
 }
 
 int main(int argc, char** argv)
@@ -109,12 +199,9 @@ int main(int argc, char** argv)
   bool help;
   vector<string> scoreFiles;
   vector<string> featureFiles;
-  int seed;
+  unsigned int seed;
   string outputFile;
-  // TODO: Add these constants to options
-  const unsigned int n_candidates = 5000; // Gamma, in Hopkins & May
-  const unsigned int n_samples = 50; // Xi, in Hopkins & May
-  const float min_diff = 0.05;
+  size_t threads = 1;
   bool smoothBP = false;
   const float bleuSmoothing = 1.0f;
 
@@ -123,9 +210,12 @@ int main(int argc, char** argv)
   ("help,h", po::value(&help)->zero_tokens()->default_value(false), "Print this help message and exit")
   ("scfile,S", po::value<vector<string> >(&scoreFiles), "Scorer data files")
   ("ffile,F", po::value<vector<string> > (&featureFiles), "Feature data files")
-  ("random-seed,r", po::value<int>(&seed), "Seed for random number generation")
+  ("random-seed,r", po::value<unsigned int>(&seed), "Seed for random number generation")
   ("output-file,o", po::value<string>(&outputFile), "Output file")
   ("smooth-brevity-penalty,b", po::value(&smoothBP)->zero_tokens()->default_value(false), "Smooth the brevity penalty, as in Nakov et al. (Coling 2012)")
+#ifdef WITH_THREADS
+  ("threads,T", po::value<size_t>(&threads), "Sample sentences on this many threads (default 1). The output does not depend on it")
+#endif
   ;
 
   po::options_description cmdline_options;
@@ -140,12 +230,17 @@ int main(int argc, char** argv)
     exit(0);
   }
 
+  // Sentence i is sampled with seed + i
   if (vm.count("random-seed")) {
     cerr << "Initialising random seed to " << seed << endl;
-    util::rand_init(seed);
   } else {
     cerr << "Initialising random seed from system clock" << endl;
-    util::rand_init();
+    seed = static_cast<unsigned int>(time(NULL));
+  }
+
+  if (threads < 1) {
+    cerr << "Error: --threads must be at least 1" << endl;
+    exit(1);
   }
 
   if (scoreFiles.size() == 0 || featureFiles.size() == 0) {
@@ -180,87 +275,67 @@ int main(int argc, char** argv)
     scoreDataIters.push_back(ScoreDataIterator(scoreFiles[i]));
   }
 
-  //loop through nbest lists
+  //loop through nbest lists, a batch of sentences at a time.  Reading adds
+  //to the names of the sparse features, which sampling looks up to write
+  //them, so the two take turns.
+  const size_t batchSize = 64 * threads;
   size_t sentenceId = 0;
-  while(1) {
-    vector<pair<size_t,size_t> > hypotheses;
-    //TODO: de-deuping. Collect hashes of score,feature pairs and
-    //only add index if it's unique.
-    if (featureDataIters[0] == FeatureDataIterator::end()) {
-      break;
-    }
-    for (size_t i = 0; i < featureFiles.size(); ++i) {
-      if (featureDataIters[i] == FeatureDataIterator::end()) {
-        cerr << "Error: Feature file " << i << " ended prematurely" << endl;
-        exit(1);
+  bool more = true;
+  while(more) {
+    vector<Sentence> batch;
+    while (batch.size() < batchSize) {
+      //TODO: de-deuping. Collect hashes of score,feature pairs and
+      //only add index if it's unique.
+      if (featureDataIters[0] == FeatureDataIterator::end()) {
+        more = false;
+        break;
       }
-      if (scoreDataIters[i] == ScoreDataIterator::end()) {
-        cerr << "Error: Score file " << i << " ended prematurely" << endl;
-        exit(1);
+      batch.push_back(Sentence());
+      Sentence& sentence = batch.back();
+      for (size_t i = 0; i < featureFiles.size(); ++i) {
+        if (featureDataIters[i] == FeatureDataIterator::end()) {
+          cerr << "Error: Feature file " << i << " ended prematurely" << endl;
+          exit(1);
+        }
+        if (scoreDataIters[i] == ScoreDataIterator::end()) {
+          cerr << "Error: Score file " << i << " ended prematurely" << endl;
+          exit(1);
+        }
+        if (featureDataIters[i]->size() != scoreDataIters[i]->size()) {
+          cerr << "Error: For sentence " << (sentenceId + batch.size() - 1) << " features and scores have different size" << endl;
+          exit(1);
+        }
+        for (size_t j = 0; j < featureDataIters[i]->size(); ++j) {
+          sentence.features.push_back(featureDataIters[i]->operator[](j));
+          sentence.bleu.push_back(smoothedSentenceBleu(scoreDataIters[i]->operator[](j), bleuSmoothing, smoothBP));
+        }
       }
-      if (featureDataIters[i]->size() != scoreDataIters[i]->size()) {
-        cerr << "Error: For sentence " << sentenceId << " features and scores have different size" << endl;
-        exit(1);
+      //advance all iterators
+      for (size_t i = 0; i < featureFiles.size(); ++i) {
+        ++featureDataIters[i];
+        ++scoreDataIters[i];
       }
-      for (size_t j = 0; j < featureDataIters[i]->size(); ++j) {
-        hypotheses.push_back(pair<size_t,size_t>(i,j));
-      }
-    }
-
-    //collect the candidates
-    vector<SampledPair> samples;
-    vector<float> scores;
-    size_t n_translations = hypotheses.size();
-    for(size_t  i=0; i<n_candidates; i++) {
-      size_t rand1 = util::rand_excl(n_translations);
-      pair<size_t,size_t> translation1 = hypotheses[rand1];
-      float bleu1 = smoothedSentenceBleu(scoreDataIters[translation1.first]->operator[](translation1.second), bleuSmoothing, smoothBP);
-
-      size_t rand2 = util::rand_excl(n_translations);
-      pair<size_t,size_t> translation2 = hypotheses[rand2];
-      float bleu2 = smoothedSentenceBleu(scoreDataIters[translation2.first]->operator[](translation2.second), bleuSmoothing, smoothBP);
-
-      /*
-      cerr << "t(" << translation1.first << "," << translation1.second << ") = " << bleu1 <<
-        " t(" << translation2.first << "," << translation2.second << ") = " <<
-          bleu2  << " diff = " << abs(bleu1-bleu2) << endl;
-      */
-      if (abs(bleu1-bleu2) < min_diff)
-        continue;
-
-      samples.push_back(SampledPair(translation1, translation2, bleu1-bleu2));
-      scores.push_back(1.0-abs(bleu1-bleu2));
     }
 
-    float sample_threshold = -1.0;
-    if (samples.size() > n_samples) {
-      NTH_ELEMENT3(scores.begin(), scores.begin() + (n_samples-1), scores.end());
-      sample_threshold = 0.99999-scores[n_samples-1];
+#ifdef WITH_THREADS
+    if (threads > 1) {
+      Moses::ThreadPool pool(threads);
+      for (size_t k = 0; k < batch.size(); ++k) {
+        pool.Submit(boost::shared_ptr<Moses::Task>(new SampleTask(batch[k], seed + sentenceId + k)));
+      }
+      pool.Stop(true);
+    } else
+#endif
+    {
+      for (size_t k = 0; k < batch.size(); ++k) {
+        sampleSentence(batch[k], seed + sentenceId + k);
+      }
     }
 
-    size_t collected = 0;
-    for (size_t i = 0; collected < n_samples && i < samples.size(); ++i) {
-      if (samples[i].getDiff() < sample_threshold) continue;
-      ++collected;
-      size_t file_id1 = samples[i].getTranslation1().first;
-      size_t hypo_id1 = samples[i].getTranslation1().second;
-      size_t file_id2 = samples[i].getTranslation2().first;
-      size_t hypo_id2 = samples[i].getTranslation2().second;
-      *out << "1";
-      outputSample(*out, featureDataIters[file_id1]->operator[](hypo_id1),
-                   featureDataIters[file_id2]->operator[](hypo_id2));
-      *out << endl;
-      *out << "0";
-      outputSample(*out, featureDataIters[file_id2]->operator[](hypo_id2),
-                   featureDataIters[file_id1]->operator[](hypo_id1));
-      *out << endl;
-    }
-    //advance all iterators
-    for (size_t i = 0; i < featureFiles.size(); ++i) {
-      ++featureDataIters[i];
-      ++scoreDataIters[i];
+    for (size_t k = 0; k < batch.size(); ++k) {
+      *out << batch[k].pairs;
     }
-    ++sentenceId;
+    sentenceId += batch.size();
   }
 
   outFile.close();
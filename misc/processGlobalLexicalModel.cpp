@@ -0,0 +1,55 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "moses/FF/GlobalLexiconTable.h"
+
+using namespace Moses;
+
+void printHelp()
+{
+  std::cerr << "Usage:\n"
+            "options: \n"
+            "\t-in  string -- text global lexicon\n"
+            "\t-out string -- binary global lexicon to write\n"
+            "\t-input-factors  int -- number of input factors of the model (default 1)\n"
+            "\t-output-factors int -- number of output factors of the model (default 1)\n"
+            "\t-factor-delimiter string -- (default |)\n"
+            "\n";
+}
+
+int main(int argc, char** argv)
+{
+  std::string inFilePath, outFilePath;
+  std::string factorDelimiter("|");
+  size_t numInputFactors = 1, numOutputFactors = 1;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if("-in" == arg && i+1 < argc) {
+      inFilePath = argv[++i];
+    } else if("-out" == arg && i+1 < argc) {
+      outFilePath = argv[++i];
+    } else if("-input-factors" == arg && i+1 < argc) {
+      numInputFactors = atoi(argv[++i]);
+    } else if("-output-factors" == arg && i+1 < argc) {
+      numOutputFactors = atoi(argv[++i]);
+    } else if("-factor-delimiter" == arg && i+1 < argc) {
+      factorDelimiter = argv[++i];
+    } else {
+      printHelp();
+      return 1;
+    }
+  }
+  if (inFilePath.empty() || outFilePath.empty() || !numInputFactors || !numOutputFactors) {
+    printHelp();
+    return 1;
+  }
+
+  std::cerr << "processing " << inFilePath << " to " << outFilePath << "\n";
+  GlobalLexiconTable table;
+  table.LoadText(inFilePath, factorDelimiter, numOutputFactors, numInputFactors);
+  table.WriteBinary(outFilePath);
+  std::cerr << table.NumTargetWords() << " output and " << table.NumSourceWords()
+            << " input words\n";
+  return 0;
+}
@@ -0,0 +1,43 @@
+// Serves a KenLM language model to LanguageModelRemote (feature RemoteLM)
+// over the binary protocol of moses/LM/RemoteProtocol.h.
+
+#include <cstdlib>
+#include <iostream>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "lm/model.hh"
+#include "moses/LM/RemoteServer.h"
+
+using namespace std;
+using namespace Moses;
+
+namespace
+{
+
+void printHelp()
+{
+  cerr << "Usage: remoteLMServer model port\n"
+       "\tmodel -- ARPA or KenLM binary language model\n"
+       "\tport  -- TCP port to listen on\n";
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 3) {
+    printHelp();
+    return 1;
+  }
+
+  try {
+    boost::scoped_ptr<lm::base::Model> model(lm::ngram::LoadVirtual(argv[1]));
+    RemoteLMServer server(*model, atoi(argv[2]));
+    cerr << "Serving " << argv[1] << " on port " << server.Port() << endl;
+    server.Run();
+  } catch (const std::exception &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+}
@@ -117,7 +117,6 @@ BackwardsEdge::BackwardsEdge(const BitmapContainer &prevBitmapContainer
   , m_parent(parent)
   , m_translations(translations)
   , m_futurescore(futureScore)
-  , m_seenPosition()
 {
 
   // If either dimension is empty, we haven't got anything to do.
@@ -182,8 +181,6 @@ BackwardsEdge::BackwardsEdge(const BitmapContainer &prevBitmapContainer
 
 BackwardsEdge::~BackwardsEdge()
 {
-  m_seenPosition.clear();
-  m_hypotheses.clear();
 }
 
 
@@ -219,17 +216,13 @@ Hypothesis *BackwardsEdge::CreateHypothesis(const Hypothesis &hypothesis, const
 bool
 BackwardsEdge::SeenPosition(const size_t x, const size_t y)
 {
-  boost::unordered_set< int >::iterator iter = m_seenPosition.find((x<<16) + y);
-  return (iter != m_seenPosition.end());
+  return m_seenPosition.Contains(x, y);
 }
 
 void
 BackwardsEdge::SetSeenPosition(const size_t x, const size_t y)
 {
-  UTIL_THROW_IF2(x >= (1<<17), "Error");
-  UTIL_THROW_IF2(y >= (1<<17), "Error");
-
-  m_seenPosition.insert((x<<16) + y);
+  m_seenPosition.Insert(x, y);
 }
 
 
@@ -285,15 +278,11 @@ BitmapContainer::BitmapContainer(const WordsBitmap &bitmap
 
 BitmapContainer::~BitmapContainer()
 {
-  // As we have created the square position objects we clean up now.
-
-  while (!m_queue.empty()) {
-    HypothesisQueueItem *item = m_queue.top();
-    m_queue.pop();
-
-    FREEHYPO( item->GetHypothesis() );
-    delete item;
+  // As we have created the hypotheses in the queue we clean up now.
+  for (HypothesisQueue::const_iterator iter = m_queue.begin(); iter != m_queue.end(); ++iter) {
+    FREEHYPO( iter->GetHypothesis() );
   }
+  m_queue.clear();
 
   // Delete all edges.
   RemoveAllInColl(m_edges);
@@ -309,39 +298,22 @@ BitmapContainer::Enqueue(int hypothesis_pos
                          , Hypothesis *hypothesis
                          , BackwardsEdge *edge)
 {
-  HypothesisQueueItem *item = new HypothesisQueueItem(hypothesis_pos
-      , translation_pos
-      , hypothesis
-      , edge);
   IFVERBOSE(2) {
-    item->GetHypothesis()->GetManager().GetSentenceStats().StartTimeManageCubes();
+    hypothesis->GetManager().GetSentenceStats().StartTimeManageCubes();
   }
-  m_queue.push(item);
+  m_queue.push(HypothesisQueueItem(hypothesis_pos
+                                   , translation_pos
+                                   , hypothesis
+                                   , edge));
   IFVERBOSE(2) {
-    item->GetHypothesis()->GetManager().GetSentenceStats().StopTimeManageCubes();
+    hypothesis->GetManager().GetSentenceStats().StopTimeManageCubes();
   }
 }
 
-HypothesisQueueItem*
-BitmapContainer::Dequeue(bool keepValue)
-{
-  if (!m_queue.empty()) {
-    HypothesisQueueItem *item = m_queue.top();
-
-    if (!keepValue) {
-      m_queue.pop();
-    }
-
-    return item;
-  }
-
-  return NULL;
-}
-
-HypothesisQueueItem*
+const HypothesisQueueItem*
 BitmapContainer::Top() const
 {
-  return m_queue.top();
+  return &m_queue.top();
 }
 
 size_t
@@ -404,7 +376,7 @@ BitmapContainer::AddHypothesis(Hypothesis *hypothesis)
 void
 BitmapContainer::AddBackwardsEdge(BackwardsEdge *edge)
 {
-  m_edges.insert(edge);
+  m_edges.push_back(edge);
 }
 
 void
@@ -421,6 +393,18 @@ BitmapContainer::InitializeEdges()
   }
 }
 
+// The expansions InitializeEdges() is going to build: the best hypothesis
+// of each edge extended with its best translation option.
+void
+BitmapContainer::CollectSeedExpansions(std::vector<HypothesisExpansion> &expansions) const
+{
+  for (BackwardsEdgeSet::const_iterator iter = m_edges.begin(); iter != m_edges.end(); ++iter) {
+    const BackwardsEdge &edge = **iter;
+    if (edge.m_hypotheses.empty() || edge.m_translations.size() == 0) continue;
+    expansions.push_back(HypothesisExpansion(edge.m_hypotheses[0], edge.m_translations.Get(0)));
+  }
+}
+
 void
 BitmapContainer::EnsureMinStackHyps(const size_t minNumHyps)
 {
@@ -437,27 +421,25 @@ BitmapContainer::ProcessBestHypothesis()
   }
 
   // Get the currently best hypothesis from the queue.
-  HypothesisQueueItem *item = Dequeue();
-
-  // If the priority queue is exhausted, we are done and should have exited
-  UTIL_THROW_IF2(item == NULL, "Null object");
+  const HypothesisQueueItem item = m_queue.top();
+  m_queue.pop();
 
   // check we are pulling things off of priority queue in right order
   if (!Empty()) {
-    HypothesisQueueItem *check = Dequeue(true);
-    UTIL_THROW_IF2(item->GetHypothesis()->GetTotalScore() < check->GetHypothesis()->GetTotalScore(),
+    const HypothesisQueueItem &check = m_queue.top();
+    UTIL_THROW_IF2(item.GetScore() < check.GetScore(),
                    "Non-monotonic total score: "
-                   << item->GetHypothesis()->GetTotalScore() << " vs. "
-                   << check->GetHypothesis()->GetTotalScore());
+                   << item.GetScore() << " vs. "
+                   << check.GetScore());
   }
 
   // Logging for the criminally insane
   IFVERBOSE(3) {
-    item->GetHypothesis()->PrintHypothesis();
+    item.GetHypothesis()->PrintHypothesis();
   }
 
   // Add best hypothesis to hypothesis stack.
-  const bool newstackentry = m_stack.AddPrune(item->GetHypothesis());
+  const bool newstackentry = m_stack.AddPrune(item.GetHypothesis());
   if (newstackentry)
     m_numStackInsertions++;
 
@@ -466,10 +448,7 @@ BitmapContainer::ProcessBestHypothesis()
   }
 
   // Create new hypotheses for the two successors of the hypothesis just added.
-  item->GetBackwardsEdge()->PushSuccessors(item->GetHypothesisPos(), item->GetTranslationPos());
-
-  // We are done with the queue item, we delete it.
-  delete item;
+  item.GetBackwardsEdge()->PushSuccessors(item.GetHypothesisPos(), item.GetTranslationPos());
 }
 
 void
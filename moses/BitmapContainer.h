@@ -22,10 +22,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef moses_BitmapContainer_h
 #define moses_BitmapContainer_h
 
-#include <queue>
-#include <set>
 #include <vector>
 
+#include "CubePruningQueue.h"
+#include "FF/StatefulFeatureFunction.h"
 #include "Hypothesis.h"
 #include "HypothesisStackCubePruning.h"
 #include "SquareMatrix.h"
@@ -33,8 +33,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "TypeDef.h"
 #include "WordsBitmap.h"
 
-#include <boost/unordered_set.hpp>
-
 namespace Moses
 {
 
@@ -47,22 +45,23 @@ class QueueItemOrderer;
 class TranslationOptionList;
 
 typedef std::vector< Hypothesis* > HypothesisSet;
-typedef std::set< BackwardsEdge* > BackwardsEdgeSet;
-typedef std::priority_queue< HypothesisQueueItem*, std::vector< HypothesisQueueItem* >, QueueItemOrderer> HypothesisQueue;
+typedef std::vector< BackwardsEdge* > BackwardsEdgeSet;
+typedef DaryHeap< HypothesisQueueItem, QueueItemOrderer > HypothesisQueue;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Hypothesis Priority Queue Code
 ////////////////////////////////////////////////////////////////////////////////
 
-//! 1 item in the priority queue for stack decoding (phrase-based)
+//! 1 item in the priority queue for stack decoding (phrase-based).
+//! Items are stored by value in the queue, with a copy of the hypothesis score
+//! so that ordering them does not touch the hypotheses.
 class HypothesisQueueItem
 {
 private:
   size_t m_hypothesis_pos, m_translation_pos;
   Hypothesis *m_hypothesis;
   BackwardsEdge *m_edge;
-
-  HypothesisQueueItem();
+  float m_score;
 
 public:
   HypothesisQueueItem(const size_t hypothesis_pos
@@ -72,36 +71,38 @@ public:
     : m_hypothesis_pos(hypothesis_pos)
     , m_translation_pos(translation_pos)
     , m_hypothesis(hypothesis)
-    , m_edge(edge) {
-  }
-
-  ~HypothesisQueueItem() {
+    , m_edge(edge)
+    , m_score(hypothesis->GetTotalScore()) {
   }
 
-  int GetHypothesisPos() {
+  int GetHypothesisPos() const {
     return m_hypothesis_pos;
   }
 
-  int GetTranslationPos() {
+  int GetTranslationPos() const {
     return m_translation_pos;
   }
 
-  Hypothesis *GetHypothesis() {
+  Hypothesis *GetHypothesis() const {
     return m_hypothesis;
   }
 
-  BackwardsEdge *GetBackwardsEdge() {
+  BackwardsEdge *GetBackwardsEdge() const {
     return m_edge;
   }
+
+  float GetScore() const {
+    return m_score;
+  }
 };
 
 //! Allows comparison of two HypothesisQueueItem objects by the corresponding scores.
 class QueueItemOrderer
 {
 public:
-  bool operator()(HypothesisQueueItem* itemA, HypothesisQueueItem* itemB) const {
-    float scoreA = itemA->GetHypothesis()->GetTotalScore();
-    float scoreB = itemB->GetHypothesis()->GetTotalScore();
+  bool operator()(const HypothesisQueueItem &itemA, const HypothesisQueueItem &itemB) const {
+    float scoreA = itemA.GetScore();
+    float scoreB = itemB.GetScore();
 
     return (scoreA < scoreB);
 
@@ -167,7 +168,7 @@ private:
   const SquareMatrix &m_futurescore;
 
   std::vector< const Hypothesis* > m_hypotheses;
-  boost::unordered_set< int > m_seenPosition;
+  GridPositionSet m_seenPosition;
 
   // We don't want to instantiate "empty" objects.
   BackwardsEdge();
@@ -223,8 +224,7 @@ public:
   ~BitmapContainer();
 
   void Enqueue(int hypothesis_pos, int translation_pos, Hypothesis *hypothesis, BackwardsEdge *edge);
-  HypothesisQueueItem *Dequeue(bool keepValue=false);
-  HypothesisQueueItem *Top() const;
+  const HypothesisQueueItem *Top() const;
   size_t Size();
   bool Empty() const;
 
@@ -234,6 +234,7 @@ public:
   const BackwardsEdgeSet &GetBackwardsEdges();
 
   void InitializeEdges();
+  void CollectSeedExpansions(std::vector<HypothesisExpansion> &expansions) const;
   void ProcessBestHypothesis();
   void EnsureMinStackHyps(const size_t minNumHyps);
   void AddHypothesis(Hypothesis *hypothesis);
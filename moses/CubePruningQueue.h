@@ -0,0 +1,194 @@
+// vim:tabstop=2
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_CubePruningQueue_h
+#define moses_CubePruningQueue_h
+
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+namespace Moses
+{
+
+/** Priority queue in a flat d-ary heap of values, with the interface of
+ * std::priority_queue: top() is the largest item according to Less.
+ * A wider node halves the depth of a binary heap, and its children share a
+ * cache line when items are small.
+ */
+template <class T, class Less, std::size_t D = 4>
+class DaryHeap
+{
+public:
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+  explicit DaryHeap(const Less &less = Less()) : m_less(less) {}
+
+  bool empty() const {
+    return m_heap.empty();
+  }
+  std::size_t size() const {
+    return m_heap.size();
+  }
+  const T &top() const {
+    return m_heap.front();
+  }
+
+  void push(const T &item) {
+    m_heap.push_back(item);
+    SiftUp(m_heap.size() - 1);
+  }
+
+  void pop() {
+    if (m_heap.size() > 1) {
+      m_heap.front() = m_heap.back();
+      m_heap.pop_back();
+      SiftDown(0);
+    } else {
+      m_heap.pop_back();
+    }
+  }
+
+  void clear() {
+    m_heap.clear();
+  }
+
+  void reserve(std::size_t size) {
+    m_heap.reserve(size);
+  }
+
+  //! all items, in no particular order
+  const_iterator begin() const {
+    return m_heap.begin();
+  }
+  const_iterator end() const {
+    return m_heap.end();
+  }
+
+private:
+  void SiftUp(std::size_t pos) {
+    T item = m_heap[pos];
+    while (pos > 0) {
+      std::size_t parent = (pos - 1) / D;
+      if (!m_less(m_heap[parent], item)) break;
+      m_heap[pos] = m_heap[parent];
+      pos = parent;
+    }
+    m_heap[pos] = item;
+  }
+
+  void SiftDown(std::size_t pos) {
+    const std::size_t size = m_heap.size();
+    T item = m_heap[pos];
+    while (true) {
+      std::size_t first = pos * D + 1;
+      if (first >= size) break;
+      std::size_t last = first + D < size ? first + D : size;
+      std::size_t best = first;
+      for (std::size_t child = first + 1; child < last; ++child) {
+        if (m_less(m_heap[best], m_heap[child])) best = child;
+      }
+      if (!m_less(item, m_heap[best])) break;
+      m_heap[pos] = m_heap[best];
+      pos = best;
+    }
+    m_heap[pos] = item;
+  }
+
+  Less m_less;
+  std::vector<T> m_heap;
+};
+
+/** Set of positions (x, y) in a cube pruning grid, in an open addressing
+ * table with linear probing.  Cube pruning visits a small corner of the grid,
+ * so the table grows with the number of positions seen rather than with the
+ * size of the grid.
+ */
+class GridPositionSet
+{
+public:
+  GridPositionSet() : m_size(0) {}
+
+  bool Contains(std::size_t x, std::size_t y) const {
+    if (m_table.empty()) return false;
+    const uint64_t key = Key(x, y);
+    for (std::size_t slot = Slot(key); ; slot = (slot + 1) & (m_table.size() - 1)) {
+      if (m_table[slot] == key) return true;
+      if (m_table[slot] == 0) return false;
+    }
+  }
+
+  //! returns false if (x, y) was already in the set
+  bool Insert(std::size_t x, std::size_t y) {
+    // keep the load at most 1/2
+    if ((m_size + 1) * 2 > m_table.size()) Grow();
+    return InsertKey(Key(x, y));
+  }
+
+  std::size_t Size() const {
+    return m_size;
+  }
+
+  void Clear() {
+    m_table.clear();
+    m_size = 0;
+  }
+
+private:
+  // 0 marks an empty slot.  Positions are below 2^32, so adding 1 never
+  // makes a key 0.
+  static uint64_t Key(std::size_t x, std::size_t y) {
+    return ((static_cast<uint64_t>(x) << 32) | static_cast<uint64_t>(y)) + 1;
+  }
+
+  std::size_t Slot(uint64_t key) const {
+    // Fibonacci hashing: the high bits of the product mix both coordinates.
+    return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & (m_table.size() - 1);
+  }
+
+  bool InsertKey(uint64_t key) {
+    std::size_t slot = Slot(key);
+    while (m_table[slot] != 0) {
+      if (m_table[slot] == key) return false;
+      slot = (slot + 1) & (m_table.size() - 1);
+    }
+    m_table[slot] = key;
+    ++m_size;
+    return true;
+  }
+
+  void Grow() {
+    std::vector<uint64_t> old;
+    old.swap(m_table);
+    m_table.resize(old.empty() ? 16 : old.size() * 2, 0);
+    m_size = 0;
+    for (std::vector<uint64_t>::const_iterator i = old.begin(); i != old.end(); ++i) {
+      if (*i != 0) InsertKey(*i);
+    }
+  }
+
+  std::vector<uint64_t> m_table;
+  std::size_t m_size;
+};
+
+}
+
+#endif
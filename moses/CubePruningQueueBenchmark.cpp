@@ -0,0 +1,208 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+// Pop throughput of the cube pruning queue in BitmapContainer: a flat heap of
+// items with their scores and an open addressing set of seen positions,
+// against the former std::priority_queue of heap allocated items, which reads
+// the score through the hypothesis, and boost::unordered_set of positions.
+//
+// Each edge is a grid of hypotheses by translation options whose cells score
+// the sum of both plus noise, as language model scores make it.  Hypotheses
+// are not created, so the times are for the queue alone.
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include <boost/unordered_set.hpp>
+
+#include "CubePruningQueue.h"
+#include "util/usage.hh"
+
+using namespace Moses;
+
+namespace
+{
+
+struct Grid {
+  std::vector<float> hypotheses, translations;
+  // score of each cell, row by row; stands in for the created hypothesis
+  std::vector<float> cells;
+
+  float Score(size_t x, size_t y) const {
+    return cells[x * translations.size() + y];
+  }
+};
+
+void MakeGrids(size_t edges, size_t numHypotheses, size_t numTranslations, std::vector<Grid> &grids)
+{
+  srand(42);
+  grids.resize(edges);
+  for (size_t e = 0; e < edges; ++e) {
+    Grid &grid = grids[e];
+    float hypo = -(rand() % 100) / 10.0, trans = 0;
+    for (size_t x = 0; x < numHypotheses; ++x) {
+      hypo -= (rand() % 100) / 100.0;
+      grid.hypotheses.push_back(hypo);
+    }
+    for (size_t y = 0; y < numTranslations; ++y) {
+      trans -= (rand() % 100) / 100.0;
+      grid.translations.push_back(trans);
+    }
+    for (size_t x = 0; x < numHypotheses; ++x) {
+      for (size_t y = 0; y < numTranslations; ++y) {
+        grid.cells.push_back(grid.hypotheses[x] + grid.translations[y] - (rand() % 100) / 50.0);
+      }
+    }
+  }
+}
+
+// The former implementation.
+struct OldItem {
+  size_t x, y;
+  const float *hypothesis;
+  size_t edge;
+};
+
+struct OldOrderer {
+  bool operator()(const OldItem *a, const OldItem *b) const {
+    return *a->hypothesis < *b->hypothesis;
+  }
+};
+
+double RunOld(const std::vector<Grid> &grids, size_t pops, float &checksum)
+{
+  double start = util::UserTime();
+  std::priority_queue<OldItem*, std::vector<OldItem*>, OldOrderer> queue;
+  std::vector<boost::unordered_set<int> > seen(grids.size());
+
+  for (size_t e = 0; e < grids.size(); ++e) {
+    OldItem *item = new OldItem();
+    item->x = 0;
+    item->y = 0;
+    item->hypothesis = &grids[e].cells[0];
+    item->edge = e;
+    queue.push(item);
+    seen[e].insert(0);
+  }
+  for (size_t pop = 0; pop < pops && !queue.empty(); ++pop) {
+    OldItem *item = queue.top();
+    queue.pop();
+    checksum += *item->hypothesis;
+    const Grid &grid = grids[item->edge];
+    boost::unordered_set<int> &edgeSeen = seen[item->edge];
+    size_t x = item->x, y = item->y;
+    if (y + 1 < grid.translations.size() && edgeSeen.insert((x << 16) + y + 1).second) {
+      OldItem *next = new OldItem();
+      next->x = x;
+      next->y = y + 1;
+      next->hypothesis = &grid.cells[x * grid.translations.size() + y + 1];
+      next->edge = item->edge;
+      queue.push(next);
+    }
+    if (x + 1 < grid.hypotheses.size() && edgeSeen.insert(((x + 1) << 16) + y).second) {
+      OldItem *next = new OldItem();
+      next->x = x + 1;
+      next->y = y;
+      next->hypothesis = &grid.cells[(x + 1) * grid.translations.size() + y];
+      next->edge = item->edge;
+      queue.push(next);
+    }
+    delete item;
+  }
+  while (!queue.empty()) {
+    delete queue.top();
+    queue.pop();
+  }
+  return util::UserTime() - start;
+}
+
+// The current implementation.
+struct NewItem {
+  size_t x, y;
+  const float *hypothesis;
+  size_t edge;
+  float score;
+};
+
+struct NewOrderer {
+  bool operator()(const NewItem &a, const NewItem &b) const {
+    return a.score < b.score;
+  }
+};
+
+double RunNew(const std::vector<Grid> &grids, size_t pops, float &checksum)
+{
+  double start = util::UserTime();
+  DaryHeap<NewItem, NewOrderer> queue;
+  std::vector<GridPositionSet> seen(grids.size());
+
+  for (size_t e = 0; e < grids.size(); ++e) {
+    NewItem item = { 0, 0, &grids[e].cells[0], e, grids[e].cells[0] };
+    queue.push(item);
+    seen[e].Insert(0, 0);
+  }
+  for (size_t pop = 0; pop < pops && !queue.empty(); ++pop) {
+    const NewItem item = queue.top();
+    queue.pop();
+    checksum += item.score;
+    const Grid &grid = grids[item.edge];
+    GridPositionSet &edgeSeen = seen[item.edge];
+    size_t x = item.x, y = item.y;
+    if (y + 1 < grid.translations.size() && edgeSeen.Insert(x, y + 1)) {
+      NewItem next = { x, y + 1, &grid.cells[x * grid.translations.size() + y + 1], item.edge, grid.Score(x, y + 1) };
+      queue.push(next);
+    }
+    if (x + 1 < grid.hypotheses.size() && edgeSeen.Insert(x + 1, y)) {
+      NewItem next = { x + 1, y, &grid.cells[(x + 1) * grid.translations.size() + y], item.edge, grid.Score(x + 1, y) };
+      queue.push(next);
+    }
+  }
+  return util::UserTime() - start;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  // A stack of a long sentence: many edges, each cube mostly unexplored.
+  const size_t kEdges = 2000, kHypotheses = 200, kTranslations = 50;
+  const size_t kRepeat = 5;
+  std::vector<Grid> grids;
+  MakeGrids(kEdges, kHypotheses, kTranslations, grids);
+
+  std::cout << "pops\told pops/s\tnew pops/s\tspeedup" << std::endl;
+  for (size_t pops = 1000; pops <= 1000000; pops *= 10) {
+    double oldTime = 0, newTime = 0;
+    float oldChecksum = 0, newChecksum = 0;
+    for (size_t i = 0; i < kRepeat; ++i) {
+      oldTime += RunOld(grids, pops, oldChecksum);
+      newTime += RunNew(grids, pops, newChecksum);
+    }
+    // Both pop the same scores, up to the order of ties and rounding.
+    if (std::fabs(oldChecksum - newChecksum) > 1e-4 * std::fabs(oldChecksum)) {
+      std::cerr << "Checksums differ: " << oldChecksum << " vs. " << newChecksum << std::endl;
+      return 1;
+    }
+    std::cout << pops << '\t' << (pops * kRepeat) / oldTime << '\t' << (pops * kRepeat) / newTime << '\t' << oldTime / newTime << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "CubePruningQueue.h"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(cube_pruning_queue)
+
+BOOST_AUTO_TEST_CASE(heap_order)
+{
+  vector<int> values;
+  srand(1);
+  for (size_t i = 0; i < 1000; ++i) {
+    values.push_back(rand() % 100);
+  }
+
+  DaryHeap<int, less<int> > heap;
+  for (size_t i = 0; i < values.size(); ++i) {
+    heap.push(values[i]);
+  }
+  BOOST_CHECK_EQUAL(heap.size(), values.size());
+
+  sort(values.begin(), values.end(), greater<int>());
+  for (size_t i = 0; i < values.size(); ++i) {
+    BOOST_REQUIRE(!heap.empty());
+    BOOST_CHECK_EQUAL(heap.top(), values[i]);
+    heap.pop();
+  }
+  BOOST_CHECK(heap.empty());
+}
+
+BOOST_AUTO_TEST_CASE(heap_interleaved)
+{
+  // pushes between pops, as cube pruning does
+  DaryHeap<int, greater<int>, 3> heap;
+  heap.push(5);
+  heap.push(1);
+  heap.push(3);
+  BOOST_CHECK_EQUAL(heap.top(), 1);
+  heap.pop();
+  heap.push(2);
+  heap.push(0);
+  BOOST_CHECK_EQUAL(heap.top(), 0);
+  heap.pop();
+  BOOST_CHECK_EQUAL(heap.top(), 2);
+  heap.pop();
+  BOOST_CHECK_EQUAL(heap.top(), 3);
+  heap.pop();
+  BOOST_CHECK_EQUAL(heap.top(), 5);
+  heap.pop();
+  BOOST_CHECK(heap.empty());
+}
+
+BOOST_AUTO_TEST_CASE(grid_positions)
+{
+  GridPositionSet seen;
+  BOOST_CHECK(!seen.Contains(0, 0));
+  // enough positions to grow the table several times
+  for (size_t x = 0; x < 50; ++x) {
+    for (size_t y = 0; y < 40; ++y) {
+      BOOST_CHECK(seen.Insert(x, y));
+    }
+  }
+  BOOST_CHECK_EQUAL(seen.Size(), 2000);
+  BOOST_CHECK(!seen.Insert(3, 7));
+  BOOST_CHECK(seen.Contains(49, 39));
+  BOOST_CHECK(!seen.Contains(39, 49));
+  BOOST_CHECK(!seen.Contains(50, 0));
+  // coordinates do not overlap
+  BOOST_CHECK(!seen.Contains(0, 1 << 16));
+  BOOST_CHECK(seen.Insert(0, 1 << 16));
+
+  seen.Clear();
+  BOOST_CHECK_EQUAL(seen.Size(), 0);
+  BOOST_CHECK(!seen.Contains(0, 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
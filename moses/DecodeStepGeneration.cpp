@@ -25,6 +25,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "TranslationOptionCollection.h"
 #include "PartialTranslOptColl.h"
 #include "FactorCollection.h"
+#include "CubePruningQueue.h"
+#include "moses/FF/DecodeFeature.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace Moses
 {
@@ -34,33 +40,67 @@ DecodeStepGeneration::DecodeStepGeneration(GenerationDictionary* dict,
     const DecodeStep* prev,
     const std::vector<FeatureFunction*> &features)
   : DecodeStep(dict, prev, features)
+  , m_additive(true)
 {
+  for (size_t i = 0; i < m_featuresToApply.size(); ++i) {
+    if (!dynamic_cast<const DecodeFeature*>(m_featuresToApply[i])) {
+      m_additive = false;
+    }
+  }
 }
 
-// helpers
-typedef pair<Word, ScoreComponentCollection> WordPair;
-typedef list< WordPair > WordList;
-// 1st = word
-// 2nd = score
-typedef list< WordPair >::const_iterator WordListIterator;
-
-/** used in generation: increases iterators when looping through the exponential number of generation expansions */
-inline void IncrementIterators(vector< WordListIterator > &wordListIterVector
-                               , const vector< WordList > &wordListVector)
+namespace
 {
-  for (size_t currPos = 0 ; currPos < wordListVector.size() ; currPos++) {
-    WordListIterator &iter = wordListIterVector[currPos];
-    iter++;
-    if (iter != wordListVector[currPos].end()) {
-      // eg. 4 -> 5
-      return;
-    } else {
-      //  eg 9 -> 10
-      iter = wordListVector[currPos].begin();
-    }
+//! one generation of a target word, with its weighted score
+struct Alternative {
+  const Word *word;
+  const ScoreComponentCollection *scores;
+  float weightedScore;
+};
+
+struct BetterAlternative {
+  bool operator()(const Alternative &a, const Alternative &b) const {
+    return a.weightedScore > b.weightedScore;
+  }
+};
+
+//! a combination of generations, by its index in the node store
+struct Expansion {
+  float score;
+  size_t node;
+};
+
+struct ExpansionOrderer {
+  bool operator()(const Expansion &a, const Expansion &b) const {
+    return a.score < b.score;
   }
+};
+
+/** Relative slack of the bound on the score of the next expansion.  The
+ * bound and the future score of the expansion are the same float terms
+ * summed in a different order, so they differ by a few ulps of the terms,
+ * orders of magnitude below this.  The bound is only used to stop early: a
+ * bound that is too high merely creates options that the exact check before
+ * Add() then prunes, as the collection always did, while one that is too
+ * low could drop an option the collection would have kept.
+ */
+const float kBoundSlack = 1e-4f;
 }
 
+/** Expands the target phrase of a partial translation option with every
+ * combination of the generations of its words.  The number of combinations
+ * is exponential in the phrase length, so they are taken best first by
+ * their summed generation scores, as a merge of the sorted lists of each
+ * word: the successors of a combination advance one word at or after the
+ * last word it advanced, which reaches every combination exactly once and
+ * never before a better one.
+ *
+ * An expansion is only created if the output collection would keep it.
+ * When nothing but decode features is applied at this step, an expansion
+ * scores the best one plus the difference of their generation scores, so
+ * once that falls below the collection's threshold so does every remaining
+ * expansion, and the search stops.
+ */
 void DecodeStepGeneration::Process(const TranslationOption &inputPartialTranslOpt
                                    , const DecodeStep &decodeStep
                                    , PartialTranslOptColl &outputPartialTranslOptColl
@@ -79,78 +119,117 @@ void DecodeStepGeneration::Process(const TranslationOption &inputPartialTranslOp
   // normal generation step
   const GenerationDictionary* generationDictionary  = decodeStep.GetGenerationDictionaryFeature();
 
-  const Phrase &targetPhrase  = inputPartialTranslOpt.GetTargetPhrase();
+  const TargetPhrase &inPhrase = inputPartialTranslOpt.GetTargetPhrase();
   const InputPath &inputPath = inputPartialTranslOpt.GetInputPath();
-  size_t targetLength         = targetPhrase.GetSize();
-
-  // generation list for each word in phrase
-  vector< WordList > wordListVector(targetLength);
+  const WordsRange &sourceWordsRange = inputPartialTranslOpt.GetSourceWordsRange();
+  const size_t targetLength = inPhrase.GetSize();
 
-  // create generation list
-  int wordListVectorPos = 0;
-  for (size_t currPos = 0 ; currPos < targetLength ; currPos++) { // going thorugh all words
-    // generatable factors for this word to be put in wordList
-    WordList &wordList = wordListVector[wordListVectorPos];
-    const Word &word = targetPhrase.GetWord(currPos);
+  // generations of each word, best first
+  vector< vector<Alternative> > alternatives(targetLength);
+  size_t numCombinations = 1;
+  for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
+    const Word &word = inPhrase.GetWord(currPos);
 
     // consult dictionary for possible generations for this word
     const OutputWordCollection *wordColl = generationDictionary->FindWord(word);
-
     if (wordColl == NULL) {
       // word not found in generation dictionary
-      //toc->ProcessUnknownWord(sourceWordsRange.GetStartPos(), factorCollection);
       return; // can't be part of a phrase, special handling
-    } else {
-      // sort(*wordColl, CompareWordCollScore);
-      OutputWordCollection::const_iterator iterWordColl;
-      for (iterWordColl = wordColl->begin() ; iterWordColl != wordColl->end(); ++iterWordColl) {
-        const Word &outputWord = (*iterWordColl).first;
-        const ScoreComponentCollection& score = (*iterWordColl).second;
-        // enter into word list generated factor(s) and its(their) score(s)
-        wordList.push_back(WordPair(outputWord, score));
-      }
+    }
 
-      wordListVectorPos++; // done, next word
+    vector<Alternative> &wordAlternatives = alternatives[currPos];
+    OutputWordCollection::const_iterator iterWordColl;
+    for (iterWordColl = wordColl->begin() ; iterWordColl != wordColl->end(); ++iterWordColl) {
+      // without features to apply the expansions keep the score of the input
+      Alternative alternative = { &iterWordColl->first, &iterWordColl->second,
+                                  m_featuresToApply.empty() ? 0 : iterWordColl->second.GetWeightedScore()
+                                };
+      wordAlternatives.push_back(alternative);
+    }
+    std::stable_sort(wordAlternatives.begin(), wordAlternatives.end(), BetterAlternative());
+    // only counts the pruned options, so saturate rather than wrap
+    if (numCombinations > std::numeric_limits<size_t>::max() / wordAlternatives.size()) {
+      numCombinations = std::numeric_limits<size_t>::max();
+    } else {
+      numCombinations *= wordAlternatives.size();
     }
   }
 
-  // use generation list (wordList)
-  // set up iterators (total number of expansions)
-  size_t numIteration = 1;
-  vector< WordListIterator >  wordListIterVector(targetLength);
-  vector< const Word* >       mergeWords(targetLength);
+  // node i holds the alternative chosen for each word in
+  // indices[i * targetLength ...], and the last word it advanced
+  vector<size_t> indices(targetLength, 0), pivots(1, 0);
+  vector<size_t> current(targetLength);
+  DaryHeap<Expansion, ExpansionOrderer> queue;
+  Expansion best = { 0, 0 };
   for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
-    wordListIterVector[currPos] = wordListVector[currPos].begin();
-    numIteration *= wordListVector[currPos].size();
+    best.score += alternatives[currPos][0].weightedScore;
   }
-
-  // go thru each possible factor for each word & create hypothesis
-  for (size_t currIter = 0 ; currIter < numIteration ; currIter++) {
-    ScoreComponentCollection generationScore; // total score for this string of words
+  queue.push(best);
+
+  vector<const Word*> mergeWords(targetLength);
+  bool haveOffset = false;
+  float offset = 0; // score of an expansion minus its generation score
+  size_t numExpanded = 0;
+
+  while (!queue.empty()) {
+    const Expansion expansion = queue.top();
+    if (m_additive && haveOffset) {
+      // scaled by both parts, which may cancel out in the sum
+      const float slack = kBoundSlack * (std::fabs(offset) + std::fabs(expansion.score) + 1.0f);
+      if (!outputPartialTranslOptColl.IsAdmitted(offset + expansion.score + slack)) break;
+    }
+    queue.pop();
+    ++numExpanded;
+
+    std::copy(indices.begin() + expansion.node * targetLength,
+              indices.begin() + (expansion.node + 1) * targetLength,
+              current.begin());
+
+    // queue the successors
+    for (size_t advance = pivots[expansion.node] ; advance < targetLength ; advance++) {
+      if (current[advance] + 1 >= alternatives[advance].size()) continue;
+      Expansion next = { 0, pivots.size() };
+      for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
+        size_t index = current[currPos] + (currPos == advance);
+        indices.push_back(index);
+        next.score += alternatives[currPos][index].weightedScore;
+      }
+      pivots.push_back(advance);
+      queue.push(next);
+    }
 
     // create vector of words with new factors for last phrase
+    ScoreComponentCollection generationScore; // total score for this string of words
     for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
-      const WordPair &wordPair = *wordListIterVector[currPos];
-      mergeWords[currPos] = &(wordPair.first);
-      generationScore.PlusEquals(wordPair.second);
+      const Alternative &alternative = alternatives[currPos][current[currPos]];
+      mergeWords[currPos] = alternative.word;
+      generationScore.PlusEquals(*alternative.scores);
     }
 
     // merge with existing trans opt
     Phrase genPhrase( mergeWords);
 
     if (IsFilteringStep()) {
-      if (!inputPartialTranslOpt.IsCompatible(genPhrase, m_conflictFactors))
+      if (!inputPartialTranslOpt.IsCompatible(genPhrase, m_conflictFactors)) {
         continue;
+      }
     }
 
-    const TargetPhrase &inPhrase = inputPartialTranslOpt.GetTargetPhrase();
     TargetPhrase outPhrase(inPhrase);
     outPhrase.GetScoreBreakdown().PlusEquals(generationScore);
 
     outPhrase.MergeFactors(genPhrase, m_newOutputFactors);
     outPhrase.EvaluateInIsolation(inputPath.GetPhrase(), m_featuresToApply);
 
-    const WordsRange &sourceWordsRange = inputPartialTranslOpt.GetSourceWordsRange();
+    if (!haveOffset) {
+      offset = outPhrase.GetFutureScore() - expansion.score;
+      haveOffset = true;
+    }
+
+    if (!outputPartialTranslOptColl.IsAdmitted(outPhrase.GetFutureScore())) {
+      outputPartialTranslOptColl.AddPrunedCount(1);
+      continue;
+    }
 
     TranslationOption *newTransOpt = new TranslationOption(sourceWordsRange, outPhrase);
     assert(newTransOpt);
@@ -158,12 +237,10 @@ void DecodeStepGeneration::Process(const TranslationOption &inputPartialTranslOp
     newTransOpt->SetInputPath(inputPath);
 
     outputPartialTranslOptColl.Add(newTransOpt);
-
-    // increment iterators
-    IncrementIterators(wordListIterVector, wordListVector);
   }
-}
 
+  // the combinations never reached score below the threshold
+  outputPartialTranslOptColl.AddPrunedCount(numCombinations - numExpanded);
 }
 
-
+}
@@ -47,6 +47,10 @@ public:
                , bool adhereTableLimit) const;
 
 private:
+  /** whether only decode features are applied at this step, so that the
+   * score of an expansion is that of the best one plus the difference of
+   * their generation scores */
+  bool m_additive;
 };
 
 
@@ -86,6 +86,12 @@ void DecodeStepTranslation::Process(const TranslationOption &inputPartialTranslO
       outPhrase.Merge(targetPhrase, m_newOutputFactors);
       outPhrase.EvaluateInIsolation(inputPath.GetPhrase(), m_featuresToApply); // need to do this as all non-transcores would be screwed up
 
+      // don't create options the collection would delete straight away
+      if (!outputPartialTranslOptColl.IsAdmitted(outPhrase.GetFutureScore())) {
+        outputPartialTranslOptColl.AddPrunedCount(1);
+        continue;
+      }
+
       TranslationOption *newTransOpt = new TranslationOption(sourceWordsRange, outPhrase);
       assert(newTransOpt != NULL);
 
@@ -257,6 +263,11 @@ ProcessLEGACY(TranslationOption const& in,
       outPhrase.Merge(targetPhrase, m_newOutputFactors);
       outPhrase.EvaluateInIsolation(inputPath.GetPhrase(), m_featuresToApply); // need to do this as all non-transcores would be screwed up
 
+      if (!out.IsAdmitted(outPhrase.GetFutureScore())) {
+        out.AddPrunedCount(1);
+        continue;
+      }
+
       TranslationOption *newTransOpt = new TranslationOption(srcRange, outPhrase);
       assert(newTransOpt != NULL);
 
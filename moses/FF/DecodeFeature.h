@@ -71,6 +71,9 @@ public:
   void EvaluateWhenApplied(const Syntax::SHyperedge &hyperedge,
                            ScoreComponentCollection* accumulator) const {
   }
+  bool EvaluatesHyperedges() const {
+    return true;
+  }
   void EvaluateWithSourceContext(const InputType &input
                                  , const InputPath &inputPath
                                  , const TargetPhrase &targetPhrase
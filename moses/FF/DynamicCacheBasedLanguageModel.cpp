@@ -17,6 +17,7 @@ DynamicCacheBasedLanguageModel::DynamicCacheBasedLanguageModel(const std::string
   m_query_type = CBLM_QUERY_TYPE_ALLSUBSTRINGS;
   m_score_type = CBLM_SCORE_TYPE_HYPERBOLA;
   m_maxAge = 1000;
+  m_epoch = 0;
   m_name = "default";
   m_constant = false;
 
@@ -52,7 +53,7 @@ void DynamicCacheBasedLanguageModel::SetPreComputedScores()
   VERBOSE(3, "SetPreComputedScores(): lower_age:|" << m_maxAge << "| lower_score:|" << m_lower_score << "|" << std::endl);
 }
 
-float DynamicCacheBasedLanguageModel::GetPreComputedScores(const unsigned int age)
+float DynamicCacheBasedLanguageModel::GetPreComputedScores(const unsigned int age) const
 {
   VERBOSE(2, "float DynamicCacheBasedLanguageModel::GetPreComputedScores" << std::endl);
   VERBOSE(2, "age:|"<< age << "|" << std::endl);
@@ -65,6 +66,18 @@ float DynamicCacheBasedLanguageModel::GetPreComputedScores(const unsigned int ag
   }
 }
 
+float DynamicCacheBasedLanguageModel::GetScore(decaying_cache_t::const_iterator it) const
+{
+  if (it == m_cache.end()) {
+    return m_lower_score;
+  }
+  int64_t age = m_epoch - it->second;
+  if (age > (int64_t) m_maxAge) {
+    return m_lower_score; // decayed fully, but not evicted yet
+  }
+  return GetPreComputedScores(age);
+}
+
 void DynamicCacheBasedLanguageModel::SetParameter(const std::string& key, const std::string& value)
 {
   VERBOSE(2, "DynamicCacheBasedLanguageModel::SetParameter key:|" << key << "| value:|" << value << "|" << std::endl);
@@ -91,6 +104,9 @@ void DynamicCacheBasedLanguageModel::EvaluateInIsolation(const Phrase &sp
     , ScoreComponentCollection &estimatedFutureScore) const
 {
   float score = m_lower_score;
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
+#endif
   switch(m_query_type) {
   case CBLM_QUERY_TYPE_WHOLESTRING:
     score = Evaluate_Whole_String(tp);
@@ -125,8 +141,8 @@ float DynamicCacheBasedLanguageModel::Evaluate_Whole_String(const TargetPhrase&
   it = m_cache.find(w);
 
   VERBOSE(4,"cblm::Evaluate_Whole_String: searching w:|" << w << "|" << std::endl);
+  score = GetScore(it);
   if (it != m_cache.end()) { //found!
-    score = ((*it).second).second;
     VERBOSE(4,"cblm::Evaluate_Whole_String: found w:|" << w << "|" << std::endl);
   }
 
@@ -149,11 +165,9 @@ float DynamicCacheBasedLanguageModel::Evaluate_All_Substrings(const TargetPhrase
       w += tp.GetWord(endpos).GetFactor(0)->GetString().as_string();
       it = m_cache.find(w);
 
+      score += GetScore(it);
       if (it != m_cache.end()) { //found!
-        score += ((*it).second).second;
-        VERBOSE(3,"cblm::Evaluate_All_Substrings: found w:|" << w << "| actual score:|" << ((*it).second).second << "| score:|" << score << "|" << std::endl);
-      } else {
-        score += m_lower_score;
+        VERBOSE(3,"cblm::Evaluate_All_Substrings: found w:|" << w << "| actual score:|" << GetScore(it) << "| score:|" << score << "|" << std::endl);
       }
 
       if (endpos == startpos) {
@@ -175,48 +189,59 @@ void DynamicCacheBasedLanguageModel::Print() const
   std::cout << "Content of the cache of Cache-Based Language Model" << std::endl;
   std::cout << "Size of the cache of Cache-Based Language Model:|" << m_cache.size() << "|" << std::endl;
   for ( it=m_cache.begin() ; it != m_cache.end(); it++ ) {
-    std::cout << "word:|" << (*it).first << "| age:|" << ((*it).second).first << "| score:|" << ((*it).second).second << "|" << std::endl;
+    std::cout << "word:|" << (*it).first << "| age:|" << m_epoch - (*it).second << "| score:|" << GetScore(it) << "|" << std::endl;
   }
 }
 
 void DynamicCacheBasedLanguageModel::Decay()
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
+#endif
+  {
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
+#endif
+    ++m_epoch; // every word is now one older
+  }
+  // only the words which may have decayed fully are visited
+  while (!m_expiry.empty() && m_expiry.begin()->first <= m_epoch) {
+    const std::string &word = m_expiry.begin()->second;
+    decaying_cache_t::iterator it = m_cache.find(word);
+    // the word may have been updated since this eviction was scheduled
+    if (it != m_cache.end() && m_epoch - it->second > (int64_t) m_maxAge) {
+#ifdef WITH_THREADS
+      boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
 #endif
-  decaying_cache_t::iterator it;
-
-  unsigned int age;
-  float score;
-  for ( it=m_cache.begin() ; it != m_cache.end(); it++ ) {
-    age=((*it).second).first + 1;
-    if (age > m_maxAge) {
       m_cache.erase(it);
-      it--;
-    } else {
-      score = GetPreComputedScores(age);
-//      score = decaying_score(age);
-      decaying_cache_value_t p (age, score);
-      (*it).second = p;
     }
+    m_expiry.erase(m_expiry.begin());
   }
 }
 
 void DynamicCacheBasedLanguageModel::Update(std::vector<std::string> words, int age)
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
+  // older words score like m_maxAge; they are evicted at the next Decay
+  if (age < 0 || age > (int) m_maxAge) {
+    age = m_maxAge;
+  }
+  decaying_cache_value_t stamp = m_epoch - age;
   VERBOSE(3,"words.size():|" << words.size() << "|" << std::endl);
   for (size_t j=0; j<words.size(); j++) {
     words[j] = Trim(words[j]);
-//    VERBOSE(3,"CacheBasedLanguageModel::Update   word[" << j << "]:"<< words[j] << " age:" << age << " decaying_score(age):" << decaying_score(age) << std::endl);
-//    decaying_cache_value_t p (age,decaying_score(age));
     VERBOSE(3,"CacheBasedLanguageModel::Update   word[" << j << "]:"<< words[j] << " age:" << age << " GetPreComputedScores(age):" << GetPreComputedScores(age) << std::endl);
-    decaying_cache_value_t p (age,GetPreComputedScores(age));
-    std::pair<std::string, decaying_cache_value_t> e (words[j],p);
-    m_cache.erase(words[j]); //always erase the element (do nothing if the entry does not exist)
-    m_cache.insert(e); //insert the entry
+    {
+#ifdef WITH_THREADS
+      boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
+#endif
+      m_cache[words[j]] = stamp; //insert the entry or overwrite its age
+    }
+    if (m_constant == false) {
+      m_expiry.insert(std::make_pair(stamp + m_maxAge + 1, words[j]));
+    }
   }
 }
 
@@ -233,12 +258,15 @@ void DynamicCacheBasedLanguageModel::ClearEntries(std::string &entries)
 void DynamicCacheBasedLanguageModel::ClearEntries(std::vector<std::string> words)
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
   VERBOSE(3,"words.size():|" << words.size() << "|" << std::endl);
   for (size_t j=0; j<words.size(); j++) {
     words[j] = Trim(words[j]);
     VERBOSE(3,"CacheBasedLanguageModel::ClearEntries   word[" << j << "]:"<< words[j] << std::endl);
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
+#endif
     m_cache.erase(words[j]); //always erase the element (do nothing if the entry does not exist)
   }
 }
@@ -318,9 +346,16 @@ void DynamicCacheBasedLanguageModel::Execute_Single_Command(std::string command)
 void DynamicCacheBasedLanguageModel::Clear()
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
-  m_cache.clear();
+  decaying_cache_t previous;
+  {
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
+#endif
+    m_cache.swap(previous);
+  }
+  m_expiry.clear();
 }
 
 void DynamicCacheBasedLanguageModel::Load()
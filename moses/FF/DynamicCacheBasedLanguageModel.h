@@ -7,11 +7,14 @@
 #include "FeatureFunction.h"
 
 #ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/locks.hpp>
 #endif
 
-typedef std::pair<int, float> decaying_cache_value_t;
+#include <stdint.h>
+
+typedef int64_t decaying_cache_value_t; // epoch at which the entry had age 0
 typedef std::map<std::string, decaying_cache_value_t > decaying_cache_t;
 
 #define CBLM_QUERY_TYPE_UNDEFINED (-1)
@@ -34,12 +37,18 @@ namespace Moses
 class WordsRange;
 
 /** Calculates score for the Dynamic Cache-Based pseudo LM
+ *
+ * As in PhraseDictionaryDynamicCacheBased, ages are computed from an epoch
+ * that every Insert advances, so no update walks the whole cache.
  */
 class DynamicCacheBasedLanguageModel : public StatelessFeatureFunction
 {
   // data structure for the cache;
-  // the key is the word and the value is the decaying score
+  // the key is the word and the value is the epoch at which its age was 0
   decaying_cache_t m_cache;
+  // epoch at which a word may have decayed fully
+  std::multimap<int64_t, std::string> m_expiry;
+  int64_t m_epoch;
   size_t m_query_type; //way of querying the cache
   size_t m_score_type; //way of scoring entries of the cache
   std::string m_initfiles; // vector of files loaded in the initialization phase
@@ -50,18 +59,22 @@ class DynamicCacheBasedLanguageModel : public StatelessFeatureFunction
   unsigned int m_maxAge;
 
 #ifdef WITH_THREADS
-  //multiple readers - single writer lock
+  //multiple readers - single writer lock; writers hold it for one word at a time
   mutable boost::shared_mutex m_cacheLock;
+  //serializes writers
+  boost::mutex m_updateLock;
 #endif
 
   float decaying_score(unsigned int age);
   void SetPreComputedScores();
-  float GetPreComputedScores(const unsigned int age);
+  float GetPreComputedScores(const unsigned int age) const;
+  float GetScore(decaying_cache_t::const_iterator it) const;
 
+  //callers hold m_cacheLock
   float Evaluate_Whole_String( const TargetPhrase&) const;
   float Evaluate_All_Substrings( const TargetPhrase&) const;
 
-  void Decay();
+  void Decay(); // age the cache by one and evict the words that decayed fully
   void Update(std::vector<std::string> words, int age);
 
   void ClearEntries(std::vector<std::string> entries);
@@ -1,6 +1,7 @@
 #ifndef moses_FFState_h
 #define moses_FFState_h
 
+#include <cstddef>
 #include <vector>
 
 
@@ -12,6 +13,12 @@ class FFState
 public:
   virtual ~FFState();
   virtual int Compare(const FFState& other) const = 0;
+
+  //! Hash consistent with Compare, for searches that recombine by hash.  The
+  //! default is correct but puts all states in one bucket.
+  virtual size_t Hash() const {
+    return 0;
+  }
 };
 
 class DummyState : public FFState
@@ -71,6 +71,12 @@ public:
   virtual void Load() {
   }
 
+  //! descriptions of the feature functions that must be loaded before this one.
+  //! Load() may run in parallel with the Load() of any feature not listed here
+  virtual std::vector<std::string> GetLoadDependencies() const {
+    return std::vector<std::string>();
+  }
+
   static void ResetDescriptionCounts() {
     description_counts.clear();
   }
@@ -126,6 +132,14 @@ public:
   virtual void
   InitializeForInput(ttasksptr const& ttask) { };
 
+  //! Whether EvaluateInIsolation() reads state that InitializeForInput()
+  //! set up for the decoding thread only. Translation options are then
+  //! collected on that thread, whatever options-threads says.
+  virtual bool
+  KeepsThreadLocalInputState() const {
+    return false;
+  }
+
   // clean up temporary memory, called after processing each sentence
   virtual void
   CleanUpAfterSentenceProcessing(ttasksptr const& ttask);
@@ -11,18 +11,18 @@ using namespace std;
 
 namespace Moses
 {
+
+namespace
+{
+// scores are log probabilities, so this can't be one
+const float kUnscored = 1.0f;
+}
+
 GlobalLexicalModel::GlobalLexicalModel(const std::string &line)
   : StatelessFeatureFunction(1, line)
 {
   std::cerr << "Creating global lexical model...\n";
   ReadParameters();
-
-  // define bias word
-  FactorCollection &factorCollection = FactorCollection::Instance();
-  m_bias = new Word();
-  const Factor* factor = factorCollection.AddFactor( Input, m_inputFactorsVec[0], "**BIAS**" );
-  m_bias->SetFactor( m_inputFactorsVec[0], factor );
-
 }
 
 void GlobalLexicalModel::SetParameter(const std::string& key, const std::string& value)
@@ -40,131 +40,117 @@ void GlobalLexicalModel::SetParameter(const std::string& key, const std::string&
 
 GlobalLexicalModel::~GlobalLexicalModel()
 {
-  // delete words in the hash data structure
-  DoubleHash::const_iterator iter;
-  for(iter = m_hash.begin(); iter != m_hash.end(); iter++ ) {
-    map< const Word*, float, WordComparer >::const_iterator iter2;
-    for(iter2 = iter->second.begin(); iter2 != iter->second.end(); iter2++ ) {
-      delete iter2->first; // delete input word
+}
+
+void GlobalLexicalModel::WordIndex::Init(const std::vector<FactorType> &factors,
+    const std::vector<std::vector<std::string> > &vocab)
+{
+  FactorCollection &factorCollection = FactorCollection::Instance();
+  m_factors = factors;
+
+  for (uint32_t id = 0; id < vocab.size(); ++id) {
+    if (m_factors.size() == 1) {
+      size_t factorId = factorCollection.AddFactor(vocab[id][0])->GetId();
+      if (factorId >= m_byFactorId.size()) {
+        m_byFactorId.resize(factorId + 1, GlobalLexiconTable::kNotFound);
+      }
+      m_byFactorId[factorId] = id;
+    } else {
+      std::vector<const Factor*> key(m_factors.size());
+      for (size_t i = 0; i < m_factors.size(); ++i) {
+        key[i] = factorCollection.AddFactor(vocab[id][i]);
+      }
+      m_byFactors[key] = id;
+    }
+  }
+}
+
+uint32_t GlobalLexicalModel::WordIndex::Find(const Word &word) const
+{
+  if (m_factors.size() == 1) {
+    const Factor *factor = word[m_factors[0]];
+    if (factor == NULL || factor->GetId() >= m_byFactorId.size()) {
+      return GlobalLexiconTable::kNotFound;
     }
-    delete iter->first; // delete output word
+    return m_byFactorId[factor->GetId()];
+  }
+
+  std::vector<const Factor*> key(m_factors.size());
+  for (size_t i = 0; i < m_factors.size(); ++i) {
+    key[i] = word[m_factors[i]];
   }
+  FactorsMap::const_iterator iter = m_byFactors.find(key);
+  return iter == m_byFactors.end() ? GlobalLexiconTable::kNotFound : iter->second;
 }
 
 void GlobalLexicalModel::Load()
 {
-  FactorCollection &factorCollection = FactorCollection::Instance();
   const std::string& factorDelimiter = StaticData::Instance().GetFactorDelimiter();
 
   VERBOSE(2, "Loading global lexical model from file " << m_filePath << endl);
 
   m_inputFactors = FactorMask(m_inputFactorsVec);
   m_outputFactors = FactorMask(m_outputFactorsVec);
-  InputFileStream inFile(m_filePath);
-
-  // reading in data one line at a time
-  size_t lineNum = 0;
-  string line;
-  while(getline(inFile, line)) {
-    ++lineNum;
-    vector<string> token = Tokenize<string>(line, " ");
-
-    if (token.size() != 3) { // format checking
-      UTIL_THROW2("Syntax error at " << m_filePath << ":" << lineNum << ":" << line);
-    }
-
-    // create the output word
-    Word *outWord = new Word();
-    vector<string> factorString = Tokenize( token[0], factorDelimiter );
-    for (size_t i=0 ; i < m_outputFactorsVec.size() ; i++) {
-      const FactorDirection& direction = Output;
-      const FactorType& factorType = m_outputFactorsVec[i];
-      const Factor* factor = factorCollection.AddFactor( direction, factorType, factorString[i] );
-      outWord->SetFactor( factorType, factor );
-    }
-
-    // create the input word
-    Word *inWord = new Word();
-    factorString = Tokenize( token[1], factorDelimiter );
-    for (size_t i=0 ; i < m_inputFactorsVec.size() ; i++) {
-      const FactorDirection& direction = Input;
-      const FactorType& factorType = m_inputFactorsVec[i];
-      const Factor* factor = factorCollection.AddFactor( direction, factorType, factorString[i] );
-      inWord->SetFactor( factorType, factor );
-    }
-
-    // maximum entropy feature score
-    float score = Scan<float>(token[2]);
 
-    // std::cerr << "storing word " << *outWord << " " << *inWord << " " << score << endl;
-
-    // store feature in hash
-    DoubleHash::iterator keyOutWord = m_hash.find( outWord );
-    if( keyOutWord == m_hash.end() ) {
-      m_hash[outWord][inWord] = score;
-    } else { // already have hash for outword, delete the word to avoid leaks
-      (keyOutWord->second)[inWord] = score;
-      delete outWord;
-    }
-  }
+  m_table.Load(m_filePath, factorDelimiter, m_outputFactorsVec.size(), m_inputFactorsVec.size());
+  m_targetIndex.Init(m_outputFactorsVec, m_table.GetTargetVocab());
+  m_sourceIndex.Init(m_inputFactorsVec, m_table.GetSourceVocab());
 }
 
 void GlobalLexicalModel::InitializeForInput(ttasksptr const& ttask)
 {
   UTIL_THROW_IF2(ttask->GetSource()->GetType() != SentenceInput,
                  "GlobalLexicalModel works only with sentence input.");
-  Sentence const* s = reinterpret_cast<Sentence const*>(ttask->GetSource().get());
-  m_local.reset(new ThreadLocalStorage);
-  m_local->input = s;
+  Sentence const* s = static_cast<Sentence const*>(ttask->GetSource().get());
+  if (!m_local.get()) {
+    m_local.reset(new ThreadLocalStorage);
+  }
+
+  // the input words that are in the lexicon, each once, in input order
+  std::vector<uint32_t> &input = m_local->input;
+  input.clear();
+  std::vector<bool> seen(m_table.NumSourceWords(), false);
+  for(size_t inputIndex = 0; inputIndex < s->GetSize(); inputIndex++ ) {
+    uint32_t id = m_sourceIndex.Find(s->GetWord( inputIndex ));
+    if (id != GlobalLexiconTable::kNotFound && !seen[id]) {
+      seen[id] = true;
+      input.push_back(id);
+    }
+  }
+
+  m_local->scores.assign(m_table.NumTargetWords(), kUnscored);
 }
 
-float GlobalLexicalModel::ScorePhrase( const TargetPhrase& targetPhrase ) const
+float GlobalLexicalModel::ScoreWord( uint32_t targetId ) const
 {
-  const Sentence& input = *(m_local->input);
-  float score = 0;
-  for(size_t targetIndex = 0; targetIndex < targetPhrase.GetSize(); targetIndex++ ) {
-    float sum = 0;
-    const Word& targetWord = targetPhrase.GetWord( targetIndex );
-    VERBOSE(2,"glm " << targetWord << ": ");
-    const DoubleHash::const_iterator targetWordHash = m_hash.find( &targetWord );
-    if( targetWordHash != m_hash.end() ) {
-      SingleHash::const_iterator inputWordHash = targetWordHash->second.find( m_bias );
-      if( inputWordHash != targetWordHash->second.end() ) {
-        VERBOSE(2,"*BIAS* " << inputWordHash->second);
-        sum += inputWordHash->second;
-      }
+  float sum = 0;
+  if (targetId != GlobalLexiconTable::kNotFound) {
+    float &score = m_local->scores[targetId];
+    if (score != kUnscored) {
+      return score;
+    }
 
-      set< const Word*, WordComparer > alreadyScored; // do not score a word twice
-      for(size_t inputIndex = 0; inputIndex < input.GetSize(); inputIndex++ ) {
-        const Word& inputWord = input.GetWord( inputIndex );
-        if ( alreadyScored.find( &inputWord ) == alreadyScored.end() ) {
-          SingleHash::const_iterator inputWordHash = targetWordHash->second.find( &inputWord );
-          if( inputWordHash != targetWordHash->second.end() ) {
-            VERBOSE(2," " << inputWord << " " << inputWordHash->second);
-            sum += inputWordHash->second;
-          }
-          alreadyScored.insert( &inputWord );
-        }
+    sum += m_table.GetBias(targetId);
+    const std::vector<uint32_t> &input = m_local->input;
+    for (size_t i = 0; i < input.size(); ++i) {
+      float weight;
+      if (m_table.FindWeight(targetId, input[i], weight)) {
+        sum += weight;
       }
     }
     // Hal Daume says: 1/( 1 + exp [ - sum_i w_i * f_i ] )
-    VERBOSE(2," p=" << FloorScore( log(1/(1+exp(-sum))) ) << endl);
-    score += FloorScore( log(1/(1+exp(-sum))) );
+    score = FloorScore( log(1/(1+exp(-sum))) );
+    return score;
   }
-  return score;
+  return FloorScore( log(1/(1+exp(-sum))) );
 }
 
-float GlobalLexicalModel::GetFromCacheOrScorePhrase( const TargetPhrase& targetPhrase ) const
+float GlobalLexicalModel::ScorePhrase( const TargetPhrase& targetPhrase ) const
 {
-  LexiconCache& m_cache = m_local->cache;
-  const LexiconCache::const_iterator query = m_cache.find( &targetPhrase );
-  if ( query != m_cache.end() ) {
-    return query->second;
+  float score = 0;
+  for(size_t targetIndex = 0; targetIndex < targetPhrase.GetSize(); targetIndex++ ) {
+    score += ScoreWord( m_targetIndex.Find(targetPhrase.GetWord( targetIndex )) );
   }
-
-  float score = ScorePhrase( targetPhrase );
-  m_cache.insert( pair<const TargetPhrase*, float>(&targetPhrase, score) );
-  //VERBOSE(2, "add to cache " << targetPhrase << ": " << score << endl);
   return score;
 }
 
@@ -173,7 +159,7 @@ void GlobalLexicalModel::EvaluateInIsolation(const Phrase &source
     , ScoreComponentCollection &scoreBreakdown
     , ScoreComponentCollection &estimatedFutureScore) const
 {
-  scoreBreakdown.PlusEquals( this, GetFromCacheOrScorePhrase(targetPhrase) );
+  scoreBreakdown.PlusEquals( this, ScorePhrase(targetPhrase) );
 }
 
 bool GlobalLexicalModel::IsUseable(const FactorMask &mask) const
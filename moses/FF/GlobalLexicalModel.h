@@ -13,6 +13,9 @@
 #include "moses/WordsRange.h"
 #include "moses/FactorTypeSet.h"
 #include "moses/Sentence.h"
+#include "GlobalLexiconTable.h"
+
+#include <boost/unordered_map.hpp>
 
 #ifdef WITH_THREADS
 #include <boost/thread/tss.hpp>
@@ -30,26 +33,42 @@ class InputType;
  * This is a implementation of Mauser et al., 2009's model that predicts
  * each output word from _all_ the input words. The intuition behind this
  * feature is that it uses context words for disambiguation
+ *
+ * The lexicon is read from text or from a file binarized with
+ * processGlobalLexicalModel, see GlobalLexiconTable.
  */
 class GlobalLexicalModel : public StatelessFeatureFunction
 {
-  typedef std::map< const Word*, std::map< const Word*, float, WordComparer >, WordComparer > DoubleHash;
-  typedef std::map< const Word*, float, WordComparer > SingleHash;
-  typedef std::map< const TargetPhrase*, float > LexiconCache;
+  /** lexicon id of a word. Looked up in an array indexed by factor id when
+   * the model uses a single factor, in a hash of the factors otherwise */
+  class WordIndex
+  {
+  public:
+    void Init(const std::vector<FactorType> &factors,
+              const std::vector<std::vector<std::string> > &vocab);
+    uint32_t Find(const Word &word) const;
+
+  private:
+    typedef boost::unordered_map<std::vector<const Factor*>, uint32_t> FactorsMap;
+
+    std::vector<FactorType> m_factors;
+    std::vector<uint32_t> m_byFactorId;
+    FactorsMap m_byFactors;
+  };
 
   struct ThreadLocalStorage {
-    LexiconCache cache;
-    const Sentence *input;
+    std::vector<uint32_t> input; // distinct lexicon ids of the input words, in input order
+    std::vector<float> scores; // score of each target word in this sentence, kUnscored until needed
   };
 
 private:
-  DoubleHash m_hash;
+  GlobalLexiconTable m_table;
+  WordIndex m_targetIndex, m_sourceIndex;
 #ifdef WITH_THREADS
   boost::thread_specific_ptr<ThreadLocalStorage> m_local;
 #else
   std::auto_ptr<ThreadLocalStorage> m_local;
 #endif
-  Word *m_bias;
 
   FactorMask m_inputFactors, m_outputFactors;
   std::vector<FactorType> m_inputFactorsVec, m_outputFactorsVec;
@@ -58,7 +77,7 @@ private:
   void Load();
 
   float ScorePhrase( const TargetPhrase& targetPhrase ) const;
-  float GetFromCacheOrScorePhrase( const TargetPhrase& targetPhrase ) const;
+  float ScoreWord( uint32_t targetId ) const;
 
 public:
   GlobalLexicalModel(const std::string &line);
@@ -68,6 +87,11 @@ public:
 
   void InitializeForInput(ttasksptr const& ttask);
 
+  //! the input words and scores are in m_local
+  bool KeepsThreadLocalInputState() const {
+    return true;
+  }
+
   bool IsUseable(const FactorMask &mask) const;
 
   void EvaluateInIsolation(const Phrase &source
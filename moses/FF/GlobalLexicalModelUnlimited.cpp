@@ -109,7 +109,7 @@ void GlobalLexicalModelUnlimited::InitializeForInput(ttasksptr const& ttask)
 {
   UTIL_THROW_IF2(ttask->GetSource()->GetType() != SentenceInput,
                  "GlobalLexicalModel works only with sentence input.");
-  Sentence const* s = reinterpret_cast<Sentence const*>(ttask->GetSource().get());
+  Sentence const* s = static_cast<Sentence const*>(ttask->GetSource().get());
   m_local.reset(new ThreadLocalStorage);
   m_local->input = s;
 }
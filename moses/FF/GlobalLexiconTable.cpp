@@ -0,0 +1,266 @@
+#include <cstring>
+#include <boost/unordered_map.hpp>
+
+#include "GlobalLexiconTable.h"
+#include "moses/InputFileStream.h"
+#include "moses/Util.h"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/scoped.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+const char kMagic[8] = {'m', 'o', 's', 'e', 's', 'G', 'L', 'M'};
+const uint64_t kVersion = 1;
+
+struct BinaryHeader {
+  char magic[8];
+  uint64_t version;
+  uint64_t numFactors[2];
+  uint64_t numWords[2];
+  uint64_t vocabBytes;
+  uint64_t buckets;
+};
+
+const char kBiasWord[] = "**BIAS**";
+
+size_t Align8(size_t size)
+{
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// dense ids for the words of one side, keyed on their factors joined by '\0'
+class VocabBuilder
+{
+public:
+  VocabBuilder(vector<vector<string> > &vocab) : m_vocab(vocab) {}
+
+  uint32_t Add(const vector<string> &factors, size_t numFactors) {
+    string key;
+    for (size_t i = 0; i < numFactors; ++i) {
+      key += factors[i];
+      key += '\0';
+    }
+    pair<Map::iterator, bool> ret = m_ids.insert(make_pair(key, (uint32_t) m_vocab.size()));
+    if (ret.second) {
+      UTIL_THROW_IF2(m_vocab.size() >= GlobalLexiconTable::kNotFound, "Too many words in global lexicon");
+      m_vocab.push_back(vector<string>(factors.begin(), factors.begin() + numFactors));
+    }
+    return ret.first->second;
+  }
+
+private:
+  typedef boost::unordered_map<string, uint32_t> Map;
+  Map m_ids;
+  vector<vector<string> > &m_vocab;
+};
+
+void WriteVocab(const vector<vector<string> > &vocab, string &to)
+{
+  for (size_t i = 0; i < vocab.size(); ++i) {
+    for (size_t j = 0; j < vocab[i].size(); ++j) {
+      to += vocab[i][j];
+      to += '\0';
+    }
+  }
+}
+
+const char *ReadVocab(const char *from, const char *end, size_t numWords, size_t numFactors, vector<vector<string> > &vocab)
+{
+  vocab.resize(numWords);
+  for (size_t i = 0; i < numWords; ++i) {
+    vocab[i].resize(numFactors);
+    for (size_t j = 0; j < numFactors; ++j) {
+      const char *stop = static_cast<const char*>(memchr(from, '\0', end - from));
+      UTIL_THROW_IF2(stop == NULL, "Truncated vocabulary in binary global lexicon");
+      vocab[i][j].assign(from, stop);
+      from = stop + 1;
+    }
+  }
+  return from;
+}
+
+}
+
+const uint32_t GlobalLexiconTable::kNotFound;
+const uint64_t GlobalLexiconTable::kInvalidKey;
+
+GlobalLexiconTable::GlobalLexiconTable()
+  : m_bias(NULL)
+  , m_buckets(0)
+{
+  m_numFactors[0] = m_numFactors[1] = 0;
+}
+
+bool GlobalLexiconTable::IsBinary(const string &path)
+{
+  util::scoped_fd file(util::OpenReadOrThrow(path.c_str()));
+  char magic[sizeof(kMagic)];
+  if (util::ReadOrEOF(file.get(), magic, sizeof(magic)) != sizeof(magic)) return false;
+  return !memcmp(magic, kMagic, sizeof(kMagic));
+}
+
+void GlobalLexiconTable::Load(const string &path, const string &factorDelimiter,
+                              size_t numTargetFactors, size_t numSourceFactors)
+{
+  if (IsBinary(path)) {
+    LoadBinary(path);
+    UTIL_THROW_IF2(NumTargetFactors() != numTargetFactors || NumSourceFactors() != numSourceFactors,
+                   "Binary global lexicon " << path << " was built for "
+                   << NumTargetFactors() << " output and " << NumSourceFactors()
+                   << " input factors");
+  } else {
+    LoadText(path, factorDelimiter, numTargetFactors, numSourceFactors);
+  }
+}
+
+void GlobalLexiconTable::LoadText(const string &path, const string &factorDelimiter,
+                                  size_t numTargetFactors, size_t numSourceFactors)
+{
+  m_numFactors[0] = numTargetFactors;
+  m_numFactors[1] = numSourceFactors;
+  m_targetVocab.clear();
+  m_sourceVocab.clear();
+  VocabBuilder targetVocab(m_targetVocab), sourceVocab(m_sourceVocab);
+
+  // bias words are kept apart from the pairs: kNotFound marks them
+  vector<pair<uint64_t, float> > weights;
+  InputFileStream inFile(path);
+
+  size_t lineNum = 0;
+  string line;
+  while(getline(inFile, line)) {
+    ++lineNum;
+    vector<string> token = Tokenize<string>(line, " ");
+    UTIL_THROW_IF2(token.size() != 3,
+                   "Syntax error at " << path << ":" << lineNum << ":" << line);
+
+    vector<string> targetFactors = Tokenize(token[0], factorDelimiter);
+    UTIL_THROW_IF2(targetFactors.size() < numTargetFactors,
+                   "Syntax error at " << path << ":" << lineNum << ":" << line);
+    uint32_t target = targetVocab.Add(targetFactors, numTargetFactors);
+
+    uint32_t source = kNotFound;
+    if (token[1] != kBiasWord) {
+      vector<string> sourceFactors = Tokenize(token[1], factorDelimiter);
+      UTIL_THROW_IF2(sourceFactors.size() < numSourceFactors,
+                     "Syntax error at " << path << ":" << lineNum << ":" << line);
+      source = sourceVocab.Add(sourceFactors, numSourceFactors);
+    }
+
+    weights.push_back(make_pair(Pack(target, source), Scan<float>(token[2])));
+  }
+
+  BuildTable(weights);
+}
+
+void GlobalLexiconTable::BuildTable(const vector<pair<uint64_t, float> > &weights)
+{
+  size_t numPairs = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    if ((uint32_t) weights[i].first != kNotFound) ++numPairs;
+  }
+
+  const size_t biasBytes = Align8(m_targetVocab.size() * sizeof(float));
+  const size_t tableBytes = Table::Size(numPairs, 1.5);
+  // zeroed as a whole, alignment padding included, since WriteBinary() dumps it
+  m_memory.reset(util::CallocOrThrow(biasBytes + tableBytes), biasBytes + tableBytes, util::scoped_memory::MALLOC_ALLOCATED);
+
+  float *bias = reinterpret_cast<float*>(m_memory.get());
+  m_bias = bias;
+
+  Entry *begin = reinterpret_cast<Entry*>(static_cast<char*>(m_memory.get()) + biasBytes);
+  Entry *end = begin + tableBytes / sizeof(Entry);
+  for (Entry *i = begin; i != end; ++i) {
+    i->key = kInvalidKey;
+  }
+  m_buckets = tableBytes / sizeof(Entry);
+  m_table = Table(begin, tableBytes, kInvalidKey);
+
+  // later lines override earlier ones
+  for (size_t i = 0; i < weights.size(); ++i) {
+    uint32_t target = weights[i].first >> 32;
+    if ((uint32_t) weights[i].first == kNotFound) {
+      bias[target] = weights[i].second;
+      continue;
+    }
+    Entry entry;
+    entry.key = weights[i].first;
+    entry.value = weights[i].second;
+    entry.padding = 0;
+    Table::MutableIterator it;
+    if (m_table.FindOrInsert(entry, it)) {
+      it->value = entry.value;
+    }
+  }
+}
+
+void GlobalLexiconTable::LoadBinary(const string &path, util::LoadMethod method)
+{
+  util::scoped_fd file(util::OpenReadOrThrow(path.c_str()));
+  const uint64_t size = util::SizeOrThrow(file.get());
+  UTIL_THROW_IF2(size < sizeof(BinaryHeader), "Binary global lexicon " << path << " is too small");
+  util::MapRead(method, file.get(), 0, size, m_memory);
+
+  const char *base = m_memory.begin();
+  BinaryHeader header;
+  memcpy(&header, base, sizeof(header));
+  UTIL_THROW_IF2(memcmp(header.magic, kMagic, sizeof(kMagic)), path << " is not a binary global lexicon");
+  UTIL_THROW_IF2(header.version != kVersion,
+                 "Binary global lexicon " << path << " has version " << header.version
+                 << " but this Moses reads version " << kVersion);
+
+  m_numFactors[0] = header.numFactors[0];
+  m_numFactors[1] = header.numFactors[1];
+
+  const char *vocab = base + sizeof(BinaryHeader);
+  const char *vocabEnd = vocab + header.vocabBytes;
+  const size_t biasBytes = Align8(header.numWords[0] * sizeof(float));
+  const size_t tableBytes = header.buckets * sizeof(Entry);
+  const size_t offset = sizeof(BinaryHeader) + Align8(header.vocabBytes);
+  UTIL_THROW_IF2(offset + biasBytes + tableBytes != size,
+                 "Binary global lexicon " << path << " has the wrong size");
+
+  vocab = ReadVocab(vocab, vocabEnd, header.numWords[0], m_numFactors[0], m_targetVocab);
+  ReadVocab(vocab, vocabEnd, header.numWords[1], m_numFactors[1], m_sourceVocab);
+
+  m_bias = reinterpret_cast<const float*>(base + offset);
+  m_buckets = header.buckets;
+  m_table = Table(const_cast<char*>(base) + offset + biasBytes, tableBytes, kInvalidKey);
+}
+
+void GlobalLexiconTable::WriteBinary(const string &path) const
+{
+  string vocab;
+  WriteVocab(m_targetVocab, vocab);
+  WriteVocab(m_sourceVocab, vocab);
+
+  BinaryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.numFactors[0] = m_numFactors[0];
+  header.numFactors[1] = m_numFactors[1];
+  header.numWords[0] = m_targetVocab.size();
+  header.numWords[1] = m_sourceVocab.size();
+  header.vocabBytes = vocab.size();
+  header.buckets = m_buckets;
+
+  // bias and table are already laid out as in the file, behind the header and vocabulary
+  vocab.resize(Align8(vocab.size()), '\0');
+  const char *arrays = reinterpret_cast<const char*>(m_bias);
+  const size_t arrayBytes = Align8(m_targetVocab.size() * sizeof(float)) + header.buckets * sizeof(Entry);
+
+  util::scoped_fd file(util::CreateOrThrow(path.c_str()));
+  util::WriteOrThrow(file.get(), &header, sizeof(header));
+  util::WriteOrThrow(file.get(), vocab.data(), vocab.size());
+  util::WriteOrThrow(file.get(), arrays, arrayBytes);
+}
+
+}
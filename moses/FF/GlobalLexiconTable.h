@@ -0,0 +1,134 @@
+#ifndef moses_GlobalLexiconTable_h
+#define moses_GlobalLexiconTable_h
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "util/mmap.hh"
+#include "util/murmur_hash.hh"
+#include "util/probing_hash_table.hh"
+
+namespace Moses
+{
+
+/** Weights of the global lexical model in a flat open-addressing table.
+ *
+ * Target and source words are numbered densely in the order they first
+ * appear in the lexicon. The weight of a (target, source) pair sits in a
+ * linear-probing table keyed on both ids packed into 64 bits, and the bias
+ * of each target word in an array indexed by target id.
+ *
+ * The binary format is the in-memory layout, so a binarized lexicon is
+ * mmapped rather than parsed. The table knows nothing of Moses factors:
+ * a word is stored as the strings of its factors, and the feature function
+ * maps factors to ids when it loads.
+ */
+class GlobalLexiconTable
+{
+public:
+  static const uint32_t kNotFound = 0xffffffff;
+
+  GlobalLexiconTable();
+
+  /** text lexicon, one "target source weight" triple per line. Words may have
+   * several factors joined by factorDelimiter, only the first numTargetFactors
+   * (numSourceFactors) are used. A source word of **BIAS** gives the bias
+   */
+  void LoadText(const std::string &path, const std::string &factorDelimiter,
+                size_t numTargetFactors, size_t numSourceFactors);
+
+  void LoadBinary(const std::string &path, util::LoadMethod method = util::POPULATE_OR_READ);
+
+  //! load either format, telling them apart by the binary header
+  void Load(const std::string &path, const std::string &factorDelimiter,
+            size_t numTargetFactors, size_t numSourceFactors);
+
+  void WriteBinary(const std::string &path) const;
+
+  static bool IsBinary(const std::string &path);
+
+  size_t NumTargetFactors() const {
+    return m_numFactors[0];
+  }
+  size_t NumSourceFactors() const {
+    return m_numFactors[1];
+  }
+  size_t NumTargetWords() const {
+    return m_targetVocab.size();
+  }
+  size_t NumSourceWords() const {
+    return m_sourceVocab.size();
+  }
+
+  //! factor strings of each word, indexed by id
+  const std::vector<std::vector<std::string> > &GetTargetVocab() const {
+    return m_targetVocab;
+  }
+  const std::vector<std::vector<std::string> > &GetSourceVocab() const {
+    return m_sourceVocab;
+  }
+
+  float GetBias(uint32_t target) const {
+    return m_bias[target];
+  }
+
+  //! weight of a (target, source) pair, 0 if it isn't in the lexicon
+  float GetWeight(uint32_t target, uint32_t source) const {
+    Table::ConstIterator found;
+    return m_table.Find(Pack(target, source), found) ? found->value : 0;
+  }
+
+  //! weight of a (target, source) pair. Returns false if it isn't in the lexicon
+  bool FindWeight(uint32_t target, uint32_t source, float &weight) const {
+    Table::ConstIterator found;
+    if (!m_table.Find(Pack(target, source), found)) return false;
+    weight = found->value;
+    return true;
+  }
+
+private:
+  struct Entry {
+    typedef uint64_t Key;
+    uint64_t key;
+    float value;
+    // spelled out and always zero, so no uninitialised bytes reach the binary file
+    uint32_t padding;
+
+    Key GetKey() const {
+      return key;
+    }
+    void SetKey(Key to) {
+      key = to;
+    }
+  };
+
+  struct Hash {
+    uint64_t operator()(uint64_t key) const {
+      return util::MurmurHashNative(&key, sizeof(key));
+    }
+  };
+
+  typedef util::ProbingHashTable<Entry, Hash> Table;
+
+  static const uint64_t kInvalidKey = ~static_cast<uint64_t>(0);
+
+  static uint64_t Pack(uint32_t target, uint32_t source) {
+    return (static_cast<uint64_t>(target) << 32) | source;
+  }
+
+  void BuildTable(const std::vector<std::pair<uint64_t, float> > &weights);
+
+  size_t m_numFactors[2]; // target, source
+  std::vector<std::vector<std::string> > m_targetVocab, m_sourceVocab;
+
+  // either our own arrays or pointers into the mapped binary file
+  util::scoped_memory m_memory;
+  const float *m_bias;
+  size_t m_buckets;
+  Table m_table;
+};
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "GlobalLexiconTable.h"
+#include "util/exception.hh"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+// removes its file when the test is done
+struct TempFile {
+  TempFile() : path(boost::filesystem::unique_path(
+                        boost::filesystem::temp_directory_path() / "moses-glm-%%%%-%%%%").string()) {}
+  ~TempFile() {
+    boost::filesystem::remove(path);
+  }
+  string path;
+};
+
+string ReadFile(const string &path)
+{
+  ifstream in(path.c_str(), ios::binary);
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// score of a target word for a sentence as GlobalLexicalModel adds it up
+float SentenceSum(const GlobalLexiconTable &table, uint32_t target, const vector<uint32_t> &sentence)
+{
+  float sum = table.GetBias(target);
+  for (size_t i = 0; i < sentence.size(); ++i) {
+    float weight;
+    if (table.FindWeight(target, sentence[i], weight)) sum += weight;
+  }
+  return sum;
+}
+
+void CheckSameTable(const GlobalLexiconTable &text, const GlobalLexiconTable &binary)
+{
+  BOOST_REQUIRE_EQUAL(text.NumTargetFactors(), binary.NumTargetFactors());
+  BOOST_REQUIRE_EQUAL(text.NumSourceFactors(), binary.NumSourceFactors());
+  BOOST_REQUIRE(text.GetTargetVocab() == binary.GetTargetVocab());
+  BOOST_REQUIRE(text.GetSourceVocab() == binary.GetSourceVocab());
+
+  for (uint32_t t = 0; t < text.NumTargetWords(); ++t) {
+    BOOST_CHECK_EQUAL(text.GetBias(t), binary.GetBias(t));
+    for (uint32_t s = 0; s < text.NumSourceWords(); ++s) {
+      float textWeight = -1, binaryWeight = -1;
+      BOOST_CHECK_EQUAL(text.FindWeight(t, s, textWeight), binary.FindWeight(t, s, binaryWeight));
+      BOOST_CHECK_EQUAL(textWeight, binaryWeight);
+      BOOST_CHECK_EQUAL(text.GetWeight(t, s), binary.GetWeight(t, s));
+    }
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(global_lexicon_table)
+
+BOOST_AUTO_TEST_CASE(text_lookups)
+{
+  TempFile text;
+  {
+    ofstream out(text.path.c_str());
+    out << "house|NN haus|NN 0.5\n"
+        << "house|NN **BIAS** -1.25\n"
+        << "home|NN haus|NN 0.25\n"
+        << "house|VB Haus|NN 2\n"
+        << "house|NN haus|VB 0.75\n";
+  }
+
+  GlobalLexiconTable table;
+  table.LoadText(text.path, "|", 1, 1);
+  BOOST_CHECK(!GlobalLexiconTable::IsBinary(text.path));
+
+  // only the first factor counts, and later lines override earlier ones
+  BOOST_REQUIRE_EQUAL(table.NumTargetWords(), 2);
+  BOOST_REQUIRE_EQUAL(table.NumSourceWords(), 2);
+  BOOST_CHECK_EQUAL(table.GetTargetVocab()[1][0], "home");
+  BOOST_CHECK_EQUAL(table.GetSourceVocab()[1][0], "Haus");
+  BOOST_CHECK_EQUAL(table.GetBias(0), -1.25f);
+  BOOST_CHECK_EQUAL(table.GetBias(1), 0.0f);
+  BOOST_CHECK_EQUAL(table.GetWeight(0, 0), 0.75f);
+  BOOST_CHECK_EQUAL(table.GetWeight(1, 0), 0.25f);
+  BOOST_CHECK_EQUAL(table.GetWeight(0, 1), 2.0f);
+  float weight;
+  BOOST_CHECK(!table.FindWeight(1, 1, weight));
+  BOOST_CHECK_EQUAL(table.GetWeight(1, 1), 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(binary_round_trip)
+{
+  TempFile text, binary, rewritten;
+  srand(7);
+  {
+    ofstream out(text.path.c_str());
+    for (size_t i = 0; i < 5000; ++i) {
+      out << "t" << rand() % 150 << "|x" << rand() % 2 << " ";
+      if (rand() % 20 == 0) {
+        out << "**BIAS**";
+      } else {
+        out << "s" << rand() % 400 << "|y|z";
+      }
+      out << " " << (rand() % 2001 - 1000) / 256.0 << "\n";
+    }
+  }
+
+  GlobalLexiconTable fromText;
+  fromText.LoadText(text.path, "|", 2, 1);
+  fromText.WriteBinary(binary.path);
+  BOOST_REQUIRE(GlobalLexiconTable::IsBinary(binary.path));
+
+  GlobalLexiconTable fromBinary;
+  fromBinary.Load(binary.path, "|", 2, 1);
+  CheckSameTable(fromText, fromBinary);
+
+  // per-sentence sums, added up in the same order, come out identical
+  for (size_t n = 0; n < 50; ++n) {
+    vector<uint32_t> sentence;
+    for (size_t i = 0; i < 1 + n % 30; ++i) {
+      sentence.push_back(rand() % fromText.NumSourceWords());
+    }
+    for (uint32_t t = 0; t < fromText.NumTargetWords(); ++t) {
+      BOOST_CHECK_EQUAL(SentenceSum(fromText, t, sentence), SentenceSum(fromBinary, t, sentence));
+    }
+  }
+
+  // the file holds no uninitialised bytes, so building it again gives the same bytes
+  {
+    GlobalLexiconTable again;
+    again.LoadText(text.path, "|", 2, 1);
+    again.WriteBinary(rewritten.path);
+  }
+  BOOST_CHECK(ReadFile(binary.path) == ReadFile(rewritten.path));
+
+  // a table built for other factors is refused
+  GlobalLexiconTable wrongFactors;
+  BOOST_CHECK_THROW(wrongFactors.Load(binary.path, "|", 1, 1), util::Exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 
 #include "moses/FactorCollection.h"
@@ -14,6 +15,7 @@
 #include "SparseReordering.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/unordered_set.hpp>
 
 
 using namespace std;
@@ -22,6 +24,17 @@ using namespace boost::algorithm;
 namespace Moses
 {
 
+namespace
+{
+
+struct CompareFirst {
+  bool operator()(const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) const {
+    return a.first < b.first;
+  }
+};
+
+}
+
 const std::string& SparseReorderingFeatureKey::Name (const string& wordListId)
 {
   static string kSep = "-";
@@ -60,27 +73,32 @@ const std::string& SparseReorderingFeatureKey::Name (const string& wordListId)
 
 SparseReordering::SparseReordering(const map<string,string>& config, const LexicalReordering* producer)
   : m_producer(producer)
+  , m_usePhrase(false)
+  , m_useBetween(false)
+  , m_useStack(false)
   , m_useWeightMap(false)
 {
   static const string kSource= "source";
   static const string kTarget = "target";
+  SideConfig sourceConfig;
+  SideConfig targetConfig;
   for (map<string,string>::const_iterator i = config.begin(); i != config.end(); ++i) {
     vector<string> fields = Tokenize(i->first, "-");
     if (fields[0] == "words") {
       UTIL_THROW_IF(!(fields.size() == 3), util::Exception, "Sparse reordering word list name should be sparse-words-(source|target)-<id>");
       if (fields[1] == kSource) {
-        ReadWordList(i->second,fields[2], SparseReorderingFeatureKey::Source, &m_sourceWordLists);
+        ReadWordList(i->second,fields[2], &sourceConfig);
       } else if (fields[1] == kTarget) {
-        ReadWordList(i->second,fields[2],SparseReorderingFeatureKey::Target, &m_targetWordLists);
+        ReadWordList(i->second,fields[2], &targetConfig);
       } else {
         UTIL_THROW(util::Exception, "Sparse reordering requires source or target, not " << fields[1]);
       }
     } else if (fields[0] == "clusters") {
       UTIL_THROW_IF(!(fields.size() == 3), util::Exception, "Sparse reordering cluster name should be sparse-clusters-(source|target)-<id>");
       if (fields[1] == kSource) {
-        ReadClusterMap(i->second,fields[2], SparseReorderingFeatureKey::Source, &m_sourceClusterMaps);
+        ReadClusterMap(i->second,fields[2], &sourceConfig);
       } else if (fields[1] == kTarget) {
-        ReadClusterMap(i->second,fields[2],SparseReorderingFeatureKey::Target, &m_targetClusterMaps);
+        ReadClusterMap(i->second,fields[2], &targetConfig);
       } else {
         UTIL_THROW(util::Exception, "Sparse reordering requires source or target, not " << fields[1]);
       }
@@ -104,46 +122,98 @@ SparseReordering::SparseReordering(const map<string,string>& config, const Lexic
     }
   }
 
+  // Once the weights are known, number the classes and pre-calculate their
+  // features.
+  BuildClasses(sourceConfig, SparseReorderingFeatureKey::Source, &m_sourceClasses);
+  BuildClasses(targetConfig, SparseReorderingFeatureKey::Target, &m_targetClasses);
 }
 
-void SparseReordering::PreCalculateFeatureNames(size_t index, const string& id, SparseReorderingFeatureKey::Side side, const Factor* factor, bool isCluster)
+void SparseReordering::PreCalculateFeatureNames(const string& id, SparseReorderingFeatureKey::Side side, const Factor* factor, bool isCluster)
 {
+  // In the order of FeatureIndex()
   for (size_t type = SparseReorderingFeatureKey::Stack;
        type <= SparseReorderingFeatureKey::Between; ++type) {
     for (size_t position = SparseReorderingFeatureKey::First;
          position <= SparseReorderingFeatureKey::Last; ++position) {
       for (int reoType = 0; reoType <= LRModel::MAX; ++reoType) {
         SparseReorderingFeatureKey
-        key(index, static_cast<SparseReorderingFeatureKey::Type>(type),
+        key(0, static_cast<SparseReorderingFeatureKey::Type>(type),
             factor, isCluster,
             static_cast<SparseReorderingFeatureKey::Position>(position),
             side, static_cast<LRModel::ReorderingType>(reoType));
-        m_featureMap.insert(pair<SparseReorderingFeatureKey, FName>(key,m_producer->GetFeatureName(key.Name(id))));
+        FName name = m_producer->GetFeatureName(key.Name(id));
+        if (m_useWeightMap) {
+          WeightMap::const_iterator wmi = m_weightMap.find(name.name());
+          m_featureWeights.push_back(wmi == m_weightMap.end() ? 0 : wmi->second);
+        } else {
+          m_featureNames.push_back(name);
+        }
       }
     }
   }
 }
 
-void SparseReordering::ReadWordList(const string& filename, const string& id, SparseReorderingFeatureKey::Side side, vector<WordList>* pWordLists)
+void SparseReordering::BuildClasses(const SideConfig& config, SparseReorderingFeatureKey::Side side, WordClasses* pClasses)
+{
+  // (factor id, class) for each class of each word, word lists first
+  vector<pair<size_t, size_t> > memberships;
+  size_t numClasses = m_useWeightMap ? m_featureWeights.size() / kFeaturesPerClass : m_featureNames.size() / kFeaturesPerClass;
+
+  for (size_t i = 0; i < config.wordLists.size(); ++i) {
+    const WordList& wordList = config.wordLists[i];
+    for (size_t j = 0; j < wordList.second.size(); ++j) {
+      PreCalculateFeatureNames(wordList.first, side, wordList.second[j], false);
+      memberships.push_back(make_pair(wordList.second[j]->GetId(), numClasses++));
+    }
+  }
+
+  for (size_t i = 0; i < config.clusterMaps.size(); ++i) {
+    const ClusterMap& clusterMap = config.clusterMaps[i];
+    boost::unordered_map<const Factor*, size_t> clusterClasses;
+    for (boost::unordered_map<const Factor*, const Factor*>::const_iterator p = clusterMap.second.begin();
+         p != clusterMap.second.end(); ++p) {
+      std::pair<boost::unordered_map<const Factor*, size_t>::iterator, bool> inserted =
+        clusterClasses.insert(make_pair(p->second, numClasses));
+      if (inserted.second) {
+        PreCalculateFeatureNames(clusterMap.first, side, p->second, true);
+        ++numClasses;
+      }
+      memberships.push_back(make_pair(p->first->GetId(), inserted.first->second));
+    }
+  }
+
+  // Group the classes by word, keeping their order for each word.
+  stable_sort(memberships.begin(), memberships.end(), CompareFirst());
+  pClasses->begin.clear();
+  pClasses->classes.clear();
+  for (size_t i = 0; i < memberships.size(); ++i) {
+    pClasses->begin.resize(memberships[i].first + 1, i);
+    pClasses->classes.push_back(memberships[i].second);
+  }
+  pClasses->begin.push_back(memberships.size());
+}
+
+void SparseReordering::ReadWordList(const string& filename, const string& id, SideConfig* pConfig)
 {
   ifstream fh(filename.c_str());
   UTIL_THROW_IF(!fh, util::Exception, "Unable to open: " << filename);
   string line;
-  pWordLists->push_back(WordList());
-  pWordLists->back().first = id;
+  pConfig->wordLists.push_back(WordList());
+  pConfig->wordLists.back().first = id;
+  boost::unordered_set<const Factor*> seen;
   while (getline(fh,line)) {
     //TODO: StringPiece
     const Factor* factor = FactorCollection::Instance().AddFactor(line);
-    pWordLists->back().second.insert(factor);
-    PreCalculateFeatureNames(pWordLists->size()-1, id, side, factor, false);
-
+    if (seen.insert(factor).second) {
+      pConfig->wordLists.back().second.push_back(factor);
+    }
   }
 }
 
-void SparseReordering::ReadClusterMap(const string& filename, const string& id, SparseReorderingFeatureKey::Side side, vector<ClusterMap>* pClusterMaps)
+void SparseReordering::ReadClusterMap(const string& filename, const string& id, SideConfig* pConfig)
 {
-  pClusterMaps->push_back(ClusterMap());
-  pClusterMaps->back().first = id;
+  pConfig->clusterMaps.push_back(ClusterMap());
+  pConfig->clusterMaps.back().first = id;
   util::FilePiece file(filename.c_str());
   StringPiece line;
   while (true) {
@@ -158,8 +228,7 @@ void SparseReordering::ReadClusterMap(const string& filename, const string& id,
     ++lineIter;
     if (!lineIter) UTIL_THROW(util::Exception, "Malformed cluster line (missing cluster id): '" << line << "'");
     const Factor* idFactor = FactorCollection::Instance().AddFactor(*lineIter);
-    pClusterMaps->back().second[wordFactor] = idFactor;
-    PreCalculateFeatureNames(pClusterMaps->size()-1, id, side, idFactor, true);
+    pConfig->clusterMaps.back().second[wordFactor] = idFactor;
   }
 }
 
@@ -169,57 +238,22 @@ void SparseReordering::AddFeatures(
   LRModel::ReorderingType reoType,
   ScoreComponentCollection* scores) const
 {
+  const WordClasses& classes = side == SparseReorderingFeatureKey::Source ? m_sourceClasses : m_targetClasses;
+  const Factor* wordFactor = word.GetFactor(0);
+  if (!wordFactor) return;
+  const size_t factorId = wordFactor->GetId();
+  if (factorId + 1 >= classes.begin.size()) return;
 
-  const Factor*  wordFactor = word.GetFactor(0);
-
-  const vector<WordList>* wordLists;
-  const vector<ClusterMap>* clusterMaps;
-  if (side == SparseReorderingFeatureKey::Source) {
-    wordLists = &m_sourceWordLists;
-    clusterMaps = &m_sourceClusterMaps;
-  } else {
-    wordLists = &m_targetWordLists;
-    clusterMaps = &m_targetClusterMaps;
-  }
-
-  for (size_t id = 0; id < wordLists->size(); ++id) {
-    if ((*wordLists)[id].second.find(wordFactor) == (*wordLists)[id].second.end()) continue;
-    SparseReorderingFeatureKey key(id, type, wordFactor, false, position, side, reoType);
-    FeatureMap::const_iterator fmi = m_featureMap.find(key);
-    assert(fmi != m_featureMap.end());
+  for (size_t i = classes.begin[factorId]; i < classes.begin[factorId+1]; ++i) {
+    const size_t index = FeatureIndex(classes.classes[i], type, position, reoType);
     if (m_useWeightMap) {
-      WeightMap::const_iterator wmi = m_weightMap.find(fmi->second.name());
-      if (wmi != m_weightMap.end()) {
-        if (wmi->second != 0) {
-          scores->SparsePlusEquals(m_featureMap2[reoType], wmi->second);
-        }
+      if (m_featureWeights[index] != 0) {
+        scores->SparsePlusEquals(m_featureMap2[reoType], m_featureWeights[index]);
       }
     } else {
-      scores->SparsePlusEquals(fmi->second, 1.0);
-    }
-  }
-
-  for (size_t id = 0; id < clusterMaps->size(); ++id) {
-    const ClusterMap& clusterMap = (*clusterMaps)[id];
-    boost::unordered_map<const Factor*, const Factor*>::const_iterator clusterIter
-    = clusterMap.second.find(wordFactor);
-    if (clusterIter != clusterMap.second.end()) {
-      SparseReorderingFeatureKey key(id, type, clusterIter->second, true, position, side, reoType);
-      FeatureMap::const_iterator fmi = m_featureMap.find(key);
-      assert(fmi != m_featureMap.end());
-      if (m_useWeightMap) {
-        WeightMap::const_iterator wmi = m_weightMap.find(fmi->second.name());
-        if (wmi != m_weightMap.end()) {
-          if (wmi->second != 0) {
-            scores->SparsePlusEquals(m_featureMap2[reoType], wmi->second);
-          }
-        }
-      } else {
-        scores->SparsePlusEquals(fmi->second, 1.0);
-      }
+      scores->SparsePlusEquals(m_featureNames[index], 1.0);
     }
   }
-
 }
 
 void SparseReordering::CopyScores(
@@ -6,15 +6,12 @@
 **/
 
 
-#include <functional>
 #include <map>
 #include <string>
 #include <vector>
 
-#include <boost/unordered_set.hpp>
+#include <boost/unordered_map.hpp>
 
-#include "util/murmur_hash.hh"
-#include "util/pool.hh"
 #include "util/string_piece.hh"
 
 #include "moses/FeatureVector.h"
@@ -39,7 +36,7 @@ namespace Moses
 {
 
 /**
- * Used to store pre-calculated feature names.
+ * Used to build the pre-calculated feature names.
 **/
 struct SparseReorderingFeatureKey {
   size_t id;
@@ -59,32 +56,6 @@ struct SparseReorderingFeatureKey {
   const std::string& Name(const std::string& wordListId) ;
 };
 
-struct HashSparseReorderingFeatureKey : public std::unary_function<SparseReorderingFeatureKey, std::size_t> {
-  std::size_t operator()(const SparseReorderingFeatureKey& key) const {
-    //TODO: can we just hash the memory?
-    //not sure, there could be random padding
-    std::size_t seed = 0;
-    seed = util::MurmurHashNative(&key.id, sizeof(key.id), seed);
-    seed = util::MurmurHashNative(&key.type, sizeof(key.type), seed);
-    seed = util::MurmurHashNative(&key.word, sizeof(key.word), seed);
-    seed = util::MurmurHashNative(&key.isCluster, sizeof(key.isCluster), seed);
-    seed = util::MurmurHashNative(&key.position, sizeof(key.position), seed);
-    seed = util::MurmurHashNative(&key.side, sizeof(key.side), seed);
-    seed = util::MurmurHashNative(&key.reoType, sizeof(key.reoType), seed);
-    return seed;
-  }
-};
-
-struct EqualsSparseReorderingFeatureKey :
-  public std::binary_function<SparseReorderingFeatureKey, SparseReorderingFeatureKey, bool> {
-  bool operator()(const SparseReorderingFeatureKey& left, const SparseReorderingFeatureKey& right) const {
-    //TODO: Can we just compare the memory?
-    return left.id == right.id &&  left.type == right.type && left.word == right.word &&
-           left.position == right.position && left.side == right.side &&
-           left.reoType == right.reoType;
-  }
-};
-
 class SparseReordering
 {
 public:
@@ -99,28 +70,52 @@ public:
                   ScoreComponentCollection* scores) const ;
 
 private:
-  const LexicalReordering* m_producer;
-  typedef std::pair<std::string, boost::unordered_set<const Factor*> > WordList; //id and list
-  std::vector<WordList> m_sourceWordLists;
-  std::vector<WordList> m_targetWordLists;
+  // A class is a word of a word list or a cluster of a cluster map.  Each
+  // class has kFeaturesPerClass features, one for each (type, position,
+  // reordering type), at index FeatureIndex() in the tables below.
+  static const size_t kFeaturesPerClass = 3 * 2 * (LRModel::MAX + 1);
+
+  static size_t FeatureIndex(size_t classId, SparseReorderingFeatureKey::Type type,
+                             SparseReorderingFeatureKey::Position position,
+                             LRModel::ReorderingType reoType) {
+    return classId * kFeaturesPerClass + (type * 2 + position) * (LRModel::MAX + 1) + reoType;
+  }
+
+  // The classes of the words of one side, by factor id: the classes of the
+  // word with id i are classes[begin[i]] .. classes[begin[i+1]-1], its word
+  // lists first, then its clusters, each in the order they were configured.
+  // Words with an id past the end of begin are in no class.
+  struct WordClasses {
+    std::vector<size_t> begin;
+    std::vector<size_t> classes;
+  };
+
+  // The word lists and cluster maps of one side, while they are loaded.
+  typedef std::pair<std::string, std::vector<const Factor*> > WordList; //id and list
   typedef std::pair<std::string, boost::unordered_map<const Factor*, const Factor*> > ClusterMap; //id and map
-  std::vector<ClusterMap> m_sourceClusterMaps;
-  std::vector<ClusterMap> m_targetClusterMaps;
+  struct SideConfig {
+    std::vector<WordList> wordLists;
+    std::vector<ClusterMap> clusterMaps;
+  };
+
+  const LexicalReordering* m_producer;
+  WordClasses m_sourceClasses;
+  WordClasses m_targetClasses;
   bool m_usePhrase;
   bool m_useBetween;
   bool m_useStack;
-  typedef boost::unordered_map<SparseReorderingFeatureKey, FName, HashSparseReorderingFeatureKey, EqualsSparseReorderingFeatureKey> FeatureMap;
-  FeatureMap m_featureMap;
+  std::vector<FName> m_featureNames;
 
   typedef boost::unordered_map<std::string, float> WeightMap;
   WeightMap m_weightMap;
   bool m_useWeightMap;
+  std::vector<float> m_featureWeights;
   std::vector<FName> m_featureMap2;
 
-  void ReadWordList(const std::string& filename, const std::string& id,
-                    SparseReorderingFeatureKey::Side side, std::vector<WordList>* pWordLists);
-  void ReadClusterMap(const std::string& filename, const std::string& id, SparseReorderingFeatureKey::Side side, std::vector<ClusterMap>* pClusterMaps);
-  void PreCalculateFeatureNames(size_t index, const std::string& id, SparseReorderingFeatureKey::Side side, const Factor* factor, bool isCluster);
+  void ReadWordList(const std::string& filename, const std::string& id, SideConfig* pConfig);
+  void ReadClusterMap(const std::string& filename, const std::string& id, SideConfig* pConfig);
+  void BuildClasses(const SideConfig& config, SparseReorderingFeatureKey::Side side, WordClasses* pClasses);
+  void PreCalculateFeatureNames(const std::string& id, SparseReorderingFeatureKey::Side side, const Factor* factor, bool isCluster);
   void ReadWeightMap(const std::string& filename);
 
   void AddFeatures(
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "lm/model.hh"
 #include <boost/shared_ptr.hpp>
 
@@ -12,8 +13,13 @@ class KenOSMBase
 public:
   virtual ~KenOSMBase() {}
 
-  virtual float Score(const lm::ngram::State&, const std::string&,
-                      lm::ngram::State&) const = 0;
+  virtual lm::WordIndex Index(const std::string&) const = 0;
+
+  // Score the operations in turn, starting in in_state; returns the sum of
+  // their scores, added up in double.
+  virtual double Score(const lm::ngram::State&,
+                       const std::vector<lm::WordIndex>&,
+                       lm::ngram::State&) const = 0;
 
   virtual const lm::ngram::State &BeginSentenceState() const = 0;
 
@@ -27,11 +33,21 @@ public:
   KenOSM(const std::string& file)
     : m_kenlm(new KenModel(file.c_str())) {}
 
-  virtual float Score(const lm::ngram::State &in_state,
-                      const std::string& word,
-                      lm::ngram::State &out_state) const {
-    return m_kenlm->Score(in_state, m_kenlm->GetVocabulary().Index(word),
-                          out_state);
+  virtual lm::WordIndex Index(const std::string& word) const {
+    return m_kenlm->GetVocabulary().Index(word);
+  }
+
+  virtual double Score(const lm::ngram::State &in_state,
+                       const std::vector<lm::WordIndex>& words,
+                       lm::ngram::State &out_state) const {
+    double prob = 0;
+    lm::ngram::State state = in_state;
+    out_state = in_state;
+    for (std::size_t i = 0; i < words.size(); ++i) {
+      prob += m_kenlm->Score(state, words[i], out_state);
+      state = out_state;
+    }
+    return prob;
   }
 
   virtual const lm::ngram::State &BeginSentenceState() const {
@@ -26,11 +26,12 @@ OpSequenceModel::~OpSequenceModel()
 
 void OpSequenceModel :: readLanguageModel(const char *lmFile)
 {
-  string unkOp = "_TRANS_SLF_";
   OSM = ConstructOSMLM(m_lmPath);
+  m_operationIds.load(*OSM);
 
   State startState = OSM->NullContextState();
   State endState;
+  vector <lm::WordIndex> unkOp(1, m_operationIds.transSelf);
   unkOpProb = OSM->Score(startState,unkOp,endState);
 }
 
@@ -40,23 +41,12 @@ void OpSequenceModel::Load()
   readLanguageModel(m_lmPath.c_str());
 }
 
-
-
-void OpSequenceModel:: EvaluateInIsolation(const Phrase &source
-    , const TargetPhrase &targetPhrase
-    , ScoreComponentCollection &scoreBreakdown
-    , ScoreComponentCollection &estimatedFutureScore) const
+boost::shared_ptr<osmPhrase> OpSequenceModel::MakePhrase(const vector<const Factor*> &sourceFactors
+    , const TargetPhrase &targetPhrase) const
 {
-
-  osmHypothesis obj;
-  obj.setState(OSM->NullContextState());
-  WordsBitmap myBitmap(source.GetSize());
   vector <string> mySourcePhrase;
   vector <string> myTargetPhrase;
-  vector<float> scores;
   vector <int> alignments;
-  int startIndex = 0;
-  int endIndex = source.GetSize();
 
   const AlignmentInfo &align = targetPhrase.GetAlignTerm();
   AlignmentInfo::const_iterator iter;
@@ -73,13 +63,38 @@ void OpSequenceModel:: EvaluateInIsolation(const Phrase &source
       myTargetPhrase.push_back(targetPhrase.GetWord(i).GetFactor(tFactor)->GetString().as_string());
   }
 
+  for (size_t i = 0; i < sourceFactors.size(); i++) {
+    mySourcePhrase.push_back(sourceFactors[i]->GetString().as_string());
+  }
+
+  boost::shared_ptr<osmPhrase> phrase(new osmPhrase(mySourcePhrase, myTargetPhrase, alignments, m_operationIds));
+  phrase->sourceFactors = sourceFactors;
+  return phrase;
+}
+
+void OpSequenceModel:: EvaluateInIsolation(const Phrase &source
+    , const TargetPhrase &targetPhrase
+    , ScoreComponentCollection &scoreBreakdown
+    , ScoreComponentCollection &estimatedFutureScore) const
+{
+
+  osmHypothesis obj(m_operationIds);
+  obj.setState(OSM->NullContextState());
+  WordsBitmap myBitmap(source.GetSize());
+  vector <const Factor*> sourceFactors;
+  vector<float> scores;
+  int startIndex = 0;
+
   for (size_t i = 0; i < source.GetSize(); i++) {
-    mySourcePhrase.push_back(source.GetWord(i).GetFactor(sFactor)->GetString().as_string());
+    sourceFactors.push_back(source.GetWord(i).GetFactor(sFactor));
   }
 
-  obj.setPhrases(mySourcePhrase , myTargetPhrase);
-  obj.constructCepts(alignments,startIndex,endIndex-1,targetPhrase.GetSize());
-  obj.computeOSMFeature(startIndex,myBitmap);
+  // Kept for EvaluateWhenApplied(); if the phrase was evaluated before, the
+  // operations kept then are the same.
+  boost::shared_ptr<osmPhrase> phrase = MakePhrase(sourceFactors, targetPhrase);
+  targetPhrase.SetData(GetScoreProducerDescription(), phrase);
+
+  obj.computeOSMFeature(startIndex,myBitmap,*phrase);
   obj.calculateOSMProb(*OSM);
   obj.populateScores(scores,numFeatures);
   estimatedFutureScore.PlusEquals(this, scores);
@@ -97,101 +112,36 @@ FFState* OpSequenceModel::EvaluateWhenApplied(
   WordsBitmap myBitmap = bitmap;
   const Manager &manager = cur_hypo.GetManager();
   const InputType &source = manager.GetSource();
-  // const Sentence &sourceSentence = static_cast<const Sentence&>(source);
-  osmHypothesis obj;
-  vector <string> mySourcePhrase;
-  vector <string> myTargetPhrase;
+  osmHypothesis obj(m_operationIds);
+  vector <const Factor*> sourceFactors;
   vector<float> scores;
 
-
-  //target.GetWord(0)
-
-  //cerr << target <<" --- "<<target.GetSourcePhrase()<< endl;  // English ...
-
-  //cerr << align << endl;   // Alignments ...
-  //cerr << cur_hypo.GetCurrSourceWordsRange() << endl;
-
-  //cerr << source <<endl;
-
-// int a = sourceRange.GetStartPos();
-// cerr << source.GetWord(a);
-  //cerr <<a<<endl;
-
-  //const Sentence &sentence = static_cast<const Sentence&>(curr_hypo.GetManager().GetSource());
-
-
   const WordsRange & sourceRange = cur_hypo.GetCurrSourceWordsRange();
   int startIndex  = sourceRange.GetStartPos();
   int endIndex = sourceRange.GetEndPos();
-  const AlignmentInfo &align = cur_hypo.GetCurrTargetPhrase().GetAlignTerm();
-  // osmState * statePtr;
-
-  vector <int> alignments;
-
-
-
-  AlignmentInfo::const_iterator iter;
-
-  for (iter = align.begin(); iter != align.end(); ++iter) {
-    //cerr << iter->first << "----" << iter->second << " ";
-    alignments.push_back(iter->first);
-    alignments.push_back(iter->second);
-  }
-
-
-  //cerr<<bitmap<<endl;
-  //cerr<<startIndex<<" "<<endIndex<<endl;
-
 
   for (int i = startIndex; i <= endIndex; i++) {
     myBitmap.SetValue(i,0); // resetting coverage of this phrase ...
-    mySourcePhrase.push_back(source.GetWord(i).GetFactor(sFactor)->GetString().as_string());
-    // cerr<<mySourcePhrase[i]<<endl;
+    sourceFactors.push_back(source.GetWord(i).GetFactor(sFactor));
   }
 
-  for (size_t i = 0; i < target.GetSize(); i++) {
-
-    if (target.GetWord(i).IsOOV() && sFactor == 0 && tFactor == 0)
-      myTargetPhrase.push_back("_TRANS_SLF_");
-    else
-      myTargetPhrase.push_back(target.GetWord(i).GetFactor(tFactor)->GetString().as_string());
-
+  // The operations of the phrase pair were worked out when the target phrase
+  // was evaluated in isolation, for the words of its source phrase.  Other
+  // input words (from confusion networks or lattices, say) need their own.
+  boost::shared_ptr<void> data = target.GetData(GetScoreProducerDescription());
+  boost::shared_ptr<osmPhrase> phrase = boost::static_pointer_cast<osmPhrase>(data);
+  if (!phrase || phrase->sourceFactors != sourceFactors) {
+    phrase = MakePhrase(sourceFactors, target);
   }
 
-
-  //cerr<<myBitmap<<endl;
-
   obj.setState(prev_state);
-  obj.constructCepts(alignments,startIndex,endIndex,target.GetSize());
-  obj.setPhrases(mySourcePhrase , myTargetPhrase);
-  obj.computeOSMFeature(startIndex,myBitmap);
+  obj.computeOSMFeature(startIndex,myBitmap,*phrase);
   obj.calculateOSMProb(*OSM);
   obj.populateScores(scores,numFeatures);
-  //obj.print();
-
-  /*
-    if (bitmap.GetFirstGapPos() == NOT_FOUND)
-    {
-
-      int xx;
-  	 cerr<<bitmap<<endl;
-  	 int a = bitmap.GetFirstGapPos();
-  	 obj.print();
-      cin>>xx;
-    }
-    */
-
-
 
   accumulator->PlusEquals(this, scores);
 
   return obj.saveState();
-
-
-
-
-  //return statePtr;
-// return NULL;
 }
 
 FFState* OpSequenceModel::EvaluateWhenApplied(
@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <boost/shared_ptr.hpp>
 #include "moses/FF/StatefulFeatureFunction.h"
 #include "moses/Manager.h"
 #include "moses/FF/OSM-Feature/osmHyp.h"
@@ -68,9 +69,11 @@ protected:
   typedef std::vector<float> Scores;
   std::map<ParallelPhrase, Scores> m_futureCost;
 
-  std::vector < std::pair < std::set <int> , std::set <int> > > ceptsInPhrase;
-  std::set <int> targetNullWords;
   std::string m_lmPath;
+  osmOperationIds m_operationIds;
+
+  boost::shared_ptr<osmPhrase> MakePhrase(const std::vector<const Factor*> &sourceFactors
+                                          , const TargetPhrase &targetPhrase) const;
 
 
 };
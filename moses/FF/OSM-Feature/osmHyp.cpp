@@ -6,389 +6,262 @@ using namespace lm::ngram;
 
 namespace Moses
 {
-osmState::osmState(const State & val)
-  :j(0)
-  ,E(0)
+
+namespace
 {
-  lmState = val;
 
-}
+const int numJumpBackIds = 64;
 
-void osmState::saveState(int jVal, int eVal, map <int , string> & gapVal)
+int bitCount(uint64_t x)
 {
-  gap.clear();
-  gap = gapVal;
-  j = jVal;
-  E = eVal;
+  int count = 0;
+  for (; x; x &= x - 1) {
+    count++;
+  }
+  return count;
 }
 
-int osmState::Compare(const FFState& otherBase) const
+string intToString(int num)
 {
-  const osmState &other = static_cast<const osmState&>(otherBase);
-  if (j != other.j)
-    return (j < other.j) ? -1 : +1;
-  if (E != other.E)
-    return (E < other.E) ? -1 : +1;
-  if (gap != other.gap)
-    return (gap < other.gap) ? -1 : +1;
 
-  if (lmState.length < other.lmState.length) return -1;
+  std::ostringstream stm;
+  stm<<num;
 
-  if (lmState.length > other.lmState.length) return 1;
+  return stm.str();
 
-  return 0;
 }
 
+} // namespace
 
-std::string osmState :: getName() const
+bool osmGaps :: isUnfilled(int pos) const
 {
-
-  return "done";
+  const size_t bit = pos + 1;
+  return (unfilled(bit / 64) >> (bit % 64)) & 1;
 }
 
-//////////////////////////////////////////////////
-
-osmHypothesis :: osmHypothesis()
+int osmGaps :: countUnfilled() const
 {
-  opProb = 0;
-  gapWidth = 0;
-  gapCount = 0;
-  openGapCount = 0;
-  deletionCount = 0;
-  gapCount = 0;
-  j = 0;
-  E = 0;
-  gap.clear();
+  int nd = bitCount(m_unfilled);
+  for (size_t w = 1; w < numWords(); w++) {
+    nd += bitCount(unfilled(w));
+  }
+  return nd;
 }
 
-void osmHypothesis :: setState(const FFState* prev_state)
+int osmGaps :: countUnfilledFrom(int pos) const
 {
-
-  if(prev_state != NULL) {
-
-    j = static_cast <const osmState *> (prev_state)->getJ();
-    E =  static_cast <const osmState *> (prev_state)->getE();
-    gap = static_cast <const osmState *> (prev_state)->getGap();
-    lmState = static_cast <const osmState *> (prev_state)->getLMState();
+  const size_t bit = pos + 1;
+  const uint64_t below = (uint64_t(1) << (bit % 64)) - 1;
+  int nd = bitCount(unfilled(bit / 64) & ~below);
+  for (size_t w = bit / 64 + 1; w < numWords(); w++) {
+    nd += bitCount(unfilled(w));
   }
+  return nd;
 }
 
-osmState * osmHypothesis :: saveState()
+bool osmGaps :: presentFrom(size_t w, uint64_t mask) const
 {
+  if (present(w) & ~(mask | (mask - 1)))
+    return true;
 
-  osmState * statePtr = new osmState(lmState);
-  statePtr->saveState(j,E,gap);
-  return statePtr;
+  for (w++; w < numWords(); w++) {
+    if (present(w))
+      return true;
+  }
+  return false;
 }
 
-int osmHypothesis :: isTranslationOperation(int x)
+void osmGaps :: set(int pos, bool isUnfilled)
 {
-  if (operations[x].find("_JMP_BCK_") != -1)
-    return 0;
-
-  if (operations[x].find("_JMP_FWD_") != -1)
-    return 0;
-
-  if (operations[x].find("_CONT_CEPT_") != -1)
-    return 0;
-
-  if (operations[x].find("_INS_GAP_") != -1)
-    return 0;
-
-  return 1;
+  const size_t bit = pos + 1;
+  const size_t w = bit / 64;
+  const uint64_t mask = uint64_t(1) << (bit % 64);
+
+  uint64_t *presentWord = &m_present;
+  uint64_t *unfilledWord = &m_unfilled;
+  if (w > 0) {
+    if (w >= numWords())
+      m_more.resize(2 * w, 0);
+    presentWord = &m_more[2 * (w - 1)];
+    unfilledWord = &m_more[2 * (w - 1) + 1];
+  }
 
+  *presentWord |= mask;
+  if (isUnfilled)
+    *unfilledWord |= mask;
+  else
+    *unfilledWord &= ~mask;
 }
 
-void osmHypothesis :: removeReorderingOperations()
+int osmGaps :: Compare(const osmGaps &other) const
 {
-  gapCount = 0;
-  deletionCount = 0;
-  openGapCount = 0;
-  gapWidth = 0;
-
-  std::vector <std::string> tupleSequence;
-
-  for (int x = 0; x < operations.size(); x++) {
-    // cout<<operations[x]<<endl;
-
-    if(isTranslationOperation(x) == 1) {
-      tupleSequence.push_back(operations[x]);
-    }
+  const size_t words = max(numWords(), other.numWords());
 
-  }
+  for (size_t w = 0; w < words; w++) {
+    const uint64_t present1 = present(w);
+    const uint64_t present2 = other.present(w);
+    const uint64_t unfilled1 = unfilled(w);
+    const uint64_t unfilled2 = other.unfilled(w);
+    const uint64_t diff = (present1 ^ present2) | (present1 & present2 & (unfilled1 ^ unfilled2));
 
-  operations.clear();
-  operations = tupleSequence;
-}
+    if (diff == 0)
+      continue;
 
-void osmHypothesis :: calculateOSMProb(OSMLM& ptrOp)
-{
+    // The first position at which the maps differ ...
+    const uint64_t mask = diff & (~diff + 1);
 
-  opProb = 0;
-  State currState = lmState;
-  State temp;
+    if (present1 & present2 & mask) // "Filled" < "Unfilled" ...
+      return (unfilled1 & mask) ? +1 : -1;
 
-  for (size_t i = 0; i<operations.size(); i++) {
-    temp = currState;
-    opProb += ptrOp.Score(temp,operations[i],currState);
+    // Only one map has a gap here, it is greater unless the other has a later gap ...
+    if (present1 & mask)
+      return other.presentFrom(w, mask) ? -1 : +1;
+    return presentFrom(w, mask) ? +1 : -1;
   }
 
-  lmState = currState;
-
-  //print();
+  return 0;
 }
 
+//////////////////////////////////////////////////
 
-int osmHypothesis :: firstOpenGap(vector <int> & coverageVector)
+osmState::osmState(const State & val)
+  :j(0)
+  ,E(0)
 {
-
-  int firstOG =-1;
-
-  for(int nd = 0; nd < coverageVector.size(); nd++) {
-    if(coverageVector[nd]==0) {
-      firstOG = nd;
-      return firstOG;
-    }
-  }
-
-  return firstOG;
+  lmState = val;
 
 }
 
-string osmHypothesis :: intToString(int num)
+void osmState::saveState(int jVal, int eVal, const osmGaps & gapVal)
 {
-
-  std::ostringstream stm;
-  stm<<num;
-
-  return stm.str();
-
+  gap = gapVal;
+  j = jVal;
+  E = eVal;
 }
 
-void osmHypothesis :: generateOperations(int & startIndex , int j1 , int contFlag , WordsBitmap & coverageVector , string english , string german , set <int> & targetNullWords , vector <string> & currF)
+int osmState::Compare(const FFState& otherBase) const
 {
+  const osmState &other = static_cast<const osmState&>(otherBase);
+  if (j != other.j)
+    return (j < other.j) ? -1 : +1;
+  if (E != other.E)
+    return (E < other.E) ? -1 : +1;
+  int gapCompare = gap.Compare(other.gap);
+  if (gapCompare != 0)
+    return gapCompare;
 
-  int gFlag = 0;
-  int gp = 0;
-  int ans;
+  if (lmState.length < other.lmState.length) return -1;
 
+  if (lmState.length > other.lmState.length) return 1;
 
-  if ( j < j1) { // j1 is the index of the source word we are about to generate ...
-    //if(coverageVector[j]==0) // if source word at j is not generated yet ...
-    if(coverageVector.GetValue(j)==0) { // if source word at j is not generated yet ...
-      operations.push_back("_INS_GAP_");
-      gFlag++;
-      gap[j]="Unfilled";
-    }
-    if (j == E) {
-      j = j1;
-    } else {
-      operations.push_back("_JMP_FWD_");
-      j=E;
-    }
-  }
+  return 0;
+}
 
-  if (j1 < j) {
-    // if(j < E && coverageVector[j]==0)
-    if(j < E && coverageVector.GetValue(j)==0) {
-      operations.push_back("_INS_GAP_");
-      gFlag++;
-      gap[j]="Unfilled";
-    }
 
-    j=closestGap(gap,j1,gp);
-    operations.push_back("_JMP_BCK_"+ intToString(gp));
+std::string osmState :: getName() const
+{
 
-    //cout<<"I am j "<<j<<endl;
-    //cout<<"I am j1 "<<j1<<endl;
+  return "done";
+}
 
-    if(j==j1)
-      gap[j]="Filled";
-  }
+//////////////////////////////////////////////////
 
-  if (j < j1) {
-    operations.push_back("_INS_GAP_");
-    gap[j] = "Unfilled";
-    gFlag++;
-    j=j1;
+void osmOperationIds :: load(const OSMLM &model)
+{
+  osm = &model;
+  insGap = osm->Index("_INS_GAP_");
+  jumpForward = osm->Index("_JMP_FWD_");
+  contCept = osm->Index("_CONT_CEPT_");
+  transSelf = osm->Index("_TRANS_SLF_");
+
+  jumpBack.clear();
+  for (int gp = 0; gp < numJumpBackIds; gp++) {
+    jumpBack.push_back(osm->Index("_JMP_BCK_" + intToString(gp)));
   }
+}
 
-  if(contFlag == 0) { // First words of the multi-word cept ...
+lm::WordIndex osmOperationIds :: getJumpBack(int gaps) const
+{
+  if (gaps >= 0 && gaps < (int) jumpBack.size())
+    return jumpBack[gaps];
 
-    if(english == "_TRANS_SLF_") { // Unknown word ...
-      operations.push_back("_TRANS_SLF_");
-    } else {
-      operations.push_back("_TRANS_" + english + "_TO_" + german);
-    }
+  return osm->Index("_JMP_BCK_" + intToString(gaps));
+}
 
-    //ans = firstOpenGap(coverageVector);
-    ans = coverageVector.GetFirstGapPos();
+//////////////////////////////////////////////////
 
-    if (ans != -1)
-      gapWidth += j - ans;
+osmPhrase :: osmPhrase(const vector <string> & currF, const vector <string> & currE, const vector <int> & align, const osmOperationIds & ids)
+{
 
-  } else if (contFlag == 2) {
+  std::map <int , vector <int> > sT;
+  std::map <int , vector <int> > tS;
+  std::set <int> eSide;
+  std::set <int> fSide;
+  std::set <int> sourceNullWords;
+  std::set <int> :: iterator iter;
+  std :: map <int , vector <int> > :: iterator iter2;
+  std::vector < std::pair < std::set <int> , std::set <int> > > ceptsInPhrase;
+  int src;
+  int tgt;
 
-    operations.push_back("_INS_" + german);
-    ans = coverageVector.GetFirstGapPos();
 
-    if (ans != -1)
-      gapWidth += j - ans;
-    deletionCount++;
-  } else {
-    operations.push_back("_CONT_CEPT_");
+  for (size_t i = 0;  i < align.size(); i+=2) {
+    src = align[i];
+    tgt = align[i+1];
+    tS[tgt].push_back(src);
+    sT[src].push_back(tgt);
   }
 
-  //coverageVector[j]=1;
-  coverageVector.SetValue(j,1);
-  j+=1;
-
-  if(E<j)
-    E=j;
-
-  if (gFlag > 0)
-    gapCount++;
-
-  openGapCount += getOpenGaps();
+  unalignedSource.resize(currF.size(), false);
+  insertions.resize(currF.size(), 0);
 
-  //if (coverageVector[j] == 0 && targetNullWords.find(j) != targetNullWords.end())
-  if (j < coverageVector.GetSize()) {
-    if (coverageVector.GetValue(j) == 0 && targetNullWords.find(j) != targetNullWords.end()) {
-      j1 = j;
-      german = currF[j1-startIndex];
-      english = "_INS_";
-      generateOperations(startIndex, j1, 2 , coverageVector , english , german , targetNullWords , currF);
+  for (size_t i = 0; i < currF.size(); i++) { // What are unaligned source words in this phrase ...
+    if (sT.find(i) == sT.end()) {
+      unalignedSource[i] = true;
+      insertions[i] = ids.osm->Index("_INS_" + currF[i]);
     }
   }
 
-}
-
-void osmHypothesis :: print()
-{
-  for (int i = 0; i< operations.size(); i++) {
-    cerr<<operations[i]<<" ";
-
+  for (size_t i = 0; i < currE.size(); i++) { // What are unaligned target words in this phrase ...
+    if (tS.find(i) == tS.end()) {
+      sourceNullWords.insert(i);
+    }
   }
 
-  cerr<<endl<<endl;
 
-  cerr<<"Operation Probability "<<opProb<<endl;
-  cerr<<"Gap Count "<<gapCount<<endl;
-  cerr<<"Open Gap Count "<<openGapCount<<endl;
-  cerr<<"Gap Width "<<gapWidth<<endl;
-  cerr<<"Deletion Count "<<deletionCount<<endl;
-
-  cerr<<"_______________"<<endl;
-}
-
-int osmHypothesis :: closestGap(map <int,string> gap, int j1, int & gp)
-{
-
-  int dist=1172;
-  int value=-1;
-  int temp=0;
-  gp=0;
-  int opGap=0;
-
-  map <int,string> :: iterator iter;
+  while (tS.size() != 0 && sT.size() != 0) {
 
-  iter=gap.end();
+    iter2 = tS.begin();
 
-  do {
-    iter--;
-    //cout<<"Trapped "<<iter->first<<endl;
+    eSide.clear();
+    fSide.clear();
+    eSide.insert (iter2->first);
 
-    if(iter->first==j1 && iter->second== "Unfilled") {
-      opGap++;
-      gp = opGap;
-      return j1;
+    getMeCepts(eSide, fSide, tS , sT);
 
+    for (iter = eSide.begin(); iter != eSide.end(); iter++) {
+      iter2 = tS.find(*iter);
+      tS.erase(iter2);
     }
 
-    if(iter->second =="Unfilled") {
-      opGap++;
-      temp = iter->first - j1;
-
-      if(temp<0)
-        temp=temp * -1;
-
-      if(dist>temp && iter->first < j1) {
-        dist=temp;
-        value=iter->first;
-        gp=opGap;
-      }
+    for (iter = fSide.begin(); iter != fSide.end(); iter++) {
+      iter2 = sT.find(*iter);
+      sT.erase(iter2);
     }
 
-
-  } while(iter!=gap.begin());
-
-  return value;
-}
-
-
-
-int osmHypothesis :: getOpenGaps()
-{
-  map <int,string> :: iterator iter;
-
-  int nd = 0;
-  for (iter = gap.begin(); iter!=gap.end(); iter++) {
-    if(iter->second == "Unfilled")
-      nd++;
+    ceptsInPhrase.push_back(make_pair (fSide , eSide));
   }
 
-  return nd;
-
-}
-
-void osmHypothesis :: generateDeleteOperations(std::string english, int currTargetIndex, std::set <int> doneTargetIndexes)
-{
-
-  operations.push_back("_DEL_" + english);
-  currTargetIndex++;
-
-  while(doneTargetIndexes.find(currTargetIndex) != doneTargetIndexes.end()) {
-    currTargetIndex++;
-  }
-
-  if (sourceNullWords.find(currTargetIndex) != sourceNullWords.end()) {
-    english = currE[currTargetIndex];
-    generateDeleteOperations(english,currTargetIndex,doneTargetIndexes);
-  }
-
-}
-
-void osmHypothesis :: computeOSMFeature(int startIndex , WordsBitmap & coverageVector)
-{
-
   set <int> doneTargetIndexes;
-  set <int> eSide;
-  set <int> fSide;
-  set <int> :: iterator iter;
   string english;
   string source;
-  int j1;
   int targetIndex = 0;
-  doneTargetIndexes.clear();
-
-
-  if (targetNullWords.size() != 0) { // Source words to be deleted in the start of this phrase ...
-    iter = targetNullWords.begin();
-
-    if (*iter == startIndex) {
-
-      j1 = startIndex;
-      source = currF[j1-startIndex];
-      english = "_INS_";
-      generateOperations(startIndex, j1, 2 , coverageVector , english , source , targetNullWords , currF);
-    }
-  }
 
   if (sourceNullWords.find(targetIndex) != sourceNullWords.end()) { // first word has to be deleted ...
-    english = currE[targetIndex];
-    generateDeleteOperations(english,targetIndex, doneTargetIndexes);
+    generateDeleteOperations(currE, targetIndex, doneTargetIndexes, sourceNullWords, ids, leadingDeletions);
   }
 
+  cepts.resize(ceptsInPhrase.size());
 
   for (size_t i = 0; i < ceptsInPhrase.size(); i++) {
     source = "";
@@ -421,16 +294,13 @@ void osmHypothesis :: computeOSMFeature(int startIndex , WordsBitmap & coverageV
       source += currF[*iter];
     }
 
-    iter = fSide.begin();
-    j1 = *iter + startIndex;
-    iter++;
-
-    generateOperations(startIndex, j1, 0 , coverageVector , english , source , targetNullWords , currF);
+    Cept &cept = cepts[i];
+    cept.source.assign(fSide.begin(), fSide.end());
 
-
-    for (; iter != fSide.end(); iter++) {
-      j1 = *iter + startIndex;
-      generateOperations(startIndex, j1, 1 , coverageVector , english , source , targetNullWords , currF);
+    if(english == "_TRANS_SLF_") { // Unknown word ...
+      cept.translation = ids.transSelf;
+    } else {
+      cept.translation = ids.osm->Index("_TRANS_" + english + "_TO_" + source);
     }
 
     targetIndex++; // Check whether the next target word is unaligned ...
@@ -440,18 +310,29 @@ void osmHypothesis :: computeOSMFeature(int startIndex , WordsBitmap & coverageV
     }
 
     if(sourceNullWords.find(targetIndex) != sourceNullWords.end()) {
-      english = currE[targetIndex];
-      generateDeleteOperations(english,targetIndex, doneTargetIndexes);
+      generateDeleteOperations(currE, targetIndex, doneTargetIndexes, sourceNullWords, ids, cept.deletions);
     }
   }
 
-  //removeReorderingOperations();
+}
 
-  //print();
+void osmPhrase :: generateDeleteOperations(const vector <string> & currE, int currTargetIndex, const set <int> & doneTargetIndexes, const set <int> & sourceNullWords, const osmOperationIds & ids, vector <lm::WordIndex> & out)
+{
+
+  out.push_back(ids.osm->Index("_DEL_" + currE[currTargetIndex]));
+  currTargetIndex++;
+
+  while(doneTargetIndexes.find(currTargetIndex) != doneTargetIndexes.end()) {
+    currTargetIndex++;
+  }
+
+  if (sourceNullWords.find(currTargetIndex) != sourceNullWords.end()) {
+    generateDeleteOperations(currE, currTargetIndex, doneTargetIndexes, sourceNullWords, ids, out);
+  }
 
 }
 
-void osmHypothesis :: getMeCepts ( set <int> & eSide , set <int> & fSide , map <int , vector <int> > & tS , map <int , vector <int> > & sT)
+void osmPhrase :: getMeCepts ( set <int> & eSide , set <int> & fSide , map <int , vector <int> > & tS , map <int , vector <int> > & sT)
 {
   set <int> :: iterator iter;
 
@@ -483,101 +364,206 @@ void osmHypothesis :: getMeCepts ( set <int> & eSide , set <int> & fSide , map <
 
 }
 
-void osmHypothesis :: constructCepts(vector <int> & align , int startIndex , int endIndex, int targetPhraseLength)
+//////////////////////////////////////////////////
+
+osmHypothesis :: osmHypothesis(const osmOperationIds & val)
+  : ids(val)
 {
+  opProb = 0;
+  gapWidth = 0;
+  gapCount = 0;
+  openGapCount = 0;
+  deletionCount = 0;
+  gapCount = 0;
+  j = 0;
+  E = 0;
+}
 
-  std::map <int , vector <int> > sT;
-  std::map <int , vector <int> > tS;
-  std::set <int> eSide;
-  std::set <int> fSide;
-  std::set <int> :: iterator iter;
-  std :: map <int , vector <int> > :: iterator iter2;
-  std :: pair < set <int> , set <int> > cept;
-  int src;
-  int tgt;
+void osmHypothesis :: setState(const FFState* prev_state)
+{
 
+  if(prev_state != NULL) {
 
-  for (size_t i = 0;  i < align.size(); i+=2) {
-    src = align[i];
-    tgt = align[i+1];
-    tS[tgt].push_back(src);
-    sT[src].push_back(tgt);
+    j = static_cast <const osmState *> (prev_state)->getJ();
+    E =  static_cast <const osmState *> (prev_state)->getE();
+    gap = static_cast <const osmState *> (prev_state)->getGap();
+    lmState = static_cast <const osmState *> (prev_state)->getLMState();
   }
+}
+
+osmState * osmHypothesis :: saveState()
+{
+
+  osmState * statePtr = new osmState(lmState);
+  statePtr->saveState(j,E,gap);
+  return statePtr;
+}
+
+void osmHypothesis :: calculateOSMProb(const OSMLM& ptrOp)
+{
+
+  State currState;
+  opProb = ptrOp.Score(lmState,operations,currState);
+  lmState = currState;
 
-  for (int i = startIndex; i<= endIndex; i++) { // What are unaligned source words in this phrase ...
-    if (sT.find(i-startIndex) == sT.end()) {
-      targetNullWords.insert(i);
+  //print();
+}
+
+void osmHypothesis :: generateOperations(int startIndex , int j1 , int contFlag , WordsBitmap & coverageVector , lm::WordIndex op , const osmPhrase & phrase)
+{
+
+  int gFlag = 0;
+  int gp = 0;
+  int ans;
+
+
+  if ( j < j1) { // j1 is the index of the source word we are about to generate ...
+    if(coverageVector.GetValue(j)==0) { // if source word at j is not generated yet ...
+      operations.push_back(ids.insGap);
+      gFlag++;
+      gap.setUnfilled(j);
+    }
+    if (j == E) {
+      j = j1;
+    } else {
+      operations.push_back(ids.jumpForward);
+      j=E;
     }
   }
 
-  for (int i = 0; i < targetPhraseLength; i++) { // What are unaligned target words in this phrase ...
-    if (tS.find(i) == tS.end()) {
-      sourceNullWords.insert(i);
+  if (j1 < j) {
+    if(j < E && coverageVector.GetValue(j)==0) {
+      operations.push_back(ids.insGap);
+      gFlag++;
+      gap.setUnfilled(j);
     }
+
+    j=closestGap(j1,gp);
+    operations.push_back(ids.getJumpBack(gp));
+
+    if(j==j1)
+      gap.setFilled(j);
   }
 
+  if (j < j1) {
+    operations.push_back(ids.insGap);
+    gap.setUnfilled(j);
+    gFlag++;
+    j=j1;
+  }
 
-  while (tS.size() != 0 && sT.size() != 0) {
+  if(contFlag == 0) { // First words of the multi-word cept ...
 
-    iter2 = tS.begin();
+    operations.push_back(op);
 
-    eSide.clear();
-    fSide.clear();
-    eSide.insert (iter2->first);
+    ans = coverageVector.GetFirstGapPos();
 
-    getMeCepts(eSide, fSide, tS , sT);
+    if (ans != -1)
+      gapWidth += j - ans;
 
-    for (iter = eSide.begin(); iter != eSide.end(); iter++) {
-      iter2 = tS.find(*iter);
-      tS.erase(iter2);
-    }
+  } else if (contFlag == 2) {
 
-    for (iter = fSide.begin(); iter != fSide.end(); iter++) {
-      iter2 = sT.find(*iter);
-      sT.erase(iter2);
+    operations.push_back(op);
+    ans = coverageVector.GetFirstGapPos();
+
+    if (ans != -1)
+      gapWidth += j - ans;
+    deletionCount++;
+  } else {
+    operations.push_back(ids.contCept);
+  }
+
+  coverageVector.SetValue(j,1);
+  j+=1;
+
+  if(E<j)
+    E=j;
+
+  if (gFlag > 0)
+    gapCount++;
+
+  openGapCount += getOpenGaps();
+
+  if (j < coverageVector.GetSize()) {
+    const int offset = j - startIndex;
+    if (coverageVector.GetValue(j) == 0 && offset >= 0 && offset < (int) phrase.unalignedSource.size() && phrase.unalignedSource[offset]) {
+      j1 = j;
+      generateOperations(startIndex, j1, 2 , coverageVector , phrase.insertions[offset] , phrase);
     }
+  }
+
+}
+
+void osmHypothesis :: print()
+{
+  for (size_t i = 0; i< operations.size(); i++) {
+    cerr<<operations[i]<<" ";
 
-    cept = make_pair (fSide , eSide);
-    ceptsInPhrase.push_back(cept);
   }
 
+  cerr<<endl<<endl;
 
+  cerr<<"Operation Probability "<<opProb<<endl;
+  cerr<<"Gap Count "<<gapCount<<endl;
+  cerr<<"Open Gap Count "<<openGapCount<<endl;
+  cerr<<"Gap Width "<<gapWidth<<endl;
+  cerr<<"Deletion Count "<<deletionCount<<endl;
 
-  /*
+  cerr<<"_______________"<<endl;
+}
 
-  	  cerr<<"Extracted Cepts "<<endl;
-  		for (int i = 0; i < ceptsInPhrase.size(); i++)
-  			{
+int osmHypothesis :: closestGap(int j1, int & gp) const
+{
+  gp=0;
 
-  				fSide = ceptsInPhrase[i].first;
-  				eSide = ceptsInPhrase[i].second;
+  // Gaps are counted from the last one back to the one jumped to ...
+  if (gap.isUnfilled(j1)) {
+    gp = gap.countUnfilledFrom(j1);
+    return j1;
+  }
 
-  				for (iter = eSide.begin(); iter != eSide.end(); iter++)
-  				{
-  			   		cerr<<*iter<<" ";
-  				}
-  			    	cerr<<"<---> ";
+  // The nearest unfilled gap before j1, unless it is 1172 words away or more ...
+  for (int k = j1 - 1; k >= -1 && j1 - k < 1172; k--) {
+    if (gap.isUnfilled(k)) {
+      gp = gap.countUnfilledFrom(k);
+      return k;
+    }
+  }
 
-  				for (iter = fSide.begin(); iter != fSide.end(); iter++)
-  				{
-  					cerr<<*iter<<" ";
-  				}
+  return -1;
+}
 
-  				cerr<<endl;
-  			}
-  			cerr<<endl;
 
-  		cerr<<"Unaligned Target Words"<<endl;
 
-  		for (iter = sourceNullWords.begin(); iter != sourceNullWords.end(); iter++)
-  			cerr<<*iter<<"<--->"<<endl;
+int osmHypothesis :: getOpenGaps() const
+{
+  return gap.countUnfilled();
+}
+
+void osmHypothesis :: computeOSMFeature(int startIndex , WordsBitmap & coverageVector , const osmPhrase & phrase)
+{
+
+  if (!phrase.unalignedSource.empty() && phrase.unalignedSource[0]) { // Source words to be deleted in the start of this phrase ...
+    generateOperations(startIndex, startIndex, 2 , coverageVector , phrase.insertions[0] , phrase);
+  }
 
-  		cerr<<"Unaligned Source Words"<<endl;
+  // first word has to be deleted ...
+  operations.insert(operations.end(), phrase.leadingDeletions.begin(), phrase.leadingDeletions.end());
 
-  		for (iter = targetNullWords.begin(); iter != targetNullWords.end(); iter++)
-  			cerr<<*iter<<"<--->"<<endl;
+  for (size_t i = 0; i < phrase.cepts.size(); i++) {
+    const osmPhrase::Cept &cept = phrase.cepts[i];
 
-  */
+    generateOperations(startIndex, cept.source[0] + startIndex, 0 , coverageVector , cept.translation , phrase);
+
+    for (size_t k = 1; k < cept.source.size(); k++) {
+      generateOperations(startIndex, cept.source[k] + startIndex, 1 , coverageVector , ids.contCept , phrase);
+    }
+
+    // Check whether the next target words are unaligned ...
+    operations.insert(operations.end(), cept.deletions.begin(), cept.deletions.end());
+  }
+
+  //print();
 
 }
 
@@ -7,28 +7,76 @@
 # include <string>
 # include <vector>
 
+#include <stdint.h>
+
 #include "KenOSM.h"
 
 namespace Moses
 {
 
+class Factor;
+
+// Gap history: the source positions at which gaps were inserted, each still
+// unfilled or filled.  Positions below 63 are kept in two machine words, so
+// copying the state of a hypothesis does not allocate for most sentences.
+// Compare() orders as a std::map <int, std::string> from positions to
+// "Unfilled" and "Filled" did.
+class osmGaps
+{
+public:
+  osmGaps() : m_present(0), m_unfilled(0) {}
+
+  void setUnfilled(int pos) {
+    set(pos, true);
+  }
+  void setFilled(int pos) {
+    set(pos, false);
+  }
+
+  bool isUnfilled(int pos) const;
+  int countUnfilled() const;
+  // Number of unfilled gaps at or after pos
+  int countUnfilledFrom(int pos) const;
+
+  int Compare(const osmGaps &other) const;
+
+private:
+  // Bit i of word w is position 64 * w + i - 1; -1 is kept because a failed
+  // closestGap() search returned it as the position of a new gap.
+  std::size_t numWords() const {
+    return 1 + m_more.size() / 2;
+  }
+  uint64_t present(std::size_t w) const {
+    return w == 0 ? m_present : (w < numWords() ? m_more[2 * (w - 1)] : 0);
+  }
+  uint64_t unfilled(std::size_t w) const {
+    return w == 0 ? m_unfilled : (w < numWords() ? m_more[2 * (w - 1) + 1] : 0);
+  }
+  bool presentFrom(std::size_t w, uint64_t mask) const;
+  void set(int pos, bool unfilled);
+
+  uint64_t m_present;
+  uint64_t m_unfilled;
+  std::vector<uint64_t> m_more;	// present and unfilled words, in turn, from the second word on
+};
+
 class osmState : public FFState
 {
 public:
   osmState(const lm::ngram::State & val);
   int Compare(const FFState& other) const;
-  void saveState(int jVal, int eVal, std::map <int , std::string> & gapVal);
+  void saveState(int jVal, int eVal, const osmGaps & gapVal);
   int getJ()const {
     return j;
   }
   int getE()const {
     return E;
   }
-  std::map <int , std::string> getGap() const {
+  const osmGaps &getGap() const {
     return gap;
   }
 
-  lm::ngram::State getLMState() const {
+  const lm::ngram::State &getLMState() const {
     return lmState;
   }
 
@@ -37,18 +85,57 @@ public:
 
 protected:
   int j, E;
-  std::map <int,std::string> gap;
+  osmGaps gap;
   lm::ngram::State lmState;
 };
 
+// Ids of the operations that do not depend on the words.
+struct osmOperationIds {
+  lm::WordIndex insGap;
+  lm::WordIndex jumpForward;
+  lm::WordIndex contCept;
+  lm::WordIndex transSelf;
+  std::vector <lm::WordIndex> jumpBack;	// By the number of gaps jumped ...
+  const OSMLM *osm;	// For the ids of longer jumps ...
+
+  void load(const OSMLM &model);
+  lm::WordIndex getJumpBack(int gaps) const;
+};
+
+// Everything about a phrase pair that does not depend on the hypothesis it
+// extends: its cepts and the ids of their operations, and of the operations
+// that insert and delete its unaligned words.  It is computed once for a
+// translation option and kept with its target phrase.
+class osmPhrase
+{
+public:
+  struct Cept {
+    std::vector <int> source;	// Source words of the cept, in order ...
+    lm::WordIndex translation;
+    std::vector <lm::WordIndex> deletions;	// Unaligned target words that follow ...
+  };
+
+  osmPhrase(const std::vector <std::string> & currF, const std::vector <std::string> & currE, const std::vector <int> & align, const osmOperationIds & ids);
+
+  std::vector <Cept> cepts;
+  std::vector <lm::WordIndex> leadingDeletions;
+  std::vector <bool> unalignedSource;
+  std::vector <lm::WordIndex> insertions;	// For the unaligned source words ...
+  std::vector <const Factor *> sourceFactors;	// The words it was computed for ...
+
+private:
+  static void generateDeleteOperations(const std::vector <std::string> & currE, int currTargetIndex, const std::set <int> & doneTargetIndexes, const std::set <int> & sourceNullWords, const osmOperationIds & ids, std::vector <lm::WordIndex> & out);
+  static void getMeCepts ( std::set <int> & eSide , std::set <int> & fSide , std::map <int , std::vector <int> > & tS , std::map <int , std::vector <int> > & sT);
+};
+
 class osmHypothesis
 {
 
 private:
 
 
-  std::vector <std::string> operations;	// List of operations required to generated this hyp ...
-  std::map <int,std::string> gap;	// Maintains gap history ...
+  std::vector <lm::WordIndex> operations;	// List of operations required to generated this hyp ...
+  osmGaps gap;	// Maintains gap history ...
   int j;	// Position after the last source word generated ...
   int E; // Position after the right most source word so far generated ...
   lm::ngram::State lmState; // KenLM's Model State ...
@@ -59,34 +146,19 @@ private:
   int gapWidth;
   double opProb;
 
-  std::vector <std::string> currE;
-  std::vector <std::string> currF;
-  std::vector < std::pair < std::set <int> , std::set <int> > > ceptsInPhrase;
-  std::set <int> targetNullWords;
-  std::set <int> sourceNullWords;
+  const osmOperationIds &ids;
 
-  int closestGap(std::map <int,std::string> gap,int j1, int & gp);
-  int firstOpenGap(std::vector <int> & coverageVector);
-  std::string intToString(int);
-  int  getOpenGaps();
-  int isTranslationOperation(int j);
-  void removeReorderingOperations();
+  int closestGap(int j1, int & gp) const;
+  int  getOpenGaps() const;
 
-  void getMeCepts ( std::set <int> & eSide , std::set <int> & fSide , std::map <int , std::vector <int> > & tS , std::map <int , std::vector <int> > & sT);
+  void generateOperations(int startIndex, int j1 , int contFlag , WordsBitmap & coverageVector , lm::WordIndex op , const osmPhrase & phrase);
 
 public:
 
-  osmHypothesis();
+  osmHypothesis(const osmOperationIds & val);
   ~osmHypothesis() {};
-  void generateOperations(int & startIndex, int j1 , int contFlag , WordsBitmap & coverageVector , std::string english , std::string german , std::set <int> & targetNullWords , std::vector <std::string> & currF);
-  void generateDeleteOperations(std::string english, int currTargetIndex, std::set <int> doneTargetIndexes);
-  void calculateOSMProb(OSMLM& ptrOp);
-  void computeOSMFeature(int startIndex , WordsBitmap & coverageVector);
-  void constructCepts(std::vector <int> & align , int startIndex , int endIndex, int targetPhraseLength);
-  void setPhrases(std::vector <std::string> & val1 , std::vector <std::string> & val2) {
-    currF = val1;
-    currE = val2;
-  }
+  void calculateOSMProb(const OSMLM& ptrOp);
+  void computeOSMFeature(int startIndex , WordsBitmap & coverageVector , const osmPhrase & phrase);
   void setState(const FFState* prev_state);
   osmState * saveState();
   void print();
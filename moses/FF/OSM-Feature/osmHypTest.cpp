@@ -0,0 +1,170 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include "osmHyp.h"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+// The gaps as osmHypothesis kept them before osmGaps: ordered by position,
+// and compared as maps, so "Filled" < "Unfilled".
+struct MapGaps {
+  map<int, string> gaps;
+  osmGaps bits;
+
+  void set(int pos, bool unfilled) {
+    gaps[pos] = unfilled ? "Unfilled" : "Filled";
+    if (unfilled) {
+      bits.setUnfilled(pos);
+    } else {
+      bits.setFilled(pos);
+    }
+  }
+
+  int countUnfilledFrom(int pos) const {
+    int count = 0;
+    for (map<int, string>::const_iterator i = gaps.lower_bound(pos); i != gaps.end(); ++i) {
+      count += i->second == "Unfilled";
+    }
+    return count;
+  }
+};
+
+int MapCompare(const MapGaps &a, const MapGaps &b)
+{
+  return a.gaps == b.gaps ? 0 : (a.gaps < b.gaps ? -1 : 1);
+}
+
+void CheckSameGaps(const MapGaps &gaps, int maxPos)
+{
+  BOOST_CHECK_EQUAL(gaps.bits.countUnfilled(), gaps.countUnfilledFrom(-1));
+  for (int pos = -1; pos <= maxPos; ++pos) {
+    map<int, string>::const_iterator found = gaps.gaps.find(pos);
+    BOOST_CHECK_EQUAL(gaps.bits.isUnfilled(pos), found != gaps.gaps.end() && found->second == "Unfilled");
+    BOOST_CHECK_EQUAL(gaps.bits.countUnfilledFrom(pos), gaps.countUnfilledFrom(pos));
+  }
+}
+
+void CheckSameOrder(const MapGaps &a, const MapGaps &b)
+{
+  BOOST_CHECK_EQUAL(a.bits.Compare(b.bits), MapCompare(a, b));
+  BOOST_CHECK_EQUAL(b.bits.Compare(a.bits), MapCompare(b, a));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(osm_gaps)
+
+BOOST_AUTO_TEST_CASE(random_against_map)
+{
+  srand(42);
+  for (size_t trial = 0; trial < 20000; ++trial) {
+    // mostly few positions, so that the maps are often equal or close
+    const int range = trial % 3 == 0 ? 200 : 8;
+    MapGaps gaps[2];
+    for (size_t k = 0; k < 2; ++k) {
+      const int count = rand() % 6;
+      for (int i = 0; i < count; ++i) {
+        gaps[k].set(rand() % range - 1, rand() % 2);
+      }
+    }
+    CheckSameOrder(gaps[0], gaps[1]);
+    if (trial % 100 == 0) {
+      CheckSameGaps(gaps[0], range);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(past_64_positions)
+{
+  // positions on both sides of the first word boundaries
+  const int positions[] = {0, 62, 63, 64, 126, 127, 128, 190, 300};
+  const size_t count = sizeof(positions) / sizeof(positions[0]);
+
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < count; ++j) {
+      for (int states = 0; states < 4; ++states) {
+        MapGaps a, b;
+        a.set(positions[i], states & 1);
+        b.set(positions[j], states & 2);
+        CheckSameOrder(a, b);
+
+        // a later gap in only one of them decides
+        MapGaps longer = a;
+        longer.set(positions[j] + 1, false);
+        CheckSameOrder(a, longer);
+        CheckSameOrder(b, longer);
+      }
+    }
+  }
+
+  MapGaps gaps;
+  for (size_t i = 0; i < count; ++i) {
+    gaps.set(positions[i], i % 2 == 0);
+  }
+  CheckSameGaps(gaps, 310);
+
+  // filling a gap far out keeps it, filled
+  gaps.set(300, false);
+  BOOST_CHECK(!gaps.bits.isUnfilled(300));
+  CheckSameGaps(gaps, 310);
+
+  // a gap set and then filled differs from no gap at all
+  MapGaps none, filled;
+  filled.set(200, true);
+  filled.set(200, false);
+  CheckSameOrder(none, filled);
+  BOOST_CHECK(none.bits.Compare(filled.bits) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(position_minus_one)
+{
+  // -1 is where closestGap() puts a new gap when there is none before j1
+  MapGaps gaps;
+  gaps.set(-1, true);
+  BOOST_CHECK(gaps.bits.isUnfilled(-1));
+  BOOST_CHECK(!gaps.bits.isUnfilled(0));
+  BOOST_CHECK_EQUAL(gaps.bits.countUnfilledFrom(-1), 1);
+  BOOST_CHECK_EQUAL(gaps.bits.countUnfilledFrom(0), 0);
+
+  gaps.set(5, true);
+  gaps.set(70, true);
+  CheckSameGaps(gaps, 80);
+
+  // it comes first in the order
+  MapGaps later;
+  later.set(0, true);
+  CheckSameOrder(gaps, later);
+
+  MapGaps filled = gaps;
+  filled.set(-1, false);
+  CheckSameOrder(gaps, filled);
+  CheckSameGaps(filled, 80);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
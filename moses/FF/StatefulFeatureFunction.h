@@ -1,5 +1,6 @@
 #pragma once
 
+#include <utility>
 #include "FeatureFunction.h"
 
 #include "moses/Syntax/SHyperedge.h"
@@ -8,6 +9,9 @@ namespace Moses
 {
 class FFState;
 
+//! a hypothesis and a translation option the search is about to extend it with
+typedef std::pair<const Hypothesis*, const TranslationOption*> HypothesisExpansion;
+
 /** base class for all stateful feature functions.
  * eg. LM, distortion penalty
  */
@@ -50,6 +54,13 @@ public:
     int /* featureID - used to index the state in the previous hypotheses */,
     ScoreComponentCollection* accumulator) const = 0;
 
+  /**
+   * Used by the syntax decoders and incremental search.  The tail of the
+   * hyperedge is in source order and has an entry for every source symbol.
+   * Entries for terminals have a NULL best and no states; in incremental
+   * search their pvertex is NULL too.  Only look at the tail entries of
+   * non-terminals, found through GetNonTermIndexMap2().
+   */
   virtual FFState* EvaluateWhenApplied(
     const Syntax::SHyperedge& /* cur_hypo */,
     int /* featureID - used to index the state in the previous hypotheses */,
@@ -58,6 +69,30 @@ public:
     return 0; /* FIXME */
   }
 
+  /**
+   * Whether the feature implements EvaluateWhenApplied() on a hyperedge and
+   * its states implement FFState::Hash(), which incremental search
+   * recombines by.  Incremental search refuses other stateful features.
+   */
+  virtual bool EvaluatesHyperedges() const {
+    return false;
+  }
+
+  /**
+   * Phrase-based search hands every feature that asks for it the expansions
+   * of a stack before it builds any of them: all of them in normal search,
+   * the seed of every cube in cube pruning. Features whose
+   * EvaluateWhenApplied() is dominated by expensive model queries can score
+   * them here in bulk and answer EvaluateWhenApplied() from a cache.
+   */
+  virtual bool PrefetchesWhenApplied() const {
+    return false;
+  }
+
+  virtual void PrefetchWhenApplied(
+    const std::vector<HypothesisExpansion>& /* expansions */) const {
+  }
+
   //! return the state associated with the empty hypothesis for a given sentence
   virtual const FFState* EmptyHypothesisState(const InputType &input) const = 0;
 
@@ -40,6 +40,14 @@ public:
     assert(false);
   }
 
+  /**
+   * Whether the feature implements EvaluateWhenApplied() on a hyperedge.
+   * Incremental search refuses other stateless features.
+   */
+  virtual bool EvaluatesHyperedges() const {
+    return false;
+  }
+
   virtual bool IsStateless() const {
     return true;
   }
@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include <limits>
+#include <utility>
 
 #include "moses/FF/StatelessFeatureFunction.h"
 #include "moses/PP/CountsPhraseProperty.h"
@@ -100,10 +101,36 @@ struct VWTargetSentence {
   std::vector<Constraint> m_sourceConstraints, m_targetConstraints;
 };
 
+/**
+ * VW thread-specific cache of the hashed source features of the current
+ * sentence, so that translation option lists over the same source word range
+ * share them, and features that do not look at the range are only created
+ * once.
+ */
+struct VWSourceFeatures {
+  VWSourceFeatures() : m_haveSentenceFeatures(false) {}
+
+  void Clear() {
+    m_sentenceFeatures.clear();
+    m_haveSentenceFeatures = false;
+    m_spanFeatures.clear();
+  }
+
+  // features of the source features that do not depend on the range, by position
+  // in the list of source features
+  std::vector<Discriminative::FeatureVector> m_sentenceFeatures;
+  bool m_haveSentenceFeatures;
+
+  // all source features, in the order of the list of source features, by range
+  std::map<std::pair<size_t, size_t>, Discriminative::FeatureVector> m_spanFeatures;
+};
+
 typedef ThreadLocalByFeatureStorage<Discriminative::Classifier, Discriminative::ClassifierFactory &> TLSClassifier;
 
 typedef ThreadLocalByFeatureStorage<VWTargetSentence> TLSTargetSentence;
 
+typedef ThreadLocalByFeatureStorage<VWSourceFeatures> TLSSourceFeatures;
+
 class VW : public StatelessFeatureFunction, public TLSTargetSentence
 {
 public:
@@ -117,6 +144,7 @@ public:
         : new Discriminative::ClassifierFactory(m_modelPath, m_vwOptions);
 
     m_tlsClassifier = new TLSClassifier(this, *classifierFactory);
+    m_tlsSourceFeatures = new TLSSourceFeatures(this);
 
     if (! m_normalizer) {
       VERBOSE(1, "VW :: No loss function specified, assuming logistic loss.\n");
@@ -131,6 +159,7 @@ public:
 
   virtual ~VW() {
     delete m_tlsClassifier;
+    delete m_tlsSourceFeatures;
     delete m_normalizer;
   }
 
@@ -205,10 +234,11 @@ public:
       const TargetPhrase &correctPhrase = translationOptionList.Get(firstCorrect)->GetTargetPhrase();
 
       // extract source side features
-      for(size_t i = 0; i < sourceFeatures.size(); ++i)
-        (*sourceFeatures[i])(input, inputPath, sourceRange, classifier);
+      classifier.AddLabelIndependentFeatures(
+        GetSourceFeatures(input, inputPath, sourceRange, sourceFeatures, classifier));
 
       // go over topts, extract target side features and train the classifier
+      Discriminative::FeatureVector outFeatures;
       for (size_t toptIdx = 0; toptIdx < translationOptionList.size(); toptIdx++) {
 
         // this topt was discarded by leaving one out
@@ -217,8 +247,10 @@ public:
 
         // extract target-side features for each topt
         const TargetPhrase &targetPhrase = translationOptionList.Get(toptIdx)->GetTargetPhrase();
+        outFeatures.clear();
         for(size_t i = 0; i < targetFeatures.size(); ++i)
-          (*targetFeatures[i])(input, inputPath, targetPhrase, classifier);
+          (*targetFeatures[i])(input, inputPath, targetPhrase, classifier, outFeatures);
+        classifier.AddLabelDependentFeatures(outFeatures);
 
         float loss = (*m_trainingLoss)(targetPhrase, correctPhrase, correct[toptIdx]);
 
@@ -231,10 +263,12 @@ public:
       //
 
       std::vector<float> losses(translationOptionList.size());
+      std::vector<std::string> labels(translationOptionList.size());
+      std::vector<Discriminative::FeatureVector> labelFeatures(translationOptionList.size());
 
       // extract source side features
-      for(size_t i = 0; i < sourceFeatures.size(); ++i)
-        (*sourceFeatures[i])(input, inputPath, sourceRange, classifier);
+      classifier.AddLabelIndependentFeatures(
+        GetSourceFeatures(input, inputPath, sourceRange, sourceFeatures, classifier));
 
       for (size_t toptIdx = 0; toptIdx < translationOptionList.size(); toptIdx++) {
         const TranslationOption *topt = translationOptionList.Get(toptIdx);
@@ -242,12 +276,14 @@ public:
 
         // extract target-side features for each topt
         for(size_t i = 0; i < targetFeatures.size(); ++i)
-          (*targetFeatures[i])(input, inputPath, targetPhrase, classifier);
+          (*targetFeatures[i])(input, inputPath, targetPhrase, classifier, labelFeatures[toptIdx]);
 
-        // get classifier score
-        losses[toptIdx] = classifier.Predict(MakeTargetLabel(targetPhrase));
+        labels[toptIdx] = MakeTargetLabel(targetPhrase);
       }
 
+      // get classifier scores of all topts at once
+      classifier.Predict(labels, labelFeatures, losses);
+
       // normalize classifier scores to get a probability distribution
       (*m_normalizer)(losses);
 
@@ -308,6 +344,12 @@ public:
 
   virtual void InitializeForInput(ttasksptr const& ttask) {
     InputType const& source = *(ttask->GetSource().get());
+
+    // source features are cached for one sentence at a time, and so are
+    // the ids the classifier gave them
+    m_tlsSourceFeatures->GetStored()->Clear();
+    m_tlsClassifier->GetStored()->ForgetFeatures();
+
     // tabbed sentence is assumed only in training
     if (! m_train)
       return;
@@ -347,6 +389,40 @@ private:
     return VW_DUMMY_LABEL;
   }
 
+  // Return the hashed source features of the range, in the order of the source
+  // features, from the cache of the current sentence if they were already created.
+  const Discriminative::FeatureVector &GetSourceFeatures(const InputType &input
+      , const InputPath &inputPath
+      , const WordsRange &sourceRange
+      , const std::vector<VWFeatureBase*> &sourceFeatures
+      , Discriminative::Classifier &classifier) const {
+    VWSourceFeatures &cache = *m_tlsSourceFeatures->GetStored();
+
+    std::pair<size_t, size_t> span(sourceRange.GetStartPos(), sourceRange.GetEndPos());
+    std::map<std::pair<size_t, size_t>, Discriminative::FeatureVector>::const_iterator it
+      = cache.m_spanFeatures.find(span);
+    if (it != cache.m_spanFeatures.end())
+      return it->second;
+
+    if (! cache.m_haveSentenceFeatures) {
+      cache.m_sentenceFeatures.resize(sourceFeatures.size());
+      for(size_t i = 0; i < sourceFeatures.size(); ++i) {
+        if (! sourceFeatures[i]->DependsOnSpan())
+          (*sourceFeatures[i])(input, inputPath, sourceRange, classifier, cache.m_sentenceFeatures[i]);
+      }
+      cache.m_haveSentenceFeatures = true;
+    }
+
+    Discriminative::FeatureVector &features = cache.m_spanFeatures[span];
+    for(size_t i = 0; i < sourceFeatures.size(); ++i) {
+      if (sourceFeatures[i]->DependsOnSpan())
+        (*sourceFeatures[i])(input, inputPath, sourceRange, classifier, features);
+      else
+        features.insert(features.end(), cache.m_sentenceFeatures[i].begin(), cache.m_sentenceFeatures[i].end());
+    }
+    return features;
+  }
+
   bool IsCorrectTranslationOption(const TranslationOption &topt) const {
 
     //std::cerr << topt.GetSourceWordsRange() << std::endl;
@@ -490,6 +566,7 @@ private:
 
   Discriminative::Normalizer *m_normalizer = NULL;
   TLSClassifier *m_tlsClassifier;
+  TLSSourceFeatures *m_tlsSourceFeatures;
 };
 
 }
@@ -78,11 +78,13 @@ public:
   }
 
   // Overload to process source-dependent data, create features once for every
-  // source sentence word range.
+  // source sentence word range. Features are hashed by the classifier and
+  // appended to outFeatures.
   virtual void operator()(const InputType &input
                           , const InputPath &inputPath
                           , const WordsRange &sourceRange
-                          , Discriminative::Classifier &classifier) const = 0;
+                          , Discriminative::Classifier &classifier
+                          , Discriminative::FeatureVector &outFeatures) const = 0;
 
   // Overload to process target-dependent features, create features once for
   // every target phrase. One source word range will have at leat one target
@@ -90,7 +92,14 @@ public:
   virtual void operator()(const InputType &input
                           , const InputPath &inputPath
                           , const TargetPhrase &targetPhrase
-                          , Discriminative::Classifier &classifier) const = 0;
+                          , Discriminative::Classifier &classifier
+                          , Discriminative::FeatureVector &outFeatures) const = 0;
+
+  // Source features that do not look at the source word range are created
+  // once for every sentence and reused for all its ranges.
+  virtual bool DependsOnSpan() const {
+    return true;
+  }
 
 protected:
   std::vector<FactorType> m_sourceFactors, m_targetFactors;
@@ -20,12 +20,17 @@ public:
   void operator()(const InputType &input
                   , const InputPath &inputPath
                   , const WordsRange &sourceRange
-                  , Discriminative::Classifier &classifier) const {
+                  , Discriminative::Classifier &classifier
+                  , Discriminative::FeatureVector &outFeatures) const {
     for (size_t i = 0; i < input.GetSize(); i++) {
-      classifier.AddLabelIndependentFeature("bow^" + GetWord(input, i));
+      outFeatures.push_back(classifier.MakeLabelIndependentFeature("bow^" + GetWord(input, i)));
     }
   }
 
+  virtual bool DependsOnSpan() const {
+    return false;
+  }
+
   virtual void SetParameter(const std::string& key, const std::string& value) {
     VWFeatureSource::SetParameter(key, value);
   }
@@ -25,13 +25,18 @@ public:
   void operator()(const InputType &input
                   , const InputPath &inputPath
                   , const WordsRange &sourceRange
-                  , Discriminative::Classifier &classifier) const {
+                  , Discriminative::Classifier &classifier
+                  , Discriminative::FeatureVector &outFeatures) const {
     const Features& features = *m_tls.GetStored();
     for (size_t i = 0; i < features.size(); i++) {
-      classifier.AddLabelIndependentFeature("srcext^" + features[i]);
+      outFeatures.push_back(classifier.MakeLabelIndependentFeature("srcext^" + features[i]));
     }
   }
 
+  virtual bool DependsOnSpan() const {
+    return false;
+  }
+
   virtual void SetParameter(const std::string& key, const std::string& value) {
     if(key == "column")
       m_column = Scan<size_t>(value);
@@ -25,7 +25,8 @@ public:
   virtual void operator()(const InputType &input
                           , const InputPath &inputPath
                           , const WordsRange &sourceRange
-                          , Discriminative::Classifier &classifier) const {
+                          , Discriminative::Classifier &classifier
+                          , Discriminative::FeatureVector &outFeatures) const {
   }
 
   virtual void SetParameter(const std::string& key, const std::string& value) {
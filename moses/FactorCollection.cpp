@@ -39,7 +39,6 @@ const Factor *FactorCollection::AddFactor(const StringPiece &factorString, bool
 {
   FactorFriend to_ins;
   to_ins.in.m_string = factorString;
-  to_ins.in.m_id = (isNonTerminal) ? m_factorIdNonTerminal : m_factorId;
   Set & set = (isNonTerminal) ? m_set : m_setNonTerminal;
   // If we're threaded, hope a read-only lock is sufficient.
 #ifdef WITH_THREADS
@@ -51,6 +50,9 @@ const Factor *FactorCollection::AddFactor(const StringPiece &factorString, bool
   }
   boost::unique_lock<boost::shared_mutex> lock(m_accessLock);
 #endif // WITH_THREADS
+  // The id must be read under the write lock. Models may be loaded
+  // concurrently, and an id taken before the lock could be handed out twice.
+  to_ins.in.m_id = (isNonTerminal) ? m_factorIdNonTerminal : m_factorId;
   std::pair<Set::iterator, bool> ret(set.insert(to_ins));
   if (ret.second) {
     ret.first->in.m_string.set(
@@ -70,7 +72,6 @@ const Factor *FactorCollection::GetFactor(const StringPiece &factorString, bool
 {
   FactorFriend to_find;
   to_find.in.m_string = factorString;
-  to_find.in.m_id = (isNonTerminal) ? m_factorIdNonTerminal : m_factorId;
   Set & set = (isNonTerminal) ? m_set : m_setNonTerminal;
   {
     // read=lock scope
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #ifdef WITH_THREADS
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 #endif
 
 #include "util/murmur_hash.hh"
@@ -111,6 +112,9 @@ public:
   const Factor *AddFactor(const StringPiece &factorString, bool isNonTerminal = false);
 
   size_t GetNumNonTerminals() {
+#ifdef WITH_THREADS
+    boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
+#endif
     return m_factorIdNonTerminal;
   }
 
@@ -0,0 +1,267 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "FeatureLoader.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "Util.h"
+#include "StaticData.h"
+#include "moses/FF/FeatureFunction.h"
+#include "util/exception.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+#ifdef WITH_THREADS
+namespace
+{
+class LoadTask : public Task
+{
+public:
+  LoadTask(FeatureLoader &loader, size_t node)
+    : m_loader(loader), m_node(node) {
+  }
+
+  void Run() {
+    m_loader.Execute(m_node);
+  }
+
+private:
+  FeatureLoader &m_loader;
+  size_t m_node;
+};
+}
+#endif
+
+FeatureLoader::FeatureLoader(size_t numThreads)
+  : m_numThreads(numThreads ? numThreads : 1)
+  , m_wave(0)
+#ifdef WITH_THREADS
+  , m_pool(NULL)
+  , m_numRunning(0)
+  , m_numDone(0)
+  , m_failed(false)
+#endif
+{
+}
+
+void FeatureLoader::Add(FeatureFunction *ff)
+{
+  Node node;
+  node.ff = ff;
+  node.wave = m_wave;
+  node.numDependencies = 0;
+  node.seconds = 0;
+  m_nodes.push_back(node);
+}
+
+void FeatureLoader::NextWave()
+{
+  if (m_nodes.size() && m_nodes.back().wave == m_wave) {
+    ++m_wave;
+  }
+}
+
+void FeatureLoader::LinkDependencies()
+{
+  map<string, size_t> index;
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    index[m_nodes[i].ff->GetScoreProducerDescription()] = i;
+  }
+
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    Node &node = m_nodes[i];
+    const vector<string> deps = node.ff->GetLoadDependencies();
+    for (size_t j = 0; j < deps.size(); ++j) {
+      map<string, size_t>::const_iterator iter = index.find(deps[j]);
+      UTIL_THROW_IF2(iter == index.end(),
+                     node.ff->GetScoreProducerDescription()
+                     << " depends on unknown feature " << deps[j]);
+      UTIL_THROW_IF2(iter->second == i,
+                     node.ff->GetScoreProducerDescription() << " depends on itself");
+      m_nodes[iter->second].dependents.push_back(i);
+      ++node.numDependencies;
+    }
+
+    // nodes are in the order they were added, so earlier waves come first
+    for (size_t j = 0; j < i && m_nodes[j].wave < node.wave; ++j) {
+      m_nodes[j].dependents.push_back(i);
+      ++node.numDependencies;
+    }
+  }
+}
+
+void FeatureLoader::Load()
+{
+  LinkDependencies();
+
+  Timer timer;
+  timer.start();
+
+#ifdef WITH_THREADS
+  if (m_numThreads > 1 && m_nodes.size() > 1) {
+    LoadParallel();
+  } else {
+    LoadSerial();
+  }
+#else
+  LoadSerial();
+#endif
+
+  Report(timer.get_elapsed_time());
+}
+
+void FeatureLoader::LoadOne(size_t node)
+{
+  FeatureFunction &ff = *m_nodes[node].ff;
+  VERBOSE(1, "Loading " << ff.GetScoreProducerDescription() << endl);
+
+  Timer timer;
+  timer.start();
+  ff.Load();
+  m_nodes[node].seconds = timer.get_elapsed_time();
+
+  VERBOSE(1, "Loaded " << ff.GetScoreProducerDescription()
+          << " in " << m_nodes[node].seconds << " seconds" << endl);
+}
+
+void FeatureLoader::LoadSerial()
+{
+  // Kahn's algorithm, always taking the earliest ready feature so that the
+  // order only differs from the configuration where a dependency forces it
+  vector<bool> loaded(m_nodes.size(), false);
+  for (size_t numLoaded = 0; numLoaded < m_nodes.size(); ++numLoaded) {
+    size_t next = 0;
+    while (next < m_nodes.size()
+           && (loaded[next] || m_nodes[next].numDependencies)) {
+      ++next;
+    }
+    UTIL_THROW_IF2(next == m_nodes.size(),
+                   "Cyclic dependencies between feature functions");
+
+    LoadOne(next);
+    loaded[next] = true;
+
+    const vector<size_t> &dependents = m_nodes[next].dependents;
+    for (size_t i = 0; i < dependents.size(); ++i) {
+      --m_nodes[dependents[i]].numDependencies;
+    }
+  }
+}
+
+#ifdef WITH_THREADS
+void FeatureLoader::Execute(size_t node)
+{
+  string error;
+  try {
+    LoadOne(node);
+  } catch (const std::exception &e) {
+    error = e.what();
+  } catch (const std::string &e) {
+    error = e;
+  } catch (...) {
+    error = "unknown exception";
+  }
+
+  boost::mutex::scoped_lock lock(m_mutex);
+  --m_numRunning;
+  ++m_numDone;
+  if (!error.empty() && !m_failed) {
+    m_failed = true;
+    m_error = "Error loading " + m_nodes[node].ff->GetScoreProducerDescription()
+              + ": " + error;
+  }
+  if (!m_failed) {
+    // dependents become ready once their last dependency has loaded
+    const vector<size_t> &dependents = m_nodes[node].dependents;
+    for (size_t i = 0; i < dependents.size(); ++i) {
+      if (--m_nodes[dependents[i]].numDependencies == 0) {
+        Submit(dependents[i]);
+      }
+    }
+  }
+  m_finished.notify_all();
+}
+
+void FeatureLoader::Submit(size_t node)
+{
+  ++m_numRunning;
+  boost::shared_ptr<Task> task(new LoadTask(*this, node));
+  m_pool->Submit(task);
+}
+
+void FeatureLoader::LoadParallel()
+{
+  VERBOSE(1, "Loading " << m_nodes.size() << " feature functions with "
+          << m_numThreads << " threads" << endl);
+
+  // short-lived, so its workers don't take CPUs from the decoder's in the
+  // thread placement
+  ThreadPool pool(m_numThreads, false);
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_pool = &pool;
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+      if (m_nodes[i].numDependencies == 0) {
+        Submit(i);
+      }
+    }
+
+    while (m_numRunning) {
+      m_finished.wait(lock);
+    }
+    m_pool = NULL;
+  }
+  pool.Stop(true);
+
+  UTIL_THROW_IF2(m_failed, m_error);
+  UTIL_THROW_IF2(m_numDone != m_nodes.size(),
+                 "Cyclic dependencies between feature functions");
+}
+#endif
+
+void FeatureLoader::Report(double seconds) const
+{
+  IFVERBOSE(1) {
+    size_t slowest = 0;
+    for (size_t i = 1; i < m_nodes.size(); ++i) {
+      if (m_nodes[i].seconds > m_nodes[slowest].seconds) {
+        slowest = i;
+      }
+    }
+
+    std::ostringstream msg;
+    msg << "Loaded " << m_nodes.size() << " feature functions in "
+        << seconds << " seconds";
+    if (m_nodes.size()) {
+      msg << ", slowest " << m_nodes[slowest].ff->GetScoreProducerDescription()
+          << " (" << m_nodes[slowest].seconds << " seconds)";
+    }
+    TRACE_ERR(msg.str() << endl);
+  }
+}
+
+}
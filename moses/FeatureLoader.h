@@ -0,0 +1,98 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_FeatureLoader_h
+#define moses_FeatureLoader_h
+
+#include <string>
+#include <vector>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#endif
+
+namespace Moses
+{
+
+class FeatureFunction;
+class ThreadPool;
+
+/** Calls Load() on a set of feature functions, running independent loads in
+ * parallel. A feature function is only loaded once every feature function
+ * named by its GetLoadDependencies() has finished loading, and every feature
+ * function added before the last NextWave() call before it was added. With a
+ * single thread the features are loaded in the order they were added,
+ * adjusted only where a dependency requires it.
+ *
+ * The wall time of every Load() is reported at verbosity level 1.
+ */
+class FeatureLoader
+{
+public:
+  explicit FeatureLoader(size_t numThreads);
+
+  void Add(FeatureFunction *ff);
+
+  //! features added from now on wait for all the features added so far
+  void NextWave();
+
+  //! load everything added so far. Throws if any Load() fails
+  void Load();
+
+#ifdef WITH_THREADS
+  //! run one load and schedule the features waiting on it. Called by the load tasks
+  void Execute(size_t node);
+#endif
+
+private:
+  struct Node {
+    FeatureFunction *ff;
+    size_t wave;
+    std::vector<size_t> dependents;
+    size_t numDependencies;
+    double seconds;
+  };
+
+  std::vector<Node> m_nodes;
+  size_t m_numThreads;
+  size_t m_wave;
+
+  void LinkDependencies();
+  void LoadOne(size_t node);
+  void LoadSerial();
+  void Report(double seconds) const;
+
+#ifdef WITH_THREADS
+  void LoadParallel();
+  void Submit(size_t node);
+
+  ThreadPool *m_pool;
+  boost::mutex m_mutex;
+  boost::condition_variable m_finished;
+  size_t m_numRunning, m_numDone;
+  bool m_failed;
+  std::string m_error;
+#endif
+};
+
+}
+
+#endif
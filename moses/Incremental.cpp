@@ -1,3 +1,4 @@
+#include <cassert>
 #include <cmath>
 #include <stdexcept>
 
@@ -10,16 +11,24 @@
 #include "moses/Util.h"
 #include "moses/LM/Base.h"
 #include "moses/OutputCollector.h"
+#include "moses/FF/FFState.h"
+#include "moses/FF/StatefulFeatureFunction.h"
+#include "moses/FF/StatelessFeatureFunction.h"
+#include "moses/Syntax/SHyperedge.h"
+#include "moses/Syntax/SVertex.h"
 
 #include "lm/model.hh"
 #include "search/applied.hh"
 #include "search/config.hh"
 #include "search/context.hh"
 #include "search/edge_generator.hh"
+#include "search/features.hh"
 #include "search/rule.hh"
 #include "search/vertex_generator.hh"
 
+#include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace Moses
 {
@@ -73,6 +82,138 @@ private:
   boost::object_pool<Gen> generator_pool_;
 };
 
+// Scores the stateful features other than the language model that drives the
+// search, through the interface they implement for the syntax decoders
+// (EvaluateWhenApplied on a Syntax::SHyperedge).  Stateless features get
+// their EvaluateWhenApplied too.  The feature state of a hypothesis is an
+// SVertex with the FFStates and the score breakdown of its derivation.
+// StaticData refuses stateful features that can't be scored this way.
+class FeatureScorer : public search::Features
+{
+public:
+  FeatureScorer(const LanguageModel &searchLM, boost::ptr_vector<Syntax::SVertex> &vertices)
+    : m_vertices(vertices) {
+    const StaticData &staticData = StaticData::Instance();
+    const std::vector<const StatefulFeatureFunction*> &ffs = StatefulFeatureFunction::GetStatefulFeatureFunctions();
+    m_numStateful = ffs.size();
+    for (size_t i = 0; i < ffs.size(); ++i) {
+      if (ffs[i] != &searchLM && !staticData.IsFeatureFunctionIgnored(*ffs[i])) {
+        m_stateful.push_back(i);
+      }
+    }
+    m_terminal.best = NULL;
+    m_terminal.pvertex = NULL;
+  }
+
+  // Whether there is anything to score.
+  bool Empty() const {
+    return m_stateful.empty();
+  }
+
+  search::Score Apply(const search::PartialEdge &edge, const void *&state) {
+    const StaticData &staticData = StaticData::Instance();
+    const TargetPhrase &phrase = *static_cast<const TargetPhrase*>(edge.GetNote().vp);
+
+    m_vertices.push_back(new Syntax::SVertex());
+    Syntax::SVertex &head = m_vertices.back();
+    head.best = new Syntax::SHyperedge();
+    head.pvertex = NULL;
+    head.state.resize(m_numStateful, NULL);
+    Syntax::SHyperedge &hyperedge = *head.best;
+    hyperedge.head = &head;
+    hyperedge.label.inputWeight = 0.0;
+    hyperedge.label.translation = &phrase;
+
+    // Like the syntax decoders, order the tail by the source side, with
+    // placeholders for terminals.  The edge has its non-terminals in target order.
+    const AlignmentInfo::NonTermIndexMap &sourceIndex = phrase.GetAlignNonTerm().GetNonTermIndexMap2();
+    ScoreComponentCollection &breakdown = hyperedge.label.scoreBreakdown;
+    const search::PartialVertex *nt = edge.NT();
+    for (size_t i = 0; i < phrase.GetSize(); ++i) {
+      if (!phrase.GetWord(i).IsNonTerminal()) continue;
+      Syntax::SVertex *child = const_cast<Syntax::SVertex*>(static_cast<const Syntax::SVertex*>((nt++)->FeatureState()));
+      assert(child->best && child->state.size() == m_numStateful);
+      if (hyperedge.tail.size() <= sourceIndex[i]) {
+        hyperedge.tail.resize(sourceIndex[i] + 1, &m_terminal);
+      }
+      assert(hyperedge.tail[sourceIndex[i]] == &m_terminal);
+      hyperedge.tail[sourceIndex[i]] = child;
+      breakdown.PlusEquals(child->best->label.scoreBreakdown);
+    }
+    breakdown.PlusEquals(phrase.GetScoreBreakdown());
+    const float before = breakdown.GetWeightedScore();
+
+    const std::vector<const StatelessFeatureFunction*> &sfs = StatelessFeatureFunction::GetStatelessFeatureFunctions();
+    for (size_t i = 0; i < sfs.size(); ++i) {
+      if (!staticData.IsFeatureFunctionIgnored(*sfs[i])) {
+        sfs[i]->EvaluateWhenApplied(hyperedge, &breakdown);
+      }
+    }
+    const std::vector<const StatefulFeatureFunction*> &ffs = StatefulFeatureFunction::GetStatefulFeatureFunctions();
+    for (std::vector<size_t>::const_iterator i = m_stateful.begin(); i != m_stateful.end(); ++i) {
+      head.state[*i] = ffs[*i]->EvaluateWhenApplied(hyperedge, *i, &breakdown);
+      assert(head.state[*i]);
+    }
+    hyperedge.label.score = breakdown.GetWeightedScore();
+
+    state = &head;
+    // The rule's score so far had these features' estimates, which are now
+    // replaced by the actual scores.
+    return hyperedge.label.score - before - Estimate(phrase);
+  }
+
+  uint64_t Hash(const void *state) const {
+    const Syntax::SVertex &vertex = *static_cast<const Syntax::SVertex*>(state);
+    size_t seed = 0;
+    for (std::vector<size_t>::const_iterator i = m_stateful.begin(); i != m_stateful.end(); ++i) {
+      boost::hash_combine(seed, vertex.state[*i]->Hash());
+    }
+    return seed;
+  }
+
+  bool Equal(const void *first, const void *second) const {
+    const Syntax::SVertex &a = *static_cast<const Syntax::SVertex*>(first);
+    const Syntax::SVertex &b = *static_cast<const Syntax::SVertex*>(second);
+    for (std::vector<size_t>::const_iterator i = m_stateful.begin(); i != m_stateful.end(); ++i) {
+      if (a.state[*i]->Compare(*b.state[*i])) return false;
+    }
+    return true;
+  }
+
+private:
+  // Weighted future score estimates of the stateful features for a rule, as
+  // included in TargetPhrase::GetFutureScore.  The language models, the usual
+  // stateful features, don't look at the source, which isn't known here.
+  float Estimate(const TargetPhrase &phrase) {
+    std::pair<Estimates::iterator, bool> found(m_estimates.insert(std::make_pair(&phrase, 0.0f)));
+    if (found.second) {
+      const std::vector<const StatefulFeatureFunction*> &ffs = StatefulFeatureFunction::GetStatefulFeatureFunctions();
+      const Phrase source;
+      ScoreComponentCollection ignored, estimates;
+      for (std::vector<size_t>::const_iterator i = m_stateful.begin(); i != m_stateful.end(); ++i) {
+        ffs[*i]->EvaluateInIsolation(source, phrase, ignored, estimates);
+      }
+      found.first->second = estimates.GetWeightedScore();
+    }
+    return found.first->second;
+  }
+
+  boost::ptr_vector<Syntax::SVertex> &m_vertices;
+
+  // Indices of the features to score in GetStatefulFeatureFunctions().
+  std::vector<size_t> m_stateful;
+  size_t m_numStateful;
+
+  // Tail entry for terminals, shared by all hyperedges: no best, no pvertex
+  // and no states, as documented for StatefulFeatureFunction's
+  // EvaluateWhenApplied() on a hyperedge.  The source position isn't known
+  // here, so there is nothing better to give.
+  Syntax::SVertex m_terminal;
+
+  typedef boost::unordered_map<const TargetPhrase*, float> Estimates;
+  Estimates m_estimates;
+};
+
 // This is called by the moses parser to collect hypotheses.  It converts to my
 // edges (search::PartialEdge).
 template <class Model> class Fill : public ChartParserCallback
@@ -234,7 +375,8 @@ PopulateBest(const Model &model, const std::vector<lm::WordIndex> &words, Best &
   size_t cpl = data.options().cube.pop_limit;
   size_t nbs = data.options().nbest.nbest_size;
   search::Config config(abstract.GetWeight() * log_10, cpl, search::NBestConfig(nbs));
-  search::Context<Model> context(config, model);
+  FeatureScorer features(abstract, feature_vertices_);
+  search::Context<Model> context(config, model, features.Empty() ? NULL : &features);
 
   size_t size = m_source.GetSize();
   boost::object_pool<search::Vertex> vertex_pool(std::max<size_t>(size * size / 2, 32));
@@ -529,12 +671,24 @@ namespace
 {
 
 struct NoOp {
-  void operator()(const TargetPhrase &) const {}
+  void operator()(const search::Applied &, const TargetPhrase &) const {}
 };
 struct AccumScore {
   AccumScore(ScoreComponentCollection &out) : out_(&out) {}
-  void operator()(const TargetPhrase &phrase) {
-    out_->PlusEquals(phrase.GetScoreBreakdown());
+  void operator()(const search::Applied &applied, const TargetPhrase &phrase) {
+    const Syntax::SVertex *vertex = static_cast<const Syntax::SVertex*>(applied.GetFeatureState());
+    if (!vertex) {
+      out_->PlusEquals(phrase.GetScoreBreakdown());
+      return;
+    }
+    // FeatureScorer kept the scores of the whole derivation, so take away
+    // those of the children.  Alternatives in the n-best list have children
+    // with the same feature states, so this is also their rule's share.
+    const Syntax::SHyperedge &hyperedge = *vertex->best;
+    out_->PlusEquals(hyperedge.label.scoreBreakdown);
+    for (std::vector<Syntax::SVertex*>::const_iterator i = hyperedge.tail.begin(); i != hyperedge.tail.end(); ++i) {
+      if ((*i)->best) out_->MinusEquals((*i)->best->label.scoreBreakdown);
+    }
   }
   ScoreComponentCollection *out_;
 };
@@ -542,7 +696,7 @@ template <class Action> void AppendToPhrase(const search::Applied final, Phrase
 {
   assert(final.Valid());
   const TargetPhrase &phrase = *static_cast<const TargetPhrase*>(final.GetNote().vp);
-  action(phrase);
+  action(final, phrase);
   const search::Applied *child = final.Children();
   for (std::size_t i = 0; i < phrase.GetSize(); ++i) {
     const Word &word = phrase.GetWord(i);
@@ -568,7 +722,8 @@ void PhraseAndFeatures(const search::Applied final, Phrase &phrase, ScoreCompone
   features.ZeroAll();
   AppendToPhrase(final, phrase, AccumScore(features));
 
-  // If we made it this far, there is only one language model.
+  // The language model that drove the search.  Other stateful features were
+  // added up by AccumScore.
   float full, ignored_ngram;
   std::size_t ignored_oov;
 
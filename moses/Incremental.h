@@ -10,6 +10,8 @@
 
 #include "BaseManager.h"
 
+#include <boost/ptr_container/ptr_vector.hpp>
+
 #include <vector>
 #include <string>
 
@@ -19,6 +21,11 @@ class ScoreComponentCollection;
 class InputType;
 class LanguageModel;
 
+namespace Syntax
+{
+struct SVertex;
+}
+
 namespace Incremental
 {
 
@@ -79,6 +86,10 @@ private:
 
   const std::vector<search::Applied> *completed_nbest_;
 
+  // Feature states of the hypotheses when there are stateful features other
+  // than the language model.  They are referenced by the n-best list.
+  boost::ptr_vector<Syntax::SVertex> feature_vertices_;
+
   // outputs
   void OutputDetailedTranslationReport(
     OutputCollector *collector,
@@ -35,12 +35,26 @@ void BilingualLM::Load()
   loadModel();
 }
 
-//Populates words with amount words from the targetPhrase from the previous hypothesis where
+float BilingualLM::ScoreNgrams(const std::vector<int>& ngrams) const
+{
+  const size_t order = source_ngrams + target_ngrams + 1;
+  std::vector<int> source_words;
+  std::vector<int> target_words;
+
+  float value = 0;
+  for (size_t i = 0; i + order <= ngrams.size(); i += order) {
+    source_words.assign(ngrams.begin() + i, ngrams.begin() + i + source_ngrams);
+    target_words.assign(ngrams.begin() + i + source_ngrams, ngrams.begin() + i + order);
+    value += Score(source_words, target_words);
+  }
+  return value;
+}
+
+//Populates words with amount words from the target phrases of prev_hyp and its predecessors where
 //words[0] is the last word of the previous hypothesis, words[1] is the second last etc...
 void BilingualLM::requestPrevTargetNgrams(
-  const Hypothesis &cur_hypo, int amount, std::vector<int> &words) const
+  const Hypothesis *prev_hyp, int amount, std::vector<int> &words) const
 {
-  const Hypothesis * prev_hyp = cur_hypo.GetPrevHypo();
   int found = 0;
 
   while (prev_hyp && found != amount) {
@@ -67,7 +81,7 @@ void BilingualLM::requestPrevTargetNgrams(
 //Populates the words vector with target_ngrams sized that also contains the current word we are looking at.
 //(in effect target_ngrams + 1)
 void BilingualLM::getTargetWords(
-  const Hypothesis &cur_hypo,
+  const Hypothesis *prev_hypo,
   const TargetPhrase &targetPhrase,
   int current_word_index,
   std::vector<int> &words) const
@@ -77,7 +91,7 @@ void BilingualLM::getTargetWords(
   if (additional_needed < 0) {
     additional_needed = -additional_needed;
     std::vector<int> prev_words(additional_needed);
-    requestPrevTargetNgrams(cur_hypo, additional_needed, prev_words);
+    requestPrevTargetNgrams(prev_hypo, additional_needed, prev_words);
     for (int i = additional_needed - 1; i >= 0; i--) {
       words.push_back(prev_words[i]);
     }
@@ -173,7 +187,7 @@ size_t BilingualLM::getState(const Hypothesis& cur_hypo) const
   if (additional_needed < 0) {
     additional_needed = -additional_needed;
     std::vector<int> prev_words(additional_needed);
-    requestPrevTargetNgrams(cur_hypo, additional_needed, prev_words);
+    requestPrevTargetNgrams(cur_hypo.GetPrevHypo(), additional_needed, prev_words);
     for (int i = additional_needed - 1; i >= 0; i--) {
       boost::hash_combine(hashCode, prev_words[i]);
     }
@@ -213,35 +227,48 @@ void BilingualLM::EvaluateWithSourceContext(const InputType &input
 }
 
 
-FFState* BilingualLM::EvaluateWhenApplied(
-  const Hypothesis& cur_hypo,
-  const FFState* prev_state,
-  ScoreComponentCollection* accumulator) const
+void BilingualLM::getPhraseNgrams(
+  const Hypothesis *prev_hypo,
+  const TargetPhrase &targetPhrase,
+  const Sentence &source_sent,
+  const WordsRange &sourceWordRange,
+  std::vector<int> &ngrams) const
 {
-  Manager& manager = cur_hypo.GetManager();
-  const Sentence& source_sent = static_cast<const Sentence&>(manager.GetSource());
-
   // Init vectors.
   std::vector<int> source_words;
   source_words.reserve(source_ngrams);
   std::vector<int> target_words;
   target_words.reserve(target_ngrams);
 
-  float value = 0;
-  const TargetPhrase& currTargetPhrase = cur_hypo.GetCurrTargetPhrase();
-  const WordsRange& sourceWordRange = cur_hypo.GetCurrSourceWordsRange(); //Source words range to calculate offsets
-
-  // For each word in the current target phrase get its LM score.
-  for (int i = 0; i < currTargetPhrase.GetSize(); i++) {
+  for (int i = 0; i < targetPhrase.GetSize(); i++) {
     getSourceWords(
-      currTargetPhrase, i, source_sent, sourceWordRange, source_words);
-    getTargetWords(cur_hypo, currTargetPhrase, i, target_words);
-    value += Score(source_words, target_words);
+      targetPhrase, i, source_sent, sourceWordRange, source_words);
+    getTargetWords(prev_hypo, targetPhrase, i, target_words);
+    ngrams.insert(ngrams.end(), source_words.begin(), source_words.end());
+    ngrams.insert(ngrams.end(), target_words.begin(), target_words.end());
 
     // Clear the vectors.
     source_words.clear();
     target_words.clear();
   }
+}
+
+FFState* BilingualLM::EvaluateWhenApplied(
+  const Hypothesis& cur_hypo,
+  const FFState* prev_state,
+  ScoreComponentCollection* accumulator) const
+{
+  Manager& manager = cur_hypo.GetManager();
+  const Sentence& source_sent = static_cast<const Sentence&>(manager.GetSource());
+
+  const TargetPhrase& currTargetPhrase = cur_hypo.GetCurrTargetPhrase();
+  const WordsRange& sourceWordRange = cur_hypo.GetCurrSourceWordsRange(); //Source words range to calculate offsets
+
+  // Collect the n-gram of each word in the current target phrase and score them as one batch.
+  std::vector<int> ngrams;
+  ngrams.reserve(currTargetPhrase.GetSize() * (source_ngrams + target_ngrams + 1));
+  getPhraseNgrams(cur_hypo.GetPrevHypo(), currTargetPhrase, source_sent, sourceWordRange, ngrams);
+  float value = ScoreNgrams(ngrams);
 
   size_t new_state = getState(cur_hypo);
   accumulator->PlusEquals(this, value);
@@ -249,6 +276,30 @@ FFState* BilingualLM::EvaluateWhenApplied(
   return new BilingualLMState(new_state);
 }
 
+void BilingualLM::PrefetchWhenApplied(const std::vector<HypothesisExpansion>& expansions) const
+{
+  if (expansions.empty()) return;
+  const Sentence& source_sent = static_cast<const Sentence&>(expansions[0].first->GetManager().GetSource());
+
+  // Hand the n-grams over in chunks of about this many, so a big stack
+  // doesn't need them all in memory at once.
+  const size_t order = source_ngrams + target_ngrams + 1;
+  const size_t chunk = 1 << 16;
+
+  std::vector<int> ngrams;
+  ngrams.reserve(chunk * order);
+  for (size_t i = 0; i < expansions.size(); ++i) {
+    const TranslationOption &transOpt = *expansions[i].second;
+    getPhraseNgrams(expansions[i].first, transOpt.GetTargetPhrase(), source_sent,
+                    transOpt.GetSourceWordsRange(), ngrams);
+    if (ngrams.size() >= chunk * order) {
+      PrefetchNgrams(ngrams);
+      ngrams.clear();
+    }
+  }
+  PrefetchNgrams(ngrams);
+}
+
 void BilingualLM::getAllTargetIdsChart(const ChartHypothesis& cur_hypo, size_t featureID, std::vector<int>& wordIds) const
 {
   const TargetPhrase targetPhrase = cur_hypo.GetCurrTargetPhrase();
@@ -465,19 +516,23 @@ FFState* BilingualLM::EvaluateWhenApplied(
   const ChartManager& manager = cur_hypo.GetManager();
   const Sentence& source_sent = static_cast<const Sentence&>(manager.GetSource());
 
+  std::vector<int> ngrams;
+  ngrams.reserve(neuralLMids.size() * (source_ngrams + target_ngrams + 1));
   for (int i = 0; i < neuralLMids.size(); i++) { //This loop should be bigger as non terminals expand
 
     //We already have resolved the nonterminals, we are left with a simple loop.
     appendSourceWordsToVector(source_sent, source_words, alignments[i]);
     getTargetWordsChart(neuralLMids, i, target_words, sentence_begin);
 
-    value += Score(source_words, target_words); // Get the score
+    ngrams.insert(ngrams.end(), source_words.begin(), source_words.end());
+    ngrams.insert(ngrams.end(), target_words.begin(), target_words.end());
 
     //Clear the vectors before the next iteration
     source_words.clear();
     target_words.clear();
 
   }
+  value += ScoreNgrams(ngrams); // Get the score of all n-grams at once
   size_t new_state = getStateChart(neuralLMids);
 
   // we're rescoring the full hypothesis, so we need to detract scores from previous hypos
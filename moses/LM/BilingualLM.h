@@ -45,6 +45,16 @@ class BilingualLM : public StatefulFeatureFunction
 private:
   virtual float Score(std::vector<int>& source_words, std::vector<int>& target_words) const = 0;
 
+  //Sum of the scores of all the n-grams (source window followed by target
+  //context and word) laid out back to back in ngrams. Calls Score() for each
+  //n-gram unless overridden by a model that can score a batch at once.
+  virtual float ScoreNgrams(const std::vector<int>& ngrams) const;
+
+  //Called with the n-grams of a stack's expansions before they are scored one
+  //by one, laid out like for ScoreNgrams(). Does nothing unless the model
+  //keeps a cache it can fill in bulk.
+  virtual void PrefetchNgrams(const std::vector<int>& ngrams) const {}
+
   virtual int getNeuralLMId(const Word& word, bool is_source_word) const = 0;
 
   virtual void loadModel() = 0;
@@ -63,14 +73,23 @@ private:
   void appendSourceWordsToVector(const Sentence &source_sent, std::vector<int> &words, int source_word_mid_idx) const;
 
   void getTargetWords(
-    const Hypothesis &cur_hypo,
+    const Hypothesis *prev_hypo,
     const TargetPhrase &targetPhrase,
     int current_word_index,
     std::vector<int> &words) const;
 
   size_t getState(const Hypothesis &cur_hypo) const;
 
-  void requestPrevTargetNgrams(const Hypothesis &cur_hypo, int amount, std::vector<int> &words) const;
+  void requestPrevTargetNgrams(const Hypothesis *prev_hypo, int amount, std::vector<int> &words) const;
+
+  //Appends the n-grams of every word of targetPhrase, applied over
+  //sourceWordRange after prev_hypo, to ngrams.
+  void getPhraseNgrams(
+    const Hypothesis *prev_hypo,
+    const TargetPhrase &targetPhrase,
+    const Sentence &source_sent,
+    const WordsRange &sourceWordRange,
+    std::vector<int> &ngrams) const;
 
   //Chart decoder
   void getTargetWordsChart(
@@ -134,6 +153,8 @@ public:
     const FFState* prev_state,
     ScoreComponentCollection* accumulator) const;
 
+  void PrefetchWhenApplied(const std::vector<HypothesisExpansion>& expansions) const;
+
   FFState* EvaluateWhenApplied(
     const ChartHypothesis& cur_hypo ,
     int featureID, /* - used to index the state in the previous hypotheses */
@@ -145,6 +145,9 @@ private:
 template <class Model> LanguageModelKen<Model>::LanguageModelKen(const std::string &line, const std::string &file, FactorType factorType, bool lazy)
   :LanguageModel(line)
   ,m_factorType(factorType)
+  ,m_queryCacheSize(0)
+  ,m_queryCacheHits(0)
+  ,m_queryCacheMisses(0)
 {
   ReadParameters();
 
@@ -171,10 +174,65 @@ template <class Model> LanguageModelKen<Model>::LanguageModelKen(const LanguageM
 // TODO: don't copy this.
    m_beginSentenceFactor(copy_from.m_beginSentenceFactor),
    m_factorType(copy_from.m_factorType),
-   m_lmIdLookup(copy_from.m_lmIdLookup)
+   m_lmIdLookup(copy_from.m_lmIdLookup),
+   m_queryCacheSize(copy_from.m_queryCacheSize),
+   m_queryCacheHits(0),
+   m_queryCacheMisses(0)
 {
 }
 
+template <class Model> LanguageModelKen<Model>::~LanguageModelKen()
+{
+  if (m_queryCacheSize) {
+    uint64_t hits, misses;
+    GetQueryCacheStats(hits, misses);
+    VERBOSE(1, GetScoreProducerDescription() << " query cache: " << hits << " hits, "
+            << misses << " misses, hit rate "
+            << (hits + misses ? 100.0 * hits / (hits + misses) : 0.0) << "%" << std::endl);
+  }
+}
+
+template <class Model> void LanguageModelKen<Model>::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "query-cache") {
+    m_queryCacheSize = Scan<size_t>(value);
+  } else {
+    LanguageModel::SetParameter(key, value);
+  }
+}
+
+template <class Model> typename LanguageModelKen<Model>::QueryCache &LanguageModelKen<Model>::GetQueryCache() const
+{
+  QueryCache *cache = m_queryCache.get();
+  if (!cache) {
+    cache = new QueryCache(*m_ngram, m_queryCacheSize);
+    m_queryCache.reset(cache);
+  }
+  return *cache;
+}
+
+template <class Model> void LanguageModelKen<Model>::CleanUpAfterSentenceProcessing(const InputType& source)
+{
+  QueryCache *cache = m_queryCache.get();
+  if (!cache) return;
+  // The entries stay: LM states mean the same in every sentence.
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_queryCacheStatsMutex);
+#endif
+  m_queryCacheHits += cache->Hits();
+  m_queryCacheMisses += cache->Misses();
+  cache->ResetCounters();
+}
+
+template <class Model> void LanguageModelKen<Model>::GetQueryCacheStats(uint64_t &hits, uint64_t &misses) const
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_queryCacheStatsMutex);
+#endif
+  hits = m_queryCacheHits;
+  misses = m_queryCacheMisses;
+}
+
 template <class Model> const FFState * LanguageModelKen<Model>::EmptyHypothesisState(const InputType &/*input*/) const
 {
   KenLMState *ret = new KenLMState();
@@ -253,10 +311,10 @@ template <class Model> FFState *LanguageModelKen<Model>::EvaluateWhenApplied(con
   typename Model::State aux_state;
   typename Model::State *state0 = &ret->state, *state1 = &aux_state;
 
-  float score = m_ngram->Score(in_state, TranslateID(hypo.GetWord(position)), *state0);
+  float score = Score(in_state, TranslateID(hypo.GetWord(position)), *state0);
   ++position;
   for (; position < adjust_end; ++position) {
-    score += m_ngram->Score(*state0, TranslateID(hypo.GetWord(position)), *state1);
+    score += Score(*state0, TranslateID(hypo.GetWord(position)), *state1);
     std::swap(state0, state1);
   }
 
@@ -307,6 +365,10 @@ public:
     return ret;
   }
 
+  size_t Hash() const {
+    return hash_value(m_state);
+  }
+
 private:
   lm::ngram::ChartState m_state;
 };
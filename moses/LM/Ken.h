@@ -24,7 +24,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <string>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/tss.hpp>
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
+#include "lm/query_cache.hh"
+#include "lm/state.hh"
 #include "lm/word_index.hh"
 
 #include "moses/LM/Base.h"
@@ -45,11 +52,17 @@ LanguageModel *ConstructKenLM(const std::string &line, const std::string &file,
 
 /*
  * An implementation of single factor LM using Kenneth's code.
+ *
+ * With query-cache=N, phrase-based decoding looks up (state, word) pairs in
+ * a per-thread direct-mapped cache of N entries before asking the model.
  */
 template <class Model> class LanguageModelKen : public LanguageModel
 {
 public:
   LanguageModelKen(const std::string &line, const std::string &file, FactorType factorType, bool lazy);
+  ~LanguageModelKen();
+
+  void SetParameter(const std::string& key, const std::string& value);
 
   virtual const FFState *EmptyHypothesisState(const InputType &/*input*/) const;
 
@@ -61,12 +74,21 @@ public:
 
   virtual FFState *EvaluateWhenApplied(const Syntax::SHyperedge& hyperedge, int featureID, ScoreComponentCollection *accumulator) const;
 
+  virtual bool EvaluatesHyperedges() const {
+    return true;
+  }
+
   virtual void IncrementalCallback(Incremental::Manager &manager) const;
   virtual void ReportHistoryOrder(std::ostream &out,const Phrase &phrase) const;
 
   virtual bool IsUseable(const FactorMask &mask) const;
 
+  //! Hits and misses of the query caches of all threads, over the sentences finished so far.
+  void GetQueryCacheStats(uint64_t &hits, uint64_t &misses) const;
+
 protected:
+  void CleanUpAfterSentenceProcessing(const InputType& source);
+
   boost::shared_ptr<Model> m_ngram;
 
   const Factor *m_beginSentenceFactor;
@@ -78,7 +100,17 @@ protected:
     return (factor >= m_lmIdLookup.size() ? 0 : m_lmIdLookup[factor]);
   }
 
+  // m_ngram->Score, through this thread's query cache if there is one.
+  float Score(const lm::ngram::State &in_state, lm::WordIndex word, lm::ngram::State &out_state) const {
+    if (!m_queryCacheSize) return m_ngram->Score(in_state, word, out_state);
+    return GetQueryCache().Score(in_state, word, out_state);
+  }
+
 private:
+  typedef lm::ngram::QueryCache<Model> QueryCache;
+
+  QueryCache &GetQueryCache() const;
+
   LanguageModelKen(const LanguageModelKen<Model> &copy_from);
 
   // Convert last words of hypothesis into vocab ids, returning an end pointer.
@@ -98,6 +130,16 @@ private:
 
   std::vector<lm::WordIndex> m_lmIdLookup;
 
+  // entries in each thread's cache of (state, word) queries, 0 for none
+  size_t m_queryCacheSize;
+  mutable boost::thread_specific_ptr<QueryCache> m_queryCache;
+
+  // counters of the per-thread caches, added up after every sentence
+  uint64_t m_queryCacheHits, m_queryCacheMisses;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_queryCacheStatsMutex;
+#endif
+
 };
 
 } // namespace Moses
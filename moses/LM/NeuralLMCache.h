@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace Moses
+{
+
+/** Exact cache of neural LM scores, keyed by the n-gram's id sequence.
+ * Meant to be thread-specific and cleared after every sentence, when the
+ * contexts it has seen are unlikely to come back.
+ *
+ * Besides lookups, it collects the n-grams of a batch that are not in the
+ * cache, deduplicated, so the caller can score all of them with one matrix
+ * product and hand the scores back through Fill().
+ */
+class NeuralLMCache
+{
+public:
+  typedef std::vector<int> Ngram;
+
+  NeuralLMCache() : m_hits(0), m_queries(0) {}
+
+  //! Look up every n-gram of a batch laid out back to back, order ids each.
+  //! Uncached n-grams are queued in Misses(); their scores are set by Fill().
+  void Lookup(const std::vector<int> &ngrams, size_t order, std::vector<float> &scores) {
+    const size_t num = order ? ngrams.size() / order : 0;
+    scores.resize(num);
+    m_misses.clear();
+    m_missIndex.clear();
+    m_slots.clear();
+    for (size_t i = 0; i < num; ++i) {
+      Ngram key(ngrams.begin() + i * order, ngrams.begin() + (i + 1) * order);
+      ++m_queries;
+      Map::const_iterator found = m_scores.find(key);
+      if (found != m_scores.end()) {
+        ++m_hits;
+        scores[i] = found->second;
+        continue;
+      }
+      // repeated within this batch: score it only once
+      std::pair<Pending::iterator, bool> pending = m_missIndex.insert(std::make_pair(key, m_missIndex.size()));
+      if (pending.second) {
+        m_misses.insert(m_misses.end(), key.begin(), key.end());
+      }
+      m_slots.push_back(std::make_pair(i, pending.first->second));
+    }
+  }
+
+  //! distinct uncached n-grams of the last Lookup(), back to back
+  const std::vector<int> &Misses() const {
+    return m_misses;
+  }
+
+  //! store the scores of Misses() and complete the scores of the last Lookup()
+  void Fill(const std::vector<float> &missScores, std::vector<float> &scores) {
+    for (Pending::const_iterator i = m_missIndex.begin(); i != m_missIndex.end(); ++i) {
+      m_scores[i->first] = missScores[i->second];
+    }
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+      scores[m_slots[i].first] = missScores[m_slots[i].second];
+    }
+    m_slots.clear();
+  }
+
+  void Clear() {
+    m_scores.clear();
+    m_misses.clear();
+    m_missIndex.clear();
+    m_slots.clear();
+  }
+
+  size_t Size() const {
+    return m_scores.size();
+  }
+  size_t Hits() const {
+    return m_hits;
+  }
+  size_t Queries() const {
+    return m_queries;
+  }
+
+private:
+  typedef boost::unordered_map<Ngram, float, boost::hash<Ngram> > Map;
+  typedef boost::unordered_map<Ngram, size_t, boost::hash<Ngram> > Pending;
+
+  Map m_scores;
+
+  // state of the current batch
+  std::vector<int> m_misses;
+  Pending m_missIndex;
+  std::vector<std::pair<size_t, size_t> > m_slots; // (batch position, miss index)
+
+  size_t m_hits, m_queries;
+};
+
+}
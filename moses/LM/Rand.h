@@ -42,6 +42,10 @@ public:
   void Load();
   virtual LMResult GetValue(const std::vector<const Word*> &contextFactor, State* finalState = NULL) const;
   void InitializeForInput(ttasksptr const& ttask);
+  //! RandLM sets up its thread specific data in InitializeForInput()
+  bool KeepsThreadLocalInputState() const {
+    return true;
+  }
   void CleanUpAfterSentenceProcessing(const InputType& source);
 
 protected:
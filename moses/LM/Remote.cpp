@@ -1,149 +1,446 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <unistd.h>
 #include <sys/types.h>
 #include "Remote.h"
+#include "RemoteProtocol.h"
 #include "moses/Factor.h"
+#include "moses/FactorCollection.h"
+#include "moses/FF/FFState.h"
+#include "moses/Hypothesis.h"
+#include "moses/StaticData.h"
+#include "moses/Util.h"
+#include "util/file.hh"
 
 #if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
 #include <arpa/inet.h>
 #endif
 
+using namespace std;
+
 namespace Moses
 {
 
-const Factor* LanguageModelRemote::BOS = NULL;
-const Factor* LanguageModelRemote::EOS = (LanguageModelRemote::BOS + 1);
+/** The words, at most order - 1 of them, that the next n-gram after a
+ * hypothesis is conditioned on. Compared word by word: hashing the words
+ * instead would let hypotheses with different contexts recombine whenever
+ * their hashes collide.
+ */
+class LanguageModelRemote::RemoteState : public FFState
+{
+public:
+  NGram context;
+
+  int Compare(const FFState &o) const {
+    const NGram &other = static_cast<const RemoteState&>(o).context;
+    if (context == other) return 0;
+    return context < other ? -1 : 1;
+  }
+
+  size_t Hash() const {
+    return boost::hash_value(context);
+  }
+};
 
-bool LanguageModelRemote::Load(const std::string &filePath
-                               , FactorType factorType
-                               , size_t nGramOrder)
+/** One client connection with its own numbering of the words declared so
+ * far. Only ever used by the thread that opened it.
+ */
+class LanguageModelRemote::Connection
 {
-  m_factorType    = factorType;
-  m_nGramOrder    = nGramOrder;
+public:
+  Connection(const string &host, int port);
 
-  int cutAt = filePath.find(':',0);
-  std::string host = filePath.substr(0,cutAt);
-  //std::cerr << "port string = '" << filePath.substr(cutAt+1,filePath.size()-cutAt) << "'\n";
-  int port = atoi(filePath.substr(cutAt+1,filePath.size()-cutAt).c_str());
-  bool good = start(host,port);
-  if (!good) {
-    std::cerr << "failed to connect to lm server on " << host << " on port " << port << std::endl;
+  unsigned char ServerOrder() const {
+    return m_serverOrder;
   }
-  ClearSentenceCache();
-  return good;
+
+  void Query(const vector<NGram> &ngrams, size_t batchSize, size_t maxInFlight, vector<Entry> &results);
+
+private:
+  void Connect(const string &host, int port);
+  void AddQuery(const vector<NGram> &ngrams, size_t begin, size_t end, uint32_t id);
+
+  util::scoped_fd m_fd;
+  boost::unordered_map<const Factor*, uint32_t> m_vocab;
+  uint32_t m_nextId;
+  unsigned char m_serverOrder;
+
+  RemoteLMProtocol::MessageWriter m_out;
+  RemoteLMProtocol::MessageReader m_in;
+};
+
+LanguageModelRemote::Connection::Connection(const string &host, int port)
+  : m_nextId(0)
+  , m_serverOrder(0)
+{
+  Connect(host, port);
+
+  m_out.Begin(RemoteLMProtocol::kHello);
+  m_out.PutUint32(RemoteLMProtocol::kMagic);
+  m_out.PutUint32(RemoteLMProtocol::kVersion);
+  m_out.End();
+  m_out.Send(m_fd.get());
+
+  RemoteLMProtocol::MessageType type;
+  UTIL_THROW_IF2(!m_in.Receive(m_fd.get(), type) || type != RemoteLMProtocol::kHello,
+                 "LM server on " << host << ":" << port << " did not answer the hello");
+  UTIL_THROW_IF2(m_in.Uint32() != RemoteLMProtocol::kMagic,
+                 host << ":" << port << " is not a remote LM server");
+  uint32_t version = m_in.Uint32();
+  UTIL_THROW_IF2(version != RemoteLMProtocol::kVersion,
+                 "LM server on " << host << ":" << port << " speaks protocol version " << version
+                 << " but this Moses speaks version " << RemoteLMProtocol::kVersion);
+  m_serverOrder = m_in.Uint8();
 }
 
+void LanguageModelRemote::Connection::Connect(const string &host, int port)
+{
+  struct addrinfo hints, *addresses;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  int ret = getaddrinfo(host.c_str(), SPrint(port).c_str(), &hints, &addresses);
+  UTIL_THROW_IF2(ret, "Cannot resolve LM server " << host << ": " << gai_strerror(ret));
 
-bool LanguageModelRemote::start(const std::string& host, int port)
+  // the server may still be loading its model
+  for (int attempt = 0; m_fd.get() == -1 && attempt <= 5; ++attempt) {
+    if (attempt) sleep(1);
+    for (struct addrinfo *a = addresses; a; a = a->ai_next) {
+      util::scoped_fd fd(socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+      if (fd.get() == -1) continue;
+      if (connect(fd.get(), a->ai_addr, a->ai_addrlen) == 0) {
+        m_fd.reset(fd.release());
+        break;
+      }
+    }
+  }
+  freeaddrinfo(addresses);
+  UTIL_THROW_IF2(m_fd.get() == -1, "Failed to connect to LM server on " << host << " on port " << port);
+
+  // queries are small and we wait for every answer
+  int one = 1;
+  setsockopt(m_fd.get(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void LanguageModelRemote::Connection::AddQuery(const vector<NGram> &ngrams, size_t begin, size_t end, uint32_t id)
 {
-  //std::cerr << "host = " << host << ", port = " << port << "\n";
-  sock = socket(AF_INET, SOCK_STREAM, 0);
-  hp = gethostbyname(host.c_str());
-  if (hp==NULL) {
-#if defined(_WIN32) || defined(_WIN64)
-    fprintf(stderr, "gethostbyname failed\n");
-#else
-    herror("gethostbyname failed");
-#endif
-    exit(1);
+  // declare the words the server hasn't seen on this connection
+  vector<const Factor*> newWords;
+  for (size_t i = begin; i < end; ++i) {
+    for (size_t j = 0; j < ngrams[i].size(); ++j) {
+      if (m_vocab.insert(make_pair(ngrams[i][j], m_nextId)).second) {
+        newWords.push_back(ngrams[i][j]);
+        ++m_nextId;
+      }
+    }
+  }
+  if (!newWords.empty()) {
+    m_out.Begin(RemoteLMProtocol::kVocab);
+    m_out.PutUint32(newWords.size());
+    for (size_t i = 0; i < newWords.size(); ++i) {
+      const StringPiece word = newWords[i]->GetString();
+      m_out.PutString(word.data(), word.size());
+    }
+    m_out.End();
+  }
+
+  m_out.Begin(RemoteLMProtocol::kQuery);
+  m_out.PutUint32(id);
+  m_out.PutUint32(end - begin);
+  for (size_t i = begin; i < end; ++i) {
+    m_out.PutUint8(ngrams[i].size());
+    for (size_t j = 0; j < ngrams[i].size(); ++j) {
+      m_out.PutUint32(m_vocab[ngrams[i][j]]);
+    }
+  }
+  m_out.End();
+}
+
+void LanguageModelRemote::Connection::Query(const vector<NGram> &ngrams, size_t batchSize, size_t maxInFlight, vector<Entry> &results)
+{
+  results.resize(ngrams.size());
+
+  // (query id, first n-gram) of the queries sent but not answered yet
+  deque<pair<uint32_t, size_t> > inFlight;
+  size_t sent = 0, answered = 0;
+  uint32_t nextQuery = 0;
+  while (answered < ngrams.size()) {
+    while (sent < ngrams.size() && inFlight.size() < maxInFlight) {
+      size_t end = min(sent + batchSize, ngrams.size());
+      AddQuery(ngrams, sent, end, nextQuery);
+      inFlight.push_back(make_pair(nextQuery++, sent));
+      sent = end;
+    }
+    if (!m_out.Empty()) m_out.Send(m_fd.get());
+
+    // answers come in the order of the queries
+    RemoteLMProtocol::MessageType type;
+    UTIL_THROW_IF2(!m_in.Receive(m_fd.get(), type), "LM server closed the connection");
+    UTIL_THROW_IF2(type != RemoteLMProtocol::kResult, "Unexpected message from LM server");
+    UTIL_THROW_IF2(m_in.Uint32() != inFlight.front().first, "LM server answered out of order");
+    const size_t begin = inFlight.front().second;
+    const size_t count = m_in.Uint32();
+    UTIL_THROW_IF2(count != min(batchSize, ngrams.size() - begin), "LM server answered the wrong number of n-grams");
+    for (size_t i = begin; i < begin + count; ++i) {
+      results[i].score = m_in.Float();
+      results[i].unknown = m_in.Uint8();
+    }
+    answered += count;
+    inFlight.pop_front();
   }
+}
 
-  memset(&server, '\0', sizeof(server));
-  memcpy((char *)&server.sin_addr, hp->h_addr, hp->h_length);
-  server.sin_family = hp->h_addrtype;
-  server.sin_port = htons(port);
+LanguageModelRemote::LanguageModelRemote(const std::string &line)
+  :LanguageModelSingleFactor(line)
+  ,m_port(0)
+  ,m_batchSize(1024)
+  ,m_maxInFlight(4)
+  ,m_cacheSize(1000000)
+{
+  ReadParameters();
+
+  FactorCollection &factorCollection = FactorCollection::Instance();
+  m_sentenceStart = factorCollection.AddFactor(Output, m_factorType, BOS_);
+  m_sentenceStartWord[m_factorType] = m_sentenceStart;
+  m_sentenceEnd = factorCollection.AddFactor(Output, m_factorType, EOS_);
+  m_sentenceEndWord[m_factorType] = m_sentenceEnd;
+
+  m_nullContext.reset(new RemoteState());
+  m_beginSentence.reset(new RemoteState());
+  m_beginSentence->context.push_back(m_sentenceStart);
+}
+
+LanguageModelRemote::~LanguageModelRemote()
+{
+}
 
-  int errors = 0;
-  while (connect(sock, (struct sockaddr *)&server, sizeof(server)) < 0) {
-    //std::cerr << "Error: connect()\n";
-    sleep(1);
-    errors++;
-    if (errors > 5) return false;
+void LanguageModelRemote::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "batch-size") {
+    m_batchSize = Scan<size_t>(value);
+    UTIL_THROW_IF2(m_batchSize == 0, "batch-size must be at least 1");
+  } else if (key == "in-flight") {
+    m_maxInFlight = Scan<size_t>(value);
+    UTIL_THROW_IF2(m_maxInFlight == 0, "in-flight must be at least 1");
+  } else if (key == "cache-size") {
+    m_cacheSize = Scan<size_t>(value);
+    UTIL_THROW_IF2(m_cacheSize < 2, "cache-size must be at least 2");
+  } else {
+    LanguageModelSingleFactor::SetParameter(key, value);
+  }
+}
+
+void LanguageModelRemote::Load()
+{
+  size_t cutAt = m_filePath.rfind(':');
+  UTIL_THROW_IF2(cutAt == string::npos, "Remote LM path must be host:port, not " << m_filePath);
+  m_host = m_filePath.substr(0, cutAt);
+  m_port = Scan<int>(m_filePath.substr(cutAt + 1));
+
+  // fail at startup rather than in the first sentence
+  const Connection &connection = GetConnection();
+  if (connection.ServerOrder() < m_nGramOrder) {
+    VERBOSE(1, "LM server on " << m_filePath << " has order " << (int) connection.ServerOrder()
+            << ", scoring " << m_nGramOrder << "-grams as " << (int) connection.ServerOrder() << "-grams" << endl);
   }
+}
+
+LanguageModelRemote::Connection &LanguageModelRemote::GetConnection() const
+{
+  Connection *connection = m_connection.get();
+  if (!connection) {
+    connection = new Connection(m_host, m_port);
+    m_connection.reset(connection);
+  }
+  return *connection;
+}
+
+LanguageModelRemote::NGram LanguageModelRemote::MakeNGram(const std::vector<const Word*> &contextFactor) const
+{
+  const size_t order = min(contextFactor.size(), m_nGramOrder);
+  NGram ngram(order);
+  for (size_t i = 0; i < order; ++i) {
+    ngram[i] = contextFactor[contextFactor.size() - order + i]->GetFactor(m_factorType);
+  }
+  return ngram;
+}
+
+bool LanguageModelRemote::Find(const NGram &ngram, Entry &entry) const
+{
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> lock(m_cacheMutex);
+#endif
+  Cache::const_iterator found = m_cache.find(ngram);
+  if (found == m_cache.end()) {
+    found = m_oldCache.find(ngram);
+    if (found == m_oldCache.end()) return false;
+  }
+  entry = found->second;
   return true;
 }
 
+size_t LanguageModelRemote::CacheSize() const
+{
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> lock(m_cacheMutex);
+#endif
+  return m_cache.size() + m_oldCache.size();
+}
+
+void LanguageModelRemote::Fetch(const std::vector<NGram> &ngrams, std::vector<Entry> &entries) const
+{
+  GetConnection().Query(ngrams, m_batchSize, m_maxInFlight, entries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].score = FloorScore(TransformLMScore(entries[i].score));
+  }
+
+#ifdef WITH_THREADS
+  boost::unique_lock<boost::shared_mutex> lock(m_cacheMutex);
+#endif
+  // another thread may have got there first, which is fine: same scores
+  for (size_t i = 0; i < ngrams.size(); ++i) {
+    m_cache.insert(make_pair(ngrams[i], entries[i]));
+    if (m_cache.size() >= m_cacheSize / 2) {
+      m_oldCache.swap(m_cache);
+      m_cache.clear();
+    }
+  }
+}
+
+void LanguageModelRemote::Prefetch(const std::vector<NGram> &ngrams) const
+{
+  vector<NGram> missing;
+  {
+#ifdef WITH_THREADS
+    boost::shared_lock<boost::shared_mutex> lock(m_cacheMutex);
+#endif
+    for (size_t i = 0; i < ngrams.size(); ++i) {
+      if (!m_cache.count(ngrams[i]) && !m_oldCache.count(ngrams[i])) missing.push_back(ngrams[i]);
+    }
+  }
+  if (missing.empty()) return;
+  sort(missing.begin(), missing.end());
+  missing.erase(unique(missing.begin(), missing.end()), missing.end());
+
+  vector<Entry> entries;
+  Fetch(missing, entries);
+}
+
 LMResult LanguageModelRemote::GetValue(const std::vector<const Word*> &contextFactor, State* finalState) const
 {
   LMResult ret;
   ret.unknown = false;
-  size_t count = contextFactor.size();
-  if (count == 0) {
+  if (contextFactor.empty()) {
     if (finalState) *finalState = NULL;
     ret.score = 0.0;
     return ret;
   }
-  //std::cerr << "contextFactor.size() = " << count << "\n";
-  size_t max = m_nGramOrder;
-  const FactorType factor = GetFactorType();
-  if (max > count) max = count;
-
-  Cache* cur = &m_cache;
-  int pc = static_cast<int>(count) - 1;
-  for (int i = 0; i < pc; ++i) {
-    const Factor* f = contextFactor[i]->GetFactor(factor);
-    cur = &cur->tree[f ? f : BOS];
-  }
-  const Factor* event_word = contextFactor[pc]->GetFactor(factor);
-  cur = &cur->tree[event_word ? event_word : EOS];
-  if (cur->prob) {
-    if (finalState) *finalState = cur->boState;
-    ret.score = cur->prob;
-    return ret;
+
+  NGram ngram = MakeNGram(contextFactor);
+  Entry entry;
+  if (!Find(ngram, entry)) {
+    // a prefetched n-gram may have been dropped again by a busy cache
+    vector<Entry> entries;
+    Fetch(vector<NGram>(1, ngram), entries);
+    entry = entries[0];
   }
-  cur->boState = *reinterpret_cast<const State*>(&m_curId);
-  ++m_curId;
 
-  std::ostringstream os;
-  os << "prob ";
-  if (event_word == NULL) {
-    os << "</s>";
-  } else {
-    os << event_word->GetString();
-  }
-  for (size_t i=1; i<max; i++) {
-    const Factor* f = contextFactor[count-1-i]->GetFactor(factor);
-    if (f == NULL) {
-      os << " <s>";
-    } else {
-      os << ' ' << f->GetString();
-    }
+  if (finalState) *finalState = NULL;
+  ret.score = entry.score;
+  ret.unknown = entry.unknown;
+  return ret;
+}
+
+const FFState *LanguageModelRemote::GetNullContextState() const
+{
+  return m_nullContext.get();
+}
+
+const FFState *LanguageModelRemote::GetBeginSentenceState() const
+{
+  return m_beginSentence.get();
+}
+
+FFState *LanguageModelRemote::NewState(const FFState *from) const
+{
+  return from ? new RemoteState(static_cast<const RemoteState&>(*from)) : new RemoteState();
+}
+
+LMResult LanguageModelRemote::GetValueForgotState(const std::vector<const Word*> &contextFactor, FFState &outState) const
+{
+  LMResult ret = GetValue(contextFactor);
+
+  NGram &context = static_cast<RemoteState&>(outState).context;
+  const size_t size = min(contextFactor.size(), m_nGramOrder - 1);
+  context.resize(size);
+  for (size_t i = 0; i < size; ++i) {
+    context[i] = contextFactor[contextFactor.size() - size + i]->GetFactor(m_factorType);
   }
-  os << std::endl;
-  std::string out = os.str();
-  write(sock, out.c_str(), out.size());
-  char res[6];
-  int r = read(sock, res, 6);
-  int errors = 0;
-  int cnt = 0;
-  while (1) {
-    if (r < 0) {
-      errors++;
-      sleep(1);
-      //std::cerr << "Error: read()\n";
-      if (errors > 5) exit(1);
-    } else if (r==0 || res[cnt] == '\n') {
-      break;
-    } else {
-      cnt += r;
-      if (cnt==6) break;
-      read(sock, &res[cnt], 6-cnt);
+  return ret;
+}
+
+void LanguageModelRemote::CalcScore(const Phrase &phrase, float &fullScore, float &ngramScore, size_t &oovCount) const
+{
+  // the n-grams LanguageModelImplementation::CalcScore will ask for
+  vector<NGram> ngrams;
+  vector<const Word*> contextFactor;
+  contextFactor.reserve(GetNGramOrder());
+  for (size_t pos = 0; pos < phrase.GetSize(); ++pos) {
+    const Word &word = phrase.GetWord(pos);
+    if (word.IsNonTerminal()) {
+      contextFactor.clear();
+      continue;
+    }
+    if (contextFactor.size() == GetNGramOrder()) {
+      contextFactor.erase(contextFactor.begin());
+    }
+    contextFactor.push_back(&word);
+    if (word != GetSentenceStartWord()) {
+      ngrams.push_back(MakeNGram(contextFactor));
     }
   }
-  cur->prob = FloorScore(TransformLMScore(*reinterpret_cast<float*>(res)));
-  if (finalState) {
-    *finalState = cur->boState;
-  }
-  ret.score = cur->prob;
-  return ret;
+  Prefetch(ngrams);
+
+  LanguageModelImplementation::CalcScore(phrase, fullScore, ngramScore, oovCount);
 }
 
-LanguageModelRemote::~LanguageModelRemote()
+FFState *LanguageModelRemote::EvaluateWhenApplied(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out) const
 {
-  // Step 8 When finished send all lingering transmissions and close the connection
-  close(sock);
+  // the n-grams across the phrase boundary and at the end of the sentence,
+  // as LanguageModelImplementation::EvaluateWhenApplied will ask for them
+  const size_t order = GetNGramOrder();
+  if (order > 1 && hypo.GetCurrTargetLength()) {
+    vector<NGram> ngrams;
+    vector<const Word*> contextFactor(order);
+    const int startPos = hypo.GetCurrTargetWordsRange().GetStartPos();
+    const int endPos = min(startPos + order - 2, hypo.GetCurrTargetWordsRange().GetEndPos());
+    for (int currPos = startPos; currPos <= endPos; ++currPos) {
+      for (size_t i = 0; i < order; ++i) {
+        int pos = currPos - (int) order + 1 + (int) i;
+        contextFactor[i] = pos >= 0 ? &hypo.GetWord(pos) : &GetSentenceStartWord();
+      }
+      ngrams.push_back(MakeNGram(contextFactor));
+    }
+    if (hypo.IsSourceCompleted()) {
+      const int size = hypo.GetSize();
+      for (size_t i = 0; i + 1 < order; ++i) {
+        int pos = size - (int) order + 1 + (int) i;
+        contextFactor[i] = pos >= 0 ? &hypo.GetWord(pos) : &GetSentenceStartWord();
+      }
+      contextFactor.back() = &GetSentenceEndWord();
+      ngrams.push_back(MakeNGram(contextFactor));
+    }
+    Prefetch(ngrams);
+  }
+
+  return LanguageModelImplementation::EvaluateWhenApplied(hypo, ps, out);
 }
 
 }
@@ -1,52 +1,102 @@
 #ifndef moses_LanguageModelRemote_h
 #define moses_LanguageModelRemote_h
 
+#include <string>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/unordered_map.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#endif
+
 #include "SingleFactor.h"
 #include "moses/TypeDef.h"
 #include "moses/Factor.h"
-#include <sys/types.h>
-
-#if defined(_WIN32) || defined(_WIN64)
-#include <winsock2.h>
-#else
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netdb.h>
-#endif
 
 namespace Moses
 {
 
-/** @todo ask miles
+/** Language model queried over TCP from a server such as remoteLMServer,
+ * speaking the binary protocol of RemoteLMProtocol.
+ *
+ * The path is host:port. Every thread has its own connection. The n-grams
+ * of a phrase or of a hypothesis extension are sent as one batch, split into
+ * queries of at most batch-size n-grams of which up to in-flight are
+ * outstanding at a time. Scores are kept in a cache of at most cache-size
+ * n-grams shared by all threads. The LM state of a hypothesis is the words
+ * the next n-gram is conditioned on, so only equal contexts recombine.
  */
 class LanguageModelRemote : public LanguageModelSingleFactor
 {
-private:
-  struct Cache {
-    std::map<const Factor*, Cache> tree;
-    float prob;
-    State boState;
-    Cache() : prob(0) {}
-  };
-
-  int sock, port;
-  struct hostent *hp;
-  struct sockaddr_in server;
-  mutable size_t m_curId;
-  mutable Cache m_cache;
-  bool start(const std::string& host, int port);
-  static const Factor* BOS;
-  static const Factor* EOS;
 public:
+  LanguageModelRemote(const std::string &line);
   ~LanguageModelRemote();
-  void ClearSentenceCache() {
-    m_cache.tree.clear();
-    m_curId = 1000;
-  }
+
+  void Load();
+  void SetParameter(const std::string& key, const std::string& value);
+
+  //! the score only. finalState, if given, is set to NULL: see RemoteState
   virtual LMResult GetValue(const std::vector<const Word*> &contextFactor, State* finalState = 0) const;
-  bool Load(const std::string &filePath
-            , FactorType factorType
-            , size_t nGramOrder);
+
+  const FFState *GetNullContextState() const;
+  const FFState *GetBeginSentenceState() const;
+  FFState *NewState(const FFState *from = NULL) const;
+  LMResult GetValueForgotState(const std::vector<const Word*> &contextFactor, FFState &outState) const;
+
+  void CalcScore(const Phrase &phrase, float &fullScore, float &ngramScore, size_t &oovCount) const;
+
+  //! number of n-gram scores currently cached
+  size_t CacheSize() const;
+
+  using LanguageModelImplementation::EvaluateWhenApplied;
+  FFState *EvaluateWhenApplied(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out) const;
+
+private:
+  typedef std::vector<const Factor*> NGram;
+
+  struct Entry {
+    float score;
+    bool unknown;
+  };
+
+  typedef boost::unordered_map<NGram, Entry, boost::hash<NGram> > Cache;
+
+  class Connection;
+  class RemoteState;
+
+  Connection &GetConnection() const;
+  NGram MakeNGram(const std::vector<const Word*> &contextFactor) const;
+
+  // look up an n-gram in the cache. Returns false if it isn't there
+  bool Find(const NGram &ngram, Entry &entry) const;
+
+  // ask the server for n-grams, and cache the answers
+  void Fetch(const std::vector<NGram> &ngrams, std::vector<Entry> &entries) const;
+
+  // ask the server for those n-grams that aren't cached yet
+  void Prefetch(const std::vector<NGram> &ngrams) const;
+
+  std::string m_host;
+  int m_port;
+  size_t m_batchSize, m_maxInFlight;
+  size_t m_cacheSize;
+
+  // Two generations, so the cache holds at most cache-size n-grams: once the
+  // current one holds half of them it replaces the old one, which is dropped.
+  // LM states hold their own copy of the context, not pointers into the cache.
+  mutable Cache m_cache, m_oldCache;
+#ifdef WITH_THREADS
+  mutable boost::shared_mutex m_cacheMutex;
+#endif
+
+  mutable boost::thread_specific_ptr<Connection> m_connection;
+
+  boost::scoped_ptr<RemoteState> m_nullContext, m_beginSentence;
 };
 
 }
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <arpa/inet.h>
+#endif
+
+#include "util/exception.hh"
+#include "util/file.hh"
+
+namespace Moses
+{
+
+/** Wire format shared by LanguageModelRemote and the remote LM server.
+ *
+ * Every message is a frame: the length of the body (uint32), a type byte,
+ * then the body. All integers are in network byte order, floats are sent as
+ * the bits of an IEEE float in a uint32.
+ *
+ * A connection opens with a hello from the client (magic, version), which the
+ * server answers with its own hello (magic, version, order of its model).
+ * Words are not sent with every n-gram: the client first declares new words
+ * in a vocab message, and both sides number them from 0 in the order they are
+ * declared on that connection. A query carries a batch of n-grams as word
+ * ids, oldest word first and the predicted word last. The server answers
+ * every query in order with a result holding the query's id and, for every
+ * n-gram, its log10 probability and whether the predicted word is unknown.
+ * A client may have several queries in flight on one connection.
+ */
+namespace RemoteLMProtocol
+{
+
+const uint32_t kMagic = 0x4d4c4d52; // "RMLM"
+const uint32_t kVersion = 1;
+
+// bodies are bounded so that a corrupt length can't make us allocate gigabytes
+const uint32_t kMaxBody = 1 << 28;
+
+enum MessageType {
+  kHello = 'H',
+  kVocab = 'V',
+  kQuery = 'Q',
+  kResult = 'R'
+};
+
+//! builds messages, several may be appended before sending them in one write
+class MessageWriter
+{
+public:
+  void Begin(MessageType type) {
+    m_start = m_buffer.size();
+    PutUint32(0);
+    m_buffer += static_cast<char>(type);
+  }
+
+  void PutUint32(uint32_t value) {
+    value = htonl(value);
+    m_buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void PutUint8(uint8_t value) {
+    m_buffer += static_cast<char>(value);
+  }
+
+  void PutFloat(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutUint32(bits);
+  }
+
+  void PutString(const char *data, size_t size) {
+    PutUint32(size);
+    m_buffer.append(data, size);
+  }
+
+  //! fill in the length of the message started by the last Begin()
+  void End() {
+    uint32_t length = htonl(m_buffer.size() - m_start - sizeof(uint32_t) - 1);
+    memcpy(&m_buffer[m_start], &length, sizeof(length));
+  }
+
+  void Send(int fd) {
+    util::WriteOrThrow(fd, m_buffer.data(), m_buffer.size());
+    m_buffer.clear();
+  }
+
+  bool Empty() const {
+    return m_buffer.empty();
+  }
+
+private:
+  std::string m_buffer;
+  size_t m_start;
+};
+
+//! reads the body of one message, throwing if it is shorter than expected
+class MessageReader
+{
+public:
+  MessageReader() : m_at(NULL), m_end(NULL) {}
+
+  //! read the next message. Returns false if the peer closed the connection
+  bool Receive(int fd, MessageType &type) {
+    char header[sizeof(uint32_t) + 1];
+    std::size_t got = util::ReadOrEOF(fd, header, sizeof(header));
+    if (got == 0) return false;
+    UTIL_THROW_IF2(got != sizeof(header), "Connection closed in the middle of a message");
+
+    uint32_t length;
+    memcpy(&length, header, sizeof(length));
+    length = ntohl(length);
+    UTIL_THROW_IF2(length > kMaxBody, "Remote LM message of " << length << " bytes is too large");
+    type = static_cast<MessageType>(header[sizeof(uint32_t)]);
+
+    m_body.resize(length);
+    if (length) util::ReadOrThrow(fd, &m_body[0], length);
+    m_at = m_body.data();
+    m_end = m_at + length;
+    return true;
+  }
+
+  uint32_t Uint32() {
+    uint32_t value;
+    Get(&value, sizeof(value));
+    return ntohl(value);
+  }
+
+  uint8_t Uint8() {
+    uint8_t value;
+    Get(&value, sizeof(value));
+    return value;
+  }
+
+  float Float() {
+    uint32_t bits = Uint32();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  //! points into the message, valid until the next Receive()
+  const char *String(uint32_t &size) {
+    size = Uint32();
+    UTIL_THROW_IF2(size > static_cast<size_t>(m_end - m_at), "Truncated remote LM message");
+    const char *data = m_at;
+    m_at += size;
+    return data;
+  }
+
+private:
+  void Get(void *to, size_t size) {
+    UTIL_THROW_IF2(size > static_cast<size_t>(m_end - m_at), "Truncated remote LM message");
+    memcpy(to, m_at, size);
+    m_at += size;
+  }
+
+  std::string m_body;
+  const char *m_at, *m_end;
+};
+
+}
+
+}
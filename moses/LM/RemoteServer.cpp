@@ -0,0 +1,155 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "RemoteServer.h"
+#include "RemoteProtocol.h"
+#include "lm/model.hh"
+#include "util/exception.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+// log10 p(last word | the words before it). Context before the last <s> is
+// ignored, and so is context beyond the order of the model.
+float Score(const lm::base::Model &model, const vector<lm::WordIndex> &ngram, char *state, char *next)
+{
+  const lm::base::Vocabulary &vocab = model.BaseVocabulary();
+  size_t start = 0;
+  if (ngram.size() > model.Order()) start = ngram.size() - model.Order();
+  bool sentenceStart = false;
+  for (size_t i = start; i + 1 < ngram.size(); ++i) {
+    if (ngram[i] == vocab.BeginSentence()) {
+      sentenceStart = true;
+      start = i + 1;
+    }
+  }
+
+  if (sentenceStart) {
+    model.BeginSentenceWrite(state);
+  } else {
+    model.NullContextWrite(state);
+  }
+  for (size_t i = start; i + 1 < ngram.size(); ++i) {
+    model.BaseScore(state, ngram[i], next);
+    memcpy(state, next, model.StateSize());
+  }
+  return model.BaseScore(state, ngram.back(), next);
+}
+
+}
+
+RemoteLMServer::RemoteLMServer(const lm::base::Model &model, int port)
+  : m_model(model)
+  , m_listener(socket(AF_INET, SOCK_STREAM, 0))
+  , m_port(port)
+{
+  UTIL_THROW_IF(m_listener.get() == -1, util::ErrnoException, "socket");
+  int one = 1;
+  setsockopt(m_listener.get(), SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  UTIL_THROW_IF(bind(m_listener.get(), (struct sockaddr*) &address, sizeof(address)),
+                util::ErrnoException, "bind to port " << port);
+  UTIL_THROW_IF(listen(m_listener.get(), 64), util::ErrnoException, "listen");
+
+  socklen_t length = sizeof(address);
+  UTIL_THROW_IF(getsockname(m_listener.get(), (struct sockaddr*) &address, &length),
+                util::ErrnoException, "getsockname");
+  m_port = ntohs(address.sin_port);
+}
+
+void RemoteLMServer::Run()
+{
+  int one = 1;
+  while (true) {
+    int client = accept(m_listener.get(), NULL, NULL);
+    if (client == -1) continue;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    boost::thread(boost::bind(&RemoteLMServer::Serve, &m_model, client)).detach();
+  }
+}
+
+void RemoteLMServer::Serve(const lm::base::Model *model, int socket)
+{
+  util::scoped_fd fd(socket);
+  try {
+    const lm::base::Vocabulary &vocab = model->BaseVocabulary();
+    vector<lm::WordIndex> words; // this connection's word ids to the model's
+    vector<lm::WordIndex> ngram;
+    vector<char> state(model->StateSize()), next(model->StateSize());
+
+    RemoteLMProtocol::MessageReader in;
+    RemoteLMProtocol::MessageWriter out;
+    RemoteLMProtocol::MessageType type;
+    while (in.Receive(fd.get(), type)) {
+      switch (type) {
+      case RemoteLMProtocol::kHello: {
+        UTIL_THROW_IF2(in.Uint32() != RemoteLMProtocol::kMagic, "Not a remote LM client");
+        uint32_t version = in.Uint32();
+        UTIL_THROW_IF2(version != RemoteLMProtocol::kVersion,
+                       "Client speaks protocol version " << version);
+        out.Begin(RemoteLMProtocol::kHello);
+        out.PutUint32(RemoteLMProtocol::kMagic);
+        out.PutUint32(RemoteLMProtocol::kVersion);
+        out.PutUint8(model->Order());
+        out.End();
+        out.Send(fd.get());
+        break;
+      }
+      case RemoteLMProtocol::kVocab: {
+        for (uint32_t count = in.Uint32(); count; --count) {
+          uint32_t size;
+          const char *word = in.String(size);
+          words.push_back(vocab.Index(StringPiece(word, size)));
+        }
+        break;
+      }
+      case RemoteLMProtocol::kQuery: {
+        const uint32_t id = in.Uint32();
+        const uint32_t count = in.Uint32();
+        out.Begin(RemoteLMProtocol::kResult);
+        out.PutUint32(id);
+        out.PutUint32(count);
+        for (uint32_t i = 0; i < count; ++i) {
+          ngram.resize(in.Uint8());
+          UTIL_THROW_IF2(ngram.empty(), "Empty n-gram in query");
+          for (size_t j = 0; j < ngram.size(); ++j) {
+            uint32_t word = in.Uint32();
+            UTIL_THROW_IF2(word >= words.size(), "Query uses undeclared word " << word);
+            ngram[j] = words[word];
+          }
+          out.PutFloat(Score(*model, ngram, &state[0], &next[0]));
+          out.PutUint8(ngram.back() == vocab.NotFound());
+        }
+        out.End();
+        out.Send(fd.get());
+        break;
+      }
+      default:
+        UTIL_THROW2("Unknown message type " << static_cast<int>(type));
+      }
+    }
+  } catch (const std::exception &e) {
+    cerr << "Closing connection: " << e.what() << endl;
+  }
+}
+
+}
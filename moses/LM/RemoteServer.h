@@ -0,0 +1,43 @@
+#pragma once
+
+#include "util/file.hh"
+
+namespace lm
+{
+namespace base
+{
+class Model;
+}
+}
+
+namespace Moses
+{
+
+/** Serves a KenLM model to LanguageModelRemote over the binary protocol of
+ * RemoteLMProtocol, with one thread per connection. The model is only read,
+ * so all connections share it.
+ */
+class RemoteLMServer
+{
+public:
+  //! listen on port, or on any free port if it is 0
+  RemoteLMServer(const lm::base::Model &model, int port);
+
+  //! the port actually listened on
+  int Port() const {
+    return m_port;
+  }
+
+  //! accept connections until the process ends
+  void Run();
+
+  //! answer one client until it disconnects. Closes the socket
+  static void Serve(const lm::base::Model *model, int socket);
+
+private:
+  const lm::base::Model &m_model;
+  util::scoped_fd m_listener;
+  int m_port;
+};
+
+}
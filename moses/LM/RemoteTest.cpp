@@ -0,0 +1,226 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2010 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+#define BOOST_TEST_MODULE RemoteTest
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "lm/model.hh"
+
+#include "moses/FactorCollection.h"
+#include "moses/FF/FFState.h"
+#include "moses/Phrase.h"
+#include "moses/Util.h"
+#include "moses/Word.h"
+#include "moses/LM/Remote.h"
+#include "moses/LM/RemoteServer.h"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+// Apparently some Boost versions use templates and are pretty strict about types matching.
+#define SLOPPY_CHECK_CLOSE(ref, value, tol) BOOST_CHECK_CLOSE(static_cast<double>(ref), static_cast<double>(value), static_cast<double>(tol));
+
+/** The ARPA file of the command line, loaded directly and served by a
+ * RemoteLMServer on a free port of this process. The server thread runs
+ * until the process ends, so there is one server for all tests.
+ */
+class RemoteFixture
+{
+public:
+  RemoteFixture() : m_served(Served::Instance()) {}
+
+  LanguageModelRemote *Connect(const string &options) const {
+    LanguageModelRemote *lm = new LanguageModelRemote(
+      "RemoteLM path=127.0.0.1:" + SPrint(m_served.server.Port()) + " order=3 " + options);
+    lm->Load();
+    return lm;
+  }
+
+  //! log10 p(last word | the others), straight from KenLM. A leading <s> starts the sentence
+  float Direct(const vector<string> &ngram) const {
+    const lm::ngram::Model &model = m_served.model;
+    lm::ngram::State state, next;
+    size_t start = 0;
+    if (ngram[0] == "<s>") {
+      state = model.BeginSentenceState();
+      start = 1;
+    } else {
+      state = model.NullContextState();
+    }
+    float score = 0;
+    for (size_t i = start; i < ngram.size(); ++i) {
+      score = model.Score(state, model.GetVocabulary().Index(ngram[i]), next);
+      state = next;
+    }
+    return score;
+  }
+
+private:
+  struct Served {
+    explicit Served(const char *path) : model(path), server(model, 0) {
+      boost::thread(boost::bind(&RemoteLMServer::Run, &server)).detach();
+    }
+
+    static Served &Instance() {
+      static Served *served = new Served(boost::unit_test::framework::master_test_suite().argv[1]);
+      return *served;
+    }
+
+    lm::ngram::Model model;
+    RemoteLMServer server;
+  };
+
+  Served &m_served;
+};
+
+vector<string> Split(const string &text)
+{
+  return Tokenize(text, " ");
+}
+
+// the words of an n-gram the order 3 model looks at
+vector<string> LastWords(const string &text, size_t count = 3)
+{
+  vector<string> ngram = Split(text);
+  return vector<string>(ngram.end() - min<size_t>(ngram.size(), count), ngram.end());
+}
+
+vector<const Word*> MakeContext(const vector<string> &ngram, vector<Word> &words)
+{
+  words.resize(ngram.size());
+  vector<const Word*> context;
+  for (size_t i = 0; i < ngram.size(); ++i) {
+    words[i].SetFactor(0, FactorCollection::Instance().AddFactor(ngram[i]));
+    context.push_back(&words[i]);
+  }
+  return context;
+}
+
+const char *kNGrams[] = {
+  "a", "b", "c", "</s>", "zzz",
+  "<s> a", "a b", "b c", "c </s>", "b a", "c a", "a zzz",
+  "<s> a b", "a b c", "b c </s>", "c a b", "zzz a b",
+  "b <s> a b", "c a b c"
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(remote_lm, RemoteFixture)
+
+BOOST_AUTO_TEST_CASE(pipelined_queries)
+{
+  // tiny batches with several in flight, so every phrase takes many queries
+  boost::scoped_ptr<LanguageModelRemote> lm(Connect("batch-size=2 in-flight=3"));
+
+  for (size_t i = 0; i < sizeof(kNGrams) / sizeof(kNGrams[0]); ++i) {
+    const vector<string> ngram = Split(kNGrams[i]);
+    vector<Word> words;
+    LMResult result = lm->GetValue(MakeContext(ngram, words));
+    // context beyond the order of the model is dropped
+    SLOPPY_CHECK_CLOSE(FloorScore(TransformLMScore(Direct(LastWords(kNGrams[i])))), result.score, 0.001);
+    BOOST_CHECK_EQUAL(result.unknown, ngram.back() == "zzz");
+  }
+
+  const string text = "<s> a b c a b c zzz a b c </s>";
+  Phrase phrase;
+  vector<FactorType> factorOrder(1, 0);
+  phrase.CreateFromString(Output, factorOrder, text, NULL);
+
+  float fullScore, ngramScore;
+  size_t oovCount;
+  lm->CalcScore(phrase, fullScore, ngramScore, oovCount);
+
+  const vector<string> words = Split(text);
+  float expected = 0;
+  for (size_t i = 1; i < words.size(); ++i) {
+    vector<string> ngram(words.begin() + (i < 2 ? 0 : i - 2), words.begin() + i + 1);
+    expected += FloorScore(TransformLMScore(Direct(ngram)));
+  }
+  SLOPPY_CHECK_CLOSE(expected, fullScore, 0.001);
+  BOOST_CHECK_EQUAL(oovCount, 1);
+}
+
+BOOST_AUTO_TEST_CASE(bounded_cache)
+{
+  boost::scoped_ptr<LanguageModelRemote> lm(Connect("batch-size=3 cache-size=4"));
+  const size_t count = sizeof(kNGrams) / sizeof(kNGrams[0]);
+
+  // twice over, so the second round is answered again after eviction
+  vector<float> scores;
+  boost::ptr_vector<FFState> states; // LM states after each n-gram
+  for (size_t round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < count; ++i) {
+      vector<Word> words;
+      FFState *state = lm->NewState(lm->GetNullContextState());
+      LMResult result = lm->GetValueForgotState(MakeContext(Split(kNGrams[i]), words), *state);
+      BOOST_CHECK_LE(lm->CacheSize(), 4);
+      if (round == 0) {
+        scores.push_back(result.score);
+        states.push_back(state);
+      } else {
+        BOOST_CHECK_EQUAL(scores[i], result.score);
+        BOOST_CHECK_EQUAL(states[i].Compare(*state), 0);
+        BOOST_CHECK_EQUAL(states[i].Hash(), state->Hash());
+        delete state;
+      }
+    }
+  }
+
+  // states are the last two words, the context of the next n-gram
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < count; ++j) {
+      const bool same = LastWords(kNGrams[i], 2) == LastWords(kNGrams[j], 2);
+      BOOST_CHECK_EQUAL(states[i].Compare(states[j]) == 0, same);
+      BOOST_CHECK_EQUAL(states[i].Compare(states[j]), -states[j].Compare(states[i]));
+      if (same) BOOST_CHECK_EQUAL(states[i].Hash(), states[j].Hash());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(states_compare_contexts)
+{
+  boost::scoped_ptr<LanguageModelRemote> lm(Connect(""));
+
+  // a hypothesis is extended from its own context only
+  vector<Word> words;
+  boost::scoped_ptr<FFState> fromB(lm->NewState(lm->GetBeginSentenceState()));
+  lm->GetValueGivenState(MakeContext(Split("<s> a"), words), *fromB);
+  boost::scoped_ptr<FFState> copy(lm->NewState(fromB.get()));
+  BOOST_CHECK_EQUAL(copy->Compare(*fromB), 0);
+  lm->GetValueGivenState(MakeContext(Split("<s> a b"), words), *copy);
+  BOOST_CHECK(copy->Compare(*fromB) != 0);
+
+  // the begin sentence context is <s>, the null context empty
+  boost::scoped_ptr<FFState> afterS(lm->NewState(lm->GetNullContextState()));
+  lm->GetValueForgotState(MakeContext(Split("<s>"), words), *afterS);
+  BOOST_CHECK_EQUAL(afterS->Compare(*lm->GetBeginSentenceState()), 0);
+  BOOST_CHECK(lm->GetNullContextState()->Compare(*lm->GetBeginSentenceState()) != 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,14 +2,19 @@
 #include "neuralLM.h"
 #include "vocabulary.h"
 
+#include <algorithm>
+
 namespace Moses
 {
 
+typedef Eigen::Map<const Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic> > IntMatrixMap;
+
 BilingualLM_NPLM::BilingualLM_NPLM(const std::string &line)
   : BilingualLM(line),
     premultiply(true),
     factored(false),
-    neuralLM_cache(1000000)
+    neuralLM_cache(1000000),
+    batch_size(256)
 {
 
   NULL_string = "<null>"; //Default null value for nplm
@@ -25,6 +30,62 @@ float BilingualLM_NPLM::Score(std::vector<int>& source_words, std::vector<int>&
   return FloorScore(m_neuralLM->lookup_ngram(source_words));
 }
 
+float BilingualLM_NPLM::ScoreNgrams(const std::vector<int>& ngrams) const
+{
+  std::vector<float> scores;
+  LookupNgrams(ngrams, scores);
+
+  float value = 0;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    value += scores[i];
+  }
+  return value;
+}
+
+void BilingualLM_NPLM::PrefetchNgrams(const std::vector<int>& ngrams) const
+{
+  std::vector<float> scores;
+  LookupNgrams(ngrams, scores);
+}
+
+void BilingualLM_NPLM::LookupNgrams(const std::vector<int>& ngrams, std::vector<float>& scores) const
+{
+  initSharedPointer();
+  if (!m_ngramCache.get()) {
+    m_ngramCache.reset(new NeuralLMCache());
+  }
+  NeuralLMCache &cache = *m_ngramCache;
+
+  const size_t order = source_ngrams + target_ngrams + 1;
+  cache.Lookup(ngrams, order, scores);
+
+  // Score the distinct n-grams we haven't seen yet with one matrix product per batch_size of them
+  const std::vector<int> &misses = cache.Misses();
+  if (!misses.empty()) {
+    const size_t numMisses = misses.size() / order;
+    std::vector<float> missScores(numMisses);
+    Eigen::Matrix<double, 1, Eigen::Dynamic> log_probs;
+    for (size_t start = 0; start < numMisses; start += batch_size) {
+      const size_t width = std::min(batch_size, numMisses - start);
+      IntMatrixMap block(&misses[start * order], order, width);
+      log_probs.resize(width);
+      m_neuralLM->lookup_ngram(block, log_probs);
+      for (size_t i = 0; i < width; ++i) {
+        missScores[start + i] = FloorScore(log_probs(i));
+      }
+    }
+    cache.Fill(missScores, scores);
+  }
+}
+
+void BilingualLM_NPLM::CleanUpAfterSentenceProcessing(const InputType& source)
+{
+  // Thread safe: the n-gram cache is thread specific.
+  if (m_ngramCache.get()) {
+    m_ngramCache->Clear();
+  }
+}
+
 const Word& BilingualLM_NPLM::getNullWord() const
 {
   return NULL_word;
@@ -71,6 +132,7 @@ void BilingualLM_NPLM::initSharedPointer() const
 {
   if (!m_neuralLM.get()) {
     m_neuralLM.reset(new nplm::neuralLM(*m_neuralLM_shared));
+    m_neuralLM->set_width(batch_size);
   }
 }
 
@@ -90,6 +152,9 @@ void BilingualLM_NPLM::SetParameter(const std::string& key, const std::string& v
     target_vocab_path = value;
   } else if (key == "cache_size") {
     neuralLM_cache = atoi(value.c_str());
+  } else if (key == "batch_size") {
+    batch_size = Scan<size_t>(value);
+    UTIL_THROW_IF2(batch_size == 0, "batch_size must be positive");
   } else if (key == "premultiply") {
     premultiply = Scan<bool>(value);
     //TODO: doesn't currently do anything (constructor doesn't know about parameters)
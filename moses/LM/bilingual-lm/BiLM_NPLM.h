@@ -1,4 +1,5 @@
 #include "moses/LM/BilingualLM.h"
+#include "moses/LM/NeuralLMCache.h"
 #include <boost/unordered_map.hpp>
 #include <utility> //make_pair
 #include <fstream> //Read vocabulary files
@@ -19,6 +20,19 @@ public:
 private:
   float Score(std::vector<int>& source_words, std::vector<int>& target_words) const;
 
+  float ScoreNgrams(const std::vector<int>& ngrams) const;
+
+  void PrefetchNgrams(const std::vector<int>& ngrams) const;
+
+  bool PrefetchesWhenApplied() const {
+    return true;
+  }
+
+  // scores of ngrams from the cache, scoring the misses batch_size at a time
+  void LookupNgrams(const std::vector<int>& ngrams, std::vector<float>& scores) const;
+
+  void CleanUpAfterSentenceProcessing(const InputType& source);
+
   int getNeuralLMId(const Word& word, bool is_source_word) const;
 
   void initSharedPointer() const;
@@ -31,6 +45,8 @@ private:
 
   nplm::neuralLM *m_neuralLM_shared;
   mutable boost::thread_specific_ptr<nplm::neuralLM> m_neuralLM;
+  // scores of the n-grams seen in the current sentence, per thread
+  mutable boost::thread_specific_ptr<NeuralLMCache> m_ngramCache;
 
   mutable boost::unordered_map<const Factor*, int> target_neuralLMids;
   mutable boost::unordered_map<const Factor*, int> source_neuralLMids;
@@ -45,6 +61,7 @@ private:
   bool premultiply;
   bool factored;
   int neuralLM_cache;
+  size_t batch_size;
   int source_unknown_word_id;
   int target_unknown_word_id;
 };
@@ -0,0 +1,190 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+// Decodes with options-threads set, so it loads StaticData and runs apart
+// from moses_test.
+
+#define BOOST_TEST_MODULE ParallelOptions
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "moses/FF/FeatureFunction.h"
+#include "moses/Hypothesis.h"
+#include "moses/Manager.h"
+#include "moses/Parameter.h"
+#include "moses/Sentence.h"
+#include "moses/StaticData.h"
+#include "moses/TranslationTask.h"
+#include "moses/Util.h"
+#include "util/exception.hh"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+// A factored model: the generation step adds tags, which
+// GlobalLexicalModel scores from the input words of the sentence.  The
+// model keeps the input in thread local storage of the decoding thread.
+const char *kPhraseTable =
+  "das ||| the ||| 0.9\n"
+  "haus ||| house ||| 0.8\n"
+  "ist ||| is ||| 0.7\n"
+  "klein ||| small ||| 0.6\n";
+
+const char *kGenerationTable =
+  "the DET 1\n"
+  "house NN 1\n"
+  "is VB 1\n"
+  "small ADJ 1\n";
+
+const char *kLexicon =
+  "DET das 0.5\n"
+  "DET **BIAS** -0.25\n"
+  "NN haus 1.5\n"
+  "NN klein -0.75\n"
+  "VB ist 2\n"
+  "ADJ klein 1\n"
+  "ADJ **BIAS** 0.5\n";
+
+// score of a tag as GlobalLexicalModel adds it up for a sentence
+float LexiconScore(const string &tag, const vector<string> &input)
+{
+  float sum = 0;
+  for (const char *line = kLexicon; *line; ) {
+    const char *end = line;
+    while (*end != '\n') ++end;
+    vector<string> token = Tokenize(string(line, end));
+    line = end + 1;
+    if (token[0] != tag) continue;
+    if (token[1] == "**BIAS**" || find(input.begin(), input.end(), token[1]) != input.end()) {
+      sum += Scan<float>(token[2]);
+    }
+  }
+  return FloorScore(log(1 / (1 + exp(-sum))));
+}
+
+// StaticData loaded once for all tests, from files in a temporary directory
+struct ModelFixture {
+  boost::filesystem::path dir;
+
+  ModelFixture() : dir(boost::filesystem::temp_directory_path() /
+                         boost::filesystem::unique_path("moses-parallel-options-%%%%-%%%%")) {
+    boost::filesystem::create_directory(dir);
+    Write("phrase-table", kPhraseTable);
+    Write("generation", kGenerationTable);
+    Write("lexicon", kLexicon);
+    Write("moses.ini", string(
+            "[input-factors]\n0\n"
+            "[mapping]\n0 T 0\n0 G 0\n"
+            "[distortion-limit]\n6\n"
+            "[options-threads]\n4\n"
+            "[verbose]\n0\n"
+            "[feature]\n"
+            "UnknownWordPenalty\n"
+            "WordPenalty\n"
+            "Distortion\n"
+            "PhraseDictionaryMemory name=TranslationModel0 num-features=1 path=") + File("phrase-table") +
+          " input-factor=0 output-factor=0\n"
+          "Generation name=GenerationModel0 num-features=1 path=" + File("generation") +
+          " input-factor=0 output-factor=1\n"
+          "GlobalLexicalModel input-factor=0 output-factor=1 path=" + File("lexicon") + "\n"
+          "[weight]\n"
+          "UnknownWordPenalty0= 1\n"
+          "WordPenalty0= -1\n"
+          "Distortion0= 0.3\n"
+          "TranslationModel0= 0.2\n"
+          "GenerationModel0= 0.3\n"
+          "GlobalLexicalModel0= 0.5\n");
+
+    Parameter *params = new Parameter(); // kept by StaticData
+    const string ini = File("moses.ini");
+    char arg0[] = "moses", arg1[] = "-f";
+    char *argv[] = {arg0, arg1, const_cast<char*>(ini.c_str())};
+    UTIL_THROW_IF2(!params->LoadParam(3, argv), "Cannot load " << ini);
+    UTIL_THROW_IF2(!StaticData::LoadDataStatic(params, arg0), "Cannot load the models of " << ini);
+  }
+
+  ~ModelFixture() {
+    boost::filesystem::remove_all(dir);
+  }
+
+  string File(const string &name) const {
+    return (dir / name).string();
+  }
+
+  void Write(const string &name, const string &text) const {
+    ofstream out(File(name).c_str());
+    out << text;
+  }
+};
+
+BOOST_GLOBAL_FIXTURE(ModelFixture);
+
+const FeatureFunction &Feature(const string &name)
+{
+  const vector<FeatureFunction*> &ffs = FeatureFunction::GetFeatureFunctions();
+  for (size_t i = 0; i < ffs.size(); ++i) {
+    if (ffs[i]->GetScoreProducerDescription() == name) return *ffs[i];
+  }
+  BOOST_FAIL("no feature " << name);
+  return *ffs[0];
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(thread_local_input_state)
+{
+  BOOST_REQUIRE_EQUAL(StaticData::Instance().OptionsThreadCount(), 4);
+  const FeatureFunction &glm = Feature("GlobalLexicalModel0");
+  BOOST_CHECK(glm.KeepsThreadLocalInputState());
+
+  // the model must see the input of the sentence being decoded
+  const char *sentences[] = {"das haus ist klein", "haus klein", "das ist"};
+  const char *translations[] = {"the house is small", "house small", "the is"};
+  const char *tags[] = {"DET NN VB ADJ", "NN ADJ", "DET VB"};
+  for (size_t s = 0; s < 3; ++s) {
+    vector<FactorType> factors(1, 0);
+    boost::shared_ptr<InputType> source(new Sentence(s, sentences[s], &factors));
+    boost::shared_ptr<TranslationTask> task = TranslationTask::create(source);
+    Manager manager(task);
+    manager.Decode();
+    const Hypothesis *best = manager.GetBestHypothesis();
+    BOOST_REQUIRE(best);
+
+    Phrase output;
+    best->GetOutputPhrase(output);
+    BOOST_CHECK_EQUAL(output.GetStringRep(vector<FactorType>(1, 0)), translations[s]);
+    BOOST_CHECK_EQUAL(output.GetStringRep(vector<FactorType>(1, 1)), tags[s]);
+
+    const vector<string> input = Tokenize(sentences[s]);
+    float expected = 0;
+    for (size_t i = 0; i < output.GetSize(); ++i) {
+      expected += LexiconScore(output.GetWord(i).GetString(1).as_string(), input);
+    }
+    BOOST_CHECK_CLOSE(best->GetScoreBreakdown().GetScoreForProducer(&glm), expected, 1e-3);
+  }
+}
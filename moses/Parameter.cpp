@@ -103,6 +103,9 @@ Parameter::Parameter()
   AddParam(search_opts,"disable-discarding", "dd", "disable hypothesis discarding"); // ??? memory management? UG
   AddParam(search_opts,"phrase-drop-allowed", "da", "if present, allow dropping of source words"); //da = drop any (word); see -du for comparison
   AddParam(search_opts,"threads","th", "number of threads to use in decoding (defaults to single-threaded)");
+  AddParam(search_opts,"load-threads", "number of threads to use for loading models at startup (defaults to single-threaded)");
+  AddParam(search_opts,"options-threads", "number of threads per sentence to use for creating translation options (defaults to single-threaded)");
+  AddParam(search_opts,"thread-placement", "pin the workers of the thread pools to CPUs: none (default), core (one core each) or node (one NUMA node each), dealt out to the NUMA nodes in turn, with a task queue per node");
 
   // distortion options
   po::options_description disto_opts("Distortion options");
@@ -75,6 +75,18 @@ public:
   void Add(TranslationOption *partialTranslOpt);
   void Prune();
 
+  /** whether an option with this future score would be kept by Add().
+   * Decode steps check it to avoid creating options that would be deleted
+   * straight away. The threshold only rises as options are added */
+  bool IsAdmitted(float futureScore) const {
+    return futureScore >= m_worstScore;
+  }
+
+  /** count options that a decode step pruned without creating them */
+  void AddPrunedCount(size_t count) {
+    m_totalPruned += count;
+  }
+
   /** returns list of translation options */
   const std::vector<TranslationOption*>& GetList() const {
     return m_list;
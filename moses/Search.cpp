@@ -14,6 +14,14 @@ Search::Search(Manager& manager)
   , interrupted_flag(0)
 {
   m_initialTransOpt.SetInputPath(m_inputPath);
+
+  const StaticData &staticData = StaticData::Instance();
+  const std::vector<const StatefulFeatureFunction*> &ffs
+  = StatefulFeatureFunction::GetStatefulFeatureFunctions();
+  for (size_t i = 0; i < ffs.size(); ++i) {
+    if (ffs[i]->PrefetchesWhenApplied() && !staticData.IsFeatureFunctionIgnored(*ffs[i]))
+      m_prefetchingFFs.push_back(ffs[i]);
+  }
 }
 
 
@@ -48,4 +56,13 @@ out_of_time()
   return true;
 }
 
+void
+Search::
+PrefetchWhenApplied(const std::vector<HypothesisExpansion>& expansions) const
+{
+  if (expansions.empty()) return;
+  for (size_t i = 0; i < m_prefetchingFFs.size(); ++i)
+    m_prefetchingFFs[i]->PrefetchWhenApplied(expansions);
+}
+
 }
@@ -6,6 +6,7 @@
 #include "TranslationOption.h"
 #include "Phrase.h"
 #include "InputPath.h"
+#include "FF/StatefulFeatureFunction.h"
 
 namespace Moses
 {
@@ -48,7 +49,13 @@ protected:
   /** flag indicating that decoder ran out of time (see switch -time-out) */
   size_t interrupted_flag;
 
+  //! stateful features that want a stack's expansions before they are built
+  std::vector<const StatefulFeatureFunction*> m_prefetchingFFs;
+
   bool out_of_time();
+
+  //! hand the expansions of a stack to m_prefetchingFFs
+  void PrefetchWhenApplied(const std::vector<HypothesisExpansion>& expansions) const;
 };
 
 }
@@ -5,6 +5,7 @@
 #include "InputType.h"
 #include "TranslationOptionCollection.h"
 #include <boost/foreach.hpp>
+#include <queue>
 using namespace std;
 
 namespace Moses
@@ -24,8 +25,8 @@ public:
     }
 
     // Compare the top hypothesis of each bitmap container using the TotalScore, which includes future cost
-    const float scoreA = A->Top()->GetHypothesis()->GetTotalScore();
-    const float scoreB = B->Top()->GetHypothesis()->GetTotalScore();
+    const float scoreA = A->Top()->GetScore();
+    const float scoreB = B->Top()->GetScore();
 
     if (scoreA < scoreB) {
       return true;
@@ -103,6 +104,13 @@ void SearchCubePruning::Decode()
     _BMType::const_iterator bmIter;
     const _BMType &accessor = sourceHypoColl.GetBitmapAccessor();
 
+    if (!m_prefetchingFFs.empty()) {
+      std::vector<HypothesisExpansion> expansions;
+      for(bmIter = accessor.begin(); bmIter != accessor.end(); ++bmIter)
+        bmIter->second->CollectSeedExpansions(expansions);
+      PrefetchWhenApplied(expansions);
+    }
+
     for(bmIter = accessor.begin(); bmIter != accessor.end(); ++bmIter) {
       // build the first hypotheses
       bmIter->second->InitializeEdges();
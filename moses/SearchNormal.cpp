@@ -68,11 +68,32 @@ ProcessOneStack(HypothesisStack* hstack)
   sourceHypoColl.CleanupArcList();
   IFVERBOSE(2)  stats.StopTimeStack();
 
-  // go through each hypothesis on the stack and try to expand it
+  // go through each hypothesis on the stack and find where it can be
+  // expanded; features may prefetch the scores of all these expansions
+  // before they are built
   // BOOST_FOREACH(Hypothesis* h, sourceHypoColl)
+  m_expansionSpans.clear();
   HypothesisStackNormal::const_iterator h;
   for (h = sourceHypoColl.begin(); h != sourceHypoColl.end(); ++h)
     ProcessOneHypothesis(**h);
+
+  if (!m_prefetchingFFs.empty()) {
+    std::vector<HypothesisExpansion> expansions;
+    for (size_t i = 0; i < m_expansionSpans.size(); ++i) {
+      const WordsRange &range = m_expansionSpans[i].second;
+      const TranslationOptionList* tol
+      = m_transOptColl.GetTranslationOptionList(range.GetStartPos(), range.GetEndPos());
+      if (!tol) continue;
+      for (TranslationOptionList::const_iterator iter = tol->begin(); iter != tol->end(); ++iter)
+        expansions.push_back(HypothesisExpansion(m_expansionSpans[i].first, *iter));
+    }
+    PrefetchWhenApplied(expansions);
+  }
+
+  for (size_t i = 0; i < m_expansionSpans.size(); ++i) {
+    const WordsRange &range = m_expansionSpans[i].second;
+    ExpandAllHypotheses(*m_expansionSpans[i].first, range.GetStartPos(), range.GetEndPos());
+  }
   return true;
 }
 
@@ -98,9 +119,9 @@ void SearchNormal::Decode()
 }
 
 
-/** Find all translation options to expand one hypothesis, trigger expansion
- * this is mostly a check for overlap with already covered words, and for
- * violation of reordering limits.
+/** Find all spans over which one hypothesis can be expanded and queue them
+ * in m_expansionSpans; this is mostly a check for overlap with already
+ * covered words, and for violation of reordering limits.
  * \param hypothesis hypothesis to be expanded upon
  */
 void
@@ -134,7 +155,7 @@ ProcessOneHypothesis(const Hypothesis &hypothesis)
         }
 
         //TODO: does this method include incompatible WordLattice hypotheses?
-        ExpandAllHypotheses(hypothesis, startPos, endPos);
+        m_expansionSpans.push_back(std::make_pair(&hypothesis, WordsRange(startPos, endPos)));
       }
     }
     return; // done with special case (no reordering limit)
@@ -211,7 +232,7 @@ ProcessOneHypothesis(const Hypothesis &hypothesis)
 
       if (isLeftMostEdge) {
         // any length extension is okay if starting at left-most edge
-        ExpandAllHypotheses(hypothesis, startPos, endPos);
+        m_expansionSpans.push_back(std::make_pair(&hypothesis, WordsRange(startPos, endPos)));
       } else { // starting somewhere other than left-most edge, use caution
         // the basic idea is this: we would like to translate a phrase
         // starting from a position further right than the left-most
@@ -227,7 +248,7 @@ ProcessOneHypothesis(const Hypothesis &hypothesis)
             > m_options.reordering.max_distortion) continue;
 
         // everything is fine, we're good to go
-        ExpandAllHypotheses(hypothesis, startPos, endPos);
+        m_expansionSpans.push_back(std::make_pair(&hypothesis, WordsRange(startPos, endPos)));
       }
     }
   }
@@ -32,6 +32,9 @@ protected:
   /** pre-computed list of translation options for the phrases in this sentence */
   const TranslationOptionCollection &m_transOptColl;
 
+  //! spans over which the hypotheses of the current stack are to be expanded
+  std::vector<std::pair<const Hypothesis*, WordsRange> > m_expansionSpans;
+
   // functions for creating hypotheses
 
   virtual bool
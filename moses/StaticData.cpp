@@ -30,6 +30,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "moses/FF/UnknownWordPenaltyProducer.h"
 #include "moses/FF/InputFeature.h"
 #include "moses/FF/DynamicCacheBasedLanguageModel.h"
+#include "moses/LM/Base.h"
 #include "moses/TranslationModel/PhraseDictionaryDynamicCacheBased.h"
 
 #include "DecodeStepTranslation.h"
@@ -39,6 +40,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "Util.h"
 #include "FactorCollection.h"
 #include "Timer.h"
+#include "FeatureLoader.h"
+#include "ThreadPool.h"
 #include "TranslationOption.h"
 #include "DecodeGraph.h"
 #include "InputFileStream.h"
@@ -345,6 +348,64 @@ StaticData
 #endif
     }
   }
+
+  m_loadThreadCount = 1;
+  params = m_parameter->GetParam("load-threads");
+  if (params && params->size()) {
+    if (params->at(0) == "all") {
+#ifdef WITH_THREADS
+      m_loadThreadCount = boost::thread::hardware_concurrency();
+      if (!m_loadThreadCount) {
+        std::cerr << "-load-threads all specified but Boost doesn't know how many cores there are";
+        return false;
+      }
+#else
+      std::cerr << "-load-threads all specified but moses not built with thread support";
+      return false;
+#endif
+    } else {
+      m_loadThreadCount = Scan<int>(params->at(0));
+      if (m_loadThreadCount < 1) {
+        std::cerr << "Specify at least one load thread.";
+        return false;
+      }
+#ifndef WITH_THREADS
+      if (m_loadThreadCount > 1) {
+        std::cerr << "Error: Load thread count of " << params->at(0)
+                  << " but moses not built with thread support";
+        return false;
+      }
+#endif
+    }
+  }
+
+  m_optionsThreadCount = 1;
+  params = m_parameter->GetParam("options-threads");
+  if (params && params->size()) {
+    m_optionsThreadCount = Scan<int>(params->at(0));
+    if (m_optionsThreadCount < 1) {
+      std::cerr << "Specify at least one options thread.";
+      return false;
+    }
+#ifndef WITH_THREADS
+    if (m_optionsThreadCount > 1) {
+      std::cerr << "Error: Options thread count of " << params->at(0)
+                << " but moses not built with thread support";
+      return false;
+    }
+#endif
+  }
+
+  params = m_parameter->GetParam("thread-placement");
+  if (params && params->size()) {
+    ThreadPlacement::Policy policy;
+    if (!ThreadPlacement::Parse(params->at(0), policy)) {
+      std::cerr << "Unknown thread placement " << params->at(0)
+                << ", use none, core or node";
+      return false;
+    }
+    ThreadPlacement::SetPolicy(policy);
+  }
   return true;
 }
 
@@ -848,6 +909,9 @@ StaticData
 
 void StaticData::LoadFeatureFunctions()
 {
+  // phrase tables are added last so that a serial load keeps the old order
+  FeatureLoader loader(m_loadThreadCount);
+
   const std::vector<FeatureFunction*> &ffs = FeatureFunction::GetFeatureFunctions();
   std::vector<FeatureFunction*>::const_iterator iter;
   for (iter = ffs.begin(); iter != ffs.end(); ++iter) {
@@ -864,19 +928,22 @@ void StaticData::LoadFeatureFunctions()
     }
 
     if (doLoad) {
-      VERBOSE(1, "Loading " << ff->GetScoreProducerDescription() << endl);
-      ff->Load();
+      loader.Add(ff);
     }
   }
 
+  // phrase tables score rules and phrases with the other features while
+  // they load, so those have to be loaded first
+  loader.NextWave();
   const std::vector<PhraseDictionary*> &pts = PhraseDictionary::GetColl();
   for (size_t i = 0; i < pts.size(); ++i) {
-    PhraseDictionary *pt = pts[i];
-    VERBOSE(1, "Loading " << pt->GetScoreProducerDescription() << endl);
-    pt->Load();
+    loader.Add(pts[i]);
   }
 
+  loader.Load();
+
   CheckLEGACYPT();
+  CheckIncrementalFeatures();
 }
 
 bool StaticData::CheckWeights() const
@@ -1145,6 +1212,29 @@ void StaticData::CheckLEGACYPT()
   m_useLegacyPT = false;
 }
 
+void StaticData::CheckIncrementalFeatures() const
+{
+  if (options().search.algo != ChartIncremental) return;
+
+  // the first language model drives the search, the others are scored on
+  // hyperedges and recombined by the Hash() of their states
+  const LanguageModel &searchLM = LanguageModel::GetFirstLM();
+  const std::vector<const StatefulFeatureFunction*> &ffs = StatefulFeatureFunction::GetStatefulFeatureFunctions();
+  for (size_t i = 0; i < ffs.size(); ++i) {
+    UTIL_THROW_IF2(ffs[i] != &searchLM && !ffs[i]->EvaluatesHyperedges(),
+                   ffs[i]->GetScoreProducerDescription()
+                   << " cannot be used with incremental search");
+  }
+
+  // stateless features are applied to every hyperedge too
+  const std::vector<const StatelessFeatureFunction*> &sfs = StatelessFeatureFunction::GetStatelessFeatureFunctions();
+  for (size_t i = 0; i < sfs.size(); ++i) {
+    UTIL_THROW_IF2(!sfs[i]->EvaluatesHyperedges(),
+                   sfs[i]->GetScoreProducerDescription()
+                   << " cannot be used with incremental search");
+  }
+}
+
 
 void StaticData::ResetWeights(const std::string &denseWeights, const std::string &sparseFile)
 {
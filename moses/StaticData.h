@@ -193,6 +193,8 @@ protected:
   WordAlignmentSort m_wordAlignmentSort;
 
   int m_threadCount;
+  int m_loadThreadCount;
+  int m_optionsThreadCount;
   long m_startTranslationId;
 
   // alternate weight settings
@@ -664,6 +666,14 @@ public:
     return m_threadCount;
   }
 
+  int LoadThreadCount() const {
+    return m_loadThreadCount;
+  }
+
+  int OptionsThreadCount() const {
+    return m_optionsThreadCount;
+  }
+
   long GetStartTranslationId() const {
     return m_startTranslationId;
   }
@@ -792,6 +802,8 @@ public:
   ** eventually, we'll stop support the binary phrase-table and delete this legacy code
   **/
   void CheckLEGACYPT();
+  //! refuse stateful features that incremental search cannot score
+  void CheckIncrementalFeatures() const;
   bool GetUseLegacyPT() const {
     return m_useLegacyPT;
   }
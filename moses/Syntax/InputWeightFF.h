@@ -27,6 +27,10 @@ public:
   void EvaluateWhenApplied(const Syntax::SHyperedge &hyperedge,
                            ScoreComponentCollection* accumulator) const;
 
+  bool EvaluatesHyperedges() const {
+    return true;
+  }
+
 
   void SetParameter(const std::string& key, const std::string& value);
 
@@ -22,7 +22,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "ThreadPool.h"
 
-#ifdef WITH_THREADS
+#if defined(WITH_THREADS) && defined(__linux__)
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 using namespace std;
 using namespace Moses;
@@ -30,8 +37,160 @@ using namespace Moses;
 namespace Moses
 {
 
-ThreadPool::ThreadPool( size_t numThreads )
-  : m_stopped(false), m_stopping(false), m_queueLimit(0)
+namespace
+{
+ThreadPlacement::Policy s_placementPolicy = ThreadPlacement::None;
+
+#if defined(WITH_THREADS) && defined(__linux__)
+typedef vector<vector<int> > Topology; // CPUs of each NUMA node
+
+// parse a kernel cpu list such as "0-7,16-23"
+void ParseCpuList(const string &list, const cpu_set_t &allowed, vector<int> &cpus)
+{
+  const char *p = list.c_str();
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p) break;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+    }
+    if (*p == ',') ++p;
+  }
+}
+
+// CPUs we may run on, grouped by NUMA node. Falls back to a single node
+// when the kernel doesn't tell.
+void ReadTopology(Topology &nodes)
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed)) return;
+
+  for (size_t node = 0; ; ++node) {
+    ostringstream path;
+    path << "/sys/devices/system/node/node" << node << "/cpulist";
+    ifstream file(path.str().c_str());
+    string list;
+    if (!file || !getline(file, list)) break;
+    vector<int> cpus;
+    ParseCpuList(list, allowed, cpus);
+    if (!cpus.empty()) nodes.push_back(cpus);
+  }
+
+  if (nodes.empty()) {
+    nodes.resize(1);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) nodes[0].push_back(cpu);
+    }
+    if (nodes[0].empty()) nodes.clear();
+  }
+}
+
+boost::mutex s_placementMutex;
+bool s_topologyRead = false;
+Topology s_topology;
+size_t s_nextWorker = 0;
+boost::thread_specific_ptr<size_t> s_currentNode;
+
+// called with s_placementMutex held
+const Topology &GetTopology()
+{
+  if (!s_topologyRead) {
+    ReadTopology(s_topology);
+    s_topologyRead = true;
+  }
+  return s_topology;
+}
+#endif
+}
+
+void ThreadPlacement::SetPolicy(Policy policy)
+{
+  s_placementPolicy = policy;
+}
+
+ThreadPlacement::Policy ThreadPlacement::GetPolicy()
+{
+  return s_placementPolicy;
+}
+
+bool ThreadPlacement::Parse(const string &name, Policy &policy)
+{
+  if (name == "none") policy = None;
+  else if (name == "core") policy = Core;
+  else if (name == "node") policy = Node;
+  else return false;
+  return true;
+}
+
+size_t ThreadPlacement::NumNodes()
+{
+#if defined(WITH_THREADS) && defined(__linux__)
+  if (s_placementPolicy == None) return 1;
+  boost::mutex::scoped_lock lock(s_placementMutex);
+  return max<size_t>(GetTopology().size(), 1);
+#else
+  return 1;
+#endif
+}
+
+size_t ThreadPlacement::PlaceCurrentThread()
+{
+#if defined(WITH_THREADS) && defined(__linux__)
+  if (s_placementPolicy == None) return 0;
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  size_t nodeIndex;
+  {
+    boost::mutex::scoped_lock lock(s_placementMutex);
+    const Topology &topology = GetTopology();
+    if (topology.empty()) return 0;
+
+    const size_t worker = s_nextWorker++;
+    nodeIndex = worker % topology.size();
+    const vector<int> &node = topology[nodeIndex];
+    if (s_placementPolicy == Core) {
+      CPU_SET(node[(worker / topology.size()) % node.size()], &cpus);
+    } else {
+      for (size_t i = 0; i < node.size(); ++i) {
+        CPU_SET(node[i], &cpus);
+      }
+    }
+  }
+  // failing to bind costs speed, not correctness
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  s_currentNode.reset(new size_t(nodeIndex));
+  return nodeIndex;
+#else
+  return 0;
+#endif
+}
+
+bool ThreadPlacement::CurrentNode(size_t &node)
+{
+#if defined(WITH_THREADS) && defined(__linux__)
+  if (!s_currentNode.get()) return false;
+  node = *s_currentNode;
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef WITH_THREADS
+
+ThreadPool::ThreadPool( size_t numThreads, bool placeWorkers )
+  : m_tasks(placeWorkers ? ThreadPlacement::NumNodes() : 1)
+  , m_numTasks(0), m_nextQueue(0)
+  , m_stopped(false), m_stopping(false), m_queueLimit(0), m_placeWorkers(placeWorkers)
 {
   for (size_t i = 0; i < numThreads; ++i) {
     m_threads.create_thread(boost::bind(&ThreadPool::Execute,this));
@@ -40,17 +199,18 @@ ThreadPool::ThreadPool( size_t numThreads )
 
 void ThreadPool::Execute()
 {
+  size_t node = 0;
+  if (m_placeWorkers) node = ThreadPlacement::PlaceCurrentThread() % m_tasks.size();
   do {
     boost::shared_ptr<Task> task;
     {
       // Find a job to perform
       boost::mutex::scoped_lock lock(m_mutex);
-      if (m_tasks.empty() && !m_stopped) {
+      if (m_numTasks == 0 && !m_stopped) {
         m_threadNeeded.wait(lock);
       }
-      if (!m_stopped && !m_tasks.empty()) {
-        task = m_tasks.front();
-        m_tasks.pop();
+      if (!m_stopped && m_numTasks) {
+        task = Take(node);
       }
     }
     //Execute job
@@ -64,16 +224,40 @@ void ThreadPool::Execute()
   } while (!m_stopped);
 }
 
+boost::shared_ptr<Task> ThreadPool::Take(size_t node)
+{
+  // own node first, then the others
+  for (size_t i = 0; i < m_tasks.size(); ++i) {
+    std::queue<boost::shared_ptr<Task> > &queue = m_tasks[(node + i) % m_tasks.size()];
+    if (!queue.empty()) {
+      boost::shared_ptr<Task> task = queue.front();
+      queue.pop();
+      --m_numTasks;
+      return task;
+    }
+  }
+  return boost::shared_ptr<Task>();
+}
+
 void ThreadPool::Submit(boost::shared_ptr<Task> task)
 {
+  size_t node;
+  if (!ThreadPlacement::CurrentNode(node)) {
+    node = m_tasks.size();
+  }
+
   boost::mutex::scoped_lock lock(m_mutex);
   if (m_stopping) {
     throw runtime_error("ThreadPool stopping - unable to accept new jobs");
   }
-  while (m_queueLimit > 0 && m_tasks.size() >= m_queueLimit) {
+  while (m_queueLimit > 0 && m_numTasks >= m_queueLimit) {
     m_threadAvailable.wait(lock);
   }
-  m_tasks.push(task);
+  if (node >= m_tasks.size()) {
+    node = m_nextQueue++ % m_tasks.size();
+  }
+  m_tasks[node].push(task);
+  ++m_numTasks;
   m_threadNeeded.notify_all();
 }
 
@@ -88,7 +272,7 @@ void ThreadPool::Stop(bool processRemainingJobs)
   if (processRemainingJobs) {
     boost::mutex::scoped_lock lock(m_mutex);
     //wait for queue to drain.
-    while (!m_tasks.empty() && !m_stopped) {
+    while (m_numTasks && !m_stopped) {
       m_threadAvailable.wait(lock);
     }
   }
@@ -101,7 +285,7 @@ void ThreadPool::Stop(bool processRemainingJobs)
 
   m_threads.join_all();
 }
+#endif //WITH_THREADS
 
 }
-#endif //WITH_THREADS
 
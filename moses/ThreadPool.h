@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <iostream>
 #include <queue>
+#include <string>
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
@@ -59,15 +60,56 @@ public:
   virtual ~Task() {}
 };
 
+/** Optional CPU pinning for the workers of Moses::ThreadPool.
+ *
+ * With a policy other than None, each worker of a pool that asks for it
+ * binds itself when it starts. Workers are numbered in the order they start,
+ * across all pools, and dealt out to the NUMA nodes in turn. Such a pool
+ * keeps one queue per node, see ThreadPool.
+ */
+class ThreadPlacement
+{
+public:
+  enum Policy {
+    None, //!< leave it to the scheduler
+    Core, //!< each worker on one core of its node
+    Node  //!< each worker on any core of its node
+  };
+
+  static void SetPolicy(Policy policy);
+  static Policy GetPolicy();
+
+  //! parse "none", "core" or "node". Returns false for anything else
+  static bool Parse(const std::string &name, Policy &policy);
+
+  //! number of NUMA nodes the workers are dealt out to. 1 for None
+  static size_t NumNodes();
+
+  /** bind the calling thread as the next worker and return the index of its
+   * node. Does nothing and returns 0 for None
+   */
+  static size_t PlaceCurrentThread();
+
+  //! node of the calling thread if it was placed, else false
+  static bool CurrentNode(size_t &node);
+};
+
 #ifdef WITH_THREADS
 
 class ThreadPool
 {
 public:
   /**
-   * Construct a thread pool of a fixed size.
+   * Construct a thread pool of a fixed size. Its workers are pinned as
+   * ThreadPlacement says unless placeWorkers is false.
+   *
+   * A pool with pinned workers has a queue for each NUMA node. A task
+   * submitted by a pinned thread goes to the queue of that thread's node,
+   * so the jobs a sentence task spawns run near its data; other tasks are
+   * dealt out to the queues in turn. Workers take tasks from their own
+   * node's queue first and from the others only when it is empty.
    **/
-  explicit ThreadPool(size_t numThreads);
+  explicit ThreadPool(size_t numThreads, bool placeWorkers = true);
 
   ~ThreadPool() {
     Stop();
@@ -97,7 +139,12 @@ private:
    **/
   void Execute();
 
-  std::queue<boost::shared_ptr<Task> > m_tasks;
+  //! next task for a worker on the given node. Called with m_mutex held
+  boost::shared_ptr<Task> Take(size_t node);
+
+  std::vector<std::queue<boost::shared_ptr<Task> > > m_tasks; // one per node
+  size_t m_numTasks;
+  size_t m_nextQueue;
   boost::thread_group m_threads;
   boost::mutex m_mutex;
   boost::condition_variable m_threadNeeded;
@@ -105,6 +152,7 @@ private:
   bool m_stopped;
   bool m_stopping;
   size_t m_queueLimit;
+  bool m_placeWorkers;
 };
 
 class TestTask : public Task
@@ -46,6 +46,7 @@ PhraseDictionaryDynamicCacheBased::PhraseDictionaryDynamicCacheBased(const std::
   m_score_type = CBTM_SCORE_TYPE_HYPERBOLA;
   m_maxAge = 1000;
   m_entries = 0;
+  m_epoch = 0;
   m_name = "default";
   m_constant = false;
   ReadParameters();
@@ -152,24 +153,37 @@ void PhraseDictionaryDynamicCacheBased::InitializeForInput(ttasksptr const& ttas
 
 const TargetPhraseCollection *PhraseDictionaryDynamicCacheBased::GetTargetPhraseCollection(const Phrase &source) const
 {
+  CacheEntryPtr entry;
+  int64_t epoch;
+  {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
+    boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
 #endif
-  TargetPhraseCollection* tpc = NULL;
-  cacheMap::const_iterator it = m_cacheTM.find(source);
-  if(it != m_cacheTM.end()) {
-    tpc = new TargetPhraseCollection(*(it->second).first);
-
-    std::vector<const TargetPhrase*>::const_iterator it2 = tpc->begin();
+    cacheMap::const_iterator it = m_cacheTM.find(source);
+    if (it == m_cacheTM.end()) {
+      return NULL;
+    }
+    entry = it->second;
+    epoch = m_epoch;
+  }
 
-    while (it2 != tpc->end()) {
-      ((TargetPhrase*) *it2)->EvaluateInIsolation(source, GetFeaturesToApply());
-      it2++;
+  // the entry cannot change any more, so score the copies without the lock
+  TargetPhraseCollection* tpc = new TargetPhraseCollection();
+  for (size_t tp_pos = 0; tp_pos < entry->targets.GetSize(); ++tp_pos) {
+    int64_t age = epoch - entry->stamps[tp_pos];
+    if (age > (int64_t) m_maxAge) {
+      continue; // decayed fully, but not evicted yet
     }
+    TargetPhrase* tp_ptr = new TargetPhrase(*entry->targets.GetTargetPhrase(tp_pos));
+    tp_ptr->GetScoreBreakdown().Assign(this, GetPreComputedScores(age));
+    tp_ptr->EvaluateInIsolation(source, GetFeaturesToApply());
+    tpc->Add(tp_ptr);
   }
-  if (tpc)  {
-    tpc->NthElement(m_tableLimit); // sort the phrases for the decoder
+  if (tpc->IsEmpty()) {
+    delete tpc;
+    return NULL;
   }
+  tpc->NthElement(m_tableLimit); // sort the phrases for the decoder
 
   return tpc;
 }
@@ -290,7 +304,7 @@ void PhraseDictionaryDynamicCacheBased::SetPreComputedScores(const unsigned int
   VERBOSE(3, "SetPreComputedScores(const unsigned int): lower_age:|" << m_maxAge << "| lower_score:|" << m_lower_score << "|" << std::endl);
 }
 
-Scores PhraseDictionaryDynamicCacheBased::GetPreComputedScores(const unsigned int age)
+Scores PhraseDictionaryDynamicCacheBased::GetPreComputedScores(const unsigned int age) const
 {
   if (age < m_maxAge) {
     return precomputedScores.at(age);
@@ -353,7 +367,7 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
 {
   VERBOSE(3,"PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)" << std::endl);
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
   VERBOSE(3, "PhraseDictionaryCache deleting sp:|" << sp << "| tp:|" << tp << "|" << std::endl);
 
@@ -362,46 +376,35 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
   if(it!=m_cacheTM.end()) {
     VERBOSE(3,"sp:|" << sp << "| FOUND" << std::endl);
     // sp is found
-    // here we have to remove the target phrase from targetphrasecollection and from the TargetAgeMap
-    // and then add new entry
-
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection* tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
-    const Phrase* p_ptr = NULL;
-    TargetPhrase* tp_ptr = NULL;
+    // here we have to build a new entry without the target phrase
+    // and then publish it
+
+    const CacheEntry &old = *(it->second);
+    std::auto_ptr<CacheEntry> entry(new CacheEntry());
     bool found = false;
-    size_t tp_pos=0;
-    while (!found && tp_pos < tpc->GetSize()) {
-      tp_ptr = (TargetPhrase*) tpc->GetTargetPhrase(tp_pos);
-      p_ptr = (const Phrase*) tp_ptr;
-      if (tp == *p_ptr) {
+    for (size_t tp_pos = 0; tp_pos < old.targets.GetSize(); ++tp_pos) {
+      const TargetPhrase* tp_ptr = old.targets.GetTargetPhrase(tp_pos);
+      if (!found && tp == *((const Phrase*) tp_ptr)) {
         found = true;
         continue;
       }
-      tp_pos++;
+      entry->targets.Add(new TargetPhrase(*tp_ptr));
+      entry->stamps.push_back(old.stamps[tp_pos]);
     }
     if (!found) {
       VERBOSE(3,"tp:|" << tp << "| NOT FOUND" << std::endl);
       //do nothing
-    } else {
-      VERBOSE(3,"tp:|" << tp << "| FOUND" << std::endl);
-
-      tpc->Remove(tp_pos); //delete entry in the Target Phrase Collection
-      ac->erase(ac->begin() + tp_pos); //delete entry in the Age Collection
-      m_entries--;
-      VERBOSE(3,"tpc size:|" << tpc->GetSize() << "|" << std::endl);
-      VERBOSE(3,"ac size:|" << ac->size() << "|" << std::endl);
-      VERBOSE(3,"tp:|" << tp << "| DELETED" << std::endl);
+      return;
     }
-    if (tpc->GetSize() == 0) {
-      // delete the entry from m_cacheTM in case it points to an empty TargetPhraseCollection and AgeCollection
-      ac->clear();
-      delete tpc;
-      delete ac;
-      m_cacheTM.erase(sp);
+    VERBOSE(3,"tp:|" << tp << "| FOUND" << std::endl);
+    m_entries--;
+    VERBOSE(3,"tpc size:|" << entry->targets.GetSize() << "|" << std::endl);
+    VERBOSE(3,"tp:|" << tp << "| DELETED" << std::endl);
+    if (entry->targets.IsEmpty()) {
+      // delete the entry from m_cacheTM instead of keeping an empty TargetPhraseCollection
+      entry.reset();
     }
-
+    Publish(sp, entry.release());
   } else {
     VERBOSE(3,"sp:|" << sp << "| NOT FOUND" << std::endl);
     //do nothing
@@ -445,22 +448,18 @@ void PhraseDictionaryDynamicCacheBased::ClearSource(std::vector<std::string> ent
 void PhraseDictionaryDynamicCacheBased::ClearSource(Phrase sp)
 {
   VERBOSE(3,"void PhraseDictionaryDynamicCacheBased::ClearSource(Phrase sp) sp:|" << sp << "|" << std::endl);
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_updateLock);
+#endif
   cacheMap::const_iterator it = m_cacheTM.find(sp);
   if (it != m_cacheTM.end()) {
     VERBOSE(3,"found:|" << sp << "|" << std::endl);
     //sp is found
 
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection* tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
+    m_entries-=it->second->targets.GetSize(); //reduce the total amount of entries of the cache
 
-    m_entries-=tpc->GetSize(); //reduce the total amount of entries of the cache
-
-    // delete the entry from m_cacheTM in case it points to an empty TargetPhraseCollection and AgeCollection
-    ac->clear();
-    delete tpc;
-    delete ac;
-    m_cacheTM.erase(sp);
+    // delete the entry from m_cacheTM; readers holding it keep their copy
+    Publish(sp, NULL);
   } else {
     //do nothing
   }
@@ -545,84 +544,95 @@ void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int a
 {
   VERBOSE(3,"PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int age, std::string waString)" << std::endl);
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
   VERBOSE(3, "PhraseDictionaryCache inserting sp:|" << sp << "| tp:|" << tp << "| age:|" << age << "| word-alignment |" << waString << "|" << std::endl);
 
+  // older entries score like m_maxAge; they are evicted at the next Decay
+  if (age < 0 || age > (int) m_maxAge) {
+    age = m_maxAge;
+  }
+  int64_t stamp = m_epoch - age;
+
+  std::auto_ptr<CacheEntry> entry(new CacheEntry());
+  bool found = false;
   cacheMap::const_iterator it = m_cacheTM.find(sp);
   VERBOSE(3,"sp:|" << sp << "|" << std::endl);
   if(it!=m_cacheTM.end()) {
     VERBOSE(3,"sp:|" << sp << "| FOUND" << std::endl);
     // sp is found
-    // here we have to remove the target phrase from targetphrasecollection and from the TargetAgeMap
-    // and then add new entry
-
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection* tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
-//    const TargetPhrase* p_ptr = NULL;
-    const Phrase* p_ptr = NULL;
-    TargetPhrase* tp_ptr = NULL;
-    bool found = false;
-    size_t tp_pos=0;
-    while (!found && tp_pos < tpc->GetSize()) {
-      tp_ptr = (TargetPhrase*) tpc->GetTargetPhrase(tp_pos);
-      p_ptr = (const TargetPhrase*) tp_ptr;
-      if ((Phrase) tp == *p_ptr) {
+    // here we have to copy the target phrases into a new entry
+    // and then update or add the given one
+
+    const CacheEntry &old = *(it->second);
+    for (size_t tp_pos = 0; tp_pos < old.targets.GetSize(); ++tp_pos) {
+      std::auto_ptr<TargetPhrase> tp_ptr(new TargetPhrase(*old.targets.GetTargetPhrase(tp_pos)));
+      int64_t tp_stamp = old.stamps[tp_pos];
+      if (!found && (Phrase) tp == *((const Phrase*) tp_ptr.get())) {
         found = true;
-        continue;
+        if (!waString.empty()) tp_ptr->SetAlignmentInfo(waString);
+        tp_stamp = stamp;
+        VERBOSE(3,"sp:|" << sp << "tp:|" << tp << "| UPDATED" << std::endl);
       }
-      tp_pos++;
-    }
-    if (!found) {
-      VERBOSE(3,"tp:|" << tp << "| NOT FOUND" << std::endl);
-      std::auto_ptr<TargetPhrase> targetPhrase(new TargetPhrase(tp));
-
-      targetPhrase->GetScoreBreakdown().Assign(this, GetPreComputedScores(age));
-      if (!waString.empty()) targetPhrase->SetAlignmentInfo(waString);
-
-      tpc->Add(targetPhrase.release());
-
-      tp_pos = tpc->GetSize()-1;
-      ac->push_back(age);
-      m_entries++;
-      VERBOSE(3,"sp:|" << sp << "tp:|" << tp << "| INSERTED" << std::endl);
-    } else {
-      tp_ptr->GetScoreBreakdown().Assign(this, GetPreComputedScores(age));
-      if (!waString.empty()) tp_ptr->SetAlignmentInfo(waString);
-      ac->at(tp_pos) = age;
-      VERBOSE(3,"sp:|" << sp << "tp:|" << tp << "| UPDATED" << std::endl);
+      entry->targets.Add(tp_ptr.release());
+      entry->stamps.push_back(tp_stamp);
     }
   } else {
     VERBOSE(3,"sp:|" << sp << "| NOT FOUND" << std::endl);
-    // p is not found
-    // create target collection
-    // we have to create new target collection age pair and add new entry to target collection age pair
-
-    TargetPhraseCollection* tpc = new TargetPhraseCollection();
-    AgeCollection* ac = new AgeCollection();
-    m_cacheTM.insert(make_pair(sp,make_pair(tpc,ac)));
-
-    //tp is not found
+  }
+  if (!found) {
+    VERBOSE(3,"tp:|" << tp << "| NOT FOUND" << std::endl);
     std::auto_ptr<TargetPhrase> targetPhrase(new TargetPhrase(tp));
-    targetPhrase->GetScoreBreakdown().Assign(this, GetPreComputedScores(age));
     if (!waString.empty()) targetPhrase->SetAlignmentInfo(waString);
 
-    tpc->Add(targetPhrase.release());
-    ac->push_back(age);
+    entry->targets.Add(targetPhrase.release());
+    entry->stamps.push_back(stamp);
     m_entries++;
     VERBOSE(3,"sp:|" << sp << "| tp:|" << tp << "| INSERTED" << std::endl);
   }
+
+  if (m_constant == false) {
+    m_expiry.insert(std::make_pair(stamp + m_maxAge + 1, sp));
+  }
+  Publish(sp, entry.release());
+}
+
+void PhraseDictionaryDynamicCacheBased::Publish(const Phrase &sp, CacheEntry *entry)
+{
+  CacheEntryPtr next(entry);
+  // released after the lock, so readers never wait for its destructor
+  CacheEntryPtr previous;
+#ifdef WITH_THREADS
+  boost::unique_lock<boost::shared_mutex> lock(m_cacheLock);
+#endif
+  if (entry) {
+    CacheEntryPtr &slot = m_cacheTM[sp];
+    previous.swap(slot);
+    slot.swap(next);
+  } else {
+    cacheMap::iterator it = m_cacheTM.find(sp);
+    if (it != m_cacheTM.end()) {
+      previous.swap(it->second);
+      m_cacheTM.erase(it);
+    }
+  }
 }
 
 void PhraseDictionaryDynamicCacheBased::Decay()
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
-  cacheMap::iterator it;
-  for(it = m_cacheTM.begin(); it!=m_cacheTM.end(); it++) {
-    Decay((*it).first);
+  {
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
+#endif
+    ++m_epoch; // every entry is now one older
+  }
+  // only the source phrases whose targets may have decayed fully are visited
+  while (!m_expiry.empty() && m_expiry.begin()->first <= m_epoch) {
+    Decay(m_expiry.begin()->second);
+    m_expiry.erase(m_expiry.begin());
   }
 }
 
@@ -634,42 +644,37 @@ void PhraseDictionaryDynamicCacheBased::Decay(Phrase sp)
     VERBOSE(3,"found:|" << sp << "|" << std::endl);
     //sp is found
 
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection* tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
-
-    //loop in inverted order to allow a correct deletion of std::vectors tpc and ac
-    for (int tp_pos = tpc->GetSize() - 1 ; tp_pos >= 0; tp_pos--) {
-      unsigned int tp_age = ac->at(tp_pos); //increase the age by 1
-      tp_age++; //increase the age by 1
-      VERBOSE(3,"sp:|" << sp << "| " << " new tp_age:|" << tp_age << "|" << std::endl);
-
-      TargetPhrase* tp_ptr = (TargetPhrase*) tpc->GetTargetPhrase(tp_pos);
-
-      if (tp_age > m_maxAge) {
-        VERBOSE(3,"tp_age:|" << tp_age << "| TOO BIG" << std::endl);
-        tpc->Remove(tp_pos); //delete entry in the Target Phrase Collection
-        ac->erase(ac->begin() + tp_pos); //delete entry in the Age Collection
-        m_entries--;
-      } else {
-        VERBOSE(3,"tp_age:|" << tp_age << "| STILL GOOD" << std::endl);
-        tp_ptr->GetScoreBreakdown().Assign(this, GetPreComputedScores(tp_age));
-        ac->at(tp_pos) = tp_age;
+    const CacheEntry &old = *(it->second);
+    size_t expired = 0;
+    for (size_t tp_pos = 0; tp_pos < old.targets.GetSize(); ++tp_pos) {
+      if (m_epoch - old.stamps[tp_pos] > (int64_t) m_maxAge) {
+        ++expired;
       }
     }
-    if (tpc->GetSize() == 0) {
-      // delete the entry from m_cacheTM in case it points to an empty TargetPhraseCollection and AgeCollection
-      (((*it).second).second)->clear();
-      delete ((*it).second).second;
-      delete ((*it).second).first;
-      m_cacheTM.erase(sp);
+    // the targets may have been updated since this eviction was scheduled
+    if (expired == 0) {
+      return;
+    }
+
+    std::auto_ptr<CacheEntry> entry;
+    if (expired < old.targets.GetSize()) {
+      entry.reset(new CacheEntry());
+      for (size_t tp_pos = 0; tp_pos < old.targets.GetSize(); ++tp_pos) {
+        if (m_epoch - old.stamps[tp_pos] > (int64_t) m_maxAge) {
+          VERBOSE(3,"tp_age:|" << m_epoch - old.stamps[tp_pos] << "| TOO BIG" << std::endl);
+          continue;
+        }
+        entry->targets.Add(new TargetPhrase(*old.targets.GetTargetPhrase(tp_pos)));
+        entry->stamps.push_back(old.stamps[tp_pos]);
+      }
     }
+    m_entries -= expired;
+    // an empty entry is deleted from m_cacheTM
+    Publish(sp, entry.release());
   } else {
     //do nothing
     VERBOSE(3,"sp:|" << sp << "| NOT FOUND" << std::endl);
   }
-
-  //put here the removal of entries with age greater than m_maxAge
 }
 
 void PhraseDictionaryDynamicCacheBased::Execute(std::string command)
@@ -701,15 +706,16 @@ void PhraseDictionaryDynamicCacheBased::Execute_Single_Command(std::string comma
 void PhraseDictionaryDynamicCacheBased::Clear()
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  boost::mutex::scoped_lock lock(m_updateLock);
 #endif
-  cacheMap::const_iterator it;
-  for(it = m_cacheTM.begin(); it!=m_cacheTM.end(); it++) {
-    (((*it).second).second)->clear();
-    delete ((*it).second).second;
-    delete ((*it).second).first;
+  cacheMap previous;
+  {
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::shared_mutex> write_lock(m_cacheLock);
+#endif
+    m_cacheTM.swap(previous);
   }
-  m_cacheTM.clear();
+  m_expiry.clear();
   m_entries = 0;
 }
 
@@ -746,9 +752,9 @@ void PhraseDictionaryDynamicCacheBased::Print() const
   cacheMap::const_iterator it;
   for(it = m_cacheTM.begin(); it!=m_cacheTM.end(); it++) {
     std::string source = (it->first).ToString();
-    TargetPhraseCollection* tpc = (it->second).first;
-    TargetPhraseCollection::iterator itr;
-    for(itr = tpc->begin(); itr != tpc->end(); itr++) {
+    const TargetPhraseCollection &tpc = (it->second)->targets;
+    TargetPhraseCollection::const_iterator itr;
+    for(itr = tpc.begin(); itr != tpc.end(); itr++) {
       std::string target = (*itr)->ToString();
       std::cout << source << " ||| " << target << std::endl;
     }
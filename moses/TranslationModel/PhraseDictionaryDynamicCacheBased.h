@@ -25,7 +25,10 @@
 #include "moses/TypeDef.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
 
+#include <boost/shared_ptr.hpp>
+
 #ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/locks.hpp>
 #endif
@@ -48,16 +51,32 @@ class ChartCellCollectionBase;
 class ChartRuleLookupManager;
 
 /** Implementation of a Cache-based phrase table.
+ *
+ * Ages are not stored.  Each target phrase records the epoch at which its age
+ * was 0, and every Insert into a decaying cache advances the epoch, so aging
+ * the whole cache costs one increment.  Scores are assigned from the age when
+ * a collection is looked up.
+ *
+ * An entry in the map is never modified once published: writers build a new
+ * CacheEntry and swap the pointer.  A reader holds m_cacheLock only to find
+ * the entry and copy the pointer, then works on that snapshot.
  */
 class PhraseDictionaryDynamicCacheBased : public PhraseDictionary
 {
 
-  typedef std::vector<unsigned int> AgeCollection;
-  typedef std::pair<TargetPhraseCollection*, AgeCollection*> TargetCollectionAgePair;
-  typedef std::map<Phrase, TargetCollectionAgePair> cacheMap;
+  struct CacheEntry {
+    TargetPhraseCollection targets;
+    std::vector<int64_t> stamps; // epoch at which each target had age 0
+  };
+  typedef boost::shared_ptr<const CacheEntry> CacheEntryPtr;
+  typedef std::map<Phrase, CacheEntryPtr> cacheMap;
+  // epoch at which the targets of a source phrase may have decayed fully
+  typedef std::multimap<int64_t, Phrase> expiryMap;
 
   // data structure for the cache
   cacheMap m_cacheTM;
+  expiryMap m_expiry;
+  int64_t m_epoch;
   std::vector<Scores> precomputedScores;
   unsigned int m_maxAge;
   size_t m_score_type; //scoring type of the match
@@ -68,8 +87,10 @@ class PhraseDictionaryDynamicCacheBased : public PhraseDictionary
   std::string m_name; // internal name to identify this instance of the Cache-based phrase table
 
 #ifdef WITH_THREADS
-  //multiple readers - single writer lock
+  //held by readers to copy an entry and by writers to publish one
   mutable boost::shared_mutex m_cacheLock;
+  //serializes writers, which then read m_cacheTM without m_cacheLock
+  boost::mutex m_updateLock;
 #endif
 
   friend std::ostream& operator<<(std::ostream&, const PhraseDictionaryDynamicCacheBased&);
@@ -148,8 +169,9 @@ protected:
   float decaying_score(const int age);  // calculates the decay score given the age
   void Insert(std::vector<std::string> entries);
 
-  void Decay();   // traverse through the cache and decay each entry
-  void Decay(Phrase p);   // traverse through the cache and decay each entry for a given Phrase
+  void Decay();   // age the cache by one and evict the entries that decayed fully
+  void Decay(Phrase p);   // evict the entries of a given Phrase that decayed fully; caller holds m_updateLock
+  void Publish(const Phrase &sp, CacheEntry *entry);   // replace the entry of sp, or remove it if entry is NULL
   void Update(std::vector<std::string> entries, std::string ageString);
   void Update(std::string sourceString, std::string targetString, std::string ageString, std::string waString="");
   void Update(Phrase p, TargetPhrase tp, int age, std::string waString="");
@@ -166,7 +188,7 @@ protected:
 
 
   void SetPreComputedScores(const unsigned int numScoreComponent);
-  Scores GetPreComputedScores(const unsigned int age);
+  Scores GetPreComputedScores(const unsigned int age) const;
 
   void Load_Multiple_Files(std::vector<std::string> files);
   void Load_Single_File(const std::string file);
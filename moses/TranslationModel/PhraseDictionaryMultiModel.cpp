@@ -20,13 +20,193 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "moses/TranslationModel/PhraseDictionaryMultiModel.h"
 
+#include <boost/functional/hash.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#endif
+
 using namespace std;
 
 namespace Moses
 
 {
+
+MultiModelTargetPhrases::MultiModelTargetPhrases(const std::vector<FactorType> &output, size_t width)
+  : m_width(width)
+  , m_index(16, OutputHash(output), OutputEqual(output))
+{
+}
+
+MultiModelTargetPhrases::~MultiModelTargetPhrases()
+{
+  RemoveAllInColl(m_phrases);
+}
+
+size_t MultiModelTargetPhrases::OutputHash::operator()(const Phrase *phrase) const
+{
+  size_t seed = phrase->GetSize();
+  for (size_t pos = 0; pos < phrase->GetSize(); ++pos) {
+    const Word &word = phrase->GetWord(pos);
+    for (size_t i = 0; i < m_output->size(); ++i) {
+      // factors are unique, so their addresses identify them
+      boost::hash_combine(seed, word[(*m_output)[i]]);
+    }
+  }
+  return seed;
+}
+
+bool MultiModelTargetPhrases::OutputEqual::operator()(const Phrase *a, const Phrase *b) const
+{
+  if (a->GetSize() != b->GetSize()) {
+    return false;
+  }
+  for (size_t pos = 0; pos < a->GetSize(); ++pos) {
+    const Word &wordA = a->GetWord(pos);
+    const Word &wordB = b->GetWord(pos);
+    for (size_t i = 0; i < m_output->size(); ++i) {
+      if (wordA[(*m_output)[i]] != wordB[(*m_output)[i]]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+size_t MultiModelTargetPhrases::Find(const Phrase &phrase) const
+{
+  Index::const_iterator it = m_index.find(&phrase);
+  return it == m_index.end() ? NOT_FOUND : it->second;
+}
+
+size_t MultiModelTargetPhrases::Add(TargetPhrase *targetPhrase)
+{
+  size_t k = m_phrases.size();
+  m_phrases.push_back(targetPhrase);
+  m_scores.resize(m_scores.size() + m_width, 0);
+  m_index[targetPhrase] = k;
+  return k;
+}
+
+#ifdef WITH_THREADS
+namespace
+{
+
+// Runs one job at a time on its own thread.
+class LookupThread : boost::noncopyable
+{
+public:
+  LookupThread() : m_busy(false), m_stop(false) {
+    m_thread.reset(new boost::thread(boost::bind(&LookupThread::Run, this)));
+  }
+
+  ~LookupThread() {
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_stop = true;
+    }
+    m_changed.notify_all();
+    m_thread->join();
+  }
+
+  void Start(const boost::function<void ()> &job) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_job = job;
+    m_error.clear();
+    m_busy = true;
+    m_changed.notify_all();
+  }
+
+  // Wait for the job; returns the message of its exception, or "".
+  std::string Wait() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (m_busy) {
+      m_changed.wait(lock);
+    }
+    return m_error;
+  }
+
+private:
+  void Run() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (true) {
+      while (!m_busy && !m_stop) {
+        m_changed.wait(lock);
+      }
+      if (!m_busy) {
+        return;
+      }
+      lock.unlock();
+      std::string error;
+      try {
+        m_job();
+      } catch (const std::exception &e) {
+        error = e.what();
+      }
+      lock.lock();
+      m_error = error;
+      m_busy = false;
+      m_changed.notify_all();
+    }
+  }
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_changed;
+  boost::function<void ()> m_job;
+  std::string m_error;
+  bool m_busy, m_stop;
+  boost::scoped_ptr<boost::thread> m_thread;
+};
+
+void LookupComponent(const PhraseDictionary *pd, const Phrase *src, const TargetPhraseCollection **out)
+{
+  *out = pd->GetTargetPhraseCollectionLEGACY(*src);
+}
+
+} // namespace
+
+class MultiModelLookupThreads
+{
+public:
+  explicit MultiModelLookupThreads(size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      m_threads.push_back(new LookupThread());
+    }
+  }
+
+  // Run jobs[i] on thread i and the caller's job here, then throw the first error.
+  void RunAll(const std::vector<boost::function<void ()> > &jobs, const boost::function<void ()> &here) {
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      m_threads[i].Start(jobs[i]);
+    }
+    std::string error;
+    try {
+      if (here) here();
+    } catch (const std::exception &e) {
+      error = e.what();
+    }
+    // the jobs refer to the caller's data, so wait for all of them
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      std::string threadError = m_threads[i].Wait();
+      if (error.empty()) error = threadError;
+    }
+    UTIL_THROW_IF2(!error.empty(), error);
+  }
+
+private:
+  boost::ptr_vector<LookupThread> m_threads;
+};
+#endif
+
 PhraseDictionaryMultiModel::PhraseDictionaryMultiModel(const std::string &line)
   :PhraseDictionary(line, true)
+  ,m_parallelLookup(false)
 {
   ReadParameters();
 
@@ -55,6 +235,7 @@ PhraseDictionaryMultiModel::PhraseDictionaryMultiModel(const std::string &line)
 
 PhraseDictionaryMultiModel::PhraseDictionaryMultiModel(int type, const std::string &line)
   :PhraseDictionary(line, true)
+  ,m_parallelLookup(false)
 {
   if (type == 1) {
     // PhraseDictionaryMultiModelCounts
@@ -73,6 +254,8 @@ void PhraseDictionaryMultiModel::SetParameter(const std::string& key, const std:
     m_numModels = m_pdStr.size();
   } else if (key == "lambda") {
     m_multimodelweights = Tokenize<float>(value, ",");
+  } else if (key == "parallel-lookup") {
+    m_parallelLookup = Scan<bool>(value);
   } else {
     PhraseDictionary::SetParameter(key, value);
   }
@@ -109,11 +292,9 @@ const TargetPhraseCollection *PhraseDictionaryMultiModel::GetTargetPhraseCollect
   TargetPhraseCollection *ret = NULL;
 
   if (m_mode == "interpolate") {
-    std::map<std::string,multiModelStatistics*>* allStats = new(std::map<std::string,multiModelStatistics*>);
+    MultiModelTargetPhrases allStats(m_output, m_numScoreComponents * m_numModels);
     CollectSufficientStatistics(src, allStats);
     ret = CreateTargetPhraseCollectionLinearInterpolation(src, allStats, multimodelweights);
-    RemoveAllInMap(*allStats);
-    delete allStats;
   } else if (m_mode == "all") {
     ret = CreateTargetPhraseCollectionAll(src, false);
   } else if (m_mode == "all-restrict") {
@@ -127,15 +308,36 @@ const TargetPhraseCollection *PhraseDictionaryMultiModel::GetTargetPhraseCollect
 }
 
 
-void PhraseDictionaryMultiModel::CollectSufficientStatistics(const Phrase& src, std::map<std::string,multiModelStatistics*>* allStats) const
+void PhraseDictionaryMultiModel::LookupComponents(const Phrase& src, std::vector<const TargetPhraseCollection*> &collections) const
 {
+  collections.assign(m_numModels, NULL);
+#ifdef WITH_THREADS
+  if (m_parallelLookup && m_numModels > 1) {
+    std::vector<boost::function<void ()> > jobs;
+    for(size_t i = 1; i < m_numModels; ++i) {
+      jobs.push_back(boost::bind(&LookupComponent, m_pd[i], &src, &collections[i]));
+    }
+    GetLookupThreads().RunAll(jobs, boost::bind(&LookupComponent, m_pd[0], &src, &collections[0]));
+    return;
+  }
+#endif
+  for(size_t i = 0; i < m_numModels; ++i) {
+    collections[i] = m_pd[i]->GetTargetPhraseCollectionLEGACY(src);
+  }
+}
+
+void PhraseDictionaryMultiModel::CollectSufficientStatistics(const Phrase& src, MultiModelTargetPhrases &allStats) const
+{
+  std::vector<const TargetPhraseCollection*> collections;
+  LookupComponents(src, collections);
+
   for(size_t i = 0; i < m_numModels; ++i) {
     const PhraseDictionary &pd = *m_pd[i];
 
-    TargetPhraseCollection *ret_raw = (TargetPhraseCollection*)  pd.GetTargetPhraseCollectionLEGACY( src);
+    const TargetPhraseCollection *ret_raw = collections[i];
     if (ret_raw != NULL) {
 
-      TargetPhraseCollection::iterator iterTargetPhrase, iterLast;
+      TargetPhraseCollection::const_iterator iterTargetPhrase, iterLast;
       if (m_tableLimit != 0 && ret_raw->GetSize() > m_tableLimit) {
         iterLast = ret_raw->begin() + m_tableLimit;
       } else {
@@ -146,78 +348,82 @@ void PhraseDictionaryMultiModel::CollectSufficientStatistics(const Phrase& src,
         const TargetPhrase * targetPhrase = *iterTargetPhrase;
         std::vector<float> raw_scores = targetPhrase->GetScoreBreakdown().GetScoresForProducer(&pd);
 
-        std::string targetString = targetPhrase->GetStringRep(m_output);
-        if (allStats->find(targetString) == allStats->end()) {
+        size_t k = allStats.Find(*targetPhrase);
+        if (k == NOT_FOUND) {
 
-          multiModelStatistics * statistics = new multiModelStatistics;
-          statistics->targetPhrase = new TargetPhrase(*targetPhrase); //make a copy so that we don't overwrite the original phrase table info
-          statistics->p.resize(m_numScoreComponents);
-          for(size_t j = 0; j < m_numScoreComponents; ++j) {
-            statistics->p[j].resize(m_numModels);
-          }
+          TargetPhrase *statistics = new TargetPhrase(*targetPhrase); //make a copy so that we don't overwrite the original phrase table info
 
           //correct future cost estimates and total score
-          statistics->targetPhrase->GetScoreBreakdown().InvertDenseFeatures(&pd);
+          statistics->GetScoreBreakdown().InvertDenseFeatures(&pd);
           vector<FeatureFunction*> pd_feature;
           pd_feature.push_back(m_pd[i]);
           const vector<FeatureFunction*> pd_feature_const(pd_feature);
-          statistics->targetPhrase->EvaluateInIsolation(src, pd_feature_const);
+          statistics->EvaluateInIsolation(src, pd_feature_const);
           // zero out scores from original phrase table
-          statistics->targetPhrase->GetScoreBreakdown().ZeroDenseFeatures(&pd);
-
-          (*allStats)[targetString] = statistics;
+          statistics->GetScoreBreakdown().ZeroDenseFeatures(&pd);
 
+          k = allStats.Add(statistics);
         }
-        multiModelStatistics * statistics = (*allStats)[targetString];
 
+        // row k holds score j of model i at j * m_numModels + i
+        float *p = allStats.GetRow(k);
         for(size_t j = 0; j < m_numScoreComponents; ++j) {
-          statistics->p[j][i] = UntransformScore(raw_scores[j]);
+          p[j * m_numModels + i] = UntransformScore(raw_scores[j]);
         }
-
-        (*allStats)[targetString] = statistics;
       }
     }
   }
 }
 
-TargetPhraseCollection* PhraseDictionaryMultiModel::CreateTargetPhraseCollectionLinearInterpolation(const Phrase& src, std::map<std::string,multiModelStatistics*>* allStats, std::vector<std::vector<float> > &multimodelweights) const
+TargetPhraseCollection* PhraseDictionaryMultiModel::CreateTargetPhraseCollectionLinearInterpolation(const Phrase& src, MultiModelTargetPhrases &allStats, std::vector<std::vector<float> > &multimodelweights) const
 {
-  TargetPhraseCollection *ret = new TargetPhraseCollection();
-  for ( std::map< std::string, multiModelStatistics*>::const_iterator iter = allStats->begin(); iter != allStats->end(); ++iter ) {
+  // weights in the layout of a row of statistics, so scoring a phrase is one pass over its row
+  std::vector<float> weights(m_numScoreComponents * m_numModels);
+  for(size_t i = 0; i < m_numScoreComponents; ++i) {
+    std::copy(multimodelweights[i].begin(), multimodelweights[i].end(), weights.begin() + i * m_numModels);
+  }
 
-    multiModelStatistics * statistics = iter->second;
+  vector<FeatureFunction*> pd_feature;
+  pd_feature.push_back(const_cast<PhraseDictionaryMultiModel*>(this));
+  const vector<FeatureFunction*> pd_feature_const(pd_feature);
 
-    Scores scoreVector(m_numScoreComponents);
+  TargetPhraseCollection *ret = new TargetPhraseCollection();
+  Scores scoreVector(m_numScoreComponents);
+  for (size_t k = 0; k < allStats.GetSize(); ++k) {
 
+    const float *p = allStats.GetRow(k);
     for(size_t i = 0; i < m_numScoreComponents; ++i) {
-      scoreVector[i] = TransformScore(std::inner_product(statistics->p[i].begin(), statistics->p[i].end(), multimodelweights[i].begin(), 0.0));
+      const float *begin = p + i * m_numModels;
+      scoreVector[i] = TransformScore(std::inner_product(begin, begin + m_numModels, &weights[i * m_numModels], 0.0));
     }
 
-    statistics->targetPhrase->GetScoreBreakdown().Assign(this, scoreVector);
+    TargetPhrase &targetPhrase = allStats.GetTargetPhrase(k);
+    targetPhrase.GetScoreBreakdown().Assign(this, scoreVector);
 
     //correct future cost estimates and total score
-    vector<FeatureFunction*> pd_feature;
-    pd_feature.push_back(const_cast<PhraseDictionaryMultiModel*>(this));
-    const vector<FeatureFunction*> pd_feature_const(pd_feature);
-    statistics->targetPhrase->EvaluateInIsolation(src, pd_feature_const);
+    targetPhrase.EvaluateInIsolation(src, pd_feature_const);
 
-    ret->Add(new TargetPhrase(*statistics->targetPhrase));
+    ret->Add(new TargetPhrase(targetPhrase));
   }
   return ret;
 }
 
 TargetPhraseCollection* PhraseDictionaryMultiModel::CreateTargetPhraseCollectionAll(const Phrase& src, const bool restricted) const
 {
+  std::vector<const TargetPhraseCollection*> collections;
+  LookupComponents(src, collections);
+
   // Collect phrases from all models
-  std::map<std::string, multiModelPhrase*> allPhrases;
+  // a row contains scores from all models in order.  Values default to zero for models that do not contain phrase.
+  MultiModelTargetPhrases allPhrases(m_output, m_numScoreComponents);
   size_t offset = 0;
   for(size_t i = 0; i < m_numModels; ++i) {
     const PhraseDictionary &pd = *m_pd[i];
 
-    TargetPhraseCollection *ret_raw = (TargetPhraseCollection*) pd.GetTargetPhraseCollectionLEGACY(src);
+    const TargetPhraseCollection *ret_raw = collections[i];
     if (ret_raw != NULL) {
 
-      TargetPhraseCollection::iterator iterTargetPhrase, iterLast;
+      TargetPhraseCollection::const_iterator iterTargetPhrase, iterLast;
       if (m_tableLimit != 0 && ret_raw->GetSize() > m_tableLimit) {
         iterLast = ret_raw->begin() + m_tableLimit;
       } else {
@@ -228,35 +434,31 @@ TargetPhraseCollection* PhraseDictionaryMultiModel::CreateTargetPhraseCollection
         const TargetPhrase* targetPhrase = *iterTargetPhrase;
         std::vector<float> raw_scores = targetPhrase->GetScoreBreakdown().GetScoresForProducer(&pd);
 
-        std::string targetString = targetPhrase->GetStringRep(m_output);
+        size_t k = allPhrases.Find(*targetPhrase);
         // Phrase not in collection -> add if unrestricted (all) or first model (all-restrict)
-        if (allPhrases.find(targetString) == allPhrases.end()) {
+        if (k == NOT_FOUND) {
           // all-restrict and not first model: skip adding unseen phrase
           if (restricted && i > 0) {
             continue;
           }
 
-          multiModelPhrase* phrase = new multiModelPhrase;
-          phrase->targetPhrase = new TargetPhrase(*targetPhrase); //make a copy so that we don't overwrite the original phrase table info
-          // p contains scores from all models in order.  Values default to zero for models that do not contain phrase.
-          phrase->p.resize(m_numScoreComponents, 0);
+          TargetPhrase *phrase = new TargetPhrase(*targetPhrase); //make a copy so that we don't overwrite the original phrase table info
 
           //correct future cost estimates and total score
-          phrase->targetPhrase->GetScoreBreakdown().InvertDenseFeatures(&pd);
+          phrase->GetScoreBreakdown().InvertDenseFeatures(&pd);
           vector<FeatureFunction*> pd_feature;
           pd_feature.push_back(m_pd[i]);
           const vector<FeatureFunction*> pd_feature_const(pd_feature);
-          phrase->targetPhrase->EvaluateInIsolation(src, pd_feature_const);
+          phrase->EvaluateInIsolation(src, pd_feature_const);
           // zero out scores from original phrase table
-          phrase->targetPhrase->GetScoreBreakdown().ZeroDenseFeatures(&pd);
-
-          allPhrases[targetString] = phrase;
+          phrase->GetScoreBreakdown().ZeroDenseFeatures(&pd);
 
+          k = allPhrases.Add(phrase);
         }
-        multiModelPhrase* phrase = allPhrases[targetString];
 
+        float *p = allPhrases.GetRow(k);
         for(size_t j = 0; j < pd.GetNumScoreComponents(); ++j) {
-          phrase->p[offset + j] = raw_scores[j];
+          p[offset + j] = raw_scores[j];
         }
       }
     }
@@ -264,28 +466,25 @@ TargetPhraseCollection* PhraseDictionaryMultiModel::CreateTargetPhraseCollection
   }
 
   // Copy accumulated score vectors to phrases
+  vector<FeatureFunction*> pd_feature;
+  pd_feature.push_back(const_cast<PhraseDictionaryMultiModel*>(this));
+  const vector<FeatureFunction*> pd_feature_const(pd_feature);
+
   TargetPhraseCollection* ret = new TargetPhraseCollection();
-  for (std::map<std::string, multiModelPhrase*>::const_iterator iter = allPhrases.begin(); iter != allPhrases.end(); ++iter) {
+  for (size_t k = 0; k < allPhrases.GetSize(); ++k) {
 
-    multiModelPhrase* phrase = iter->second;
-    Scores scoreVector(m_numScoreComponents);
+    const float *p = allPhrases.GetRow(k);
+    Scores scoreVector(p, p + m_numScoreComponents);
 
-    for(size_t i = 0; i < m_numScoreComponents; ++i) {
-      scoreVector[i] = phrase->p[i];
-    }
-
-    phrase->targetPhrase->GetScoreBreakdown().Assign(this, scoreVector);
+    TargetPhrase &phrase = allPhrases.GetTargetPhrase(k);
+    phrase.GetScoreBreakdown().Assign(this, scoreVector);
 
     //correct future cost estimates and total score
-    vector<FeatureFunction*> pd_feature;
-    pd_feature.push_back(const_cast<PhraseDictionaryMultiModel*>(this));
-    const vector<FeatureFunction*> pd_feature_const(pd_feature);
-    phrase->targetPhrase->EvaluateInIsolation(src, pd_feature_const);
+    phrase.EvaluateInIsolation(src, pd_feature_const);
 
-    ret->Add(new TargetPhrase(*phrase->targetPhrase));
+    ret->Add(new TargetPhrase(phrase));
   }
 
-  RemoveAllInMap(allPhrases);
   return ret;
 }
 
@@ -386,8 +585,45 @@ void  PhraseDictionaryMultiModel::CleanUpComponentModels(const InputType &source
   for(size_t i = 0; i < m_numModels; ++i) {
     m_pd[i]->CleanUpAfterSentenceProcessing(source);
   }
+#ifdef WITH_THREADS
+  // and the memory the components kept for the helper threads
+  if (m_parallelLookup && m_numModels > 1) {
+    std::vector<boost::function<void ()> > jobs;
+    for(size_t i = 1; i < m_numModels; ++i) {
+      jobs.push_back(boost::bind(&PhraseDictionary::CleanUpAfterSentenceProcessing, m_pd[i], boost::cref(source)));
+    }
+    GetLookupThreads().RunAll(jobs, boost::function<void ()>());
+  }
+#endif
+}
+
+void PhraseDictionaryMultiModel::InitializeForInput(ttasksptr const& ttask)
+{
+  /* Don't do anything source specific here as this object is shared between threads.*/
+#ifdef WITH_THREADS
+  // the decoder initializes the components for this thread, but not for its helpers
+  if (m_parallelLookup && m_numModels > 1) {
+    std::vector<boost::function<void ()> > jobs;
+    for(size_t i = 1; i < m_numModels; ++i) {
+      jobs.push_back(boost::bind(&PhraseDictionary::InitializeForInput, m_pd[i], boost::cref(ttask)));
+    }
+    GetLookupThreads().RunAll(jobs, boost::function<void ()>());
+  }
+#endif
 }
 
+#ifdef WITH_THREADS
+MultiModelLookupThreads &PhraseDictionaryMultiModel::GetLookupThreads() const
+{
+  MultiModelLookupThreads *threads = m_lookupThreads.get();
+  if (threads == NULL) {
+    threads = new MultiModelLookupThreads(m_numModels - 1);
+    m_lookupThreads.reset(threads);
+  }
+  return *threads;
+}
+#endif
+
 const std::vector<float>* PhraseDictionaryMultiModel::GetTemporaryMultiModelWeightsVector() const
 {
 #ifdef WITH_THREADS
@@ -431,28 +667,31 @@ vector<float> PhraseDictionaryMultiModel::MinimizePerplexity(vector<pair<string,
     string target_string = phrase_pair.second;
 
     vector<float> fs(m_numModels);
-    map<string,multiModelStatistics*>* allStats = new(map<string,multiModelStatistics*>);
+    MultiModelTargetPhrases allStats(m_output, m_numScoreComponents * m_numModels);
 
     Phrase sourcePhrase(0);
     sourcePhrase.CreateFromString(Input, m_input, source_string, NULL);
 
     CollectSufficientStatistics(sourcePhrase, allStats); //optimization potential: only call this once per source phrase
 
+    Phrase targetPhrase(0);
+    targetPhrase.CreateFromString(Output, m_output, target_string, NULL);
+
     //phrase pair not found; leave cache empty
-    if (allStats->find(target_string) == allStats->end()) {
-      RemoveAllInMap(*allStats);
-      delete allStats;
+    size_t k = allStats.Find(targetPhrase);
+    if (k == NOT_FOUND) {
       continue;
     }
 
     multiModelStatisticsOptimization* targetStatistics = new multiModelStatisticsOptimization();
-    targetStatistics->targetPhrase = new TargetPhrase(*(*allStats)[target_string]->targetPhrase);
-    targetStatistics->p = (*allStats)[target_string]->p;
+    targetStatistics->targetPhrase = new TargetPhrase(allStats.GetTargetPhrase(k));
+    const float *p = allStats.GetRow(k);
+    targetStatistics->p.resize(m_numScoreComponents);
+    for(size_t j = 0; j < m_numScoreComponents; ++j) {
+      targetStatistics->p[j].assign(p + j * m_numModels, p + (j + 1) * m_numModels);
+    }
     targetStatistics->f = iter->second;
     optimizerStats.push_back(targetStatistics);
-
-    RemoveAllInMap(*allStats);
-    delete allStats;
   }
 
   Sentence sentence;
@@ -23,8 +23,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "moses/TranslationModel/PhraseDictionary.h"
 
 
+#include <boost/noncopyable.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread/tss.hpp>
+#endif
 #include "moses/StaticData.h"
 #include "moses/TargetPhrase.h"
 #include "moses/Util.h"
@@ -49,6 +53,57 @@ struct multiModelStatisticsOptimization: multiModelStatistics {
 };
 
 class OptimizationObjective;
+class MultiModelLookupThreads;
+
+/** Target phrases of one source phrase, merged across the component models.
+ * A target phrase is identified by its output factors, and row k of a dense
+ * score block holds the statistics of phrase k.
+ */
+class MultiModelTargetPhrases : boost::noncopyable
+{
+public:
+  MultiModelTargetPhrases(const std::vector<FactorType> &output, size_t width);
+  ~MultiModelTargetPhrases();
+
+  //! index of the row of phrase, or NOT_FOUND
+  size_t Find(const Phrase &phrase) const;
+  //! add a row of zeros for targetPhrase, which is adopted, and return its index
+  size_t Add(TargetPhrase *targetPhrase);
+
+  size_t GetSize() const {
+    return m_phrases.size();
+  }
+  size_t GetWidth() const {
+    return m_width;
+  }
+  TargetPhrase &GetTargetPhrase(size_t k) {
+    return *m_phrases[k];
+  }
+  float *GetRow(size_t k) {
+    return &m_scores[k * m_width];
+  }
+  const float *GetRow(size_t k) const {
+    return &m_scores[k * m_width];
+  }
+
+private:
+  struct OutputHash {
+    explicit OutputHash(const std::vector<FactorType> &output) : m_output(&output) {}
+    size_t operator()(const Phrase *phrase) const;
+    const std::vector<FactorType> *m_output;
+  };
+  struct OutputEqual {
+    explicit OutputEqual(const std::vector<FactorType> &output) : m_output(&output) {}
+    bool operator()(const Phrase *a, const Phrase *b) const;
+    const std::vector<FactorType> *m_output;
+  };
+  typedef boost::unordered_map<const Phrase*, size_t, OutputHash, OutputEqual> Index;
+
+  size_t m_width;
+  Index m_index;
+  std::vector<TargetPhrase*> m_phrases;
+  std::vector<float> m_scores;
+};
 
 struct multiModelPhrase {
   TargetPhrase *targetPhrase;
@@ -71,8 +126,11 @@ public:
   PhraseDictionaryMultiModel(int type, const std::string &line);
   ~PhraseDictionaryMultiModel();
   void Load();
-  virtual void CollectSufficientStatistics(const Phrase& src, std::map<std::string,multiModelStatistics*>* allStats) const;
-  virtual TargetPhraseCollection* CreateTargetPhraseCollectionLinearInterpolation(const Phrase& src, std::map<std::string,multiModelStatistics*>* allStats, std::vector<std::vector<float> > &multimodelweights) const;
+  std::vector<std::string> GetLoadDependencies() const {
+    return m_pdStr;
+  }
+  virtual void CollectSufficientStatistics(const Phrase& src, MultiModelTargetPhrases &allStats) const;
+  virtual TargetPhraseCollection* CreateTargetPhraseCollectionLinearInterpolation(const Phrase& src, MultiModelTargetPhrases &allStats, std::vector<std::vector<float> > &multimodelweights) const;
   virtual TargetPhraseCollection* CreateTargetPhraseCollectionAll(const Phrase& src, const bool restricted = false) const;
   std::vector<std::vector<float> > getWeights(size_t numWeights, bool normalize) const;
   std::vector<float> normalizeWeights(std::vector<float> &weights) const;
@@ -85,9 +143,7 @@ public:
 #endif
   // functions below required by base class
   virtual const TargetPhraseCollection* GetTargetPhraseCollectionLEGACY(const Phrase& src) const;
-  virtual void InitializeForInput(ttasksptr const& ttask) {
-    /* Don't do anything source specific here as this object is shared between threads.*/
-  }
+  virtual void InitializeForInput(ttasksptr const& ttask);
   ChartRuleLookupManager *CreateRuleLookupManager(const ChartParser &, const ChartCellCollectionBase&, std::size_t);
   void SetParameter(const std::string& key, const std::string& value);
 
@@ -95,11 +151,25 @@ public:
   void SetTemporaryMultiModelWeightsVector(std::vector<float> weights);
 
 protected:
+  //! look up src in every component; collections[i] is NULL if component i has no translation
+  void LookupComponents(const Phrase& src, std::vector<const TargetPhraseCollection*> &collections) const;
+
   std::string m_mode;
   std::vector<std::string> m_pdStr;
   std::vector<PhraseDictionary*> m_pd;
   size_t m_numModels;
   std::vector<float> m_multimodelweights;
+  bool m_parallelLookup;
+
+#ifdef WITH_THREADS
+  /* With parallel-lookup, each decoding thread has one helper thread for
+   * every component after the first.  A component is always queried on the
+   * same helper, and is initialized and cleaned up there too, so components
+   * that keep per-thread state see it as they would from a decoding thread.
+   */
+  MultiModelLookupThreads &GetLookupThreads() const;
+  mutable boost::thread_specific_ptr<MultiModelLookupThreads> m_lookupThreads;
+#endif
 
   typedef std::vector<TargetPhraseCollection*> PhraseCache;
 #ifdef WITH_THREADS
@@ -82,6 +82,13 @@ PhraseDictionaryMultiModelCounts::~PhraseDictionaryMultiModelCounts()
 }
 
 
+std::vector<std::string> PhraseDictionaryMultiModelCounts::GetLoadDependencies() const
+{
+  std::vector<std::string> ret(m_pdStr);
+  ret.insert(ret.end(), m_targetTable.begin(), m_targetTable.end());
+  return ret;
+}
+
 void PhraseDictionaryMultiModelCounts::Load()
 {
   SetFeaturesToApply();
@@ -41,6 +41,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "util/exception.hh"
 
 #include <boost/foreach.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include "ThreadPool.h"
+#endif
 using namespace std;
 
 namespace Moses
@@ -286,24 +291,35 @@ CalcFutureScore()
   //   we leave the +inf in the matrix
   // like in chart parsing we want each cell to contain the highest score
   // of the full-span trOpt or the sum of scores of joining two smaller spans
+  //
+  // Cells are filled by increasing span length from a copy of the matrix
+  // by rows and one by columns, so that the scores of [sPos, joinAt] and of
+  // [joinAt+1, ePos] over all join points are two contiguous arrays.  The
+  // sums are those of the cell by cell loop and max is exact, so the matrix
+  // is the same.
+  std::vector<float> rows(size * size), cols(size * size);
+  for(size_t sPos = 0; sPos < size; sPos++) {
+    for(size_t ePos = sPos; ePos < size; ePos++) {
+      float score = m_futureScore.GetScore(sPos, ePos);
+      rows[sPos * size + ePos] = score;
+      cols[ePos * size + sPos] = score;
+    }
+  }
 
   for(size_t colstart = 1; colstart < size ; colstart++) {
-    for(size_t diagshift = 0; diagshift < size-colstart ; diagshift++) {
-      size_t sPos = diagshift;
-      size_t ePos = colstart+diagshift;
-      for(size_t joinAt = sPos; joinAt < ePos ; joinAt++)  {
-        float joinedScore = m_futureScore.GetScore(sPos, joinAt)
-                            + m_futureScore.GetScore(joinAt+1, ePos);
-        // uncomment to see the cell filling scheme
-        // TRACE_ERR("[" << sPos << "," << ePos << "] <-? ["
-        // 	  << sPos << "," << joinAt << "]+["
-        // 	  << joinAt+1 << "," << ePos << "] (colstart: "
-        // 	  << colstart << ", diagshift: " << diagshift << ")"
-        // 	  << endl);
-
-        if (joinedScore > m_futureScore.GetScore(sPos, ePos))
-          m_futureScore.SetScore(sPos, ePos, joinedScore);
+    for(size_t sPos = 0; sPos < size-colstart ; sPos++) {
+      size_t ePos = colstart+sPos;
+      // left[i] is [sPos, sPos+i], right[i] is [sPos+i+1, ePos]
+      const float *left = &rows[sPos * size + sPos];
+      const float *right = &cols[ePos * size + sPos + 1];
+      float best = rows[sPos * size + ePos];
+      for(size_t i = 0; i < colstart; i++) {
+        float joinedScore = left[i] + right[i];
+        best = joinedScore > best ? joinedScore : best;
       }
+      rows[sPos * size + ePos] = best;
+      cols[ePos * size + sPos] = best;
+      m_futureScore.SetScore(sPos, ePos, best);
     }
   }
 
@@ -336,6 +352,78 @@ CalcFutureScore()
 
 
 
+#ifdef WITH_THREADS
+namespace
+{
+//! progress and first error of the collection tasks of a sentence
+struct CollectStatus {
+  explicit CollectStatus(size_t tasks) : pending(tasks) {}
+  boost::mutex mutex;
+  boost::condition_variable done;
+  size_t pending;
+  std::string error;
+};
+
+boost::mutex s_optionsPoolMutex;
+ThreadPool *s_optionsPool = NULL;
+
+/** The pool that collects translation options, shared by all decoding
+ * threads and never deleted. Its workers are not pinned: each task works for
+ * the decoding thread that submitted it, wherever that thread was placed.
+ */
+ThreadPool &OptionsPool()
+{
+  boost::mutex::scoped_lock lock(s_optionsPoolMutex);
+  if (!s_optionsPool) {
+    s_optionsPool = new ThreadPool(StaticData::Instance().OptionsThreadCount(), false);
+  }
+  return *s_optionsPool;
+}
+
+/** Whether the features can evaluate phrases on the pool's threads, which
+ * never ran InitializeForInput().
+ */
+bool FeaturesEvaluateOnAnyThread()
+{
+  const std::vector<FeatureFunction*> &ffs = FeatureFunction::GetFeatureFunctions();
+  for (size_t i = 0; i < ffs.size(); ++i) {
+    if (ffs[i]->KeepsThreadLocalInputState()) return false;
+  }
+  return true;
+}
+}
+
+/** Collects the translation options of the spans starting at one position.
+ * Tasks write to disjoint rows of m_collection, so they need no locking.
+ */
+class TranslationOptionCollection::CollectTask : public Task
+{
+public:
+  CollectTask(TranslationOptionCollection &coll, size_t startPos, CollectStatus &status)
+    : m_coll(coll), m_startPos(startPos), m_status(status) {
+  }
+
+  void Run() {
+    std::string error;
+    try {
+      m_coll.CreateTranslationOptionsStartingAt(m_startPos);
+    } catch (const std::exception &e) {
+      error = e.what();
+    } catch (...) {
+      error = "unknown exception";
+    }
+    boost::mutex::scoped_lock lock(m_status.mutex);
+    if (!error.empty() && m_status.error.empty()) m_status.error = error;
+    if (--m_status.pending == 0) m_status.done.notify_all();
+  }
+
+private:
+  TranslationOptionCollection &m_coll;
+  size_t m_startPos;
+  CollectStatus &m_status;
+};
+#endif
+
 /** Create all possible translations from the phrase tables
  * for a particular input sentence. This implies applying all
  * translation and generation steps. Also computes future cost matrix.
@@ -348,45 +436,94 @@ CreateTranslationOptions()
   // in the phraseDictionary (which is the- possibly filtered-- phrase
   // table loaded on initialization), generate TranslationOption objects
   // for all phrases
+  CreateTranslationOptionsForAllSpans();
 
+  ProcessUnknownWord();
+  EvaluateWithSourceContext();
+  VERBOSE(3,"Translation Option Collection\n " << *this << endl);
+  Prune();
+  Sort();
+  CalcFutureScore(); // future score matrix
+  CacheLexReordering(); // Cached lex reodering costs
+}
+
+void
+TranslationOptionCollection::
+CreateTranslationOptionsForAllSpans()
+{
+  const size_t size = m_source.GetSize();
+
+#ifdef WITH_THREADS
+  // The phrase tables have been queried by GetTargetPhraseCollectionBatch()
+  // already, except by the legacy tables, which look up each span as it is
+  // created.  The decoding steps after the first evaluate the new phrases
+  // with the other features.
+  const size_t numThreads = StaticData::Instance().OptionsThreadCount();
+  if (numThreads > 1 && size > 1 && !StaticData::Instance().GetUseLegacyPT()
+      && FeaturesEvaluateOnAnyThread()) {
+    CreateTranslationOptionsForAllSpansParallel();
+    return;
+  }
+#endif
+
+  for (size_t sPos = 0 ; sPos < size; sPos++) {
+    CreateTranslationOptionsStartingAt(sPos);
+  }
+}
+
+#ifdef WITH_THREADS
+void
+TranslationOptionCollection::
+CreateTranslationOptionsForAllSpansParallel()
+{
+  const size_t size = m_source.GetSize();
+  CollectStatus status(size);
+  ThreadPool &pool = OptionsPool();
+  for (size_t sPos = 0 ; sPos < size; sPos++) {
+    boost::shared_ptr<Task> task(new CollectTask(*this, sPos, status));
+    pool.Submit(task);
+  }
+  {
+    boost::mutex::scoped_lock lock(status.mutex);
+    while (status.pending) status.done.wait(lock);
+  }
+  UTIL_THROW_IF2(!status.error.empty(), status.error);
+}
+#endif
+
+/** Create the translation options of the spans [startPos, endPos] from
+ * each decoding graph in turn.  A span only depends on the options the
+ * earlier graphs created for the same span, so the start positions are
+ * independent of each other.
+ */
+void
+TranslationOptionCollection::
+CreateTranslationOptionsStartingAt(size_t sPos)
+{
   // there may be multiple decoding graphs (factorizations of decoding)
   const vector <DecodeGraph*> &decodeGraphList
   = StaticData::Instance().GetDecodeGraphs();
 
   // length of the sentence
   const size_t size = m_source.GetSize();
+  size_t maxSize = size - sPos; // don't go over end of sentence
+  size_t maxSizePhrase = StaticData::Instance().GetMaxPhraseLength();
+  maxSize = std::min(maxSize, maxSizePhrase);
 
   // loop over all decoding graphs, each generates translation options
   for (size_t gidx = 0 ; gidx < decodeGraphList.size() ; gidx++) {
-    if (decodeGraphList.size() > 1)
-      VERBOSE(3,"Creating translation options from decoding graph " << gidx << endl);
-
     const DecodeGraph& dg = *decodeGraphList[gidx];
     size_t backoff = dg.GetBackoff();
-    // iterate over spans
-    for (size_t sPos = 0 ; sPos < size; sPos++) {
-      size_t maxSize = size - sPos; // don't go over end of sentence
-      size_t maxSizePhrase = StaticData::Instance().GetMaxPhraseLength();
-      maxSize = std::min(maxSize, maxSizePhrase);
-
-      for (size_t ePos = sPos ; ePos < sPos + maxSize ; ePos++) {
-        if (gidx && backoff &&
-            (ePos-sPos+1 <= backoff || // size exceeds backoff limit (HUH? UG) or ...
-             m_collection[sPos][ePos-sPos].size() > 0)) {
-          VERBOSE(3,"No backoff to graph " << gidx << " for span [" << sPos << ";" << ePos << "]" << endl);
-          continue;
-        }
-        CreateTranslationOptionsForRange(dg, sPos, ePos, true, gidx);
+    for (size_t ePos = sPos ; ePos < sPos + maxSize ; ePos++) {
+      if (gidx && backoff &&
+          (ePos-sPos+1 <= backoff || // size exceeds backoff limit (HUH? UG) or ...
+           m_collection[sPos][ePos-sPos].size() > 0)) {
+        VERBOSE(3,"No backoff to graph " << gidx << " for span [" << sPos << ";" << ePos << "]" << endl);
+        continue;
       }
+      CreateTranslationOptionsForRange(dg, sPos, ePos, true, gidx);
     }
   }
-  ProcessUnknownWord();
-  EvaluateWithSourceContext();
-  VERBOSE(3,"Translation Option Collection\n " << *this << endl);
-  Prune();
-  Sort();
-  CalcFutureScore(); // future score matrix
-  CacheLexReordering(); // Cached lex reodering costs
 }
 
 
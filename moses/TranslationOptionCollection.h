@@ -80,6 +80,17 @@ protected:
 
   void CalcFutureScore();
 
+  //! Create the translation options of all spans starting at startPos, from every decoding graph
+  void CreateTranslationOptionsStartingAt(size_t startPos);
+
+  //! Create the translation options of all spans, one start position at a time or on several threads
+  void CreateTranslationOptionsForAllSpans();
+
+#ifdef WITH_THREADS
+  class CollectTask;
+  void CreateTranslationOptionsForAllSpansParallel();
+#endif
+
   //! Force a creation of a translation option where there are none for a particular source position.
   void ProcessUnknownWord();
   //! special handling of ONE unknown words.
@@ -0,0 +1,281 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2015 University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "ExtractSorter.h"
+#include "OutputFileStream.h"
+#include "util/exception.hh"
+#include "util/file.hh"
+
+using namespace std;
+
+namespace MosesTraining
+{
+
+struct ExtractSorter::LineOrder {
+  const char *base;
+
+  explicit LineOrder(const char *b) : base(b) {}
+
+  bool operator()(const Line &a, const Line &b) const {
+    int cmp = memcmp(base + a.start, base + b.start, min(a.length, b.length));
+    return cmp ? cmp < 0 : a.length < b.length;
+  }
+};
+
+ExtractSorter::ExtractSorter(const string &outputPath, size_t memoryBytes, const string &tempPrefix)
+  : m_outputPath(outputPath)
+  , m_memoryBytes(memoryBytes)
+  , m_tempPrefix(tempPrefix)
+  , m_pending(0)
+  , m_runsFile(NULL)
+  , m_numRuns(0)
+{
+  util::NormalizeTempPrefix(m_tempPrefix);
+  if (boost::algorithm::ends_with(m_outputPath, ".runs")) {
+    util::scoped_fd file(util::CreateOrThrow(m_outputPath.c_str()));
+    m_runsFile = util::FDOpenOrThrow(file);
+  }
+}
+
+ExtractSorter::~ExtractSorter()
+{
+  for (size_t i = 0; i < m_runs.size(); ++i) {
+    fclose(m_runs[i]);
+  }
+  if (m_runsFile) {
+    fclose(m_runsFile);
+  }
+}
+
+void ExtractSorter::Write(const char *data, size_t size)
+{
+  size_t from = m_buffer.size();
+  m_buffer.append(data, size);
+  for (const char *nl; (nl = static_cast<const char*>(memchr(m_buffer.data() + from, '\n', m_buffer.size() - from)));) {
+    Line line;
+    line.start = m_pending;
+    line.length = nl - m_buffer.data() - m_pending;
+    m_lines.push_back(line);
+    m_pending = from = nl - m_buffer.data() + 1;
+  }
+
+  if (m_buffer.size() + m_lines.size() * sizeof(Line) >= m_memoryBytes) {
+    Spill();
+  }
+}
+
+void ExtractSorter::SortLines()
+{
+  sort(m_lines.begin(), m_lines.end(), LineOrder(m_buffer.data()));
+}
+
+void ExtractSorter::Spill()
+{
+  if (m_lines.empty()) return;
+  SortLines();
+
+  std::FILE *run = m_runsFile;
+  if (!run) {
+    run = util::FMakeTemp(m_tempPrefix);
+    m_runs.push_back(run);
+  }
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < m_lines.size(); ++i) {
+    bytes += sizeof(uint32_t) + m_lines[i].length;
+  }
+  util::WriteOrThrow(run, &bytes, sizeof(bytes));
+  for (size_t i = 0; i < m_lines.size(); ++i) {
+    uint32_t length = m_lines[i].length;
+    util::WriteOrThrow(run, &length, sizeof(length));
+    util::WriteOrThrow(run, m_buffer.data() + m_lines[i].start, length);
+  }
+  ++m_numRuns;
+
+  // keep the incomplete line for the next Write()
+  m_buffer.erase(0, m_pending);
+  m_pending = 0;
+  m_lines.clear();
+}
+
+void ExtractSorter::Finish()
+{
+  // a last line without newline is still a line
+  if (m_pending < m_buffer.size()) {
+    Write("\n", 1);
+  }
+
+  if (m_runsFile) {
+    Spill();
+    std::FILE *file = m_runsFile;
+    m_runsFile = NULL;
+    UTIL_THROW_IF2(fclose(file), "Could not close " << m_outputPath);
+    return;
+  }
+
+  Moses::OutputFileStream out(m_outputPath);
+
+  if (m_runs.empty()) {
+    SortLines();
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+      out.write(m_buffer.data() + m_lines[i].start, m_lines[i].length);
+      out.put('\n');
+    }
+  } else {
+    Spill();
+    string().swap(m_buffer);
+    vector<Line>().swap(m_lines);
+
+    SortedRunsReader merged;
+    for (size_t i = 0; i < m_runs.size(); ++i) {
+      UTIL_THROW_IF2(fflush(m_runs[i]), "Could not write sort run");
+      merged.AddRuns(fileno(m_runs[i]));
+    }
+    string line;
+    while (merged.ReadLine(line)) {
+      out << line << '\n';
+    }
+  }
+
+  out.Close();
+}
+
+// one run during the merge, holding its smallest remaining line
+struct SortedRunsReader::Cursor {
+  static const size_t kBufferSize = 1 << 16;
+
+  int fd;
+  uint64_t offset, end; // what is left of the run in the file
+  std::string buffer;
+  size_t bufferPos;
+  std::string line;
+
+  Cursor(int f, uint64_t from, uint64_t to) : fd(f), offset(from), end(to), bufferPos(0) {}
+
+  bool Next() {
+    if (bufferPos == buffer.size() && offset == end) return false;
+    uint32_t length;
+    Read(reinterpret_cast<char*>(&length), sizeof(length));
+    line.resize(length);
+    if (length) Read(&line[0], length);
+    return true;
+  }
+
+  void Read(char *to, size_t size) {
+    while (size) {
+      if (bufferPos == buffer.size()) {
+        UTIL_THROW_IF2(offset == end, "Truncated sort run");
+        buffer.resize(min<uint64_t>(kBufferSize, end - offset));
+        util::ErsatzPRead(fd, &buffer[0], buffer.size(), offset);
+        offset += buffer.size();
+        bufferPos = 0;
+      }
+      size_t got = min(size, buffer.size() - bufferPos);
+      memcpy(to, buffer.data() + bufferPos, got);
+      bufferPos += got;
+      to += got;
+      size -= got;
+    }
+  }
+};
+
+bool SortedRunsReader::CursorGreater::operator()(const Cursor *a, const Cursor *b) const
+{
+  return a->line > b->line;
+}
+
+SortedRunsReader::SortedRunsReader()
+  : m_fd(-1)
+{
+}
+
+SortedRunsReader::SortedRunsReader(const string &path)
+  : m_fd(util::OpenReadOrThrow(path.c_str()))
+{
+  AddRuns(m_fd);
+}
+
+SortedRunsReader::~SortedRunsReader()
+{
+  for (size_t i = 0; i < m_cursors.size(); ++i) {
+    delete m_cursors[i];
+  }
+  if (m_fd != -1) {
+    close(m_fd);
+  }
+}
+
+void SortedRunsReader::AddRuns(int fd)
+{
+  uint64_t size = util::SizeFile(fd);
+  UTIL_THROW_IF2(size == util::kBadSize, "Can't size sort runs");
+  for (uint64_t offset = 0; offset < size;) {
+    uint64_t bytes;
+    UTIL_THROW_IF2(size - offset < sizeof(bytes), "Truncated sort run");
+    util::ErsatzPRead(fd, &bytes, sizeof(bytes), offset);
+    offset += sizeof(bytes);
+    UTIL_THROW_IF2(bytes > size - offset, "Truncated sort run");
+
+    Cursor *cursor = new Cursor(fd, offset, offset + bytes);
+    m_cursors.push_back(cursor);
+    if (cursor->Next()) m_queue.push(cursor);
+    offset += bytes;
+  }
+}
+
+bool SortedRunsReader::ReadLine(string &line)
+{
+  if (m_queue.empty()) return false;
+  Cursor *top = m_queue.top();
+  m_queue.pop();
+  line.swap(top->line);
+  if (top->Next()) m_queue.push(top);
+  return true;
+}
+
+SortedRunsSource::SortedRunsSource(const string &path)
+  : m_reader(new SortedRunsReader(path))
+  , m_pos(0)
+{
+}
+
+std::streamsize SortedRunsSource::read(char *s, std::streamsize n)
+{
+  std::streamsize copied = 0;
+  while (copied < n) {
+    if (m_pos == m_line.size()) {
+      if (!m_reader->ReadLine(m_line)) break;
+      m_line += '\n';
+      m_pos = 0;
+    }
+    size_t got = min<size_t>(n - copied, m_line.size() - m_pos);
+    memcpy(s + copied, m_line.data() + m_pos, got);
+    m_pos += got;
+    copied += got;
+  }
+  return copied ? copied : -1;
+}
+
+}
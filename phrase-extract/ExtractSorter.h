@@ -0,0 +1,157 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2015 University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#pragma once
+
+#include <cstdio>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/categories.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace MosesTraining
+{
+
+/** Sorts the lines written to it in byte order, the order of LC_ALL=C sort,
+ * with bounded memory.
+ *
+ * Lines are collected in one buffer. Whenever the buffer is full it is sorted
+ * and spilled to an unlinked temporary file as a run of length-prefixed binary
+ * records. Finish() merges the runs and writes the sorted text to its
+ * destination, which is compressed if its name ends in ".gz". Output that fits
+ * in memory never touches the temporary directory.
+ *
+ * If the destination name ends in ".runs", the runs are written there instead
+ * and never merged into text. A SortedRunsReader merges them when the file is
+ * read, so extract can hand its phrase pairs to score, and score its table
+ * halves to consolidate, without a text file in between.
+ */
+class ExtractSorter
+{
+public:
+  ExtractSorter(const std::string &outputPath, size_t memoryBytes, const std::string &tempPrefix);
+  ~ExtractSorter();
+
+  //! append text. Lines may be split across calls
+  void Write(const char *data, size_t size);
+
+  //! sort everything written so far and write it to the output file
+  void Finish();
+
+  size_t NumRuns() const {
+    return m_numRuns;
+  }
+
+private:
+  struct Line {
+    size_t start, length; // length excludes the newline
+  };
+  struct LineOrder;
+
+  void SortLines();
+  void Spill();
+
+  std::string m_outputPath;
+  size_t m_memoryBytes;
+  std::string m_tempPrefix;
+
+  std::string m_buffer;
+  std::vector<Line> m_lines; // complete lines in m_buffer
+  size_t m_pending; // start of the incomplete line at the end of m_buffer
+
+  std::FILE *m_runsFile; // the destination, if it takes the runs as they are
+  std::vector<std::FILE*> m_runs; // temporary files, one run each
+  size_t m_numRuns;
+};
+
+/** Sink device so that an ExtractSorter can sit behind a
+ * boost::iostreams::filtering_ostream, in place of an OutputFileStream.
+ */
+class ExtractSorterSink
+{
+public:
+  typedef char char_type;
+  typedef boost::iostreams::sink_tag category;
+
+  explicit ExtractSorterSink(ExtractSorter &sorter) : m_sorter(&sorter) {}
+
+  std::streamsize write(const char *s, std::streamsize n) {
+    m_sorter->Write(s, n);
+    return n;
+  }
+
+private:
+  ExtractSorter *m_sorter;
+};
+
+/** Reads the lines of a ".runs" file in byte order, merging its runs.
+ *
+ * A run is a 64-bit byte count followed by that many bytes of records, each a
+ * 32-bit length and the line without its newline. The numbers are in host
+ * byte order: the files are intermediates that do not leave the machine.
+ * Since every run says how long it is, the runs files of several extract
+ * processes concatenated are one runs file. Each run is read through its own
+ * small buffer, so memory grows with the number of runs, not their size.
+ */
+class SortedRunsReader
+{
+public:
+  explicit SortedRunsReader(const std::string &path);
+  ~SortedRunsReader();
+
+  //! the next line, without its newline. False at the end
+  bool ReadLine(std::string &line);
+
+private:
+  friend class ExtractSorter;
+  struct Cursor;
+  struct CursorGreater {
+    bool operator()(const Cursor *a, const Cursor *b) const;
+  };
+
+  SortedRunsReader();
+  void AddRuns(int fd);
+
+  int m_fd; // owned if opened by name
+  std::vector<Cursor*> m_cursors;
+  std::priority_queue<Cursor*, std::vector<Cursor*>, CursorGreater> m_queue;
+};
+
+/** Source device that reads a ".runs" file as text, one sorted line at a
+ * time. Moses::InputFileStream opens ".runs" files through it.
+ */
+class SortedRunsSource
+{
+public:
+  typedef char char_type;
+  typedef boost::iostreams::source_tag category;
+
+  explicit SortedRunsSource(const std::string &path);
+
+  std::streamsize read(char *s, std::streamsize n);
+
+private:
+  boost::shared_ptr<SortedRunsReader> m_reader;
+  std::string m_line; // the current line, with its newline
+  size_t m_pos; // how much of m_line has been read
+};
+
+}
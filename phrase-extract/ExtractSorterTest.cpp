@@ -0,0 +1,164 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2015 University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include "ExtractSorter.h"
+#include "InputFileStream.h"
+
+#define  BOOST_TEST_MODULE MosesTrainingExtractSorter
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace MosesTraining;
+using namespace std;
+
+namespace
+{
+
+// a temporary directory, removed with everything in it
+struct TempDir {
+  boost::filesystem::path path;
+
+  TempDir() : path(boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path("extract-sorter-%%%%-%%%%")) {
+    boost::filesystem::create_directory(path);
+  }
+  ~TempDir() {
+    boost::filesystem::remove_all(path);
+  }
+
+  string File(const string &name) const {
+    return (path / name).string();
+  }
+};
+
+// lines with shared prefixes, duplicates and bytes above 127, as in extract
+vector<string> MakeLines(size_t count, unsigned seed)
+{
+  srand(seed);
+  const char *words[] = {"das", "haus", "|||", "the", "house", "h\xc3\xa4us", "0-0", "0-1 1-0", ""};
+  vector<string> lines;
+  for (size_t i = 0; i < count; ++i) {
+    string line;
+    for (int w = rand() % 6; w >= 0; --w) {
+      line += words[rand() % 9];
+      line += ' ';
+    }
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+void SortTo(const string &path, const vector<string> &lines, size_t memoryBytes)
+{
+  ExtractSorter sorter(path, memoryBytes, path);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    string line = lines[i] + '\n';
+    // uneven pieces, so that lines are split across writes
+    size_t half = line.size() / 2;
+    sorter.Write(line.data(), half);
+    sorter.Write(line.data() + half, line.size() - half);
+  }
+  sorter.Finish();
+}
+
+vector<string> ReadRuns(const string &path)
+{
+  SortedRunsReader reader(path);
+  vector<string> lines;
+  string line;
+  while (reader.ReadLine(line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+vector<string> ReadText(const string &path)
+{
+  Moses::InputFileStream in(path);
+  vector<string> lines;
+  string line;
+  while (getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(text_output_in_byte_order)
+{
+  TempDir dir;
+  vector<string> lines = MakeLines(5000, 1);
+  vector<string> expected = lines;
+  sort(expected.begin(), expected.end());
+
+  // everything in memory, and spilled many times
+  SortTo(dir.File("memory.gz"), lines, 1 << 30);
+  BOOST_CHECK(ReadText(dir.File("memory.gz")) == expected);
+  SortTo(dir.File("spilled"), lines, 4096);
+  BOOST_CHECK(ReadText(dir.File("spilled")) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(runs_read_back_sorted)
+{
+  TempDir dir;
+  vector<string> lines = MakeLines(5000, 2);
+  vector<string> expected = lines;
+  sort(expected.begin(), expected.end());
+
+  SortTo(dir.File("one.runs"), lines, 1 << 30);
+  BOOST_CHECK(ReadRuns(dir.File("one.runs")) == expected);
+  SortTo(dir.File("many.runs"), lines, 4096);
+  BOOST_CHECK(ReadRuns(dir.File("many.runs")) == expected);
+
+  // as a text stream, the way score and consolidate open them
+  BOOST_CHECK(ReadText(dir.File("many.runs")) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(concatenated_runs_files)
+{
+  TempDir dir;
+  vector<string> first = MakeLines(3000, 3);
+  vector<string> second = MakeLines(2000, 4);
+  SortTo(dir.File("first.runs"), first, 4096);
+  SortTo(dir.File("second.runs"), second, 1 << 30);
+  SortTo(dir.File("empty.runs"), vector<string>(), 4096);
+
+  {
+    ofstream out(dir.File("both.runs").c_str(), ios::binary);
+    const char *parts[] = {"first.runs", "empty.runs", "second.runs"};
+    for (size_t i = 0; i < 3; ++i) {
+      ifstream in(dir.File(parts[i]).c_str(), ios::binary);
+      out << string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+  }
+
+  vector<string> expected = first;
+  expected.insert(expected.end(), second.begin(), second.end());
+  sort(expected.begin(), expected.end());
+  BOOST_CHECK(ReadRuns(dir.File("both.runs")) == expected);
+  BOOST_CHECK(ReadRuns(dir.File("empty.runs")).empty());
+}
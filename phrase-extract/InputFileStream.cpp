@@ -21,7 +21,9 @@
 
 #include "InputFileStream.h"
 #include "gzfilebuf.h"
+#include "ExtractSorter.h"
 #include <iostream>
+#include <boost/iostreams/stream_buffer.hpp>
 
 using namespace std;
 
@@ -34,6 +36,11 @@ InputFileStream::InputFileStream(const std::string &filePath)
   if (filePath.size() > 3 &&
       filePath.substr(filePath.size() - 3, 3) == ".gz") {
     m_streambuf = new gzfilebuf(filePath.c_str());
+  } else if (filePath.size() > 5 &&
+             filePath.substr(filePath.size() - 5, 5) == ".runs") {
+    // sorted runs, see ExtractSorter
+    m_streambuf = new boost::iostreams::stream_buffer<MosesTraining::SortedRunsSource>(
+      MosesTraining::SortedRunsSource(filePath));
   } else {
     std::filebuf* fb = new std::filebuf();
     fb = fb->open(filePath.c_str(), std::ios::in);
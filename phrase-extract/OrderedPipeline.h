@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include <boost/function.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread.hpp>
+#endif
+
+namespace MosesTraining
+{
+
+// Reads items, processes them and writes the results in input order.
+//
+// 'read' fills the next item and returns false at the end of the input.
+// 'process' turns an item into its output; it is given the index of the
+// thread it runs on (0 to threads-1), so that it can use scratch space of
+// that thread.  'write' writes an output.  Each item starts out as a
+// default-constructed Input and Output.
+//
+// Reading and writing happen on the thread that calls Run().  With more than
+// one thread, the items are processed on that many worker threads.  The
+// reader stops to write once 'capacity' items are in flight, which bounds the
+// memory taken by outputs that wait for an earlier, slower item.
+//
+// If a callback throws, the pipeline stops: the outputs not yet written are
+// dropped and Run() rethrows the first exception on the calling thread, once
+// the workers are done.
+template <typename Input, typename Output>
+class OrderedPipeline
+{
+public:
+  typedef boost::function<bool (Input &)> ReadFunction;
+  typedef boost::function<void (std::size_t, Input &, Output &)> ProcessFunction;
+  typedef boost::function<void (const Output &)> WriteFunction;
+
+  OrderedPipeline(const ReadFunction &read, const ProcessFunction &process,
+                  const WriteFunction &write)
+    : m_read(read)
+    , m_process(process)
+    , m_write(write) {}
+
+  ~OrderedPipeline();
+
+  void Run(std::size_t threads, std::size_t capacity);
+
+private:
+#ifdef WITH_THREADS
+  void Feed();
+  void Work(std::size_t thread);
+  void WriteNext(boost::mutex::scoped_lock &);
+  void Stop(const boost::exception_ptr &);
+#endif
+
+  ReadFunction m_read;
+  ProcessFunction m_process;
+  WriteFunction m_write;
+
+#ifdef WITH_THREADS
+  std::size_t m_capacity;
+  std::size_t m_numRead;
+  std::size_t m_numWritten;
+  bool m_finished;
+  boost::exception_ptr m_error;
+  std::deque<std::pair<std::size_t, Input *> > m_inputs;
+  std::map<std::size_t, Output *> m_outputs;
+  boost::mutex m_mutex;
+  boost::condition_variable m_inputReady;
+  boost::condition_variable m_outputReady;
+#endif
+};
+
+template <typename Input, typename Output>
+OrderedPipeline<Input, Output>::~OrderedPipeline()
+{
+#ifdef WITH_THREADS
+  // Only left over if the pipeline stopped.
+  for (std::size_t i = 0; i < m_inputs.size(); ++i) {
+    delete m_inputs[i].second;
+  }
+  for (typename std::map<std::size_t, Output *>::iterator p = m_outputs.begin();
+       p != m_outputs.end(); ++p) {
+    delete p->second;
+  }
+#endif
+}
+
+template <typename Input, typename Output>
+void OrderedPipeline<Input, Output>::Run(std::size_t threads,
+    std::size_t capacity)
+{
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    m_capacity = capacity;
+    m_numRead = 0;
+    m_numWritten = 0;
+    m_finished = false;
+    m_error = boost::exception_ptr();
+    boost::thread_group workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers.create_thread(boost::bind(&OrderedPipeline::Work, this, i));
+    }
+    try {
+      Feed();
+    } catch (...) {
+      Stop(boost::current_exception());
+    }
+    workers.join_all();
+    if (m_error) {
+      boost::rethrow_exception(m_error);
+    }
+    return;
+  }
+#endif
+
+  while (true) {
+    Input input;
+    if (!m_read(input)) {
+      break;
+    }
+    Output output;
+    m_process(0, input, output);
+    m_write(output);
+  }
+}
+
+#ifdef WITH_THREADS
+// Read the input and write the outputs, on the thread that calls Run().
+template <typename Input, typename Output>
+void OrderedPipeline<Input, Output>::Feed()
+{
+  while (true) {
+    std::auto_ptr<Input> input(new Input());
+    if (!m_read(*input)) {
+      break;
+    }
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (!m_error && m_numRead - m_numWritten >= m_capacity) {
+      WriteNext(lock);
+    }
+    if (m_error) {
+      return;
+    }
+    m_inputs.push_back(std::make_pair(m_numRead++, input.release()));
+    m_inputReady.notify_one();
+  }
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_finished = true;
+  m_inputReady.notify_all();
+  while (!m_error && m_numWritten < m_numRead) {
+    WriteNext(lock);
+  }
+}
+
+template <typename Input, typename Output>
+void OrderedPipeline<Input, Output>::Work(std::size_t thread)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  while (true) {
+    while (m_inputs.empty() && !m_finished && !m_error) {
+      m_inputReady.wait(lock);
+    }
+    if (m_inputs.empty() || m_error) {
+      return;
+    }
+    const std::pair<std::size_t, Input *> next = m_inputs.front();
+    m_inputs.pop_front();
+    lock.unlock();
+    std::auto_ptr<Input> input(next.second);
+    std::auto_ptr<Output> output(new Output());
+    try {
+      m_process(thread, *input, *output);
+    } catch (...) {
+      Stop(boost::current_exception());
+      return;
+    }
+    input.reset();
+    lock.lock();
+    m_outputs[next.first] = output.release();
+    m_outputReady.notify_one();
+  }
+}
+
+// Write the next output in input order, waiting for it to be processed if
+// necessary.  Returns without writing if the pipeline stops meanwhile.  Called
+// with the mutex locked.
+template <typename Input, typename Output>
+void OrderedPipeline<Input, Output>::WriteNext(boost::mutex::scoped_lock &lock)
+{
+  typename std::map<std::size_t, Output *>::iterator p;
+  while ((p = m_outputs.find(m_numWritten)) == m_outputs.end()) {
+    if (m_error) {
+      return;
+    }
+    m_outputReady.wait(lock);
+  }
+  std::auto_ptr<Output> output(p->second);
+  m_outputs.erase(p);
+  ++m_numWritten;
+  lock.unlock();
+  m_write(*output);
+  lock.lock();
+}
+
+// Keep the first exception and wake up every thread, so that they stop.
+template <typename Input, typename Output>
+void OrderedPipeline<Input, Output>::Stop(const boost::exception_ptr &error)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (!m_error) {
+    m_error = error;
+  }
+  m_inputReady.notify_all();
+  m_outputReady.notify_all();
+}
+#endif
+
+}  // namespace MosesTraining
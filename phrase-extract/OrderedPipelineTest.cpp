@@ -0,0 +1,132 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2015 University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include "OrderedPipeline.h"
+
+#define  BOOST_TEST_MODULE MosesTrainingOrderedPipeline
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace MosesTraining;
+using namespace std;
+
+namespace
+{
+
+// Numbers the items, squares them and collects the squares.  Throws when it
+// reaches the item or write it is told to fail at.
+struct Squares {
+  int count;
+  int failProcess;
+  int failWrite;
+  int numRead;
+  vector<int> written;
+
+  Squares(int count) : count(count), failProcess(-1), failWrite(-1), numRead(0) {}
+
+  bool Read(int &item) {
+    if (numRead == count) {
+      return false;
+    }
+    item = numRead++;
+    return true;
+  }
+
+  void Process(size_t, int &item, int &square) {
+    if (item == failProcess) {
+      throw runtime_error("cannot process item");
+    }
+    // uneven work, so that items finish out of order
+    for (int i = 0; i < (item * 7919) % 2000; ++i) {
+      square += i % 3;
+    }
+    square = item * item;
+  }
+
+  void Write(const int &square) {
+    if (int(written.size()) == failWrite) {
+      throw logic_error("cannot write item");
+    }
+    written.push_back(square);
+  }
+
+  void Run(size_t threads, size_t capacity) {
+    OrderedPipeline<int, int> pipeline(
+      boost::bind(&Squares::Read, this, _1),
+      boost::bind(&Squares::Process, this, _1, _2, _3),
+      boost::bind(&Squares::Write, this, _1));
+    pipeline.Run(threads, capacity);
+  }
+
+  // the written squares are those of the first items, in order
+  bool WroteInOrder() const {
+    for (size_t i = 0; i < written.size(); ++i) {
+      if (written[i] != int(i * i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(writes_in_input_order)
+{
+  const size_t threads[] = {1, 2, 4};
+  for (size_t t = 0; t < 3; ++t) {
+    Squares squares(3000);
+    squares.Run(threads[t], 16);
+    BOOST_CHECK_EQUAL(squares.written.size(), 3000);
+    BOOST_CHECK(squares.WroteInOrder());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(rethrows_from_process)
+{
+  const size_t threads[] = {1, 4};
+  for (size_t t = 0; t < 2; ++t) {
+    Squares squares(3000);
+    squares.failProcess = 1000;
+    try {
+      squares.Run(threads[t], 16);
+      BOOST_FAIL("no exception");
+    } catch (const runtime_error &e) {
+      BOOST_CHECK_EQUAL(string(e.what()), "cannot process item");
+    }
+    // the pipeline stopped, without the output of the item that failed
+    BOOST_CHECK(squares.written.size() <= 1000);
+    BOOST_CHECK(squares.numRead < 3000);
+    BOOST_CHECK(squares.WroteInOrder());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(rethrows_from_write)
+{
+  Squares squares(3000);
+  squares.failWrite = 500;
+  BOOST_CHECK_THROW(squares.Run(4, 16), logic_error);
+  BOOST_CHECK_EQUAL(squares.written.size(), 500);
+  BOOST_CHECK(squares.WroteInOrder());
+}
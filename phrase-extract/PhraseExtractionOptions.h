@@ -49,6 +49,9 @@ private:
   bool includeSentenceIdFlag; //include sentence id in extract file
   bool onlyOutputSpanInfo;
   bool gzOutput;
+  bool sortedOutput; //write the extract files as text already sorted, in-process
+  bool sortedRuns; //write extract and extract.inv as binary sorted runs for score
+  size_t sortMemory; //in MB per extract file
   std::string instanceWeightsFile; //weights for each sentence
   bool flexScoreFlag;
 
@@ -72,6 +75,9 @@ public:
     includeSentenceIdFlag(false),
     onlyOutputSpanInfo(false),
     gzOutput(false),
+    sortedOutput(false),
+    sortedRuns(false),
+    sortMemory(1024),
     flexScoreFlag(false),
     debug(false) {
   }
@@ -113,6 +119,15 @@ public:
   void initGzOutput (const bool initgzOutput) {
     gzOutput= initgzOutput;
   }
+  void initSortedOutput(const bool initsortedOutput) {
+    sortedOutput=initsortedOutput;
+  }
+  void initSortedRuns(const bool initsortedRuns) {
+    sortedRuns=initsortedRuns;
+  }
+  void initSortMemory(const size_t initsortMemory) {
+    sortMemory=initsortMemory;
+  }
   void initInstanceWeightsFile(const char* initInstanceWeightsFile) {
     instanceWeightsFile = std::string(initInstanceWeightsFile);
   }
@@ -157,6 +172,15 @@ public:
   bool isGzOutput () const {
     return gzOutput;
   }
+  bool isSortedOutput() const {
+    return sortedOutput;
+  }
+  bool isSortedRuns() const {
+    return sortedRuns;
+  }
+  size_t getSortMemory() const {
+    return sortMemory;
+  }
   std::string getInstanceWeightsFile() const {
     return instanceWeightsFile;
   }
@@ -24,16 +24,20 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/program_options.hpp>
 
 #include "syntax-common/exception.h"
 #include "syntax-common/xml_tree_parser.h"
 
 #include "InputFileStream.h"
+#include "OrderedPipeline.h"
 #include "OutputFileStream.h"
 #include "SyntaxNode.h"
 #include "SyntaxNodeCollection.h"
@@ -122,182 +126,49 @@ int ExtractGHKM::Main(int argc, char *argv[])
   }
 
   // Word count statistics for producing unknown word labels.
-  std::map<std::string, int> targetWordCount;
-  std::map<std::string, std::string> targetWordLabel;
+  WordStatistics stats;
 
-  // Word count statistics for producing unknown word labels: source side.
-  std::map<std::string, int> sourceWordCount;
-  std::map<std::string, std::string> sourceWordLabel;
+  // One pair of parsers per thread.  Besides parsing, they collect the label
+  // sets of the trees, which are merged once all sentences are done.
+  std::vector<Parsers *> parsers;
+  for (int i = 0; i < options.threads; ++i) {
+    parsers.push_back(new Parsers());
+  }
 
-  std::string targetLine;
-  std::string sourceLine;
-  std::string alignmentLine;
-  Alignment alignment;
-  XmlTreeParser targetXmlTreeParser;
-  XmlTreeParser sourceXmlTreeParser;
-  ScfgRuleWriter scfgWriter(fwdExtractStream, invExtractStream, options);
-  StsgRuleWriter stsgWriter(fwdExtractStream, invExtractStream, options);
+  // Sentence pairs are extracted on one thread per pair of parsers and
+  // written in input order.
+  std::string readError;
   size_t lineNum = options.sentenceOffset;
-  while (true) {
-    std::getline(targetStream, targetLine);
-    std::getline(sourceStream, sourceLine);
-    std::getline(alignmentStream, alignmentLine);
-
-    if (targetStream.eof() && sourceStream.eof() && alignmentStream.eof()) {
-      break;
-    }
-
-    if (targetStream.eof() || sourceStream.eof() || alignmentStream.eof()) {
-      Error("Files must contain same number of lines");
-    }
-
-    ++lineNum;
-
-    // Parse target tree.
-    if (targetLine.size() == 0) {
-      std::cerr << "skipping line " << lineNum << " with empty target tree\n";
-      continue;
-    }
-    std::auto_ptr<SyntaxTree> targetParseTree;
-    try {
-      targetParseTree = targetXmlTreeParser.Parse(targetLine);
-      assert(targetParseTree.get());
-    } catch (const Exception &e) {
-      std::ostringstream oss;
-      oss << "Failed to parse target XML tree at line " << lineNum;
-      if (!e.msg().empty()) {
-        oss << ": " << e.msg();
-      }
-      Error(oss.str());
-    }
-
-    // Read source tokens (and parse tree if using source labels).
-    std::vector<std::string> sourceTokens;
-    std::auto_ptr<SyntaxTree> sourceParseTree;
-    if (!options.sourceLabels) {
-      sourceTokens = ReadTokens(sourceLine);
-    } else {
-      try {
-        sourceParseTree = sourceXmlTreeParser.Parse(sourceLine);
-        assert(sourceParseTree.get());
-      } catch (const Exception &e) {
-        std::ostringstream oss;
-        oss << "Failed to parse source XML tree at line " << lineNum;
-        if (!e.msg().empty()) {
-          oss << ": " << e.msg();
-        }
-        Error(oss.str());
-      }
-      sourceTokens = sourceXmlTreeParser.words();
-    }
-
-    // Read word alignments.
-    try {
-      ReadAlignment(alignmentLine, alignment);
-    } catch (const Exception &e) {
-      std::ostringstream oss;
-      oss << "Failed to read alignment at line " << lineNum << ": ";
-      oss << e.msg();
-      Error(oss.str());
-    }
-    if (alignment.size() == 0) {
-      std::cerr << "skipping line " << lineNum << " without alignment points\n";
-      continue;
-    }
-    if (options.t2s) {
-      FlipAlignment(alignment);
-    }
-
-    // Record word counts.
-    if (!options.targetUnknownWordFile.empty()) {
-      CollectWordLabelCounts(*targetParseTree, options, targetWordCount,
-                             targetWordLabel);
-    }
-
-    // Record word counts: source side.
-    if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
-      CollectWordLabelCounts(*sourceParseTree, options, sourceWordCount,
-                             sourceWordLabel);
-    }
-
-    // Form an alignment graph from the target tree, source words, and
-    // alignment.
-    AlignmentGraph graph(targetParseTree.get(), sourceTokens, alignment);
-
-    // Extract minimal rules, adding each rule to its root node's rule set.
-    graph.ExtractMinimalRules(options);
-
-    // Extract composed rules.
-    if (!options.minimal) {
-      graph.ExtractComposedRules(options);
-    }
-
-    // Initialize phrase orientation scoring object
-    PhraseOrientation phraseOrientation(sourceTokens.size(),
-                                        targetXmlTreeParser.words().size(), alignment);
-
-    // Write the rules, subject to scope pruning.
-    const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
-    for (std::vector<Node *>::const_iterator p = targetNodes.begin();
-         p != targetNodes.end(); ++p) {
-
-      const std::vector<const Subgraph *> &rules = (*p)->GetRules();
-
-      PhraseOrientation::REO_CLASS l2rOrientation=PhraseOrientation::REO_CLASS_UNKNOWN, r2lOrientation=PhraseOrientation::REO_CLASS_UNKNOWN;
-      if (options.phraseOrientation && !rules.empty()) {
-        int sourceSpanBegin = *((*p)->GetSpan().begin());
-        int sourceSpanEnd   = *((*p)->GetSpan().rbegin());
-        l2rOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_L2R);
-        r2lOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_R2L);
-        // std::cerr << "span " << sourceSpanBegin << " " << sourceSpanEnd << std::endl;
-        // std::cerr << "phraseOrientation " << phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd) << std::endl;
-      }
-
-      for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
-           q != rules.end(); ++q) {
-        // STSG output.
-        if (options.stsg) {
-          StsgRule rule(**q);
-          if (rule.Scope() <= options.maxScope) {
-            stsgWriter.Write(rule);
-          }
-          continue;
-        }
-        // SCFG output.
-        ScfgRule *r = 0;
-        if (options.sourceLabels) {
-          r = new ScfgRule(**q, &sourceXmlTreeParser.node_collection());
-        } else {
-          r = new ScfgRule(**q);
-        }
-        // TODO Can scope pruning be done earlier?
-        if (r->Scope() <= options.maxScope) {
-          scfgWriter.Write(*r,lineNum,false);
-          if (options.treeFragments) {
-            fwdExtractStream << " {{Tree ";
-            (*q)->PrintTree(fwdExtractStream);
-            fwdExtractStream << "}}";
-          }
-          if (options.partsOfSpeech) {
-            fwdExtractStream << " {{POS";
-            (*q)->PrintPartsOfSpeech(fwdExtractStream);
-            fwdExtractStream << "}}";
-          }
-          if (options.phraseOrientation) {
-            fwdExtractStream << " {{Orientation ";
-            phraseOrientation.WriteOrientation(fwdExtractStream,l2rOrientation);
-            fwdExtractStream << " ";
-            phraseOrientation.WriteOrientation(fwdExtractStream,r2lOrientation);
-            fwdExtractStream << "}}";
-            phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_L2R,l2rOrientation,1);
-            phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_R2L,r2lOrientation,1);
-          }
-          fwdExtractStream << std::endl;
-          invExtractStream << std::endl;
-        }
-        delete r;
-      }
-    }
+  OrderedPipeline<SentenceInput, SentenceOutput> pipeline(
+    boost::bind(&ExtractGHKM::ReadSentence, this, boost::ref(targetStream),
+                boost::ref(sourceStream), boost::ref(alignmentStream),
+                boost::ref(lineNum), boost::ref(readError), _1),
+    boost::bind(&ExtractGHKM::ExtractThreadSentence, this,
+                boost::cref(options), boost::ref(parsers), _1, _2, _3),
+    boost::bind(&ExtractGHKM::WriteSentence, this, _1, boost::cref(options),
+                boost::ref(fwdExtractStream), boost::ref(invExtractStream),
+                boost::ref(stats)));
+  pipeline.Run(options.threads, options.threads * 64);
+
+  if (!readError.empty()) {
+    Error(readError);
+  }
+
+  // Merge the label sets collected by each thread's parsers.
+  std::set<std::string> targetLabelSet;
+  std::map<std::string, int> targetTopLabelSet;
+  std::set<std::string> sourceLabelSet;
+  for (size_t i = 0; i < parsers.size(); ++i) {
+    const XmlTreeParser &target = parsers[i]->target;
+    targetLabelSet.insert(target.label_set().begin(), target.label_set().end());
+    for (std::map<std::string, int>::const_iterator p =
+           target.top_label_set().begin();
+         p != target.top_label_set().end(); ++p) {
+      targetTopLabelSet[p->first] += p->second;
+    }
+    const XmlTreeParser &source = parsers[i]->source;
+    sourceLabelSet.insert(source.label_set().begin(), source.label_set().end());
+    delete parsers[i];
   }
 
   if (options.phraseOrientation) {
@@ -309,7 +180,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
 
   std::map<std::string,size_t> sourceLabels;
   if (options.sourceLabels && !options.sourceLabelSetFile.empty()) {
-    std::set<std::string> extendedLabelSet = sourceXmlTreeParser.label_set();
+    std::set<std::string> extendedLabelSet = sourceLabelSet;
     extendedLabelSet.insert("XLHS"); // non-matching label (left-hand side)
     extendedLabelSet.insert("XRHS"); // non-matching label (right-hand side)
     extendedLabelSet.insert("TOPLABEL");  // as used in the glue grammar
@@ -326,8 +197,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
   std::map<std::string, int> strippedTargetTopLabelSet;
   if (options.stripBitParLabels &&
       (!options.glueGrammarFile.empty() || !options.unknownWordSoftMatchesFile.empty())) {
-    StripBitParLabels(targetXmlTreeParser.label_set(),
-                      targetXmlTreeParser.top_label_set(),
+    StripBitParLabels(targetLabelSet, targetTopLabelSet,
                       strippedTargetLabelSet, strippedTargetTopLabelSet);
   }
 
@@ -335,32 +205,267 @@ int ExtractGHKM::Main(int argc, char *argv[])
     if (options.stripBitParLabels) {
       WriteGlueGrammar(strippedTargetLabelSet, strippedTargetTopLabelSet, sourceLabels, options, glueGrammarStream);
     } else {
-      WriteGlueGrammar(targetXmlTreeParser.label_set(),
-                       targetXmlTreeParser.top_label_set(),
+      WriteGlueGrammar(targetLabelSet, targetTopLabelSet,
                        sourceLabels, options, glueGrammarStream);
     }
   }
 
   if (!options.targetUnknownWordFile.empty()) {
-    WriteUnknownWordLabel(targetWordCount, targetWordLabel, options, targetUnknownWordStream);
+    WriteUnknownWordLabel(stats.targetWordCount, stats.targetWordLabel, options, targetUnknownWordStream);
   }
 
   if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
-    WriteUnknownWordLabel(sourceWordCount, sourceWordLabel, options, sourceUnknownWordStream, true);
+    WriteUnknownWordLabel(stats.sourceWordCount, stats.sourceWordLabel, options, sourceUnknownWordStream, true);
   }
 
   if (!options.unknownWordSoftMatchesFile.empty()) {
     if (options.stripBitParLabels) {
       WriteUnknownWordSoftMatches(strippedTargetLabelSet, unknownWordSoftMatchesStream);
     } else {
-      WriteUnknownWordSoftMatches(targetXmlTreeParser.label_set(),
-                                  unknownWordSoftMatchesStream);
+      WriteUnknownWordSoftMatches(targetLabelSet, unknownWordSoftMatchesStream);
     }
   }
 
   return 0;
 }
 
+void ExtractGHKM::ExtractSentence(const SentenceInput &input,
+                                  const Options &options,
+                                  Parsers &parsers,
+                                  SentenceOutput &output) const
+{
+  XmlTreeParser &targetXmlTreeParser = parsers.target;
+  XmlTreeParser &sourceXmlTreeParser = parsers.source;
+  const size_t lineNum = input.lineNum;
+
+  // Parse target tree.
+  if (input.targetLine.size() == 0) {
+    std::ostringstream msg;
+    msg << "skipping line " << lineNum << " with empty target tree\n";
+    output.messages = msg.str();
+    return;
+  }
+  std::auto_ptr<SyntaxTree> targetParseTree;
+  try {
+    targetParseTree = targetXmlTreeParser.Parse(input.targetLine);
+    assert(targetParseTree.get());
+  } catch (const Exception &e) {
+    std::ostringstream oss;
+    oss << "Failed to parse target XML tree at line " << lineNum;
+    if (!e.msg().empty()) {
+      oss << ": " << e.msg();
+    }
+    output.error = oss.str();
+    return;
+  }
+
+  // Read source tokens (and parse tree if using source labels).
+  std::vector<std::string> sourceTokens;
+  std::auto_ptr<SyntaxTree> sourceParseTree;
+  if (!options.sourceLabels) {
+    sourceTokens = ReadTokens(input.sourceLine);
+  } else {
+    try {
+      sourceParseTree = sourceXmlTreeParser.Parse(input.sourceLine);
+      assert(sourceParseTree.get());
+    } catch (const Exception &e) {
+      std::ostringstream oss;
+      oss << "Failed to parse source XML tree at line " << lineNum;
+      if (!e.msg().empty()) {
+        oss << ": " << e.msg();
+      }
+      output.error = oss.str();
+      return;
+    }
+    sourceTokens = sourceXmlTreeParser.words();
+  }
+
+  // Read word alignments.
+  Alignment alignment;
+  try {
+    ReadAlignment(input.alignmentLine, alignment);
+  } catch (const Exception &e) {
+    std::ostringstream oss;
+    oss << "Failed to read alignment at line " << lineNum << ": ";
+    oss << e.msg();
+    output.error = oss.str();
+    return;
+  }
+  if (alignment.size() == 0) {
+    std::ostringstream msg;
+    msg << "skipping line " << lineNum << " without alignment points\n";
+    output.messages = msg.str();
+    return;
+  }
+  if (options.t2s) {
+    FlipAlignment(alignment);
+  }
+
+  // Record word labels, to be counted in input order.
+  if (!options.targetUnknownWordFile.empty()) {
+    CollectWordLabels(*targetParseTree, options, output.targetWordLabels);
+  }
+
+  // Record word labels: source side.
+  if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
+    CollectWordLabels(*sourceParseTree, options, output.sourceWordLabels);
+  }
+
+  // Form an alignment graph from the target tree, source words, and
+  // alignment.
+  AlignmentGraph graph(targetParseTree.get(), sourceTokens, alignment);
+
+  // Extract minimal rules, adding each rule to its root node's rule set.
+  graph.ExtractMinimalRules(options);
+
+  // Extract composed rules.
+  if (!options.minimal) {
+    graph.ExtractComposedRules(options);
+  }
+
+  // Initialize phrase orientation scoring object
+  PhraseOrientation phraseOrientation(sourceTokens.size(),
+                                      targetXmlTreeParser.words().size(), alignment);
+
+  // Write the rules, subject to scope pruning.
+  std::ostringstream fwdExtractStream;
+  std::ostringstream invExtractStream;
+  ScfgRuleWriter scfgWriter(fwdExtractStream, invExtractStream, options);
+  StsgRuleWriter stsgWriter(fwdExtractStream, invExtractStream, options);
+  const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
+  for (std::vector<Node *>::const_iterator p = targetNodes.begin();
+       p != targetNodes.end(); ++p) {
+
+    const std::vector<const Subgraph *> &rules = (*p)->GetRules();
+
+    PhraseOrientation::REO_CLASS l2rOrientation=PhraseOrientation::REO_CLASS_UNKNOWN, r2lOrientation=PhraseOrientation::REO_CLASS_UNKNOWN;
+    if (options.phraseOrientation && !rules.empty()) {
+      int sourceSpanBegin = *((*p)->GetSpan().begin());
+      int sourceSpanEnd   = *((*p)->GetSpan().rbegin());
+      l2rOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_L2R);
+      r2lOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_R2L);
+    }
+
+    for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
+         q != rules.end(); ++q) {
+      // STSG output.
+      if (options.stsg) {
+        StsgRule rule(**q);
+        if (rule.Scope() <= options.maxScope) {
+          stsgWriter.Write(rule);
+        }
+        continue;
+      }
+      // SCFG output.
+      ScfgRule *r = 0;
+      if (options.sourceLabels) {
+        r = new ScfgRule(**q, &sourceXmlTreeParser.node_collection());
+      } else {
+        r = new ScfgRule(**q);
+      }
+      // TODO Can scope pruning be done earlier?
+      if (r->Scope() <= options.maxScope) {
+        scfgWriter.Write(*r,lineNum,false);
+        if (options.treeFragments) {
+          fwdExtractStream << " {{Tree ";
+          (*q)->PrintTree(fwdExtractStream);
+          fwdExtractStream << "}}";
+        }
+        if (options.partsOfSpeech) {
+          fwdExtractStream << " {{POS";
+          (*q)->PrintPartsOfSpeech(fwdExtractStream);
+          fwdExtractStream << "}}";
+        }
+        if (options.phraseOrientation) {
+          fwdExtractStream << " {{Orientation ";
+          phraseOrientation.WriteOrientation(fwdExtractStream,l2rOrientation);
+          fwdExtractStream << " ";
+          phraseOrientation.WriteOrientation(fwdExtractStream,r2lOrientation);
+          fwdExtractStream << "}}";
+          // The prior counts are shared, so they are added in input order.
+          output.orientations.push_back(std::make_pair(l2rOrientation, r2lOrientation));
+        }
+        fwdExtractStream << '\n';
+        invExtractStream << '\n';
+      }
+      delete r;
+    }
+  }
+  output.fwd = fwdExtractStream.str();
+  output.inv = invExtractStream.str();
+}
+
+void ExtractGHKM::WriteSentence(const SentenceOutput &output,
+                                const Options &options,
+                                std::ostream &fwd,
+                                std::ostream &inv,
+                                WordStatistics &stats) const
+{
+  std::cerr << output.messages;
+  if (!output.error.empty()) {
+    Error(output.error);
+  }
+
+  fwd << output.fwd;
+  inv << output.inv;
+
+  typedef std::vector<std::pair<std::string, std::string> >::const_iterator
+  LabelIter;
+  for (LabelIter p = output.targetWordLabels.begin();
+       p != output.targetWordLabels.end(); ++p) {
+    ++stats.targetWordCount[p->first];
+    stats.targetWordLabel[p->first] = p->second;
+  }
+  for (LabelIter p = output.sourceWordLabels.begin();
+       p != output.sourceWordLabels.end(); ++p) {
+    ++stats.sourceWordCount[p->first];
+    stats.sourceWordLabel[p->first] = p->second;
+  }
+
+  PhraseOrientation::REO_DIR l2r = PhraseOrientation::REO_DIR_L2R;
+  PhraseOrientation::REO_DIR r2l = PhraseOrientation::REO_DIR_R2L;
+  for (size_t i = 0; i < output.orientations.size(); ++i) {
+    PhraseOrientation::IncrementPriorCount(l2r, output.orientations[i].first, 1);
+    PhraseOrientation::IncrementPriorCount(r2l, output.orientations[i].second, 1);
+  }
+}
+
+// Read the next sentence pair, numbering it after 'lineNum'.  Returns false
+// at the end of the input or, setting 'error', if the files end at different
+// lines.
+bool ExtractGHKM::ReadSentence(std::istream &targetStream,
+                               std::istream &sourceStream,
+                               std::istream &alignmentStream,
+                               size_t &lineNum, std::string &error,
+                               SentenceInput &input) const
+{
+  std::getline(targetStream, input.targetLine);
+  std::getline(sourceStream, input.sourceLine);
+  std::getline(alignmentStream, input.alignmentLine);
+
+  if (targetStream.eof() && sourceStream.eof() && alignmentStream.eof()) {
+    return false;
+  }
+
+  if (targetStream.eof() || sourceStream.eof() || alignmentStream.eof()) {
+    error = "Files must contain same number of lines";
+    return false;
+  }
+
+  input.lineNum = ++lineNum;
+  return true;
+}
+
+// Extract a sentence pair with the parsers of the thread.
+void ExtractGHKM::ExtractThreadSentence(const Options &options,
+                                        std::vector<Parsers *> &parsers,
+                                        size_t thread,
+                                        const SentenceInput &input,
+                                        SentenceOutput &output) const
+{
+  ExtractSentence(input, options, *parsers[thread], output);
+}
+
 void ExtractGHKM::ProcessOptions(int argc, char *argv[],
                                  Options &options) const
 {
@@ -456,6 +561,9 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
    "output STSG rules (default is SCFG)")
   ("T2S",
    "enable tree-to-string rule extraction (string-to-tree is assumed by default)")
+  ("Threads",
+   po::value(&options.threads)->default_value(options.threads),
+   "extract sentence pairs on this many threads (output is in input order)")
   ("TreeFragments",
    "output parse tree information")
   ("SourceLabels",
@@ -591,6 +699,15 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
     options.unpairedExtractFormat = true;
   }
 
+  if (options.threads < 1) {
+    Error("--Threads must be at least 1");
+  }
+#ifndef WITH_THREADS
+  if (options.threads > 1) {
+    Error("--Threads requires thread support");
+  }
+#endif
+
   // Workaround for extract-parallel issue.
   if (options.sentenceOffset > 0) {
     options.targetUnknownWordFile.clear();
@@ -764,11 +881,10 @@ void ExtractGHKM::WriteSourceLabelSet(
   }
 }
 
-void ExtractGHKM::CollectWordLabelCounts(
+void ExtractGHKM::CollectWordLabels(
   SyntaxTree &root,
   const Options &options,
-  std::map<std::string, int> &wordCount,
-  std::map<std::string, std::string> &wordLabel)
+  std::vector<std::pair<std::string, std::string> > &wordLabels) const
 {
   for (SyntaxTree::ConstLeafIterator p(root);
        p != SyntaxTree::ConstLeafIterator(); ++p) {
@@ -786,8 +902,7 @@ void ExtractGHKM::CollectWordLabelCounts(
       ancestor = ancestor->parent();
     }
     const std::string &label = ancestor->value().label;
-    ++wordCount[word];
-    wordLabel[word] = label;
+    wordLabels.push_back(std::make_pair(word, label));
   }
 }
 
@@ -23,12 +23,16 @@
 #include <ostream>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "OutputFileStream.h"
 #include "SyntaxTree.h"
 
 #include "syntax-common/tool.h"
+#include "syntax-common/xml_tree_parser.h"
+
+#include "PhraseOrientation.h"
 
 namespace MosesTraining
 {
@@ -47,11 +51,56 @@ public:
   virtual int Main(int argc, char *argv[]);
 
 private:
+  // One sentence pair, as read from the input files.
+  struct SentenceInput {
+    size_t lineNum;
+    std::string targetLine;
+    std::string sourceLine;
+    std::string alignmentLine;
+  };
+
+  // Everything extracted from one sentence pair.  Sentence pairs can be
+  // extracted in any order, but their outputs are written in input order.
+  struct SentenceOutput {
+    std::string messages;
+    std::string error;
+    std::string fwd;
+    std::string inv;
+    std::vector<std::pair<std::string, std::string> > targetWordLabels;
+    std::vector<std::pair<std::string, std::string> > sourceWordLabels;
+    std::vector<std::pair<PhraseOrientation::REO_CLASS,
+                          PhraseOrientation::REO_CLASS> > orientations;
+  };
+
+  // The parsers of one thread.  They also collect the label sets.
+  struct Parsers {
+    XmlTreeParser target;
+    XmlTreeParser source;
+  };
+
+  // Word count statistics for producing unknown word labels.
+  struct WordStatistics {
+    std::map<std::string, int> targetWordCount;
+    std::map<std::string, std::string> targetWordLabel;
+    std::map<std::string, int> sourceWordCount;
+    std::map<std::string, std::string> sourceWordLabel;
+  };
+
+  void ExtractSentence(const SentenceInput &, const Options &, Parsers &,
+                       SentenceOutput &) const;
+  void WriteSentence(const SentenceOutput &, const Options &, std::ostream &,
+                     std::ostream &, WordStatistics &) const;
+
+  bool ReadSentence(std::istream &, std::istream &, std::istream &,
+                    size_t &, std::string &, SentenceInput &) const;
+  void ExtractThreadSentence(const Options &, std::vector<Parsers *> &,
+                             size_t, const SentenceInput &,
+                             SentenceOutput &) const;
+
   void RecordTreeLabels(const SyntaxTree &, std::set<std::string> &);
-  void CollectWordLabelCounts(SyntaxTree &,
-                              const Options &,
-                              std::map<std::string, int> &,
-                              std::map<std::string, std::string> &);
+  void CollectWordLabels(SyntaxTree &,
+                         const Options &,
+                         std::vector<std::pair<std::string, std::string> > &) const;
   void WriteUnknownWordLabel(const std::map<std::string, int> &,
                              const std::map<std::string, std::string> &,
                              const Options &,
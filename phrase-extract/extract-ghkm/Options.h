@@ -49,6 +49,7 @@ public:
     , stripBitParLabels(false)
     , stsg(false)
     , t2s(false)
+    , threads(1)
     , treeFragments(false)
     , unknownWordMinRelFreq(0.03f)
     , unknownWordUniform(false)
@@ -82,6 +83,7 @@ public:
   bool stripBitParLabels;
   bool stsg;
   bool t2s;
+  int threads;
   std::string targetUnknownWordFile;
   bool treeFragments;
   float unknownWordMinRelFreq;
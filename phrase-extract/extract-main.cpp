@@ -20,6 +20,10 @@
 #include <vector>
 #include <limits>
 
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "ExtractSorter.h"
 #include "SentenceAlignment.h"
 #include "tables-core.h"
 #include "InputFileStream.h"
@@ -78,6 +82,44 @@ std::vector<std::string> Tokenize(const std::string& str,
 
 bool flexScoreFlag = false;
 
+// One of the extract files. With --SortedOutput the phrases go through a
+// sorter, which writes the usual text file, sorted, once all sentences are
+// done. With --SortedRuns, extract and extract.inv are ".runs" files instead,
+// which score reads without a text file in between.
+class ExtractOutput
+{
+public:
+  void Open(const string &fileName, const PhraseExtractionOptions &options) {
+    if (options.isSortedOutput()) {
+      m_sorter.reset(new ExtractSorter(fileName, options.getSortMemory() << 20, fileName));
+      m_sortStream.push(ExtractSorterSink(*m_sorter));
+    } else {
+      m_file.Open(fileName);
+    }
+  }
+
+  std::ostream &Stream() {
+    if (m_sorter.get()) return m_sortStream;
+    return m_file;
+  }
+
+  void Close() {
+    if (m_sorter.get()) {
+      m_sortStream.flush();
+      m_sortStream.reset();
+      m_sorter->Finish();
+      m_sorter.reset();
+    } else {
+      m_file.Close();
+    }
+  }
+
+private:
+  Moses::OutputFileStream m_file;
+  boost::iostreams::filtering_ostream m_sortStream;
+  boost::scoped_ptr<ExtractSorter> m_sorter;
+};
+
 }
 
 namespace MosesTraining
@@ -89,11 +131,11 @@ public:
   ExtractTask(
     size_t id, SentenceAlignment &sentence,
     PhraseExtractionOptions &initoptions,
-    Moses::OutputFileStream &extractFile,
-    Moses::OutputFileStream &extractFileInv,
-    Moses::OutputFileStream &extractFileOrientation,
-    Moses::OutputFileStream &extractFileContext,
-    Moses::OutputFileStream &extractFileContextInv):
+    std::ostream &extractFile,
+    std::ostream &extractFileInv,
+    std::ostream &extractFileOrientation,
+    std::ostream &extractFileContext,
+    std::ostream &extractFileContextInv):
     m_sentence(sentence),
     m_options(initoptions),
     m_extractFile(extractFile),
@@ -118,11 +160,11 @@ private:
 
   SentenceAlignment &m_sentence;
   const PhraseExtractionOptions &m_options;
-  Moses::OutputFileStream &m_extractFile;
-  Moses::OutputFileStream &m_extractFileInv;
-  Moses::OutputFileStream &m_extractFileOrientation;
-  Moses::OutputFileStream &m_extractFileContext;
-  Moses::OutputFileStream &m_extractFileContextInv;
+  std::ostream &m_extractFile;
+  std::ostream &m_extractFileInv;
+  std::ostream &m_extractFileOrientation;
+  std::ostream &m_extractFileContext;
+  std::ostream &m_extractFileContextInv;
 };
 }
 
@@ -133,15 +175,15 @@ int main(int argc, char* argv[])
 
   if (argc < 6) {
     cerr << "syntax: extract en de align extract max-length [orientation [ --model [wbe|phrase|hier]-[msd|mslr|mono] ] ";
-    cerr<<"| --OnlyOutputSpanInfo | --NoTTable | --GZOutput | --IncludeSentenceId | --SentenceOffset n | --InstanceWeights filename ]\n";
+    cerr<<"| --OnlyOutputSpanInfo | --NoTTable | --GZOutput | --SortedOutput | --SortedRuns | --SortMemory MB | --IncludeSentenceId | --SentenceOffset n | --InstanceWeights filename ]\n";
     exit(1);
   }
 
-  Moses::OutputFileStream extractFile;
-  Moses::OutputFileStream extractFileInv;
-  Moses::OutputFileStream extractFileOrientation;
-  Moses::OutputFileStream extractFileContext;
-  Moses::OutputFileStream extractFileContextInv;
+  ExtractOutput extractFile;
+  ExtractOutput extractFileInv;
+  ExtractOutput extractFileOrientation;
+  ExtractOutput extractFileContext;
+  ExtractOutput extractFileContextInv;
   const char* const &fileNameE = argv[1];
   const char* const &fileNameF = argv[2];
   const char* const &fileNameA = argv[3];
@@ -167,6 +209,17 @@ int main(int argc, char* argv[])
       sentenceOffset = atoi(argv[++i]);
     } else if (strcmp(argv[i], "--GZOutput") == 0) {
       options.initGzOutput(true);
+    } else if (strcmp(argv[i], "--SortedOutput") == 0) {
+      options.initSortedOutput(true);
+    } else if (strcmp(argv[i], "--SortedRuns") == 0) {
+      options.initSortedOutput(true);
+      options.initSortedRuns(true);
+    } else if (strcmp(argv[i], "--SortMemory") == 0) {
+      if (i+1 >= argc || argv[i+1][0] < '0' || argv[i+1][0] > '9') {
+        cerr << "extract: syntax error, used switch --SortMemory without a number" << endl;
+        exit(1);
+      }
+      options.initSortMemory(atoi(argv[++i]));
     } else if (strcmp(argv[i], "--InstanceWeights") == 0) {
       if (i+1 >= argc) {
         cerr << "extract: syntax error, used switch --InstanceWeights without file name" << endl;
@@ -263,19 +316,19 @@ int main(int argc, char* argv[])
 
   // open output files
   if (options.isTranslationFlag()) {
-    string fileNameExtractInv = fileNameExtract + ".inv" + (options.isGzOutput()?".gz":"");
-    extractFile.Open( (fileNameExtract + (options.isGzOutput()?".gz":"")).c_str());
-    extractFileInv.Open(fileNameExtractInv.c_str());
+    string suffix = options.isSortedRuns() ? ".runs" : (options.isGzOutput()?".gz":"");
+    extractFile.Open(fileNameExtract + suffix, options);
+    extractFileInv.Open(fileNameExtract + ".inv" + suffix, options);
   }
   if (options.isOrientationFlag()) {
     string fileNameExtractOrientation = fileNameExtract + ".o" + (options.isGzOutput()?".gz":"");
-    extractFileOrientation.Open(fileNameExtractOrientation.c_str());
+    extractFileOrientation.Open(fileNameExtractOrientation, options);
   }
   if (options.isFlexScoreFlag()) {
     string fileNameExtractContext = fileNameExtract + ".context"  + (options.isGzOutput()?".gz":"");
     string fileNameExtractContextInv = fileNameExtract + ".context.inv"  + (options.isGzOutput()?".gz":"");
-    extractFileContext.Open(fileNameExtractContext.c_str());
-    extractFileContextInv.Open(fileNameExtractContextInv.c_str());
+    extractFileContext.Open(fileNameExtractContext, options);
+    extractFileContextInv.Open(fileNameExtractContextInv, options);
   }
 
   int i = sentenceOffset;
@@ -310,7 +363,7 @@ int main(int argc, char* argv[])
       if (options.placeholders.size()) {
         sentence.invertAlignment();
       }
-      ExtractTask *task = new ExtractTask(i-1, sentence, options, extractFile , extractFileInv, extractFileOrientation, extractFileContext, extractFileContextInv);
+      ExtractTask *task = new ExtractTask(i-1, sentence, options, extractFile.Stream(), extractFileInv.Stream(), extractFileOrientation.Stream(), extractFileContext.Stream(), extractFileContextInv.Stream());
       task->Run();
       delete task;
 
@@ -19,8 +19,9 @@ class CfgFilter
 public:
   virtual ~CfgFilter() {}
 
-  // Read a rule table from 'in' and filter it according to the test sentences.
-  virtual void Filter(std::istream &in, std::ostream &out) = 0;
+  // Read a rule table from 'in' and filter it according to the test sentences,
+  // using the given number of threads.
+  virtual void Filter(std::istream &in, std::ostream &out, int threads) = 0;
 
 protected:
 };
@@ -82,12 +82,12 @@ ForestTsgFilter::StringForestToIdForest(const StringForest &f)
 }
 
 bool ForestTsgFilter::MatchFragment(const IdTree &fragment,
-                                    const std::vector<IdTree *> &leaves)
+                                    const std::vector<IdTree *> &leaves) const
 {
   typedef std::vector<const IdTree *> TreeVec;
 
-  // Reset the match counter.
-  m_matchCount = 0;
+  // The number of calls to MatchFragment() for this rule.
+  std::size_t matchCount = 0;
 
   // Determine which of the fragment's leaves occurs in the smallest number of
   // sentences in the test set.  If the fragment contains a rare word
@@ -150,7 +150,7 @@ bool ForestTsgFilter::MatchFragment(const IdTree &fragment,
         continue;
       }
       // Attempt to match the fragment at the candidate site.
-      if (MatchFragment(fragment, v)) {
+      if (MatchFragment(fragment, v, matchCount)) {
         return true;
       }
     }
@@ -159,9 +159,10 @@ bool ForestTsgFilter::MatchFragment(const IdTree &fragment,
 }
 
 bool ForestTsgFilter::MatchFragment(const IdTree &fragment,
-                                    const IdForest::Vertex &v)
+                                    const IdForest::Vertex &v,
+                                    std::size_t &matchCount) const
 {
-  if (++m_matchCount >= kMatchLimit) {
+  if (++matchCount >= kMatchLimit) {
     return true;
   }
   if (fragment.value() != v.value.id) {
@@ -179,7 +180,7 @@ bool ForestTsgFilter::MatchFragment(const IdTree &fragment,
     }
     bool match = true;
     for (std::size_t i = 0; i < children.size(); ++i) {
-      if (!MatchFragment(*children[i], *tail[i])) {
+      if (!MatchFragment(*children[i], *tail[i], matchCount)) {
         match = false;
         break;
       }
@@ -51,10 +51,12 @@ private:
   typedef std::vector<InnerMap> IdToSentenceMap;
 
   // Forest-specific implementation of virtual function.
-  bool MatchFragment(const IdTree &, const std::vector<IdTree *> &);
+  bool MatchFragment(const IdTree &, const std::vector<IdTree *> &) const;
 
   // Try to match a fragment against a specific vertex of a test forest.
-  bool MatchFragment(const IdTree &, const IdForest::Vertex &);
+  // matchCount counts the calls made for the current rule.
+  bool MatchFragment(const IdTree &, const IdForest::Vertex &,
+                     std::size_t &matchCount) const;
 
   // Convert a StringForest to an IdForest (wrt m_testVocab).  Inserts symbols
   // into m_testVocab.
@@ -62,7 +64,6 @@ private:
 
   std::vector<boost::shared_ptr<IdForest> > m_sentences;
   IdToSentenceMap m_idToSentence;
-  std::size_t m_matchCount;
 };
 
 }  // namespace FilterRuleTable
@@ -0,0 +1,110 @@
+#include "ParallelFilter.h"
+
+#include <string>
+
+#include <boost/bind.hpp>
+
+#include "util/tokenize_piece.hh"
+
+#include "OrderedPipeline.h"
+
+namespace MosesTraining
+{
+namespace Syntax
+{
+namespace FilterRuleTable
+{
+
+namespace
+{
+
+// Approximate size of a block in bytes.  Blocks end at line boundaries, so a
+// block is a little shorter or, if a single line is longer, longer.
+const std::size_t kBlockSize = 1 << 22;
+
+// Read the next block of whole lines into 'block'.  'carry' holds the start of
+// a line that was read with the previous block; on return it holds the start
+// of the first line of the next block.  A missing newline at the end of the
+// input is added, as the line-by-line filter did.  Returns false at the end of
+// the input.
+bool ReadBlock(std::istream &in, std::string &carry, std::string &block)
+{
+  block.swap(carry);
+  carry.clear();
+  while (in) {
+    const std::size_t oldSize = block.size();
+    block.resize(oldSize + kBlockSize);
+    in.read(&block[oldSize], kBlockSize);
+    block.resize(oldSize + in.gcount());
+    const std::size_t pos = block.rfind('\n');
+    if (pos != std::string::npos) {
+      carry.assign(block, pos+1, std::string::npos);
+      block.resize(pos+1);
+      return true;
+    }
+  }
+  if (block.empty()) {
+    return false;
+  }
+  block += '\n';
+  return true;
+}
+
+// Append the lines of 'block' that 'matcher' keeps to 'output'.
+void FilterBlock(SourceMatcher &matcher, const std::string &block,
+                 std::string &output)
+{
+  const util::MultiCharacter delimiter("|||");
+
+  StringPiece source;
+  bool keep = true;
+  std::size_t start = 0;
+  while (start < block.size()) {
+    const std::size_t end = block.find('\n', start) + 1;
+    const StringPiece line(block.data() + start, end - start - 1);
+
+    // Read the source-side of the rule and, if it differs from the previous
+    // rule's, decide whether to keep it.
+    util::TokenIter<util::MultiCharacter> it(line, delimiter);
+    if (*it != source) {
+      source = *it;
+      keep = matcher.Match(source);
+    }
+    if (keep) {
+      output.append(block, start, end - start);
+    }
+    start = end;
+  }
+}
+
+// Filter a block with the matcher of the thread.
+void FilterThreadBlock(
+  const std::vector<boost::shared_ptr<SourceMatcher> > &matchers,
+  std::size_t thread, const std::string &block, std::string &output)
+{
+  output.reserve(block.size());
+  FilterBlock(*matchers[thread], block, output);
+}
+
+void WriteBlock(std::ostream &out, const std::string &output)
+{
+  out.write(output.data(), output.size());
+}
+
+}  // namespace
+
+void FilterInBlocks(
+  std::istream &in, std::ostream &out,
+  const std::vector<boost::shared_ptr<SourceMatcher> > &matchers)
+{
+  std::string carry;
+  OrderedPipeline<std::string, std::string> pipeline(
+    boost::bind(&ReadBlock, boost::ref(in), boost::ref(carry), _1),
+    boost::bind(&FilterThreadBlock, boost::cref(matchers), _1, _2, _3),
+    boost::bind(&WriteBlock, boost::ref(out), _1));
+  pipeline.Run(matchers.size(), matchers.size() * 4);
+}
+
+}  // namespace FilterRuleTable
+}  // namespace Syntax
+}  // namespace MosesTraining
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "util/string_piece.hh"
+
+namespace MosesTraining
+{
+namespace Syntax
+{
+namespace FilterRuleTable
+{
+
+// Decides whether to keep the rules with a given source-side.  Each thread
+// has its own matcher, which can hold scratch space between calls.
+class SourceMatcher
+{
+public:
+  virtual ~SourceMatcher() {}
+
+  virtual bool Match(const StringPiece &source) = 0;
+};
+
+// Reads a rule table from 'in' in blocks of lines and writes to 'out' the
+// rules that the matchers keep, in input order.  The blocks are filtered on
+// one thread per matcher.
+//
+// Within a block, a rule with the same source-side as the previous rule
+// reuses the previous decision.  This optimisation is based on the assumption
+// that the rule table is sorted (which is the case in the standard Moses
+// training pipeline).
+void FilterInBlocks(std::istream &in, std::ostream &out,
+                    const std::vector<boost::shared_ptr<SourceMatcher> > &);
+
+}  // namespace FilterRuleTable
+}  // namespace Syntax
+}  // namespace MosesTraining
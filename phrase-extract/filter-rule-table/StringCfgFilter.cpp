@@ -2,8 +2,12 @@
 
 #include <algorithm>
 
+#include <boost/make_shared.hpp>
+
 #include "util/string_piece_hash.hh"
 
+#include "ParallelFilter.h"
+
 namespace MosesTraining
 {
 namespace Syntax
@@ -50,57 +54,40 @@ StringCfgFilter::StringCfgFilter(
   }
 }
 
-void StringCfgFilter::Filter(std::istream &in, std::ostream &out)
+class StringCfgFilter::Matcher : public SourceMatcher
 {
-  const util::MultiCharacter fieldDelimiter("|||");
-  const util::AnyCharacter symbolDelimiter(" \t");
-
-  std::string line;
-  std::string prevLine;
-  StringPiece source;
-  std::vector<StringPiece> symbols;
-  Pattern pattern;
-  bool keep = true;
-  int lineNum = 0;
-
-  while (std::getline(in, line)) {
-    ++lineNum;
-
-    // Read the source-side of the rule.
-    util::TokenIter<util::MultiCharacter> it(line, fieldDelimiter);
-
-    // Check if this rule has the same source-side as the previous rule.  If
-    // it does then we already know whether or not to keep the rule.  This
-    // optimisation is based on the assumption that the rule table is sorted
-    // (which is the case in the standard Moses training pipeline).
-    if (*it == source) {
-      if (keep) {
-        out << line << std::endl;
-      }
-      continue;
-    }
+public:
+  explicit Matcher(const StringCfgFilter &filter) : m_filter(filter) {}
 
-    // The source-side is different from the previous rule's.
-    source = *it;
+  bool Match(const StringPiece &source) {
+    const util::AnyCharacter symbolDelimiter(" \t");
 
     // Tokenize the source-side.
-    symbols.clear();
+    m_symbols.clear();
     for (util::TokenIter<util::AnyCharacter, true> p(source, symbolDelimiter);
          p; ++p) {
-      symbols.push_back(*p);
+      m_symbols.push_back(*p);
     }
 
     // Generate a pattern (fails if any source-side terminal is not in the
     // test set vocabulary) and attempt to match it against the test sentences.
-    keep = GeneratePattern(symbols, pattern) && MatchPattern(pattern);
-    if (keep) {
-      out << line << std::endl;
-    }
+    return m_filter.GeneratePattern(m_symbols, m_pattern) &&
+           m_filter.MatchPattern(m_pattern);
+  }
+
+private:
+  const StringCfgFilter &m_filter;
+  std::vector<StringPiece> m_symbols;
+  Pattern m_pattern;
+};
 
-    // Retain line for the next iteration (in order that the source StringPiece
-    // remains valid).
-    prevLine.swap(line);
+void StringCfgFilter::Filter(std::istream &in, std::ostream &out, int threads)
+{
+  std::vector<boost::shared_ptr<SourceMatcher> > matchers;
+  for (int i = 0; i < threads; ++i) {
+    matchers.push_back(boost::make_shared<Matcher>(*this));
   }
+  FilterInBlocks(in, out, matchers);
 }
 
 void StringCfgFilter::AddSentenceNGrams(
@@ -264,17 +251,19 @@ bool StringCfgFilter::MatchPattern(
       tables[i]->intraSentencePositions.find(sentenceId);
     assert(r != tables[i]->intraSentencePositions.end());
     const PositionSeq &col = r->second;
+    // Both the positions and the ranges are in ascending order (the ranges by
+    // both start and end, since they are generated from ascending positions).
+    // So a single pass over each suffices: the first range that ends at or
+    // after a position is the only one that can contain it.
+    std::vector<Range>::const_iterator q = rangeSet.begin();
     for (PositionSeq::const_iterator p = col.begin(); p != col.end(); ++p) {
-      bool inRange = false;
-      for (std::vector<Range>::const_iterator q = rangeSet.begin();
-           q != rangeSet.end(); ++q) {
-        // TODO Use the fact that the ranges are ordered to break early.
-        if (*p >= q->first && *p <= q->second) {
-          inRange = true;
-          break;
-        }
+      while (q != rangeSet.end() && q->second < *p) {
+        ++q;
+      }
+      if (q == rangeSet.end()) {
+        break;
       }
-      if (!inRange) {
+      if (*p < q->first) {
         continue;
       }
       // If this is the last subpattern then we're done.
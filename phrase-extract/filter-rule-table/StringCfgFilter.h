@@ -29,9 +29,12 @@ public:
   // Initialize the filter for a given set of test sentences.
   StringCfgFilter(const std::vector<boost::shared_ptr<std::string> > &);
 
-  void Filter(std::istream &in, std::ostream &out);
+  void Filter(std::istream &in, std::ostream &out, int threads);
 
 private:
+  // Matches source-sides against the test set on one thread.
+  class Matcher;
+
   // Filtering works by converting the source LHSs of translation rules to
   // patterns containing variable length gaps and then pattern matching
   // against the test set.
@@ -1,10 +1,12 @@
 #include "TsgFilter.h"
 
-#include "boost/scoped_ptr.hpp"
+#include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "util/string_piece.hh"
 #include "util/string_piece_hash.hh"
-#include "util/tokenize_piece.hh"
+
+#include "ParallelFilter.h"
 
 namespace MosesTraining
 {
@@ -13,6 +15,37 @@ namespace Syntax
 namespace FilterRuleTable
 {
 
+class TsgFilter::Matcher : public SourceMatcher
+{
+public:
+  explicit Matcher(const TsgFilter &filter) : m_filter(filter) {}
+
+  bool Match(const StringPiece &source) {
+    // Tokenize the source-side tree fragment.
+    m_tokens.clear();
+    for (TreeFragmentTokenizer p(source); p != TreeFragmentTokenizer(); ++p) {
+      m_tokens.push_back(*p);
+    }
+
+    // Construct an IdTree representing the source-side tree fragment.  This
+    // will fail if the fragment contains any symbols that don't occur in
+    // m_testVocab and in that case the rule can be discarded.  In practice,
+    // this catches a lot of discardable rules (see comment at Filter()).  If
+    // the fragment is successfully created then we attempt to match the tree
+    // fragment against the test trees.  This test is exact, but slow.
+    int i = 0;
+    m_leaves.clear();
+    boost::scoped_ptr<IdTree> fragment(m_filter.BuildTree(m_tokens, i,
+                                       m_leaves));
+    return fragment.get() && m_filter.MatchFragment(*fragment, m_leaves);
+  }
+
+private:
+  const TsgFilter &m_filter;
+  std::vector<TreeFragmentToken> m_tokens;
+  std::vector<IdTree *> m_leaves;
+};
+
 // Read a rule table from 'in' and filter it according to the test sentences.
 //
 // This involves testing TSG fragments for matches against at potential match
@@ -21,7 +54,8 @@ namespace FilterRuleTable
 //
 // Optimization 1
 // If a rule has the same TSG fragment as the previous rule then re-use the
-// result of the previous filtering decision.
+// result of the previous filtering decision (see FilterInBlocks, which splits
+// the rule table into blocks that are filtered on separate threads).
 //
 // Optimization 2
 // Test if the TSG fragment contains any symbols that don't occur in the
@@ -47,68 +81,18 @@ namespace FilterRuleTable
 // 24.1M    Number of rules requiring full tree matching test
 //  6.7M    Number of rules retained after filtering
 //
-void TsgFilter::Filter(std::istream &in, std::ostream &out)
+void TsgFilter::Filter(std::istream &in, std::ostream &out, int threads)
 {
-  const util::MultiCharacter delimiter("|||");
-
-  std::string line;
-  std::string prevLine;
-  StringPiece source;
-  bool keep = true;
-  int lineNum = 0;
-  std::vector<TreeFragmentToken> tokens;
-  std::vector<IdTree *> leaves;
-
-  while (std::getline(in, line)) {
-    ++lineNum;
-
-    // Read the source-side of the rule.
-    util::TokenIter<util::MultiCharacter> it(line, delimiter);
-
-    // Check if this rule has the same source-side as the previous rule.  If
-    // it does then we already know whether or not to keep the rule.  This
-    // optimisation is based on the assumption that the rule table is sorted
-    // (which is the case in the standard Moses training pipeline).
-    if (*it == source) {
-      if (keep) {
-        out << line << std::endl;
-      }
-      continue;
-    }
-
-    // The source-side is different from the previous rule's.
-    source = *it;
-
-    // Tokenize the source-side tree fragment.
-    tokens.clear();
-    for (TreeFragmentTokenizer p(source); p != TreeFragmentTokenizer(); ++p) {
-      tokens.push_back(*p);
-    }
-
-    // Construct an IdTree representing the source-side tree fragment.  This
-    // will fail if the fragment contains any symbols that don't occur in
-    // m_testVocab and in that case the rule can be discarded.  In practice,
-    // this catches a lot of discardable rules (see comment at the top of this
-    // function).  If the fragment is successfully created then we attempt to
-    // match the tree fragment against the test trees.  This test is exact, but
-    // slow.
-    int i = 0;
-    leaves.clear();
-    boost::scoped_ptr<IdTree> fragment(BuildTree(tokens, i, leaves));
-    keep = fragment.get() && MatchFragment(*fragment, leaves);
-    if (keep) {
-      out << line << std::endl;
-    }
-
-    // Retain line for the next iteration (in order that the source StringPiece
-    // remains valid).
-    prevLine.swap(line);
+  std::vector<boost::shared_ptr<SourceMatcher> > matchers;
+  for (int i = 0; i < threads; ++i) {
+    matchers.push_back(boost::make_shared<Matcher>(*this));
   }
+  FilterInBlocks(in, out, matchers);
 }
 
 TsgFilter::IdTree *TsgFilter::BuildTree(
   const std::vector<TreeFragmentToken> &tokens, int &i,
-  std::vector<IdTree *> &leaves)
+  std::vector<IdTree *> &leaves) const
 {
   // The subtree starting at tokens[i] is either:
   // 1. a single non-variable symbol (like NP or dog), or
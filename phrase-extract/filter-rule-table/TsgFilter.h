@@ -23,8 +23,9 @@ class TsgFilter
 public:
   virtual ~TsgFilter() {}
 
-  // Read a rule table from 'in' and filter it according to the test sentences.
-  void Filter(std::istream &in, std::ostream &out);
+  // Read a rule table from 'in' and filter it according to the test sentences,
+  // using the given number of threads.
+  void Filter(std::istream &in, std::ostream &out, int threads);
 
 protected:
   // Maps symbols (terminals and non-terminals) from strings to integers.
@@ -40,14 +41,20 @@ protected:
   // pointers to the fragment's leaves.  If the build fails then i and leaves
   // are undefined.
   IdTree *BuildTree(const std::vector<TreeFragmentToken> &tokens, int &i,
-                    std::vector<IdTree *> &leaves);
+                    std::vector<IdTree *> &leaves) const;
 
   // Try to match a fragment.  The implementation depends on whether the test
-  // sentences are trees or forests.
-  virtual bool MatchFragment(const IdTree &, const std::vector<IdTree *> &) = 0;
+  // sentences are trees or forests.  Called concurrently by the threads of
+  // Filter().
+  virtual bool MatchFragment(const IdTree &,
+                             const std::vector<IdTree *> &) const = 0;
 
   // The symbol vocabulary of the test sentences.
   Vocabulary m_testVocab;
+
+private:
+  // Matches source-side tree fragments on one thread.
+  class Matcher;
 };
 
 }  // namespace FilterRuleTable
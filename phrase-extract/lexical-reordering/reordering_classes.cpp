@@ -273,76 +273,59 @@ void ScorerLR::createConstSmoothing(double weight, vector<double>& smoothing) co
   }
 }
 
-void Model::score_fe(const string& f, const string& e)
+void Model::score(const vector<double>& counts, const vector<double>& smoothing, ostream& out) const
+{
+  vector<double> scores;
+  scorer->score(counts, scores);
+  double sum = 0;
+  for(size_t i=0; i<scores.size(); ++i) {
+    scores[i] += smoothing[i];
+    sum += scores[i];
+  }
+  for(size_t i=0; i<scores.size(); ++i) {
+    out << " " << (scores[i]/sum);
+  }
+}
+
+void Model::score_fe(const ModelScore& ms, const StringPiece& f, const StringPiece& e, ostream& out) const
 {
   if (!fe)    //Make sure we do not do anything if it is not a fe model
     return;
-  outputFile << f << " ||| " << e << " |||";
+  out << f << " ||| " << e << " |||";
   //condition on the previous phrase
   if (previous) {
-    vector<double> scores;
-    scorer->score(modelscore->get_scores_fe_prev(), scores);
-    double sum = 0;
-    for(size_t i=0; i<scores.size(); ++i) {
-      scores[i] += smoothing_prev[i];
-      sum += scores[i];
-    }
-    for(size_t i=0; i<scores.size(); ++i) {
-      outputFile << " " << (scores[i]/sum);
-    }
+    score(ms.get_scores_fe_prev(), smoothing_prev, out);
   }
   //condition on the next phrase
   if (next) {
-    vector<double> scores;
-    scorer->score(modelscore->get_scores_fe_next(), scores);
-    double sum = 0;
-    for(size_t i=0; i<scores.size(); ++i) {
-      scores[i] += smoothing_next[i];
-      sum += scores[i];
-    }
-    for(size_t i=0; i<scores.size(); ++i) {
-      outputFile << " " << (scores[i]/sum);
-    }
+    score(ms.get_scores_fe_next(), smoothing_next, out);
   }
-  outputFile << endl;
+  out << '\n';
 }
 
-void Model::score_f(const string& f)
+void Model::score_f(const ModelScore& ms, const StringPiece& f, ostream& out) const
 {
   if (fe)      //Make sure we do not do anything if it is not a f model
     return;
-  cout << f << " |||";
+  out << f << " |||";
   //condition on the previous phrase
   if (previous) {
-    vector<double> scores;
-    scorer->score(modelscore->get_scores_f_prev(), scores);
-    double sum = 0;
-    for(size_t i=0; i<scores.size(); ++i) {
-      scores[i] += smoothing_prev[i];
-      sum += scores[i];
-    }
-    for(size_t i=0; i<scores.size(); ++i) {
-      outputFile << " " << (scores[i]/sum);
-    }
+    score(ms.get_scores_f_prev(), smoothing_prev, out);
   }
   //condition on the next phrase
   if (next) {
-    vector<double> scores;
-    scorer->score(modelscore->get_scores_f_next(), scores);
-    double sum = 0;
-    for(size_t i=0; i<scores.size(); ++i) {
-      scores[i] += smoothing_next[i];
-      sum += scores[i];
-    }
-    for(size_t i=0; i<scores.size(); ++i) {
-      outputFile << " " << (scores[i]/sum);
-    }
+    score(ms.get_scores_f_next(), smoothing_next, out);
   }
-  outputFile << endl;
+  out << '\n';
+}
+
+void Model::write(const string& text)
+{
+  outputFile << text;
 }
 
-Model::Model(ModelScore* ms, Scorer* sc, const string& dir, const string& lang, const string& fn)
-  : modelscore(ms), scorer(sc), filename(fn)
+Model::Model(Scorer* sc, const string& dir, const string& lang, const string& fn)
+  : scorer(sc), filename(fn)
 {
   outputFile.Open( (filename+".gz").c_str() );
   fe = false;
@@ -366,7 +349,6 @@ Model::Model(ModelScore* ms, Scorer* sc, const string& dir, const string& lang,
 Model::~Model()
 {
   outputFile.Close();
-  delete modelscore;
   delete scorer;
 }
 
@@ -380,20 +362,20 @@ void Model::split_config(const string& config, string& dir, string& lang, string
   getline(is, lang, '-');
 }
 
-Model* Model::createModel(ModelScore* modelscore, const string& config, const string& filepath)
+Model* Model::createModel(const string& config, const string& filepath)
 {
   string dir, lang, orient, filename;
   split_config(config,dir,lang,orient);
 
   filename = filepath + config;
   if (orient.compare("mslr") == 0) {
-    return new Model(modelscore, new ScorerMSLR(), dir, lang, filename);
+    return new Model(new ScorerMSLR(), dir, lang, filename);
   } else if (orient.compare("msd") == 0) {
-    return new Model(modelscore, new ScorerMSD(), dir, lang, filename);
+    return new Model(new ScorerMSD(), dir, lang, filename);
   } else if (orient.compare("monotonicity") == 0) {
-    return new Model(modelscore, new ScorerMonotonicity(), dir, lang, filename);
+    return new Model(new ScorerMonotonicity(), dir, lang, filename);
   } else if (orient.compare("leftright") == 0) {
-    return new Model(modelscore, new ScorerLR(), dir, lang, filename);
+    return new Model(new ScorerLR(), dir, lang, filename);
   } else {
     cerr << "Illegal orientation type of reordering model: " << orient
          << "\n allowed types: mslr, msd, monotonicity, leftright\n";
@@ -403,10 +385,10 @@ Model* Model::createModel(ModelScore* modelscore, const string& config, const st
 
 
 
-void Model::createSmoothing(double w)
+void Model::createSmoothing(const ModelScore& ms, double w)
 {
-  scorer->createSmoothing(modelscore->get_scores_fe_prev(), w, smoothing_prev);
-  scorer->createSmoothing(modelscore->get_scores_fe_next(), w, smoothing_next);
+  scorer->createSmoothing(ms.get_scores_fe_prev(), w, smoothing_prev);
+  scorer->createSmoothing(ms.get_scores_fe_next(), w, smoothing_next);
 }
 
 void Model::createConstSmoothing(double w)
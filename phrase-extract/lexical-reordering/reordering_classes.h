@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <ostream>
 
 #include "util/string_piece.hh"
 #include "../OutputFileStream.h"
@@ -113,13 +114,13 @@ public:
 
 
 //Class for representing each model
-//Contains a modelscore and scorer (which can be of different model types (mslr, msd...)),
-//and file handling.
+//Contains a scorer (which can be of different model types (mslr, msd...)),
+//and file handling. The counts come from a modelscore of the right type, which
+//the caller keeps, so that several threads can score with their own counts.
 //This class also keeps track of bidirectionality, and which language to condition on
 class Model
 {
 private:
-  ModelScore* modelscore;
   Scorer* scorer;
 
   std::string filename;
@@ -134,15 +135,25 @@ private:
 
   static void split_config(const std::string& config, std::string& dir,
                            std::string& lang, std::string& orient);
+  void score(const std::vector<double>& counts, const std::vector<double>& smoothing,
+             std::ostream& out) const;
 public:
-  Model(ModelScore* ms, Scorer* sc, const std::string& dir,
+  Model(Scorer* sc, const std::string& dir,
         const std::string& lang, const std::string& fn);
   ~Model();
-  static Model* createModel(ModelScore*, const std::string&, const std::string&);
-  void createSmoothing(double w);
+  static Model* createModel(const std::string&, const std::string&);
+  void createSmoothing(const ModelScore& ms, double w);
   void createConstSmoothing(double w);
-  void score_fe(const std::string& f, const std::string& e);
-  void score_f(const std::string& f);
-  void zipFile();
+  //Write the scores of a phrase pair (resp. a source phrase) from the counts in ms to out
+  void score_fe(const ModelScore& ms, const StringPiece& f, const StringPiece& e, std::ostream& out) const;
+  void score_f(const ModelScore& ms, const StringPiece& f, std::ostream& out) const;
+  //Append scored text to the model's file
+  void write(const std::string& text);
+  const std::string& getFilename() const {
+    return filename;
+  }
+  bool isFe() const {
+    return fe;
+  }
 };
 
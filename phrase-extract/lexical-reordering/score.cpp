@@ -11,14 +11,24 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+
 #include "util/exception.hh"
 #include "util/file_piece.hh"
 #include "util/string_piece.hh"
 #include "util/tokenize_piece.hh"
 
+#include "phrase-extract/OrderedPipeline.h"
+
 #include "InputFileStream.h"
 #include "reordering_classes.h"
 
@@ -36,6 +46,227 @@ public:
   ~FileFormatException() throw() {}
 };
 
+namespace
+{
+
+// Approximate size of a block in bytes.  A block ends where the source phrase
+// changes, so that all the counts of a source phrase are in one block.
+const size_t kBlockSize = 1 << 22;
+
+// The models to score, the kind of orientations ("hier", "phrase" or "wbe")
+// each one is trained on, and the type of counts of each kind.
+struct Models {
+  vector<Model*> models;
+  vector<string> kinds;
+  map<string,string> scoreTypes;
+};
+
+StringPiece SourcePhrase(const StringPiece& line)
+{
+  util::TokenIter<util::MultiCharacter> pipes(line, util::MultiCharacter(" ||| "));
+  return *pipes;
+}
+
+// Read the next block of whole lines from the extract file into 'block'.
+// 'carry' holds the first line of the block, which was read with the previous
+// one.  Returns false at the end of the input.
+bool ReadBlock(util::FilePiece& in, string& carry, string& block)
+{
+  block.swap(carry);
+  carry.clear();
+  size_t last = 0; // start of the last line in the block
+  while (true) {
+    StringPiece line;
+    try {
+      line = in.ReadLine();
+    } catch (util::EndOfFileException &e) {
+      break;
+    }
+    if (block.size() >= kBlockSize &&
+        SourcePhrase(line) != SourcePhrase(StringPiece(block.data() + last, block.size() - last - 1))) {
+      carry.assign(line.data(), line.size());
+      carry += '\n';
+      return true;
+    }
+    last = block.size();
+    block.append(line.data(), line.size());
+    block += '\n';
+  }
+  return !block.empty();
+}
+
+void AddExample(map<string,ModelScore*>& modelScores, const string& kind,
+                const StringPiece& orientations, float weight)
+{
+  map<string,ModelScore*>::iterator it = modelScores.find(kind);
+  if (it == modelScores.end()) {
+    return;
+  }
+  StringPiece prev, next;
+  get_orientations(orientations, prev, next);
+  it->second->add_example(prev,next,weight);
+}
+
+// Count the orientations of one line of the extract file.
+void AddExamples(map<string,ModelScore*>& modelScores, const StringPiece& line)
+{
+  StringPiece e,f,w,p,h;
+  float weight = 1;
+  split_line(line,f,e,w,p,h,weight);
+  AddExample(modelScores, "hier", h, weight);
+  AddExample(modelScores, "phrase", p, weight);
+  AddExample(modelScores, "wbe", w, weight);
+}
+
+map<string,ModelScore*> CreateModelScores(const Models& config)
+{
+  map<string,ModelScore*> modelScores;
+  for (map<string,string>::const_iterator it = config.scoreTypes.begin(); it != config.scoreTypes.end(); ++it) {
+    modelScores[it->first] = ModelScore::createModelScore(it->second);
+  }
+  return modelScores;
+}
+
+void DeleteModelScores(map<string,ModelScore*>& modelScores)
+{
+  for (map<string,ModelScore*>::iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
+    delete it->second;
+  }
+  modelScores.clear();
+}
+
+// Score the phrase pairs of a block, which holds all the lines of its source
+// phrases, into one text per model.
+void ScoreBlock(const Models& config, const string& block, vector<string>& outputs)
+{
+  const vector<Model*>& models = config.models;
+  map<string,ModelScore*> modelScores = CreateModelScores(config);
+  vector<const ModelScore*> counts(models.size());
+  for (size_t i=0; i<models.size(); ++i) {
+    counts[i] = modelScores[config.kinds[i]];
+  }
+  boost::scoped_array<ostringstream> out(new ostringstream[models.size()]);
+
+  StringPiece f_current, e_current;
+  StringPiece e,f,w,p,h;
+  bool first = true;
+  size_t start = 0;
+  while (start < block.size()) {
+    const size_t end = block.find('\n', start);
+    const StringPiece line(block.data() + start, end - start);
+    start = end + 1;
+
+    float weight = 1;
+    split_line(line,f,e,w,p,h,weight);
+
+    if (first) {
+      f_current = f;
+      e_current = e;
+      first = false;
+    } else if (f != f_current || e != e_current) {
+      //fe - score
+      for (size_t i=0; i<models.size(); ++i) {
+        models[i]->score_fe(*counts[i],f_current,e_current,out[i]);
+      }
+      //reset
+      for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
+        it->second->reset_fe();
+      }
+
+      if (f != f_current) {
+        //f - score
+        for (size_t i=0; i<models.size(); ++i) {
+          models[i]->score_f(*counts[i],f_current,out[i]);
+        }
+        //reset
+        for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
+          it->second->reset_f();
+        }
+      }
+      f_current = f;
+      e_current = e;
+    }
+
+    // update counts
+    AddExamples(modelScores, line);
+  }
+  //Score the last phrases
+  if (!first) {
+    for (size_t i=0; i<models.size(); ++i) {
+      models[i]->score_fe(*counts[i],f_current,e_current,out[i]);
+      models[i]->score_f(*counts[i],f_current,out[i]);
+    }
+  }
+
+  outputs.resize(models.size());
+  for (size_t i=0; i<models.size(); ++i) {
+    outputs[i] = out[i].str();
+  }
+  DeleteModelScores(modelScores);
+}
+
+void WriteBlock(const Models& config, const vector<string>& outputs)
+{
+  for (size_t i=0; i<config.models.size(); ++i) {
+    config.models[i]->write(outputs[i]);
+  }
+}
+
+// Score the extract file in blocks on 'threads' threads and write the tables
+// in input order.
+void ScoreInBlocks(util::FilePiece& in, const Models& config, size_t threads)
+{
+  string carry;
+  MosesTraining::OrderedPipeline<string, vector<string> > pipeline(
+    boost::bind(&ReadBlock, boost::ref(in), boost::ref(carry), _1),
+    boost::bind(&ScoreBlock, boost::cref(config), _2, _3),
+    boost::bind(&WriteBlock, boost::cref(config), _1));
+  pipeline.Run(threads, threads * 4);
+}
+
+// Convert a finished table to the compact format with processLexicalTableMin,
+// which is installed next to this program (or on the PATH, if this program
+// was started from there).
+void CompactTable(const string& program, const string& filename, size_t threads)
+{
+  const string directory = program.substr(0, program.rfind('/') + 1);
+  const string converter = directory + "processLexicalTableMin";
+  const string in = filename + ".gz";
+  const string out = filename + ".minlexr";
+  ostringstream threadCount;
+  threadCount << threads;
+  const string threadArg = threadCount.str();
+
+  vector<const char*> args;
+  args.push_back(converter.c_str());
+  args.push_back("-in");
+  args.push_back(in.c_str());
+  args.push_back("-out");
+  args.push_back(out.c_str());
+#ifdef WITH_THREADS
+  args.push_back("-threads");
+  args.push_back(threadArg.c_str());
+#endif
+  args.push_back(NULL);
+
+  cerr << "Converting " << in << " to " << out << "\n";
+  const pid_t child = fork();
+  UTIL_THROW_IF(child == -1, util::ErrnoException, "fork failed");
+  if (child == 0) {
+    execvp(converter.c_str(), const_cast<char* const*>(&args[0]));
+    cerr << "score: could not run " << converter << ": " << strerror(errno) << endl;
+    _exit(127);
+  }
+  int status;
+  while (waitpid(child, &status, 0) == -1) {
+    UTIL_THROW_IF(errno != EINTR, util::ErrnoException, "waitpid failed");
+  }
+  UTIL_THROW_IF(!WIFEXITED(status) || WEXITSTATUS(status) != 0, util::Exception,
+                converter << " failed to convert " << in);
+}
+
+}  // namespace
+
 int main(int argc, char* argv[])
 {
 
@@ -43,7 +274,7 @@ int main(int argc, char* argv[])
        << "scores lexical reordering models of several types (hierarchical, phrase-based and word-based-extraction\n";
 
   if (argc < 3) {
-    cerr << "syntax: score_reordering extractFile smoothingValue filepath (--model \"type max-orientation (specification-strings)\" )+\n";
+    cerr << "syntax: score_reordering extractFile smoothingValue filepath [--Threads N] [--Compact] (--model \"type max-orientation (specification-strings)\" )+\n";
     exit(1);
   }
 
@@ -54,19 +285,36 @@ int main(int argc, char* argv[])
   util::FilePiece eFile(extractFileName);
 
   bool smoothWithCounts = false;
-  map<string,ModelScore*> modelScores;
-  vector<Model*> models;
+  bool compact = false;
+  size_t threads = 1;
+  Models config;
   bool hier = false;
   bool phrase = false;
   bool wbe = false;
 
-  StringPiece e,f,w,p,h;
-  StringPiece prev, next;
-
   int i = 4;
   while (i<argc) {
     if (strcmp(argv[i],"--SmoothWithCounts") == 0) {
       smoothWithCounts = true;
+    } else if (strcmp(argv[i],"--Compact") == 0) {
+      compact = true;
+    } else if (strcmp(argv[i],"--Threads") == 0) {
+      if (i+1 >= argc) {
+        cerr << "score: syntax error, no number of threads provided to the option" << argv[i] << endl;
+        exit(1);
+      }
+      int n = atoi(argv[++i]);
+      if (n < 1) {
+        cerr << "score: the number of threads must be at least 1" << endl;
+        exit(1);
+      }
+      threads = n;
+#ifndef WITH_THREADS
+      if (threads > 1) {
+        cerr << "score: thread support not compiled in, using 1 thread" << endl;
+        threads = 1;
+      }
+#endif
     } else if (strcmp(argv[i],"--model") == 0) {
       if (i+1 >= argc) {
         cerr << "score: syntax error, no model information provided to the option" << argv[i] << endl;
@@ -75,7 +323,8 @@ int main(int argc, char* argv[])
       istringstream is(argv[++i]);
       string m,t;
       is >> m >> t;
-      modelScores[m] = ModelScore::createModelScore(t);
+      config.scoreTypes[m] = t;
+      delete ModelScore::createModelScore(t); // check the type
       if (m.compare("hier") == 0) {
         hier = true;
       } else if (m.compare("phrase") == 0) {
@@ -90,10 +339,11 @@ int main(int argc, char* argv[])
         return 0;
       }
 
-      string config;
+      string modelConfig;
       //Store all models
-      while (is >> config) {
-        models.push_back(Model::createModel(modelScores[m],config,filepath));
+      while (is >> modelConfig) {
+        config.models.push_back(Model::createModel(modelConfig,filepath));
+        config.kinds.push_back(m);
       }
     } else {
       cerr << "illegal option given to lexical reordering model score\n";
@@ -105,6 +355,7 @@ int main(int argc, char* argv[])
   ////////////////////////////////////
   //calculate smoothing
   if (smoothWithCounts) {
+    map<string,ModelScore*> modelScores = CreateModelScores(config);
     util::FilePiece eFileForCounts(extractFileName);
     while (true) {
       StringPiece line;
@@ -113,101 +364,39 @@ int main(int argc, char* argv[])
       } catch (util::EndOfFileException &e) {
         break;
       }
-      float weight = 1;
-      split_line(line,e,f,w,p,h,weight);
-      if (hier) {
-        get_orientations(h, prev, next);
-        modelScores["hier"]->add_example(prev,next,weight);
-      }
-      if (phrase) {
-        get_orientations(p, prev, next);
-        modelScores["phrase"]->add_example(prev,next,weight);
-      }
-      if (wbe) {
-        get_orientations(w, prev, next);
-        modelScores["wbe"]->add_example(prev,next,weight);
-      }
+      AddExamples(modelScores, line);
     }
 
     // calculate smoothing for each model
-    for (size_t i=0; i<models.size(); ++i) {
-      models[i]->createSmoothing(smoothingValue);
+    for (size_t i=0; i<config.models.size(); ++i) {
+      config.models[i]->createSmoothing(*modelScores[config.kinds[i]], smoothingValue);
     }
+    DeleteModelScores(modelScores);
 
   } else {
     //constant smoothing
-    for (size_t i=0; i<models.size(); ++i) {
-      models[i]->createConstSmoothing(smoothingValue);
+    for (size_t i=0; i<config.models.size(); ++i) {
+      config.models[i]->createConstSmoothing(smoothingValue);
     }
   }
 
   ////////////////////////////////////
   //calculate scores for reordering table
-  string f_current,e_current;
-  bool first = true;
-  while (true) {
-    StringPiece line;
-    try {
-      line = eFile.ReadLine();
-    } catch (util::EndOfFileException &e) {
-      break;
-    }
-    float weight = 1;
-    split_line(line,f,e,w,p,h,weight);
-
-    if (first) {
-      f_current = f.as_string(); //FIXME: Avoid the copy.
-      e_current = e.as_string();
-      first = false;
-    } else if (f.compare(f_current) != 0 || e.compare(e_current) != 0) {
-      //fe - score
-      for (size_t i=0; i<models.size(); ++i) {
-        models[i]->score_fe(f_current,e_current);
-      }
-      //reset
-      for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
-        it->second->reset_fe();
-      }
-
-      if (f.compare(f_current) != 0) {
-        //f - score
-        for (size_t i=0; i<models.size(); ++i) {
-          models[i]->score_f(f_current);
-        }
-        //reset
-        for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
-          it->second->reset_f();
-        }
-      }
-      f_current = f.as_string();
-      e_current = e.as_string();
-    }
+  ScoreInBlocks(eFile, config, threads);
 
-    // uppdate counts
-    if (hier) {
-      get_orientations(h, prev, next);
-      modelScores["hier"]->add_example(prev,next,weight);
-    }
-    if (phrase) {
-      get_orientations(p, prev, next);
-      modelScores["phrase"]->add_example(prev,next,weight);
-    }
-    if (wbe) {
-      get_orientations(w, prev, next);
-      modelScores["wbe"]->add_example(prev,next,weight);
-    }
-  }
-  //Score the last phrases
-  for (size_t i=0; i<models.size(); ++i) {
-    models[i]->score_fe(f_current,e_current);
-  }
-  for (size_t i=0; i<models.size(); ++i) {
-    models[i]->score_f(f_current);
+  // delete model objects (and close files)
+  vector<string> filenames;
+  for (size_t i=0; i<config.models.size(); ++i) {
+    filenames.push_back(config.models[i]->getFilename());
+    delete config.models[i];
   }
 
-  // delete model objects (and close files)
-  for (size_t i=0; i<models.size(); ++i) {
-    delete models[i];
+  ////////////////////////////////////
+  //convert the tables to the compact format
+  if (compact) {
+    for (size_t i=0; i<filenames.size(); ++i) {
+      CompactTable(argv[0], filenames[i], threads);
+    }
   }
   return 0;
 }
@@ -26,7 +26,10 @@
 #include <vector>
 #include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/unordered_map.hpp>
+#include "ExtractSorter.h"
 
 #include "ScoreFeature.h"
 #include "tables-core.h"
@@ -73,6 +76,7 @@ int countOfCounts[COC_MAX+1];
 int totalDistinct = 0;
 float minCount = 0;
 float minCountHierarchical = 0;
+size_t sortMemory = 1024; // in MB, for a ".runs" phrase table
 bool phraseOrientationPriorsFlag = false;
 
 boost::unordered_map<std::string,float> sourceLHSCounts;
@@ -153,7 +157,8 @@ int main(int argc, char* argv[])
               "[--TargetPreferenceLabels] "
               "[--UnpairedExtractFormat] "
               "[--ConditionOnTargetLHS] "
-              "[--CrossedNonTerm]"
+              "[--CrossedNonTerm] "
+              "[--SortMemory MB]"
               << std::endl;
     std::cerr << featureManager.usage() << std::endl;
     exit(1);
@@ -259,6 +264,12 @@ int main(int argc, char* argv[])
       minCountHierarchical = std::atof( argv[++i] );
       std::cerr << "dropping all hierarchical phrase pairs occurring less than " << minCountHierarchical << " times" << std::endl;
       minCountHierarchical -= 0.00001; // account for rounding
+    } else if (strcmp(argv[i],"--SortMemory") == 0) {
+      if (i+1==argc) {
+        std::cerr << "ERROR: specify the memory in MB for --SortMemory!" << std::endl;
+        exit(1);
+      }
+      sortMemory = std::atoi( argv[++i] );
     } else if (strcmp(argv[i],"--CrossedNonTerm") == 0) {
       crossedNonTerm = true;
       std::cerr << "crossed non-term reordering feature" << std::endl;
@@ -328,9 +339,16 @@ int main(int argc, char* argv[])
 
   // output file: phrase translation table
   std::ostream *phraseTableFile;
+  boost::scoped_ptr<ExtractSorter> phraseTableSorter;
 
   if (fileNamePhraseTable == "-") {
     phraseTableFile = &std::cout;
+  } else if (ends_with(fileNamePhraseTable, ".runs")) {
+    // sorted runs, which consolidate reads without a separate sort
+    phraseTableSorter.reset(new ExtractSorter(fileNamePhraseTable, sortMemory << 20, fileNamePhraseTable));
+    boost::iostreams::filtering_ostream *sortStream = new boost::iostreams::filtering_ostream();
+    sortStream->push(ExtractSorterSink(*phraseTableSorter));
+    phraseTableFile = sortStream;
   } else {
     Moses::OutputFileStream *outputFile = new Moses::OutputFileStream();
     bool success = outputFile->Open(fileNamePhraseTable);
@@ -486,6 +504,9 @@ int main(int argc, char* argv[])
   if (phraseTableFile != &std::cout) {
     delete phraseTableFile;
   }
+  if (phraseTableSorter) {
+    phraseTableSorter->Finish();
+  }
 
   // output count of count statistics
   if (goodTuringFlag || kneserNeyFlag) {
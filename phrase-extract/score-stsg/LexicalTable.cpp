@@ -46,7 +46,7 @@ void LexicalTable::Load(std::istream &input)
     // Probability.
     it->CopyToString(&tmp);
     double prob = atof(tmp.c_str());
-    m_table[srcId][tgtId] = prob;
+    m_table[std::make_pair(srcId, tgtId)] = prob;
   }
   std::cerr << std::endl;
 }
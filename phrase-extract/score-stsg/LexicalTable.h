@@ -2,8 +2,10 @@
 
 #include <istream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <boost/functional/hash.hpp>
 #include <boost/unordered_map.hpp>
 
 #include "Vocabulary.h"
@@ -15,6 +17,9 @@ namespace Syntax
 namespace ScoreStsg
 {
 
+// Lexical translation probabilities, keyed by pairs of vocabulary IDs so that
+// a lookup is a single probe.  Lookups do not modify the table and can be
+// made from several threads.
 class LexicalTable
 {
 public:
@@ -22,23 +27,18 @@ public:
 
   void Load(std::istream &);
 
-  double PermissiveLookup(Vocabulary::IdType s, Vocabulary::IdType t) {
-    OuterMap::const_iterator p = m_table.find(s);
-    if (p == m_table.end()) {
-      return 1.0;
-    }
-    const InnerMap &inner = p->second;
-    InnerMap::const_iterator q = inner.find(t);
-    return q == inner.end() ? 1.0 : q->second;
+  double PermissiveLookup(Vocabulary::IdType s, Vocabulary::IdType t) const {
+    Map::const_iterator p = m_table.find(std::make_pair(s, t));
+    return p == m_table.end() ? 1.0 : p->second;
   }
 
 private:
-  typedef boost::unordered_map<Vocabulary::IdType, double> InnerMap;
-  typedef boost::unordered_map<Vocabulary::IdType, InnerMap> OuterMap;
+  typedef std::pair<Vocabulary::IdType, Vocabulary::IdType> Key;
+  typedef boost::unordered_map<Key, double, boost::hash<Key> > Map;
 
   Vocabulary &m_srcVocab;
   Vocabulary &m_tgtVocab;
-  OuterMap m_table;
+  Map m_table;
 };
 
 }  // namespace ScoreStsg
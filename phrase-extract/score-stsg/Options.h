@@ -20,6 +20,7 @@ public:
     , negLogProb(false)
     , noLex(false)
     , noWordAlignment(false)
+    , threads(1)
     , treeScore(false) {}
 
   // Positional options
@@ -36,6 +37,7 @@ public:
   bool negLogProb;
   bool noLex;
   bool noWordAlignment;
+  int threads;
   bool treeScore;
 };
 
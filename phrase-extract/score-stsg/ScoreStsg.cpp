@@ -9,6 +9,7 @@
 #include <sstream>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/program_options.hpp>
 
 #include "util/string_piece.hh"
@@ -16,6 +17,7 @@
 #include "util/tokenize_piece.hh"
 
 #include "InputFileStream.h"
+#include "OrderedPipeline.h"
 #include "OutputFileStream.h"
 
 #include "syntax-common/exception.h"
@@ -34,10 +36,40 @@ namespace ScoreStsg
 
 const int ScoreStsg::kCountOfCountsMax = 10;
 
+namespace
+{
+
+// Approximate size of a block in bytes.  Blocks end where the source-side
+// changes, so a block holds whole rule groups.
+const std::size_t kBlockSize = 1 << 22;
+
+}  // namespace
+
+// A block of whole rule groups of the extract file.  Its first line is line
+// number 'firstLine' of the file.
+struct ScoreStsg::ExtractBlock {
+  ExtractBlock() : firstLine(0) {}
+
+  std::size_t firstLine;
+  std::string input;
+};
+
+// The part of the rule table and of the count of counts statistics that come
+// from an ExtractBlock.  If scoring failed then 'error' is set and 'output'
+// holds the lines written before the failure.
+struct ScoreStsg::Block {
+  Block() : totalDistinct(0) {}
+
+  std::string output;
+  std::vector<int> countOfCounts;
+  int totalDistinct;
+  std::string error;
+};
+
 ScoreStsg::ScoreStsg()
   : Tool("score-stsg")
   , m_lexTable(m_srcVocab, m_tgtVocab)
-  , m_countOfCounts(kCountOfCountsMax, 0)
+  , m_countOfCounts(kCountOfCountsMax+1, 0)
   , m_totalDistinct(0)
 {
 }
@@ -64,15 +96,88 @@ int ScoreStsg::Main(int argc, char *argv[])
     m_lexTable.Load(lexStream);
   }
 
-  const util::MultiCharacter delimiter("|||");
+  // Score the extract file block by block.  Each block covers a range of
+  // source-sides, so blocks can be scored independently; they are written in
+  // input order.
+  std::string carry;
   std::size_t lineNum = 0;
-  std::size_t startLine= 0;
+  std::vector<Scratch> scratch(m_options.threads);
+  OrderedPipeline<ExtractBlock, Block> pipeline(
+    boost::bind(&ScoreStsg::ReadBlock, this, boost::ref(extractStream),
+                boost::ref(carry), boost::ref(lineNum), _1),
+    boost::bind(&ScoreStsg::ScoreThreadBlock, this, boost::ref(scratch),
+                _1, _2, _3),
+    boost::bind(&ScoreStsg::WriteBlock, this, _1, boost::ref(outStream)));
+  pipeline.Run(m_options.threads, m_options.threads * 4);
+
+  // Write count of counts file.
+  if (m_options.goodTuring || m_options.kneserNey) {
+    // Kneser-Ney needs the total number of distinct rules.
+    countOfCountsStream << m_totalDistinct << std::endl;
+    // Write out counts of counts.
+    for (int i = 1; i <= kCountOfCountsMax; ++i) {
+      countOfCountsStream << m_countOfCounts[i] << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+bool ScoreStsg::ReadBlock(std::istream &in, std::string &carry,
+                          std::size_t &lineNum, ExtractBlock &block) const
+{
+  const util::MultiCharacter delimiter("|||");
+
+  // 'carry' holds the first line of this block (line number 'lineNum'),
+  // which was read with the previous block.
+  block.input.clear();
+  block.firstLine = lineNum+1;
+  std::size_t lastStart = 0;
+  if (!carry.empty()) {
+    block.firstLine = lineNum;
+    block.input.swap(carry);
+    block.input += '\n';
+  }
+
   std::string line;
-  std::string tmp;
+  while (std::getline(in, line)) {
+    ++lineNum;
+    if (block.input.size() >= kBlockSize) {
+      const StringPiece last(block.input.data() + lastStart,
+                             block.input.size() - lastStart - 1);
+      if (*util::TokenIter<util::MultiCharacter>(line, delimiter) !=
+          *util::TokenIter<util::MultiCharacter>(last, delimiter)) {
+        carry.swap(line);
+        return true;
+      }
+    }
+    lastStart = block.input.size();
+    block.input += line;
+    block.input += '\n';
+  }
+  return !block.input.empty();
+}
+
+void ScoreStsg::ScoreBlock(const ExtractBlock &extract, Scratch &scratch,
+                           Block &block) const
+{
+  block.countOfCounts.assign(kCountOfCountsMax+1, 0);
+  block.totalDistinct = 0;
+  block.error.clear();
+
+  const util::MultiCharacter delimiter("|||");
+  std::ostringstream out;
+  RuleTableWriter ruleTableWriter(m_options, out);
   RuleGroup ruleGroup;
-  RuleTableWriter ruleTableWriter(m_options, outStream);
+  std::size_t lineNum = extract.firstLine-1;
+  std::size_t startLine = 0;
+  std::string tmp;
 
-  while (std::getline(extractStream, line)) {
+  std::size_t pos = 0;
+  while (pos < extract.input.size()) {
+    const std::size_t end = extract.input.find('\n', pos);
+    const StringPiece line(extract.input.data() + pos, end - pos);
+    pos = end+1;
     ++lineNum;
 
     // Tokenize the input line.
@@ -93,8 +198,12 @@ int ScoreStsg::Main(int argc, char *argv[])
     // If this is the first line or if source has changed since the last
     // line then process the current rule group and start a new one.
     if (source != ruleGroup.GetSource()) {
-      if (lineNum > 1) {
-        ProcessRuleGroupOrDie(ruleGroup, ruleTableWriter, startLine, lineNum-1);
+      if (lineNum > extract.firstLine) {
+        if (!ProcessRuleGroupOrFail(ruleGroup, ruleTableWriter, scratch, block,
+                                    startLine, lineNum-1)) {
+          block.output = out.str();
+          return;
+        }
       }
       startLine = lineNum;
       ruleGroup.SetNewSource(source);
@@ -105,22 +214,34 @@ int ScoreStsg::Main(int argc, char *argv[])
   }
 
   // Process the final rule group.
-  ProcessRuleGroupOrDie(ruleGroup, ruleTableWriter, startLine, lineNum);
+  ProcessRuleGroupOrFail(ruleGroup, ruleTableWriter, scratch, block,
+                         startLine, lineNum);
+  block.output = out.str();
+}
 
-  // Write count of counts file.
-  if (m_options.goodTuring || m_options.kneserNey) {
-    // Kneser-Ney needs the total number of distinct rules.
-    countOfCountsStream << m_totalDistinct << std::endl;
-    // Write out counts of counts.
-    for (int i = 1; i <= kCountOfCountsMax; ++i) {
-      countOfCountsStream << m_countOfCounts[i] << std::endl;
-    }
+void ScoreStsg::WriteBlock(const Block &block, std::ostream &out)
+{
+  out.write(block.output.data(), block.output.size());
+  m_totalDistinct += block.totalDistinct;
+  for (int i = 1; i <= kCountOfCountsMax; ++i) {
+    m_countOfCounts[i] += block.countOfCounts[i];
   }
+  if (!block.error.empty()) {
+    Error(block.error);
+  }
+}
 
-  return 0;
+// Score a block with the scratch space of the thread.
+void ScoreStsg::ScoreThreadBlock(std::vector<Scratch> &scratch,
+                                 std::size_t thread,
+                                 const ExtractBlock &extract,
+                                 Block &block) const
+{
+  ScoreBlock(extract, scratch[thread], block);
 }
 
-void ScoreStsg::TokenizeRuleHalf(const std::string &s, TokenizedRuleHalf &half)
+void ScoreStsg::TokenizeRuleHalf(const std::string &s,
+                                 TokenizedRuleHalf &half) const
 {
   // Copy s to half.string, but strip any leading or trailing whitespace.
   std::size_t start = s.find_first_not_of(" \t");
@@ -161,35 +282,51 @@ void ScoreStsg::TokenizeRuleHalf(const std::string &s, TokenizedRuleHalf &half)
   }
 }
 
-void ScoreStsg::ProcessRuleGroupOrDie(const RuleGroup &group,
-                                      RuleTableWriter &writer,
-                                      std::size_t start,
-                                      std::size_t end)
+bool ScoreStsg::ProcessRuleGroupOrFail(const RuleGroup &group,
+                                       RuleTableWriter &writer,
+                                       Scratch &scratch, Block &block,
+                                       std::size_t start,
+                                       std::size_t end) const
 {
+  std::ostringstream msg;
   try {
-    ProcessRuleGroup(group, writer);
+    ProcessRuleGroup(group, writer, scratch, block);
+    return true;
   } catch (const Exception &e) {
-    std::ostringstream msg;
     msg << "failed to process rule group at lines " << start << "-" << end
         << ": " << e.msg();
-    Error(msg.str());
   } catch (const std::exception &e) {
-    std::ostringstream msg;
     msg << "failed to process rule group at lines " << start << "-" << end
         << ": " << e.what();
-    Error(msg.str());
   }
+  block.error = msg.str();
+  return false;
 }
 
 void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
-                                 RuleTableWriter &writer)
+                                 RuleTableWriter &writer,
+                                 Scratch &scratch, Block &block) const
 {
   const std::size_t totalCount = group.GetTotalCount();
   const std::size_t distinctCount = group.GetSize();
 
-  TokenizeRuleHalf(group.GetSource(), m_sourceHalf);
+  TokenizedRuleHalf &sourceHalf = scratch.sourceHalf;
+  TokenizedRuleHalf &targetHalf = scratch.targetHalf;
+  TokenizeRuleHalf(group.GetSource(), sourceHalf);
 
-  const bool fullyLexical = m_sourceHalf.IsFullyLexical();
+  const bool fullyLexical = sourceHalf.IsFullyLexical();
+
+  // Look up the source symbols once for the whole group.
+  scratch.sourceIds.clear();
+  if (!m_options.noLex) {
+    for (std::vector<RuleSymbol>::const_iterator p =
+           sourceHalf.frontierSymbols.begin();
+         p != sourceHalf.frontierSymbols.end(); ++p) {
+      scratch.sourceIds.push_back(
+        m_srcVocab.Lookup(p->value, StringPieceCompatibleHash(),
+                          StringPieceCompatibleEquals()));
+    }
+  }
 
   // Process each distinct rule in turn.
   for (RuleGroup::ConstIterator p = group.Begin(); p != group.End(); ++p) {
@@ -197,10 +334,10 @@ void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
 
     // Update count of count statistics.
     if (m_options.goodTuring || m_options.kneserNey) {
-      ++m_totalDistinct;
+      ++block.totalDistinct;
       int countInt = rule.count + 0.99999;
       if (countInt <= kCountOfCountsMax) {
-        ++m_countOfCounts[countInt];
+        ++block.countOfCounts[countInt];
       }
     }
 
@@ -210,7 +347,7 @@ void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
       continue;
     }
 
-    TokenizeRuleHalf(rule.target, m_targetHalf);
+    TokenizeRuleHalf(rule.target, targetHalf);
 
     // Find the most frequent alignment (if there's a tie, take the first one).
     std::vector<std::pair<std::string, int> >::const_iterator q =
@@ -222,21 +359,24 @@ void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
       }
     }
     const std::string &bestAlignment = bestAlignmentAndCount->first;
-    ParseAlignmentString(bestAlignment, m_targetHalf.frontierSymbols.size(),
-                         m_tgtToSrc);
+    ParseAlignmentString(bestAlignment, targetHalf.frontierSymbols.size(),
+                         scratch.tgtToSrc);
 
     // Compute the lexical translation probability.
-    double lexProb = ComputeLexProb(m_sourceHalf.frontierSymbols,
-                                    m_targetHalf.frontierSymbols, m_tgtToSrc);
+    double lexProb = 1.0;
+    if (!m_options.noLex) {
+      lexProb = ComputeLexProb(scratch.sourceIds, targetHalf.frontierSymbols,
+                               scratch.tgtToSrc);
+    }
 
     // Write a line to the rule table.
-    writer.WriteLine(m_sourceHalf, m_targetHalf, bestAlignment, lexProb,
+    writer.WriteLine(sourceHalf, targetHalf, bestAlignment, lexProb,
                      rule.treeScore, p->count, totalCount, distinctCount);
   }
 }
 
 void ScoreStsg::ParseAlignmentString(const std::string &s, int numTgtWords,
-                                     ALIGNMENT &tgtToSrc)
+                                     ALIGNMENT &tgtToSrc) const
 {
   tgtToSrc.clear();
   tgtToSrc.resize(numTgtWords);
@@ -268,9 +408,10 @@ void ScoreStsg::ParseAlignmentString(const std::string &s, int numTgtWords,
   }
 }
 
-double ScoreStsg::ComputeLexProb(const std::vector<RuleSymbol> &sourceFrontier,
-                                 const std::vector<RuleSymbol> &targetFrontier,
-                                 const ALIGNMENT &tgtToSrc)
+double ScoreStsg::ComputeLexProb(
+  const std::vector<Vocabulary::IdType> &sourceIds,
+  const std::vector<RuleSymbol> &targetFrontier,
+  const ALIGNMENT &tgtToSrc) const
 {
   double lexScore = 1.0;
   for (std::size_t i = 0; i < targetFrontier.size(); ++i) {
@@ -288,11 +429,7 @@ double ScoreStsg::ComputeLexProb(const std::vector<RuleSymbol> &sourceFrontier,
       double thisWordScore = 0.0;
       for (std::set<std::size_t>::const_iterator p = srcIndices.begin();
            p != srcIndices.end(); ++p) {
-        Vocabulary::IdType srcId =
-          m_srcVocab.Lookup(sourceFrontier[*p].value,
-                            StringPieceCompatibleHash(),
-                            StringPieceCompatibleEquals());
-        thisWordScore += m_lexTable.PermissiveLookup(srcId, tgtId);
+        thisWordScore += m_lexTable.PermissiveLookup(sourceIds[*p], tgtId);
       }
       lexScore *= thisWordScore / static_cast<double>(srcIndices.size());
     }
@@ -342,6 +479,9 @@ void ScoreStsg::ProcessOptions(int argc, char *argv[], Options &options) const
    "do not output word alignments")
   ("PCFG",
    "synonym for TreeScore (included for compatibility with score)")
+  ("Threads",
+   po::value(&options.threads)->default_value(options.threads),
+   "score blocks of rule groups on this many threads (output is in input order)")
   ("TreeScore",
    "include pre-computed tree score from extract")
   ("UnpairedExtractFormat",
@@ -424,6 +564,15 @@ void ScoreStsg::ProcessOptions(int argc, char *argv[], Options &options) const
   if (vm.count("TreeScore") || vm.count("PCFG")) {
     options.treeScore = true;
   }
+
+  if (options.threads < 1) {
+    Error("--Threads must be at least 1");
+  }
+#ifndef WITH_THREADS
+  if (options.threads > 1) {
+    Error("--Threads requires thread support");
+  }
+#endif
 }
 
 }  // namespace ScoreStsg
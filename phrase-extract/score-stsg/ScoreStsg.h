@@ -37,21 +37,43 @@ public:
 private:
   static const int kCountOfCountsMax;
 
-  double ComputeLexProb(const std::vector<RuleSymbol> &,
+  struct ExtractBlock;
+  struct Block;
+
+  // The scratch space of one thread.
+  struct Scratch {
+    TokenizedRuleHalf sourceHalf;
+    TokenizedRuleHalf targetHalf;
+    ALIGNMENT tgtToSrc;
+    std::vector<Vocabulary::IdType> sourceIds;
+  };
+
+  double ComputeLexProb(const std::vector<Vocabulary::IdType> &,
                         const std::vector<RuleSymbol> &,
-                        const ALIGNMENT &);
+                        const ALIGNMENT &) const;
 
   void ParseAlignmentString(const std::string &, int,
-                            ALIGNMENT &);
+                            ALIGNMENT &) const;
 
   void ProcessOptions(int, char *[], Options &) const;
 
-  void ProcessRuleGroup(const RuleGroup &, RuleTableWriter &);
+  bool ReadBlock(std::istream &, std::string &, std::size_t &,
+                 ExtractBlock &) const;
 
-  void ProcessRuleGroupOrDie(const RuleGroup &, RuleTableWriter &,
-                             std::size_t, std::size_t);
+  void ScoreBlock(const ExtractBlock &, Scratch &, Block &) const;
 
-  void TokenizeRuleHalf(const std::string &, TokenizedRuleHalf &);
+  void ScoreThreadBlock(std::vector<Scratch> &, std::size_t,
+                        const ExtractBlock &, Block &) const;
+
+  void ProcessRuleGroup(const RuleGroup &, RuleTableWriter &, Scratch &,
+                        Block &) const;
+
+  bool ProcessRuleGroupOrFail(const RuleGroup &, RuleTableWriter &, Scratch &,
+                              Block &, std::size_t, std::size_t) const;
+
+  void WriteBlock(const Block &, std::ostream &);
+
+  void TokenizeRuleHalf(const std::string &, TokenizedRuleHalf &) const;
 
   Options m_options;
   Vocabulary m_srcVocab;
@@ -59,9 +81,6 @@ private:
   LexicalTable m_lexTable;
   std::vector<int> m_countOfCounts;
   int m_totalDistinct;
-  TokenizedRuleHalf m_sourceHalf;
-  TokenizedRuleHalf m_targetHalf;
-  ALIGNMENT m_tgtToSrc;
 };
 
 }  // namespace ScoreStsg
@@ -69,13 +69,14 @@ class SingleBest {
 
     NBestComplete Complete(PartialEdge partial) {
       if (!partial.Valid())
-        return NBestComplete(NULL, lm::ngram::ChartState(), -INFINITY);
+        return NBestComplete(NULL, lm::ngram::ChartState(), -INFINITY, NULL);
       void *place_final = pool_.Allocate(Applied::Size(partial.GetArity()));
       Applied(place_final, partial);
       return NBestComplete(
           place_final,
           partial.CompletedState(),
-          partial.GetScore());
+          partial.GetScore(),
+          partial.GetFeatureState());
     }
 
   private:
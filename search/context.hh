@@ -8,9 +8,12 @@
 
 namespace search {
 
+class Features;
+
 class ContextBase {
   public:
-    explicit ContextBase(const Config &config) : config_(config) {}
+    // features, if not NULL, are scored on top of the language model.
+    explicit ContextBase(const Config &config, Features *features = NULL) : config_(config), features_(features) {}
 
     VertexNode *NewVertexNode() {
       VertexNode *ret = vertex_node_pool_.construct();
@@ -28,15 +31,19 @@ class ContextBase {
 
     const Config &GetConfig() const { return config_; }
 
+    Features *GetFeatures() const { return features_; }
+
   private:
     boost::object_pool<VertexNode> vertex_node_pool_;
 
     Config config_;
+
+    Features *features_;
 };
 
 template <class Model> class Context : public ContextBase {
   public:
-    Context(const Config &config, const Model &model) : ContextBase(config), model_(model) {}
+    Context(const Config &config, const Model &model, Features *features = NULL) : ContextBase(config, features), model_(model) {}
 
     const Model &LanguageModel() const { return model_; }
 
@@ -4,6 +4,7 @@
 #include "lm/model.hh"
 #include "lm/partial.hh"
 #include "search/context.hh"
+#include "search/features.hh"
 #include "search/vertex.hh"
 
 #include <numeric>
@@ -68,7 +69,14 @@ template <class Model> PartialEdge EdgeGenerator::Pop(Context<Model> &context) {
       }
     }
     if (lowest_niceness == 255) {
-      return top;
+      Features *features = context.GetFeatures();
+      if (!features || top.GetFeatureState()) return top;
+      // Now the other features can be scored.  That changes the score, so requeue.
+      const void *state;
+      top.SetScore(top.GetScore() + features->Apply(top, state));
+      top.SetFeatureState(state);
+      generate_.push(top);
+      return PartialEdge();
     }
     incomplete = arity - completed;
   }
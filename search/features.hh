@@ -0,0 +1,76 @@
+#ifndef SEARCH_FEATURES__
+#define SEARCH_FEATURES__
+
+#include "search/edge.hh"
+#include "search/types.hh"
+#include "util/murmur_hash.hh"
+
+#include <cstddef>
+
+#include <stdint.h>
+
+namespace search {
+
+/* Features other than the language model that drives the search, supplied by
+ * the decoder.  Their state is opaque here: every hypothesis carries a
+ * pointer to it (Header::GetFeatureState), which the decoder owns.
+ *
+ * Until all its non-terminals are single hypotheses, an edge's score has only
+ * the decoder's estimate for these features.  Then Apply scores it and the
+ * edge goes back into the queue with the new score.  Hypotheses recombine
+ * only if both their language model states and their feature states match.
+ */
+class Features {
+  public:
+    virtual ~Features() {}
+
+    /* Score edge, whose non-terminals are all complete, so NT()[i].End() is a
+     * hypothesis with state NT()[i].FeatureState().  Returns the change to
+     * the edge's score and sets state, which must not be NULL.
+     */
+    virtual Score Apply(const PartialEdge &edge, const void *&state) = 0;
+
+    // For recombination.  Equal states must have the same hash.
+    virtual uint64_t Hash(const void *state) const = 0;
+    virtual bool Equal(const void *first, const void *second) const = 0;
+};
+
+// Hypotheses are recombined by the hash of their chart state and by their feature state.
+struct RecombinationKey {
+  RecombinationKey(uint64_t in_chart, const void *in_features)
+    : chart(in_chart), features(in_features) {}
+
+  uint64_t chart;
+  const void *features;
+};
+
+class RecombinationHash {
+  public:
+    explicit RecombinationHash(const Features *features) : features_(features) {}
+
+    std::size_t operator()(const RecombinationKey &key) const {
+      if (!key.features) return key.chart;
+      return util::MurmurHashNative(&key.chart, sizeof(uint64_t), features_->Hash(key.features));
+    }
+
+  private:
+    const Features *features_;
+};
+
+class RecombinationEqual {
+  public:
+    explicit RecombinationEqual(const Features *features) : features_(features) {}
+
+    bool operator()(const RecombinationKey &first, const RecombinationKey &second) const {
+      if (first.chart != second.chart) return false;
+      if (first.features == second.features) return true;
+      return first.features && second.features && features_->Equal(first.features, second.features);
+    }
+
+  private:
+    const Features *features_;
+};
+
+} // namespace search
+
+#endif // SEARCH_FEATURES__
@@ -1,7 +1,7 @@
 #ifndef SEARCH_HEADER__
 #define SEARCH_HEADER__
 
-// Header consisting of Score, Arity, Note and WordsRange
+// Header consisting of Score, Arity, Note, WordsRange and feature state
 
 #include "search/types.hh"
 #include "moses/WordsRange.h"
@@ -46,6 +46,15 @@ class Header {
       *reinterpret_cast<Moses::WordsRange*>(base_ + sizeof(Score) + sizeof(Arity) + sizeof(Note)) = to;
     }
 
+    // State of the features other than the language model (see features.hh).
+    // NULL until they are scored.
+    const void *GetFeatureState() const {
+      return *reinterpret_cast<const void *const*>(base_ + kFeatureStateOffset);
+    }
+    void SetFeatureState(const void *to) {
+      *reinterpret_cast<const void**>(base_ + kFeatureStateOffset) = to;
+    }
+
     uint8_t *Base() { return base_; }
     const uint8_t *Base() const { return base_; }
 
@@ -56,9 +65,11 @@ class Header {
 
     Header(void *base, Arity arity) : base_(static_cast<uint8_t*>(base)) {
       *reinterpret_cast<Arity*>(base_ + sizeof(Score)) = arity;
+      SetFeatureState(NULL);
     }
 
-    static const std::size_t kHeaderSize = sizeof(Score) + sizeof(Arity) + sizeof(Note) + sizeof(Moses::WordsRange);
+    static const std::size_t kFeatureStateOffset = sizeof(Score) + sizeof(Arity) + sizeof(Note) + sizeof(Moses::WordsRange);
+    static const std::size_t kHeaderSize = kFeatureStateOffset + sizeof(const void*);
 
     uint8_t *After() { return base_ + kHeaderSize; }
     const uint8_t *After() const { return base_ + kHeaderSize; }
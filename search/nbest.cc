@@ -70,6 +70,8 @@ void NBestList::MoveTop(util::Pool &pool) {
     if (change != -INFINITY) {
       assert(change < 0.001);
       QueueEntry new_entry(pool.Allocate(QueueEntry::Size(entry.GetArity())), basis + change, entry.GetArity(), entry.GetNote(), entry.GetRange());
+      // The alternative child has the same feature state, so the rule's does not change.
+      new_entry.SetFeatureState(entry.GetFeatureState());
       std::copy(children_begin, child, new_entry.Children());
       RevealedRef *update = new_entry.Children() + (child - children_begin);
       update->in_ = child->in_;
@@ -96,7 +98,8 @@ NBestComplete NBest::Complete(std::vector<PartialEdge> &partials) {
   return NBestComplete(
       list,
       partials.front().CompletedState(), // All partials have the same state
-      list->TopAfterConstructor());
+      list->TopAfterConstructor(),
+      partials.front().GetFeatureState());
 }
 
 const std::vector<Applied> &NBest::Extract(History history) {
@@ -18,12 +18,13 @@ union Note {
 typedef void *History;
 
 struct NBestComplete {
-  NBestComplete(History in_history, const lm::ngram::ChartState &in_state, Score in_score)
-    : history(in_history), state(&in_state), score(in_score) {}
+  NBestComplete(History in_history, const lm::ngram::ChartState &in_state, Score in_score, const void *in_feature_state)
+    : history(in_history), state(&in_state), score(in_score), feature_state(in_feature_state) {}
 
   History history;
   const lm::ngram::ChartState *state;
   Score score;
+  const void *feature_state;
 };
 
 } // namespace search
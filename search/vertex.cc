@@ -106,8 +106,9 @@ const unsigned char kPolicyAlternate = 0;
 const unsigned char kPolicyOneLeft = 1;
 // Branch based on right state only.
 const unsigned char kPolicyOneRight = 2;
-// Reveal everything in the next branch.  Used to terminate the left/right policies.
-//    static const unsigned char kPolicyEverything = 3;
+// The language model states are all the same, so only the feature states
+// differ.  Each hypothesis is a branch.
+const unsigned char kPolicyEverything = 3;
 
 } // namespace
 
@@ -163,6 +164,8 @@ void VertexNode::FinishedAppending(const unsigned char common_left, const unsign
 
   if (!all_full && !all_non_full) {
     policy_ = kPolicyAlternate;
+  } else if (left.Complete() && right.Complete()) {
+    policy_ = kPolicyEverything;
   } else if (left.Complete()) {
     policy_ = kPolicyOneRight;
   } else if (right.Complete()) {
@@ -178,22 +181,29 @@ void VertexNode::BuildExtend() {
   if (!extend_.empty()) return;
   // Nothing to build since this is a leaf.
   if (hypos_.size() <= 1) return;
-  bool left_branch = true;
-  switch (policy_) {
-    case kPolicyAlternate:
-      left_branch = (state_.left.length <= state_.right.length);
-      break;
-    case kPolicyOneLeft:
-      left_branch = true;
-      break;
-    case kPolicyOneRight:
-      left_branch = false;
-      break;
-  }
-  if (left_branch) {
-    Split(DivideLeft(state_.left.length), hypos_, extend_);
+  if (policy_ == kPolicyEverything) {
+    extend_.resize(hypos_.size());
+    for (std::size_t i = 0; i < hypos_.size(); ++i) {
+      extend_[i].AppendHypothesis(hypos_[i]);
+    }
   } else {
-    Split(DivideRight(state_.right.length), hypos_, extend_);
+    bool left_branch = true;
+    switch (policy_) {
+      case kPolicyAlternate:
+        left_branch = (state_.left.length <= state_.right.length);
+        break;
+      case kPolicyOneLeft:
+        left_branch = true;
+        break;
+      case kPolicyOneRight:
+        left_branch = false;
+        break;
+    }
+    if (left_branch) {
+      Split(DivideLeft(state_.left.length), hypos_, extend_);
+    } else {
+      Split(DivideRight(state_.right.length), hypos_, extend_);
+    }
   }
   for (std::vector<VertexNode>::iterator i = extend_.begin(); i != extend_.end(); ++i) {
     // TODO: provide more here for branching?
@@ -19,6 +19,7 @@ struct HypoState {
   History history;
   lm::ngram::ChartState state;
   Score score;
+  const void *feature_state;
 };
 
 class VertexNode {
@@ -36,11 +37,12 @@ class VertexNode {
      */
     // Must default construct, call AppendHypothesis 1 or more times then do FinishedAppending.
     void AppendHypothesis(const NBestComplete &best) {
-      assert(hypos_.empty() || !(hypos_.front().state == *best.state));
+      assert(hypos_.empty() || !(hypos_.front().state == *best.state) || hypos_.front().feature_state != best.feature_state);
       HypoState hypo;
       hypo.history = best.history;
       hypo.state = *best.state;
       hypo.score = best.score;
+      hypo.feature_state = best.feature_state;
       hypos_.push_back(hypo);
     }
     void AppendHypothesis(const HypoState &hypo) {
@@ -79,6 +81,10 @@ class VertexNode {
       assert(hypos_.size() == 1);
       return hypos_.front().history;
     }
+    const void *FeatureState() const {
+      assert(hypos_.size() == 1);
+      return hypos_.front().feature_state;
+    }
 
     VertexNode &operator[](size_t index) {
       assert(!extend_.empty());
@@ -142,6 +148,9 @@ class PartialVertex {
     const History End() const {
       return back_->End();
     }
+    const void *FeatureState() const {
+      return back_->FeatureState();
+    }
 
   private:
     VertexNode *back_;
@@ -1,10 +1,14 @@
 #ifndef SEARCH_VERTEX_GENERATOR__
 #define SEARCH_VERTEX_GENERATOR__
 
+#include "search/context.hh"
 #include "search/edge.hh"
+#include "search/features.hh"
 #include "search/types.hh"
 #include "search/vertex.hh"
 
+#include <boost/unordered_map.hpp>
+
 namespace lm {
 namespace ngram {
 struct ChartState;
@@ -13,15 +17,16 @@ struct ChartState;
 
 namespace search {
 
-class ContextBase;
-
 // Output makes the single-best or n-best list.
 template <class Output> class VertexGenerator {
   public:
-    VertexGenerator(ContextBase &context, Vertex &gen, Output &nbest) : context_(context), gen_(gen), nbest_(nbest) {}
+    VertexGenerator(ContextBase &context, Vertex &gen, Output &nbest)
+      : context_(context), gen_(gen),
+        existing_(0, RecombinationHash(context.GetFeatures()), RecombinationEqual(context.GetFeatures())),
+        nbest_(nbest) {}
 
     void NewHypothesis(PartialEdge partial) {
-      nbest_.Add(existing_[hash_value(partial.CompletedState())], partial);
+      nbest_.Add(existing_[RecombinationKey(hash_value(partial.CompletedState()), partial.GetFeatureState())], partial);
     }
 
     void FinishedSearch() {
@@ -40,7 +45,7 @@ template <class Output> class VertexGenerator {
 
     Vertex &gen_;
 
-    typedef boost::unordered_map<uint64_t, typename Output::Combine> Existing;
+    typedef boost::unordered_map<RecombinationKey, typename Output::Combine, RecombinationHash, RecombinationEqual> Existing;
     Existing existing_;
 
     Output &nbest_;
@@ -51,9 +51,10 @@ FilePiece::FilePiece(int fd, const char *name, std::ostream *show_progress, std:
   Initialize(NamePossiblyFind(fd, name).c_str(), show_progress, min_buffer);
 }
 
-FilePiece::FilePiece(std::istream &stream, const char *name, std::size_t min_buffer) :
+FilePiece::FilePiece(std::istream &stream, const char *name, std::size_t min_buffer, uint64_t offset) :
   total_size_(kBadSize), page_(SizePage()) {
   InitializeNoRead("istream", min_buffer);
+  mapped_offset_ = offset;
 
   fallback_to_read_ = true;
   data_.reset(MallocOrThrow(default_map_size_), default_map_size_, scoped_memory::MALLOC_ALLOCATED);
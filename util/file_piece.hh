@@ -35,9 +35,10 @@ class FilePiece {
     /* Read from an istream.  Don't use this if you can avoid it.  Raw fd IO is
      * much faster.  But sometimes you just have an istream like Boost's HTTP
      * server and want to parse it the same way.
-     * name is just used for messages and FileName().
+     * name is just used for messages and FileName().  offset is where the
+     * stream starts in a larger file, so that Offset() counts from there.
      */
-    explicit FilePiece(std::istream &stream, const char *name = NULL, std::size_t min_buffer = 1048576);
+    explicit FilePiece(std::istream &stream, const char *name = NULL, std::size_t min_buffer = 1048576, uint64_t offset = 0);
 
     ~FilePiece();
 
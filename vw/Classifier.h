@@ -7,7 +7,10 @@
 #include <sstream>
 #include <deque>
 #include <vector>
+#include <utility>
+#include <stdint.h>
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <boost/noncopyable.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -25,6 +28,13 @@ class ezexample;
 namespace Discriminative
 {
 
+/**
+ * A feature whose name has been hashed by a classifier, with its value.
+ */
+typedef uint32_t FeatureIdType;
+typedef std::pair<FeatureIdType, float> FeatureType;
+typedef std::vector<FeatureType> FeatureVector;
+
 /**
 * Abstract class to be implemented by classifiers.
 */
@@ -53,6 +63,45 @@ public:
    */
   virtual float Predict(const StringPiece &label) = 0;
 
+  /**
+   * Hash the name of a feature that does not depend on the class, so that the
+   * feature can be added with AddLabelIndependentFeatures() as often as needed.
+   * The ids are only valid for this classifier.
+   */
+  virtual FeatureType MakeLabelIndependentFeature(const StringPiece &name, float value) = 0;
+
+  /**
+   * Hash the name of a feature that is specific for a class.
+   */
+  virtual FeatureType MakeLabelDependentFeature(const StringPiece &name, float value) = 0;
+
+  /**
+   * Add hashed features, as AddLabelIndependentFeature() and
+   * AddLabelDependentFeature() add named ones.
+   */
+  virtual void AddLabelIndependentFeatures(const FeatureVector &features) = 0;
+  virtual void AddLabelDependentFeatures(const FeatureVector &features) = 0;
+
+  /**
+   * Forget the hashed features, whose ids are no longer valid afterwards.
+   * Called at the start of each input sentence.
+   */
+  virtual void ForgetFeatures() {}
+
+  /**
+   * Predict the losses of several classes with the current label-independent
+   * features; labelFeatures[i] are the label-dependent features of labels[i].
+   */
+  virtual void Predict(const std::vector<std::string> &labels
+                       , const std::vector<FeatureVector> &labelFeatures
+                       , std::vector<float> &losses) {
+    losses.resize(labels.size());
+    for (size_t i = 0; i < labels.size(); i++) {
+      AddLabelDependentFeatures(labelFeatures[i]);
+      losses[i] = Predict(labels[i]);
+    }
+  }
+
   // helper methods for indicator features
   void AddLabelIndependentFeature(const StringPiece &name) {
     AddLabelIndependentFeature(name, 1.0);
@@ -62,6 +111,14 @@ public:
     AddLabelDependentFeature(name, 1.0);
   }
 
+  FeatureType MakeLabelIndependentFeature(const StringPiece &name) {
+    return MakeLabelIndependentFeature(name, 1.0);
+  }
+
+  FeatureType MakeLabelDependentFeature(const StringPiece &name) {
+    return MakeLabelDependentFeature(name, 1.0);
+  }
+
   virtual ~Classifier() {}
 
 protected:
@@ -100,8 +157,18 @@ public:
   virtual void Train(const StringPiece &label, float loss);
   virtual float Predict(const StringPiece &label);
 
+  virtual FeatureType MakeLabelIndependentFeature(const StringPiece &name, float value);
+  virtual FeatureType MakeLabelDependentFeature(const StringPiece &name, float value);
+  virtual void AddLabelIndependentFeatures(const FeatureVector &features);
+  virtual void AddLabelDependentFeatures(const FeatureVector &features);
+  virtual void ForgetFeatures();
+
 protected:
   void AddFeature(const StringPiece &name, float value);
+  void AddFeature(const FeatureType &feature);
+  void StartSource();
+  void StartTarget();
+  FeatureType MakeFeature(const StringPiece &name, float value);
 
   bool m_isFirstSource, m_isFirstTarget, m_isFirstExample;
 
@@ -109,6 +176,10 @@ private:
   boost::iostreams::filtering_ostream m_bfos;
   std::deque<std::string> m_outputBuffer;
 
+  // escaped names of the features hashed for the current sentence, by id
+  std::vector<std::string> m_featureNames;
+  boost::unordered_map<std::string, FeatureIdType> m_featureIds;
+
   void WriteBuffer();
 };
 
@@ -126,10 +197,20 @@ public:
   virtual void Train(const StringPiece &label, float loss);
   virtual float Predict(const StringPiece &label);
 
+  virtual FeatureType MakeLabelIndependentFeature(const StringPiece &name, float value);
+  virtual FeatureType MakeLabelDependentFeature(const StringPiece &name, float value);
+  virtual void AddLabelIndependentFeatures(const FeatureVector &features);
+  virtual void AddLabelDependentFeatures(const FeatureVector &features);
+  virtual void Predict(const std::vector<std::string> &labels
+                       , const std::vector<FeatureVector> &labelFeatures
+                       , std::vector<float> &losses);
+
   friend class ClassifierFactory;
 
 protected:
   void AddFeature(const StringPiece &name, float values);
+  void StartSource();
+  void StartTarget();
 
   ::vw *m_VWInstance, *m_VWParser;
   ::ezexample *m_ex;
@@ -137,10 +218,13 @@ protected:
   // deleted at end; if false, then we own the VW instance and must clean up after it.
   bool m_sharedVwInstance;
   bool m_isFirstSource, m_isFirstTarget;
+  // hash seeds of the source and target namespaces, as ezexample uses them
+  FeatureIdType m_sourceSeed, m_targetSeed;
 
 private:
   // instantiation by classifier factory
   VWPredictor(vw * instance, const std::string &vwOption);
+  void InitSeeds();
 };
 
 /**
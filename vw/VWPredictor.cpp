@@ -17,6 +17,7 @@ VWPredictor::VWPredictor(const string &modelFile, const string &vwOptions)
   m_sharedVwInstance = false;
   m_ex = new ::ezexample(m_VWInstance, false, m_VWParser);
   m_isFirstSource = m_isFirstTarget = true;
+  InitSeeds();
 }
 
 VWPredictor::VWPredictor(vw *instance, const string &vwOptions)
@@ -26,6 +27,14 @@ VWPredictor::VWPredictor(vw *instance, const string &vwOptions)
   m_sharedVwInstance = true;
   m_ex = new ::ezexample(m_VWInstance, false, m_VWParser);
   m_isFirstSource = m_isFirstTarget = true;
+  InitSeeds();
+}
+
+void VWPredictor::InitSeeds()
+{
+  // ezexample hashes the features of a namespace with the hash of its name
+  m_sourceSeed = VW::hash_space(*m_VWParser, "s");
+  m_targetSeed = VW::hash_space(*m_VWParser, "t");
 }
 
 VWPredictor::~VWPredictor()
@@ -37,6 +46,44 @@ VWPredictor::~VWPredictor()
 }
 
 void VWPredictor::AddLabelIndependentFeature(const StringPiece &name, float value)
+{
+  StartSource();
+  AddFeature(name, value); // namespace 's' is set up, add the feature
+}
+
+void VWPredictor::AddLabelDependentFeature(const StringPiece &name, float value)
+{
+  StartTarget();
+  AddFeature(name, value);
+}
+
+FeatureType VWPredictor::MakeLabelIndependentFeature(const StringPiece &name, float value)
+{
+  return FeatureType(VW::hash_feature(*m_VWParser, EscapeSpecialChars(name.as_string()), m_sourceSeed), value);
+}
+
+FeatureType VWPredictor::MakeLabelDependentFeature(const StringPiece &name, float value)
+{
+  return FeatureType(VW::hash_feature(*m_VWParser, EscapeSpecialChars(name.as_string()), m_targetSeed), value);
+}
+
+void VWPredictor::AddLabelIndependentFeatures(const FeatureVector &features)
+{
+  for (FeatureVector::const_iterator it = features.begin(); it != features.end(); ++it) {
+    StartSource();
+    m_ex->addf(it->first, it->second);
+  }
+}
+
+void VWPredictor::AddLabelDependentFeatures(const FeatureVector &features)
+{
+  for (FeatureVector::const_iterator it = features.begin(); it != features.end(); ++it) {
+    StartTarget();
+    m_ex->addf(it->first, it->second);
+  }
+}
+
+void VWPredictor::StartSource()
 {
   // label-independent features are kept in a different feature namespace ('s' = source)
 
@@ -48,10 +95,9 @@ void VWPredictor::AddLabelIndependentFeature(const StringPiece &name, float valu
     m_ex->addns('s');
     if (DEBUG) std::cerr << "VW :: Setting source namespace\n";
   }
-  AddFeature(name, value); // namespace 's' is set up, add the feature
 }
 
-void VWPredictor::AddLabelDependentFeature(const StringPiece &name, float value)
+void VWPredictor::StartTarget()
 {
   // VW does not use the label directly, instead, we do a Cartesian product between source and target feature
   // namespaces, where the source namespace ('s') contains label-independent features and the target
@@ -63,7 +109,6 @@ void VWPredictor::AddLabelDependentFeature(const StringPiece &name, float value)
     m_ex->addns('t');
     if (DEBUG) std::cerr << "VW :: Setting target namespace\n";
   }
-  AddFeature(name, value);
 }
 
 void VWPredictor::Train(const StringPiece &label, float loss)
@@ -82,6 +127,29 @@ float VWPredictor::Predict(const StringPiece &label)
   return loss;
 }
 
+// Adds the label-dependent features straight to the example, with the
+// target namespace even when a label has none.
+void VWPredictor::Predict(const vector<string> &labels
+                          , const vector<FeatureVector> &labelFeatures
+                          , vector<float> &losses)
+{
+  StartSource(); // clears the example if it has no source features
+  losses.resize(labels.size());
+  for (size_t i = 0; i < labels.size(); i++) {
+    m_ex->addns('t');
+    const FeatureVector &features = labelFeatures[i];
+    for (FeatureVector::const_iterator it = features.begin(); it != features.end(); ++it) {
+      m_ex->addf(it->first, it->second);
+    }
+    m_ex->set_label(labels[i]);
+    losses[i] = m_ex->predict_partial();
+    if (DEBUG) std::cerr << "VW :: Predicted loss: " << losses[i] << "\n";
+    m_ex->remns(); // remove target namespace
+  }
+  m_isFirstSource = true;
+  m_isFirstTarget = true;
+}
+
 void VWPredictor::AddFeature(const StringPiece &name, float value)
 {
   if (DEBUG) std::cerr << "VW :: Adding feature: " << EscapeSpecialChars(name.as_string()) << ":" << value << "\n";
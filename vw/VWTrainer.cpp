@@ -26,6 +26,50 @@ VWTrainer::~VWTrainer()
 }
 
 void VWTrainer::AddLabelIndependentFeature(const StringPiece &name, float value)
+{
+  StartSource();
+  AddFeature(name, value);
+}
+
+void VWTrainer::AddLabelDependentFeature(const StringPiece &name, float value)
+{
+  StartTarget();
+  AddFeature(name, value);
+}
+
+FeatureType VWTrainer::MakeLabelIndependentFeature(const StringPiece &name, float value)
+{
+  return MakeFeature(name, value);
+}
+
+FeatureType VWTrainer::MakeLabelDependentFeature(const StringPiece &name, float value)
+{
+  return MakeFeature(name, value);
+}
+
+void VWTrainer::AddLabelIndependentFeatures(const FeatureVector &features)
+{
+  for (FeatureVector::const_iterator it = features.begin(); it != features.end(); ++it) {
+    StartSource();
+    AddFeature(*it);
+  }
+}
+
+void VWTrainer::AddLabelDependentFeatures(const FeatureVector &features)
+{
+  for (FeatureVector::const_iterator it = features.begin(); it != features.end(); ++it) {
+    StartTarget();
+    AddFeature(*it);
+  }
+}
+
+void VWTrainer::ForgetFeatures()
+{
+  m_featureNames.clear();
+  m_featureIds.clear();
+}
+
+void VWTrainer::StartSource()
 {
   if (m_isFirstSource) {
     if (m_isFirstExample) {
@@ -41,11 +85,9 @@ void VWTrainer::AddLabelIndependentFeature(const StringPiece &name, float value)
 
     m_outputBuffer.push_back("shared |s");
   }
-
-  AddFeature(name, value);
 }
 
-void VWTrainer::AddLabelDependentFeature(const StringPiece &name, float value)
+void VWTrainer::StartTarget()
 {
   if (m_isFirstTarget) {
     m_isFirstTarget = false;
@@ -54,8 +96,6 @@ void VWTrainer::AddLabelDependentFeature(const StringPiece &name, float value)
 
     m_outputBuffer.push_back("|t");
   }
-
-  AddFeature(name, value);
 }
 
 void VWTrainer::Train(const StringPiece &label, float loss)
@@ -76,6 +116,23 @@ void VWTrainer::AddFeature(const StringPiece &name, float value)
   m_outputBuffer.push_back(EscapeSpecialChars(name.as_string()) + ":" + SPrint(value));
 }
 
+void VWTrainer::AddFeature(const FeatureType &feature)
+{
+  m_outputBuffer.push_back(m_featureNames[feature.first] + ":" + SPrint(feature.second));
+}
+
+// The training file is text, so the id of a feature just numbers its escaped
+// name, which is then written without being escaped again.
+FeatureType VWTrainer::MakeFeature(const StringPiece &name, float value)
+{
+  std::string escaped = EscapeSpecialChars(name.as_string());
+  std::pair<boost::unordered_map<std::string, FeatureIdType>::iterator, bool> inserted =
+    m_featureIds.insert(std::make_pair(escaped, FeatureIdType(m_featureNames.size())));
+  if (inserted.second)
+    m_featureNames.push_back(escaped);
+  return FeatureType(inserted.first->second, value);
+}
+
 void VWTrainer::WriteBuffer()
 {
   m_bfos << Join(" ", m_outputBuffer.begin(), m_outputBuffer.end()) << "\n";